@@ -0,0 +1,229 @@
+/* components/arena/arena.c
+ *
+ * Per-job bump allocator and the cJSON hooks that draw from it:
+ *  - arena_alloc() rounds up to ARENA_ALIGN and moves one offset
+ *  - the hooks look up the calling task's bound arena (a few entries,
+ *    scanned linearly) and fall back to malloc() when there is none or it
+ *    is full
+ *  - the free hook ignores pointers inside any registered arena, so trees
+ *    from both sources can be deleted the usual way
+ */
+
+#include "arena.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "cJSON.h"
+
+static const char *TAG = "ARENA";
+
+static struct
+{
+    portMUX_TYPE lock; // guards registration and binding changes
+    arena_t *arenas[ARENA_MAX_ARENAS];
+    uint8_t n_arenas;
+    struct
+    {
+        TaskHandle_t task;
+        arena_t *arena;
+    } bound[ARENA_MAX_ARENAS];
+    bool hooks_installed;
+} s_arena = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static bool _owned(const void *p)
+{
+    const uint8_t *b = p;
+    for (uint8_t i = 0; i < s_arena.n_arenas; i++)
+    {
+        const arena_t *a = s_arena.arenas[i];
+        if (b >= a->base && b < a->base + a->size)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Only the calling task ever changes its own entry, so no lock is needed */
+static arena_t *_bound_arena(void)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    for (uint8_t i = 0; i < ARENA_MAX_ARENAS; i++)
+    {
+        if (s_arena.bound[i].task == self)
+        {
+            return s_arena.bound[i].arena;
+        }
+    }
+    return NULL;
+}
+
+static void *_cjson_malloc(size_t size)
+{
+    arena_t *a = _bound_arena();
+    if (a)
+    {
+        void *p = arena_alloc(a, size);
+        if (p)
+        {
+            return p;
+        }
+        a->fallbacks++;
+        perf_count(a->m_fallbacks, 1);
+    }
+    return malloc(size);
+}
+
+static void _cjson_free(void *p)
+{
+    if (p && !_owned(p))
+    {
+        free(p);
+    }
+}
+
+static perf_metric_t *_metric(arena_t *a, int i, const char *suffix,
+                              perf_metric_t *(*reg)(const char *))
+{
+    snprintf(a->metric_names[i], sizeof(a->metric_names[i]), "arena.%s.%s", a->name, suffix);
+    return reg(a->metric_names[i]);
+}
+
+esp_err_t arena_init(arena_t *a, const char *name, size_t size)
+{
+    if (!a || !name || size == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(a, 0, sizeof(*a));
+    strlcpy(a->name, name, sizeof(a->name));
+    a->size = size;
+    a->base = malloc(size);
+    if (!a->base)
+    {
+        ESP_LOGE(TAG, "%s: no %u byte block", a->name, (unsigned)size);
+        return ESP_ERR_NO_MEM;
+    }
+
+    taskENTER_CRITICAL(&s_arena.lock);
+    bool full = s_arena.n_arenas == ARENA_MAX_ARENAS;
+    if (!full)
+    {
+        s_arena.arenas[s_arena.n_arenas++] = a;
+    }
+    bool install = !s_arena.hooks_installed;
+    s_arena.hooks_installed = true;
+    taskEXIT_CRITICAL(&s_arena.lock);
+    if (full)
+    {
+        free(a->base);
+        a->base = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    if (install)
+    {
+        // plain malloc/free until a task binds an arena, so this is safe at any time
+        cJSON_Hooks hooks = {
+            .malloc_fn = _cjson_malloc,
+            .free_fn = _cjson_free,
+        };
+        cJSON_InitHooks(&hooks);
+    }
+
+    a->m_high_water = _metric(a, 0, "high_water", perf_gauge);
+    a->m_fallbacks = _metric(a, 1, "fallbacks", perf_counter);
+    ESP_LOGI(TAG, "%s: %u bytes", a->name, (unsigned)size);
+    return ESP_OK;
+}
+
+void arena_deinit(arena_t *a)
+{
+    if (!a->base)
+    {
+        return;
+    }
+    taskENTER_CRITICAL(&s_arena.lock);
+    for (uint8_t i = 0; i < s_arena.n_arenas; i++)
+    {
+        if (s_arena.arenas[i] == a)
+        {
+            s_arena.arenas[i] = s_arena.arenas[--s_arena.n_arenas];
+            s_arena.arenas[s_arena.n_arenas] = NULL;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&s_arena.lock);
+    free(a->base);
+    a->base = NULL;
+    a->size = 0;
+    a->used = 0;
+}
+
+void *arena_alloc(arena_t *a, size_t size)
+{
+    size_t need = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if (!a->base || need < size || need > a->size - a->used)
+    {
+        a->failures++;
+        return NULL;
+    }
+    void *p = a->base + a->used;
+    a->used += need;
+    if (a->used > a->high_water)
+    {
+        a->high_water = a->used;
+        perf_gauge_set(a->m_high_water, (int32_t)a->high_water);
+    }
+    return p;
+}
+
+void arena_reset(arena_t *a)
+{
+    a->used = 0;
+    a->resets++;
+}
+
+void arena_release(arena_t *a, size_t mark)
+{
+    if (mark < a->used)
+    {
+        a->used = mark;
+    }
+}
+
+void arena_bind_cjson(arena_t *a)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    taskENTER_CRITICAL(&s_arena.lock);
+    int slot = -1;
+    for (int i = 0; i < ARENA_MAX_ARENAS; i++)
+    {
+        if (s_arena.bound[i].task == self)
+        {
+            slot = i;
+            break;
+        }
+        if (slot < 0 && s_arena.bound[i].task == NULL)
+        {
+            slot = i;
+        }
+    }
+    if (slot >= 0)
+    {
+        s_arena.bound[slot].arena = a;
+        s_arena.bound[slot].task = a ? self : NULL;
+    }
+    taskEXIT_CRITICAL(&s_arena.lock);
+    if (slot < 0)
+    {
+        ESP_LOGW(TAG, "No binding slot left, cJSON stays on the heap");
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "perf_metrics.h"
+
+#define ARENA_MAX_ARENAS 4
+#define ARENA_ALIGN 8
+#define ARENA_NAME_MAX 12
+
+/**
+ * Bump allocator over one buffer taken from the heap at init and never
+ * returned. A job (one upload, one token refresh) resets the arena, takes
+ * what it needs and simply drops it at the end: no free() on any path, so
+ * error returns cannot leak, and the heap sees no per-job traffic to
+ * fragment it. Use one arena per task; nothing here is locked.
+ */
+typedef struct
+{
+    char name[ARENA_NAME_MAX];
+    uint8_t *base;
+    size_t size;
+    size_t used;
+    size_t high_water;  // most ever used between two resets
+    uint32_t resets;
+    uint32_t failures;  // arena_alloc() calls that did not fit
+    uint32_t fallbacks; // cJSON allocations that went to the heap instead
+    char metric_names[2][ARENA_NAME_MAX + 16];
+    perf_metric_t *m_high_water;
+    perf_metric_t *m_fallbacks;
+} arena_t;
+
+/**
+ * @brief  Allocate the buffer and register the arena; also installs the
+ *         cJSON hooks (see arena_bind_cjson()). Exports the gauge
+ *         "arena.<name>.high_water" and the counter "arena.<name>.fallbacks".
+ */
+esp_err_t arena_init(arena_t *a, const char *name, size_t size);
+
+/**
+ * @brief  Unregister the arena and return its buffer, for a start-up that
+ *         fails after arena_init(). No task may still be bound to it. Safe
+ *         on an arena that was never (or not successfully) initialised.
+ */
+void arena_deinit(arena_t *a);
+
+/** @brief ARENA_ALIGN-aligned block, or NULL if it does not fit. */
+void *arena_alloc(arena_t *a, size_t size);
+
+/** @brief Drop everything allocated since the last reset. */
+void arena_reset(arena_t *a);
+
+/** @brief Current fill level, for arena_release(). */
+static inline size_t arena_mark(const arena_t *a)
+{
+    return a->used;
+}
+
+/** @brief Drop everything allocated since `mark`, e.g. before a retry. */
+void arena_release(arena_t *a, size_t mark);
+
+/**
+ * @brief  Route cJSON allocations made by the calling task to `a`, or back
+ *         to the heap with NULL. Other tasks are unaffected. cJSON_free()
+ *         and cJSON_Delete() on arena memory are no-ops, so trees built
+ *         while bound must not outlive the next arena_reset(). When the
+ *         arena is full, allocations fall back to the heap and are counted.
+ */
+void arena_bind_cjson(arena_t *a);
@@ -0,0 +1,158 @@
+/* components/breaker/breaker.c
+ *
+ * Jittered exponential backoff, retry budget and circuit breaker for the
+ * cloud endpoints (Firestore commits, OAuth2 token refresh). Pure state
+ * machine over caller-supplied time; see breaker.h.
+ */
+
+#include "breaker.h"
+
+#include <string.h>
+
+static uint32_t _rand(breaker_t *b)
+{
+    // xorshift32
+    uint32_t x = b->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    b->rng = x;
+    return x;
+}
+
+/* Somewhere in [delay/2, delay] */
+static uint32_t _jitter(breaker_t *b, uint32_t delay_ms)
+{
+    uint32_t half = delay_ms / 2;
+    return half + (half ? _rand(b) % (half + 1) : 0);
+}
+
+static void _refill(breaker_t *b, int64_t now_us)
+{
+    if (!b->cfg.refill_ms || b->budget >= b->cfg.budget)
+    {
+        b->refill_us = now_us;
+        return;
+    }
+    int64_t step = (int64_t)b->cfg.refill_ms * 1000;
+    int64_t n = (now_us - b->refill_us) / step;
+    if (n > 0)
+    {
+        uint64_t budget = b->budget + (uint64_t)n;
+        b->budget = budget > b->cfg.budget ? b->cfg.budget : (uint32_t)budget;
+        b->refill_us += n * step;
+    }
+}
+
+static void _open(breaker_t *b, int64_t now_us)
+{
+    if (b->state == BREAKER_CLOSED)
+    {
+        b->opens++; // a failed probe only extends the open period
+    }
+    b->state = BREAKER_OPEN;
+    b->next_us = now_us + (int64_t)_jitter(b, b->cfg.max_ms) * 1000;
+}
+
+void breaker_init(breaker_t *b, const breaker_cfg_t *cfg, uint32_t seed, int64_t now_us)
+{
+    memset(b, 0, sizeof(*b));
+    b->cfg = *cfg;
+    b->rng = seed ? seed : 0x9E3779B9u;
+    b->budget = cfg->budget;
+    b->refill_us = now_us;
+    b->next_us = now_us;
+}
+
+bool breaker_allow(breaker_t *b, int64_t now_us)
+{
+    if (b->state == BREAKER_HALF_OPEN || now_us < b->next_us)
+    {
+        b->rejected++;
+        return false;
+    }
+    if (b->state == BREAKER_OPEN)
+    {
+        b->state = BREAKER_HALF_OPEN;
+    }
+    b->attempts++;
+    return true;
+}
+
+breaker_state_t breaker_success(breaker_t *b, int64_t now_us)
+{
+    _refill(b, now_us);
+    b->state = BREAKER_CLOSED;
+    b->consecutive = 0;
+    b->delay_ms = 0;
+    b->next_us = now_us;
+    return b->state;
+}
+
+breaker_state_t breaker_failure(breaker_t *b, int64_t now_us)
+{
+    _refill(b, now_us);
+    b->failures++;
+    b->consecutive++;
+    if (b->budget)
+    {
+        b->budget--;
+    }
+
+    if (b->state == BREAKER_HALF_OPEN || b->consecutive >= b->cfg.threshold || !b->budget)
+    {
+        _open(b, now_us);
+        return b->state;
+    }
+
+    b->delay_ms = b->delay_ms ? b->delay_ms * 2 : b->cfg.base_ms;
+    if (b->delay_ms > b->cfg.max_ms)
+    {
+        b->delay_ms = b->cfg.max_ms;
+    }
+    b->next_us = now_us + (int64_t)_jitter(b, b->delay_ms) * 1000;
+    return b->state;
+}
+
+void breaker_cancel(breaker_t *b)
+{
+    if (b->state == BREAKER_HALF_OPEN)
+    {
+        b->state = BREAKER_OPEN;
+    }
+    if (b->attempts)
+    {
+        b->attempts--;
+    }
+}
+
+int64_t breaker_wait_us(const breaker_t *b, int64_t now_us)
+{
+    return b->next_us > now_us ? b->next_us - now_us : 0;
+}
+
+void breaker_get_stats(const breaker_t *b, int64_t now_us, breaker_stats_t *out)
+{
+    out->state = b->state;
+    out->consecutive = b->consecutive;
+    out->budget = b->budget;
+    out->wait_ms = (uint32_t)(breaker_wait_us(b, now_us) / 1000);
+    out->attempts = b->attempts;
+    out->failures = b->failures;
+    out->opens = b->opens;
+    out->rejected = b->rejected;
+}
+
+const char *breaker_state_name(breaker_state_t s)
+{
+    switch (s)
+    {
+    case BREAKER_CLOSED:
+        return "closed";
+    case BREAKER_OPEN:
+        return "open";
+    case BREAKER_HALF_OPEN:
+        return "half-open";
+    }
+    return "?";
+}
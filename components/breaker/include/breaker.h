@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Retry gate for a remote endpoint: jittered exponential backoff, a retry
+ * budget and a circuit breaker in one.
+ *
+ *  - After a failure the next attempt waits base_ms, 2 * base_ms, ... up to
+ *    max_ms, each picked at random from [delay/2, delay] so nodes that lost
+ *    the link together do not come back in lockstep.
+ *  - `threshold` consecutive failures open the breaker: nothing is attempted
+ *    for max_ms, then exactly one probe is allowed (half-open). Its success
+ *    closes the breaker, its failure opens it again.
+ *  - Every failure also spends one token of a budget that refills by one
+ *    every refill_ms. A link that fails often but not consecutively (a
+ *    flapping one) runs the budget dry and opens the breaker as well.
+ *
+ * Time is passed in by the caller (esp_timer on the device, the simulated
+ * clock on the host). Not thread-safe; callers serialise access.
+ */
+
+typedef enum
+{
+    BREAKER_CLOSED,
+    BREAKER_OPEN,
+    BREAKER_HALF_OPEN, /* one probe in flight */
+} breaker_state_t;
+
+typedef struct
+{
+    uint32_t base_ms;   /* first retry delay */
+    uint32_t max_ms;    /* backoff cap, and how long the breaker stays open */
+    uint32_t threshold; /* consecutive failures that open the breaker */
+    uint32_t budget;    /* failures absorbed before the breaker opens anyway */
+    uint32_t refill_ms; /* one budget token back per this long */
+} breaker_cfg_t;
+
+typedef struct
+{
+    breaker_state_t state;
+    uint32_t consecutive; /* failures since the last success */
+    uint32_t budget;      /* tokens left */
+    uint32_t wait_ms;     /* until the next attempt is allowed */
+    uint32_t attempts;
+    uint32_t failures;
+    uint32_t opens;
+    uint32_t rejected;    /* attempts refused while backing off or open */
+} breaker_stats_t;
+
+typedef struct
+{
+    breaker_cfg_t cfg;
+    breaker_state_t state;
+    uint32_t consecutive;
+    uint32_t delay_ms;    /* un-jittered delay of the current backoff step */
+    int64_t next_us;      /* no attempt before this */
+    uint32_t budget;
+    int64_t refill_us;    /* last budget refill */
+    uint32_t rng;
+    uint32_t attempts;
+    uint32_t failures;
+    uint32_t opens;
+    uint32_t rejected;
+} breaker_t;
+
+/** @brief Start closed with a full budget; `seed` feeds the jitter (non-zero). */
+void breaker_init(breaker_t *b, const breaker_cfg_t *cfg, uint32_t seed, int64_t now_us);
+
+/**
+ * @brief  May an attempt start now? An open breaker whose wait is over
+ *         turns half-open and allows this one attempt, the probe.
+ */
+bool breaker_allow(breaker_t *b, int64_t now_us);
+
+/** @brief Report the outcome of an allowed attempt; returns the new state. */
+breaker_state_t breaker_success(breaker_t *b, int64_t now_us);
+breaker_state_t breaker_failure(breaker_t *b, int64_t now_us);
+
+/**
+ * @brief  Take back an allowed attempt that never reached the endpoint
+ *         (e.g. a local read failed first). Counts no outcome; a half-open
+ *         breaker goes back to open with its wait already over, so the
+ *         next breaker_allow() is the probe again.
+ */
+void breaker_cancel(breaker_t *b);
+
+/** @brief Microseconds until breaker_allow() can return true (0 = now). */
+int64_t breaker_wait_us(const breaker_t *b, int64_t now_us);
+
+void breaker_get_stats(const breaker_t *b, int64_t now_us, breaker_stats_t *out);
+
+/** @brief "closed", "open" or "half-open". */
+const char *breaker_state_name(breaker_state_t s);
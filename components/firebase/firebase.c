@@ -1,53 +1,66 @@
 /* components/firebase/firebase.c
  *
  * Firebase integration for ESP32-S3:
- *  - Obtain OAuth2 access token via JWT (RS256)
+ *  - OAuth2 access token from the credential manager (firebase_cred.c)
  *  - Send sensor data to Firestore via REST API
+ *  - Every buffer of a commit (auth header) comes from one arena, reset
+ *    per commit, and the compressor is allocated once while compression
+ *    is on, so the upload path makes no heap calls of its own
+ *  - The commit response is parsed as it is read (firestore_reader.c) and
+ *    turned into an ack/retry/reauth/drop decision for the uploader
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <sys/param.h>
 
 /* ESP-IDF headers */
 #include "esp_log.h"
 #include "esp_err.h"
 #include "esp_http_client.h"
+#include "esp_timer.h"
 #include "esp_tls.h"
 #include "nvs_flash.h"
 #include "nvs.h"
 
-/* mbedTLS for JWT signing */
-#include "mbedtls/base64.h"
-#include "mbedtls/md.h"
-#include "mbedtls/pk.h"
-
 /* JSON handling */
 #include "cJSON.h"
 
 /* Project header */
 #include "firebase.h"
+#include "firebase_conn.h"
+#include "firebase_cred.h"
+#include "firestore_writer.h"
+#include "firestore_reader.h"
+#include "gzip_stream.h"
+#include "perf_metrics.h"
+#include "arena.h"
 
 /* My modules*/
 #include "nvs_helper.h"
-#include "usb_helper.h"
+#include "config_cache.h"
 /*=============================================================================
  *                                CONSTANTS
  *============================================================================*/
 
-/* OAuth2 token endpoint and scope */
-#define TOKEN_URL "https://oauth2.googleapis.com/token"
-#define SCOPE "https://www.googleapis.com/auth/datastore"
-/* JWT expiration interval (seconds) */
-#define EXPIRATION_SEC 3600
-#define TOKEN_REFRESH_MARGIN 60
-
 /* HTTP buffer sizes */
 #define MAX_HTTP_OUTPUT_BUFFER 1024
 #define SVC_ACCT_EMAIL_SIZE 75
 #define PROJ_ID_SIZE 50
+#define FIRESTORE_READ_CHUNK 256 // response is parsed piece by piece, never held whole
+
+/* Access token; normally already cached by the credential task */
+#define TOKEN_SIZE 1200
+#define AUTH_HEADER_SIZE (TOKEN_SIZE + sizeof("Bearer "))
+#define TOKEN_WAIT_MS 20000
+
+/* Everything one commit allocates, plus alignment; the compressor state
+ * is separate and only exists while compression is on */
+#define UPLOAD_ARENA_SIZE (AUTH_HEADER_SIZE + 2 * ARENA_ALIGN)
 
 /*=============================================================================
  *                           EXTERNALLY EMBEDDED KEYS
@@ -57,20 +70,19 @@
  *============================================================================*/
 
 static const char *TAG = "FIREBASE";
-static char cached_token[1200] = {0};
-static time_t cached_expiry = 0;
-static const char *config_path = "/data/cfg.json";
+/* Long-lived Firestore connection (the oauth2 one lives in firebase_cred.c) */
+static firebase_conn_t s_store_conn = {.name = "firestore"};
+/* Scratch memory of the commit in progress; only the uploader task commits */
+static arena_t s_upload_arena;
+/* Set when the server (or a proxy) answered a gzip body with a 4xx; bodies
+ * then go out plain on this connection until cfg.json changes */
+static struct
+{
+    bool refused;
+    uint32_t cfg_generation;
+    gzip_stream_t *gz; /* ~21 KB, allocated once compression is wanted */
+} s_gzip;
 #define COMMIT_URL_FMT "https://firestore.googleapis.com/v1/projects/%s/databases/(default)/documents:commit"
-/*=============================================================================
- *                         FORWARD DECLARATIONS
- *============================================================================*/
-
-/** @brief mbedTLS RNG callback for signing. */
-static int _mbedtls_rng(void *ctx, unsigned char *buf, size_t len);
-
-/** @brief RS256-sign `header.payload` and base64-encode the signature. */
-static esp_err_t _sign_jwt_rs256(const char *header_payload, char *out_sig_b64, size_t sig_len);
-
 /*=============================================================================
  *                           PRIVATE HELPER FUNCTIONS
  *============================================================================*/
@@ -85,313 +97,314 @@ void dump_hex16(const char *tag, const uint8_t *buf)
     printf("\n");
 }
 
-static int _mbedtls_rng(void *ctx, unsigned char *buf, size_t len)
+bool get_json_string(const cJSON *root, const char *key, char *out_buf, size_t buf_len)
 {
-    (void)ctx;
-    esp_fill_random(buf, len);
-    return 0;
+    // 1) Find the item
+    cJSON *item = cJSON_GetObjectItem(root, key);
+    if (!item)
+    {
+        // key not found
+        return false;
+    }
+
+    // 2) Verify it’s a string
+    if (!cJSON_IsString(item) || (item->valuestring == NULL))
+    {
+        // wrong type
+        return false;
+    }
+
+    // 3) Copy safely into your buffer
+    // Option A: snprintf (always null‑terminates)
+    snprintf(out_buf, buf_len, "%s", item->valuestring);
+
+    return true;
+}
+
+/* Writes a request body through `sink` */
+typedef esp_err_t (*_body_fn)(void *ctx, firestore_sink_fn sink, void *sink_ctx);
+
+typedef struct
+{
+    const char *proj_id;
+    const avg_sample_t *records;
+    size_t count;
+} _records_body_t;
+
+static esp_err_t _conn_sink(void *ctx, const char *data, size_t len)
+{
+    return firebase_conn_write((firebase_conn_t *)ctx, data, len) == (int)len ? ESP_OK : ESP_FAIL;
 }
 
-static esp_err_t _sign_jwt_rs256(const char *header_payload,
-                                 char *out_sig_b64,
-                                 size_t sig_len)
+/* One HTTP/1.1 chunk per compressed piece, framed in a single write */
+static esp_err_t _chunked_sink(void *ctx, const char *data, size_t len)
 {
-    // get firebase_key from config
-    char *firebase_system_key = load_config_from_fat(config_path, "firebase_system_key");
-    if (!firebase_system_key)
+    char frame[GZIP_STREAM_OUT_CHUNK + 16];
+    if (len > GZIP_STREAM_OUT_CHUNK)
     {
-        ESP_LOGE("CONFIG_HELPER", "Did not load firebase_system_key");
-        return ESP_FAIL;
+        return ESP_ERR_INVALID_SIZE;
     }
+    int n = snprintf(frame, sizeof(frame), "%x\r\n", (unsigned)len);
+    memcpy(frame + n, data, len);
+    n += len;
+    frame[n++] = '\r';
+    frame[n++] = '\n';
+    return _conn_sink(ctx, frame, n);
+}
+
+static esp_err_t _gzip_sink(void *ctx, const char *data, size_t len)
+{
+    return gzip_stream_write((gzip_stream_t *)ctx, data, len);
+}
 
-    UBaseType_t watermark = uxTaskGetStackHighWaterMark(NULL);
-    ESP_LOGI("firebase_stack", "Sub task stack remaining: %u bytes", watermark);
+static esp_err_t _write_doc(void *ctx, firestore_sink_fn sink, void *sink_ctx)
+{
+    return sink(sink_ctx, (const char *)ctx, strlen((const char *)ctx));
+}
+
+static esp_err_t _write_records(void *ctx, firestore_sink_fn sink, void *sink_ctx)
+{
+    const _records_body_t *b = ctx;
+    return firestore_commit_stream(b->proj_id, b->records, b->count, sink, sink_ctx, NULL);
+}
 
-    mbedtls_pk_context pk;
-    mbedtls_pk_init(&pk);
+/* Smallest body worth compressing; cfg.json "firestore_gzip_min", 0 = never */
+static size_t _gzip_threshold(void)
+{
+    const char *val = config_cache_find("firestore_gzip_min");
+    return val ? (size_t)strtoul(val, NULL, 10) : FIREBASE_GZIP_MIN_BODY;
+}
 
-    /* Parse the service account private key */
-    int ret = mbedtls_pk_parse_key(&pk, (const unsigned char *)firebase_system_key, strlen(firebase_system_key) + 1, NULL, 0, _mbedtls_rng, NULL);
-    if (ret)
+/* Whether a body of `body_len` bytes goes out compressed */
+static bool _use_gzip(size_t body_len)
+{
+    if (s_gzip.refused && s_gzip.cfg_generation != config_cache_generation())
     {
-        ESP_LOGE(TAG, "Private key parse failed: %d", ret);
-        mbedtls_pk_free(&pk);
-        return ESP_FAIL;
+        s_gzip.refused = false; // cfg.json changed; perhaps the endpoint did too
     }
-
-    free(firebase_system_key);
-    ESP_LOGI(TAG, "key is parsed");
-
-    watermark = uxTaskGetStackHighWaterMark(NULL);
-    ESP_LOGI("firebase_stack", "Sub task stack remaining: %u bytes", watermark);
-
-    /* SHA256 hash of header.payload */
-    unsigned char hash[32];
-    mbedtls_md(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256),
-               (const unsigned char *)header_payload,
-               strlen(header_payload),
-               hash);
-    ESP_LOGI(TAG, "hash is created");
-    watermark = uxTaskGetStackHighWaterMark(NULL);
-    ESP_LOGI("firebase_stack", "Sub task stack remaining: %u bytes", watermark);
-
-/* Sign the hash */
-#define LEN_SIG 512
-    unsigned char *sig = malloc(LEN_SIG);
-    size_t sig_actual = 0;
-    ret = mbedtls_pk_sign(&pk, MBEDTLS_MD_SHA256,
-                          hash, sizeof(hash),
-                          sig, LEN_SIG, &sig_actual,
-                          _mbedtls_rng, NULL);
-    mbedtls_pk_free(&pk);
-    if (ret)
-    {
-        ESP_LOGE(TAG, "RSA sign failed: %d", ret);
-        return ESP_FAIL;
+    size_t gzip_min = _gzip_threshold();
+    if (s_gzip.refused || gzip_min == 0)
+    {
+        // off for good (until cfg.json changes); give the compressor back
+        free(s_gzip.gz);
+        s_gzip.gz = NULL;
+        return false;
     }
+    if (body_len < gzip_min)
+    {
+        return false;
+    }
+    if (!s_gzip.gz)
+    {
+        s_gzip.gz = malloc(sizeof(gzip_stream_t));
+        if (!s_gzip.gz)
+        {
+            ESP_LOGW(TAG, "No %u bytes for the compressor, sending plain",
+                     (unsigned)sizeof(gzip_stream_t));
+            return false;
+        }
+    }
+    return true;
+}
 
-    ESP_LOGI(TAG, "hash is signed");
-    watermark = uxTaskGetStackHighWaterMark(NULL);
-    ESP_LOGI("firebase_stack", "Sub task stack remaining: %u bytes", watermark);
+/* Commit body budget; cfg.json "firestore_max_body" */
+static size_t _max_body(void)
+{
+    const char *val = config_cache_find("firestore_max_body");
+    return val ? (size_t)strtoul(val, NULL, 10) : FIREBASE_MAX_BODY;
+}
 
-    /* Base64-encode the signature */
-    size_t olen = 0;
-    mbedtls_base64_encode((unsigned char *)out_sig_b64,
-                          sig_len, &olen,
-                          sig, sig_actual);
-    out_sig_b64[olen] = '\0';
+/**
+ * @brief  Compress the body on the fly and send it with chunked transfer
+ *         encoding, since the compressed length is only known at the end.
+ *         The compressor is the one _use_gzip() set up.
+ */
+static esp_err_t _write_body_gzip(size_t body_len, _body_fn write_body, void *body_ctx)
+{
+    gzip_stream_t *gz = s_gzip.gz;
+    if (!gz)
+    {
+        return ESP_ERR_NO_MEM;
+    }
 
-    ESP_LOGI(TAG, "signature is base64 encoded");
-    free(sig);
-    return ESP_OK;
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = gzip_stream_init(gz, _chunked_sink, &s_store_conn);
+    if (err == ESP_OK)
+    {
+        err = write_body(body_ctx, _gzip_sink, gz);
+    }
+    if (err == ESP_OK)
+    {
+        err = gzip_stream_finish(gz);
+    }
+    if (err == ESP_OK)
+    {
+        err = _conn_sink(&s_store_conn, "0\r\n\r\n", 5);
+    }
+    if (err == ESP_OK)
+    {
+        ESP_LOGI(TAG, "Body gzip %u -> %" PRIu32 " bytes (%.1fx) in %lld ms",
+                 (unsigned)body_len, gz->out_total,
+                 gz->out_total ? (double)body_len / gz->out_total : 0.0,
+                 (long long)((esp_timer_get_time() - start) / 1000));
+    }
+    return err;
 }
 
-/*=============================================================================
- *                           PUBLIC API FUNCTIONS
- *============================================================================*/
-
 /**
- * @brief  Obtain (and cache until expiry) a Firebase OAuth2 access token.
- * @param  out_token   Buffer to receive the access token string.
- * @param  max_len     Maximum length of `out_token`.
- * @param  svc_acct_email  Service account email string.
- * @return ESP_OK on success, otherwise an ESP error.
+ * @brief  Read the response body through the incremental parser and decide
+ *         what happens to the committed records.
+ * @return ESP_OK unless the body could not be read to the end; the socket
+ *         is only kept for reuse then.
  */
-esp_err_t firebase_get_access_token(char *out_token, size_t max_len, char *svc_acct_email)
+static esp_err_t _read_response(int status, size_t sent, firebase_commit_result_t *res)
 {
-    ESP_LOGI(TAG, "Requesting access token...");
+    firestore_resp_t resp;
+    firestore_resp_init(&resp, status);
 
-    /* Build JWT header and payload */
-    time_t now = time(NULL);
-    time_t exp = now + EXPIRATION_SEC;
+    char chunk[FIRESTORE_READ_CHUNK];
+    int n;
+    while ((n = firebase_conn_read(&s_store_conn, chunk, sizeof(chunk))) > 0)
+    {
+        firestore_resp_feed(&resp, chunk, n);
+    }
 
-    /* -----check for existing token----- */
-    if (cached_token[0] != '\0' && now < (cached_expiry - TOKEN_REFRESH_MARGIN))
+    res->http_status = status;
+    res->action = firestore_resp_action(&resp);
+    res->acked = firestore_resp_acked(&resp);
+    if (res->action == FIRESTORE_ACK)
     {
-        ESP_LOGI(TAG, "Reusing valid token, expires in %llds",
-                 (long long)(cached_expiry - now));
-        strlcpy(out_token, cached_token, max_len);
-        return ESP_OK;
+        ESP_LOGI(TAG, "Status %d, %" PRIu32 "/%u writes acknowledged (%" PRIu32 " bytes)",
+                 status, res->acked, (unsigned)sent, resp.bytes);
+        // a commit is all or nothing; a short list only means the body was cut
+        if (resp.complete && sent && res->acked != sent)
+        {
+            ESP_LOGW(TAG, "writeResults lists %" PRIu32 " of %u writes", res->acked, (unsigned)sent);
+        }
     }
-    ESP_LOGI(TAG, "Token expired or missing (now=%lld, expiry=%lld), fetching new one",
-             (long long)now, (long long)cached_expiry);
-
-    /* 1) Base64(header) */
-    const char hdr[] = "{\"alg\":\"RS256\",\"typ\":\"JWT\"}";
-    char hdr_b64[64];
-    size_t hdr_b64_len;
-    mbedtls_base64_encode((unsigned char *)hdr_b64,
-                          sizeof(hdr_b64), &hdr_b64_len,
-                          (const unsigned char *)hdr, strlen(hdr));
-    hdr_b64[hdr_b64_len] = '\0';
-
-/* 2) Base64(payload) */
-#define PAYLOAD_SIZE 512
-    char *payload = malloc(PAYLOAD_SIZE);
-    snprintf(payload, PAYLOAD_SIZE,
-             "{\"iss\":\"%s\",\"scope\":\"%s\",\"aud\":\"%s\",\"iat\":%lld,\"exp\":%lld}",
-             svc_acct_email, SCOPE, TOKEN_URL,
-             (long long)now, (long long)exp);
-    ESP_LOGI(TAG, "payload: %s", payload);
-#define PAYLOAD_B64_SIZE 512
-    char *payload_b64 = malloc(PAYLOAD_B64_SIZE);
-    size_t payload_b64_len;
-    mbedtls_base64_encode((unsigned char *)payload_b64,
-                          PAYLOAD_B64_SIZE, &payload_b64_len,
-                          (const unsigned char *)payload, strlen(payload));
-    payload_b64[payload_b64_len] = '\0';
-    ESP_LOGI(TAG, "%s", payload_b64);
-    free(payload);
-
-/* 3) Sign header.payload */
-#define HEADER_PAYLOAD_SIZE 1024
-    char *header_payload = malloc(HEADER_PAYLOAD_SIZE);
-    snprintf(header_payload, HEADER_PAYLOAD_SIZE, "%s.%s", hdr_b64, payload_b64);
-    ESP_LOGI(TAG, "%s", header_payload);
-    free(payload_b64);
-
-#define SIG_B64_SIZE 1024
-    char *sig_b64 = malloc(SIG_B64_SIZE);
-    _sign_jwt_rs256(header_payload, sig_b64, SIG_B64_SIZE);
-
-/* 4) Complete JWT */
-#define JWT_SIZE 1024
-    char *jwt = malloc(JWT_SIZE);
-    snprintf(jwt, JWT_SIZE, "%s.%s", header_payload, sig_b64);
-    free(header_payload);
-    free(sig_b64);
-    ESP_LOGI(TAG, "%s", jwt);
-
-    /* 5) Prepare OAuth2 POST body */
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "grant_type",
-                            "urn:ietf:params:oauth:grant-type:jwt-bearer");
-    cJSON_AddStringToObject(root, "assertion", jwt);
-    free(jwt);
-#define POST_DATA_SIZE 1024
-    char *post_data = malloc(POST_DATA_SIZE);
-    snprintf(post_data, POST_DATA_SIZE, "%s", cJSON_PrintUnformatted(root));
-    ESP_LOGI(TAG, "Post Data: %s", post_data);
-    cJSON_Delete(root);
-
-    /* 6) Perform HTTP POST */
-    // get firebase_key from config
-    char *firebase_cert = load_config_from_fat(config_path, "G_ROOT_CA_CERT");
-    if (!firebase_cert)
+    else
     {
-        ESP_LOGE("CONFIG_HELPER", "Did not load firebase_cert");
+        ESP_LOGW(TAG, "Status %d %s: %s (%s) -> %s", status,
+                 resp.error_status[0] ? resp.error_status : "-",
+                 resp.error_message[0] ? resp.error_message : "no message",
+                 resp.complete ? "complete" : "partial", firestore_action_name(res->action));
+    }
+    if (res->action == FIRESTORE_REAUTH)
+    {
+        /* Token revoked or clock skew; have the credential task sign a new one */
+        firebase_cred_invalidate();
+    }
+
+    if (n < 0)
+    {
+        ESP_LOGE(TAG, "Failed to read http request response");
         return ESP_FAIL;
     }
-    esp_http_client_config_t config = {
-        .url = TOKEN_URL,
-        .timeout_ms = 5000,
-        .cert_pem = firebase_cert,
-    };
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    esp_http_client_set_method(client, HTTP_METHOD_POST);
-    esp_http_client_set_header(client, "Content-Type", "application/json");
-    esp_http_client_set_post_field(client, post_data, strlen(post_data));
-    esp_err_t err = esp_http_client_open(client, strlen(post_data));
+    return ESP_OK;
+}
+
+/**
+ * @brief  One commit request over s_store_conn, the body gzip-compressed
+ *         with chunked encoding or plain with a Content-Length. Returns
+ *         ESP_OK once an HTTP response came back, whatever its status; `res`
+ *         says what it meant.
+ */
+static esp_err_t _firestore_post(const char *url, const char *cert, const char *auth_header,
+                                 size_t body_len, size_t sent, bool gzip, _body_fn write_body,
+                                 void *body_ctx, firebase_commit_result_t *res)
+{
+    *res = (firebase_commit_result_t){.action = FIRESTORE_RETRY};
 
+    esp_err_t err = firebase_conn_prepare(&s_store_conn, url, cert);
     if (err != ESP_OK)
     {
-        ESP_LOGE(TAG, "Failed to open HTTP connection: %s", esp_err_to_name(err));
-        esp_http_client_cleanup(client);
         return err;
     }
 
-    int wlen = esp_http_client_write(client, post_data, strlen(post_data));
-    free(post_data);
-    if (wlen < 0)
+    if (firebase_conn_set_header(&s_store_conn, "Authorization", auth_header) != ESP_OK)
     {
-        ESP_LOGE(TAG, "Write failed");
-        esp_http_client_cleanup(client);
-        return ESP_FAIL;
+        ESP_LOGE(TAG, "Failed to set first header");
+    }
+    if (firebase_conn_set_header(&s_store_conn, "Content-Type", "application/json") != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to set second header");
     }
 
-    int resp_headers_len = esp_http_client_fetch_headers(client);
-    if (resp_headers_len < 0)
+    // headers persist on the reused client, so set or clear it every time
+    if (gzip)
     {
-        ESP_LOGE(TAG, "HTTP client fetch headers failed");
-        esp_http_client_cleanup(client);
-        return ESP_FAIL;
+        firebase_conn_set_header(&s_store_conn, "Content-Encoding", "gzip");
     }
-#define RESPONSE_BUFFER_SIZE 2048
-    char *response_buffer = malloc(RESPONSE_BUFFER_SIZE + 1);
-    int response_content_len = esp_http_client_read_response(client, response_buffer, RESPONSE_BUFFER_SIZE);
-    if (response_content_len < 0)
+    else
     {
-        ESP_LOGE(TAG, "No response from HTTP request");
-        esp_http_client_cleanup(client);
-        return ESP_FAIL;
+        firebase_conn_delete_header(&s_store_conn, "Content-Encoding");
     }
-    response_buffer[response_content_len] = '\0';
-
-    ESP_LOGI(TAG, "HTTP POST Status = %d, content_length = %" PRId64,
-             esp_http_client_get_status_code(client),
-             esp_http_client_get_content_length(client));
-    ESP_LOGI(TAG, "%s", response_buffer);
 
-    free(firebase_cert);
-
-    /* 7) Parse JSON response */
-    cJSON *resp_json = cJSON_Parse(response_buffer);
-    free(response_buffer);
-    if (!resp_json)
+    static perf_metric_t *m_rtt;
+    if (!m_rtt)
     {
-        ESP_LOGE(TAG, "Failed to parse token JSON");
-        esp_http_client_cleanup(client);
-        return ESP_FAIL;
+        m_rtt = perf_histogram("http.rtt_us");
     }
-    cJSON *token_item_token = cJSON_GetObjectItem(resp_json, "access_token");
-    cJSON *token_item_expires_in = cJSON_GetObjectItem(resp_json, "expires_in");
-    if (!cJSON_IsString(token_item_token) || !cJSON_IsNumber(token_item_expires_in))
+    int64_t rtt_start = esp_timer_get_time();
+
+    err = firebase_conn_open(&s_store_conn, gzip ? -1 : (int)body_len);
+    if (err != ESP_OK)
     {
-        ESP_LOGE(TAG, "Unexpected JSON format");
-        cJSON_Delete(resp_json);
-        esp_http_client_cleanup(client);
+        ESP_LOGE(TAG, "Failed to open HTTP connection: %s", esp_err_to_name(err));
+        firebase_conn_finish(&s_store_conn, false);
         return ESP_FAIL;
     }
 
-    strlcpy(cached_token, token_item_token->valuestring, max_len);
-    strlcpy(out_token, cached_token, max_len);
-    cached_expiry = now + (time_t)token_item_expires_in->valuedouble;
-
-    cJSON_Delete(resp_json); // only delete the root
-    esp_http_client_cleanup(client);
-
-    ESP_LOGI(TAG, "Access token obtained successfully");
-    return ESP_OK;
-}
-
-bool get_json_string(const cJSON *root, const char *key, char *out_buf, size_t buf_len)
-{
-    // 1) Find the item
-    cJSON *item = cJSON_GetObjectItem(root, key);
-    if (!item)
+    err = gzip ? _write_body_gzip(body_len, write_body, body_ctx)
+               : write_body(body_ctx, _conn_sink, &s_store_conn);
+    if (err != ESP_OK)
     {
-        // key not found
-        return false;
+        ESP_LOGE(TAG, "Write failed");
+        firebase_conn_finish(&s_store_conn, false);
+        return ESP_FAIL;
     }
+    ESP_LOGI(TAG, "Wrote %u bytes", (unsigned)body_len);
 
-    // 2) Verify it’s a string
-    if (!cJSON_IsString(item) || (item->valuestring == NULL))
+    int status = 0;
+    int64_t resp_len = firebase_conn_fetch_headers(&s_store_conn, &status);
+    perf_hist_since(m_rtt, rtt_start);
+    if (resp_len < 0)
     {
-        // wrong type
-        return false;
+        ESP_LOGE(TAG, "HTTP client fetch headers failed");
+        firebase_conn_finish(&s_store_conn, false);
+        return ESP_FAIL;
     }
 
-    // 3) Copy safely into your buffer
-    // Option A: snprintf (always null‑terminates)
-    snprintf(out_buf, buf_len, "%s", item->valuestring);
+    err = _read_response(status, sent, res);
+    firebase_conn_finish(&s_store_conn, err == ESP_OK);
+    // the status line arrived, so the server did decide on the commit
+    return ESP_OK;
+}
 
-    return true;
+/* "Bearer <token>", waiting for the credential task if it has none */
+static esp_err_t _auth_header(char *out)
+{
+    strcpy(out, "Bearer ");
+    return firebase_cred_get_token(out + strlen("Bearer "), TOKEN_SIZE,
+                                   pdMS_TO_TICKS(TOKEN_WAIT_MS));
 }
 
 /**
- * @brief  Send a batch of readings to Firestore under `sensor_data` collection.
+ * @brief  Authenticate and POST a documents:commit body of `body_len` bytes
+ *         carrying `sent` writes, produced by `write_body`.
  */
-esp_err_t send_sensor_data_to_firestore(const char *doc)
+static esp_err_t _firestore_commit(size_t body_len, size_t sent, _body_fn write_body,
+                                   void *body_ctx, firebase_commit_result_t *res)
 {
-
-    // extract svc_acct_email from nvs_config
-    char *svc_acct_email = load_config_from_fat(config_path, "svc_acct_email");
-    if (!svc_acct_email)
+    *res = (firebase_commit_result_t){.action = FIRESTORE_RETRY};
+    if (!s_upload_arena.base && firebase_init() != ESP_OK)
     {
-        ESP_LOGE("CONFIG_HELPER", "Did not load svc_acct_email");
-        return ESP_FAIL;
+        return ESP_ERR_NO_MEM;
     }
-
-    // char svc_acct_email[SVC_ACCT_EMAIL_SIZE];
-    // if (!load_config_str("svs_acct_email", svc_acct_email, SVC_ACCT_EMAIL_SIZE - 1, "default-config"))
-    // {
-    //     ESP_LOGE(TAG, "Failed to get svc_acct_email");
-    //     return;
-    // }
-    ESP_LOGI(TAG, "loaded svc_acct_email");
+    arena_reset(&s_upload_arena);
 
     // extract proj_id from nvs_config
-    char *proj_id = load_config_from_fat(config_path, "proj_id");
+    const char *proj_id = config_cache_get("proj_id");
     if (!proj_id)
     {
         ESP_LOGE("CONFIG_HELPER", "Did not load proj_id");
@@ -406,94 +419,156 @@ esp_err_t send_sensor_data_to_firestore(const char *doc)
     // }
     ESP_LOGI(TAG, "extracted proj_id");
 
-// get access token
-#define TOKEN_SIZE 1200
-    char *token = malloc(TOKEN_SIZE);
-    if (firebase_get_access_token(token, TOKEN_SIZE - 1, svc_acct_email) != ESP_OK)
+    char *auth_header = arena_alloc(&s_upload_arena, AUTH_HEADER_SIZE);
+    if (!auth_header)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = _auth_header(auth_header);
+    if (err == ESP_ERR_INVALID_STATE)
+    {
+        // the credential manager is started by stage_cloud, not from here
+        ESP_LOGW(TAG, "Credential manager not started yet, holding the send");
+        return err;
+    }
+    if (err != ESP_OK)
     {
         ESP_LOGE(TAG, "Cannot obtain access token, aborting send");
         return ESP_FAIL;
     }
-    free(svc_acct_email);
-
-    char *auth_header = malloc(TOKEN_SIZE - 20);
-    snprintf(auth_header, TOKEN_SIZE - 20 - 1, "Bearer %s", token);
-    free(token);
 
     /* Build Firestore REST endpoint URL */
     char url[256];
     snprintf(url, sizeof(url), COMMIT_URL_FMT, proj_id);
-    free(proj_id);
 
-    char *firebase_cert = load_config_from_fat(config_path, "G_ROOT_CA_CERT");
+    const char *firebase_cert = config_cache_get("G_ROOT_CA_CERT");
     if (!firebase_cert)
     {
         ESP_LOGE("CONFIG_HELPER", "Did not load firebase_cert");
         return ESP_FAIL;
     }
 
-    /* Perform HTTP POST */
-    esp_http_client_config_t config = {
-        .url = url,
-        .cert_pem = firebase_cert,
-        .timeout_ms = 5000,
-        .buffer_size_tx = 2048,
-        .buffer_size = 2048};
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    esp_http_client_set_method(client, HTTP_METHOD_POST);
-    ESP_LOGI(TAG, "Set first header");
-
-    if (esp_http_client_set_header(client, "Authorization", auth_header) != ESP_OK)
+    /* Perform HTTP POST on the persistent Firestore connection. A socket the
+     * server already dropped only shows up once we use it, so a failure on a
+     * reused connection gets one more try on a fresh (resumed) one, and so
+     * does a rejected token, with a newly signed one, and a gzip body the
+     * server refused, uncompressed. */
+    err = ESP_FAIL;
+    size_t mark = arena_mark(&s_upload_arena);
+    bool gzip = _use_gzip(body_len);
+    bool fell_back = false;
+    int attempts = 2;
+    for (int attempt = 0; attempt < attempts; attempt++)
     {
-        ESP_LOGE(TAG, "Failed to set first header");
+        arena_release(&s_upload_arena, mark);
+        err = _firestore_post(url, firebase_cert, auth_header, body_len, sent, gzip,
+                              write_body, body_ctx, res);
+        if (err != ESP_OK && firebase_conn_last_reused(&s_store_conn))
+        {
+            ESP_LOGW(TAG, "Reused connection failed, retrying on a new one");
+            continue;
+        }
+        if (err == ESP_OK && gzip && res->action == FIRESTORE_DROP)
+        {
+            /* 400/411/415 and the like may be about the encoding rather than
+             * the records; the same chunk goes again plain before anything
+             * is dropped, on top of the usual retries */
+            ESP_LOGW(TAG, "HTTP %d to a gzip body, resending uncompressed; gzip off",
+                     res->http_status);
+            s_gzip.refused = true;
+            s_gzip.cfg_generation = config_cache_generation();
+            gzip = false;
+            fell_back = true;
+            attempts++;
+            continue;
+        }
+        if (err == ESP_OK && res->action == FIRESTORE_REAUTH && _auth_header(auth_header) == ESP_OK)
+        {
+            ESP_LOGW(TAG, "Token rejected, retrying with a new one");
+            continue;
+        }
+        break;
     }
-    ESP_LOGI(TAG, "Set second header");
-
-    if (esp_http_client_set_header(client, "Content-Type", "application/json") != ESP_OK)
+    if (fell_back && err == ESP_OK && res->action == FIRESTORE_DROP)
     {
-        ESP_LOGE(TAG, "Failed to set second header");
+        // refused plain as well, so it was the records, not the encoding
+        s_gzip.refused = false;
     }
-    // ***Delete? esp_http_client_set_post_field(client, json_str, strlen(json_str));
-
-    esp_err_t err = esp_http_client_open(client, strlen(doc));
-
+    firebase_conn_log_stats(&s_store_conn);
     if (err != ESP_OK)
     {
-        ESP_LOGE(TAG, "Failed to open HTTP connection: %s", esp_err_to_name(err));
-        return ESP_FAIL;
+        return err;
     }
+    return res->action == FIRESTORE_ACK ? ESP_OK : ESP_FAIL;
+}
 
-    int wlen = esp_http_client_write(client, doc, strlen(doc));
-    if (wlen <= 0)
+esp_err_t firebase_init(void)
+{
+    if (s_upload_arena.base)
     {
-        ESP_LOGE(TAG, "Write failed");
-        return ESP_FAIL;
+        return ESP_OK;
     }
-    ESP_LOGI(TAG, "Wrote %u bytes", wlen);
-
-    int resp_header_len = esp_http_client_fetch_headers(client);
-    if (resp_header_len < 0)
+    esp_err_t err = arena_init(&s_upload_arena, "upload", UPLOAD_ARENA_SIZE);
+    if (err == ESP_OK && _gzip_threshold() > 0)
     {
-        ESP_LOGE(TAG, "HTTP client fetch headers failed");
-        // return;
+        // the compressor too, while the heap has a block this size; it is
+        // only allocated when compression is on
+        _use_gzip(SIZE_MAX);
     }
-    ESP_LOGI(TAG, "%u bytes in response headers", resp_header_len);
+    return err;
+}
+
+/**
+ * @brief  Send a prebuilt documents:commit body to Firestore.
+ */
+esp_err_t send_sensor_data_to_firestore(const char *doc)
+{
+    firebase_commit_result_t res;
+    return _firestore_commit(strlen(doc), 0, _write_doc, (void *)doc, &res);
+}
 
-#define FIRESTORE_RESPONSE_BUFFER_SIZE 2048
-    char *firestore_resp_buffer = malloc(FIRESTORE_RESPONSE_BUFFER_SIZE);
-    int data_read = esp_http_client_read_response(client, firestore_resp_buffer, FIRESTORE_RESPONSE_BUFFER_SIZE - 1);
-    if (data_read <= 0)
+/**
+ * @brief  Commit a batch of window records to the `sensor_data` collection.
+ *         The body is streamed straight onto the socket; nothing is built
+ *         in RAM.
+ */
+esp_err_t firebase_commit_records(const avg_sample_t *records, size_t count,
+                                  firebase_commit_result_t *res)
+{
+    firebase_commit_result_t unused;
+    if (!res)
     {
-        ESP_LOGE(TAG, "Failed to read http request response");
+        res = &unused;
+    }
+    *res = (firebase_commit_result_t){.action = FIRESTORE_RETRY};
+    const char *proj_id = config_cache_get("proj_id");
+    if (!proj_id)
+    {
+        ESP_LOGE("CONFIG_HELPER", "Did not load proj_id");
         return ESP_FAIL;
     }
-    ESP_LOGI(TAG, "read %u bytes", data_read);
-    ESP_LOGI(TAG, "Status Code: %u", esp_http_client_get_status_code(client));
-    esp_http_client_cleanup(client);
 
-    free(auth_header);
+    _records_body_t body = {
+        .proj_id = proj_id,
+        .records = records,
+        .count = count,
+    };
+    // the measuring pass is a full JSON build without output
+    static perf_metric_t *m_json;
+    if (!m_json)
+    {
+        m_json = perf_histogram("json.build_us");
+    }
+    int64_t start = esp_timer_get_time();
+    size_t body_len = firestore_commit_serialize(proj_id, records, count, NULL, 0);
+    perf_hist_since(m_json, start);
+    esp_err_t err = _firestore_commit(body_len, count, _write_records, &body, res);
+    res->body_bytes = (uint32_t)body_len;
+    return err;
+}
 
-    free(firestore_resp_buffer);
-    free(firebase_cert);
-    return ESP_OK;
+size_t firebase_commit_fit(const avg_sample_t *records, size_t count)
+{
+    const char *proj_id = config_cache_get("proj_id");
+    return firestore_commit_fit(proj_id ? proj_id : "", records, count, _max_body(), NULL);
 }
@@ -0,0 +1,249 @@
+/* components/firebase/firebase_conn.c
+ *
+ * Long-lived HTTPS connection used by the Firebase uploader:
+ *  - One esp_http_client per host, kept open across requests (HTTP/1.1 keep-alive)
+ *  - TLS session tickets saved so a dropped socket resumes instead of
+ *    doing a full RSA/ECDHE handshake
+ *  - Handshake counts and durations for diagnostics
+ */
+
+#include "firebase_conn.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "config_cache.h"
+#include "perf_metrics.h"
+
+static const char *TAG = "FIREBASE_CONN";
+
+#define CONN_TIMEOUT_MS 5000
+#define CONN_BUFFER_SIZE 2048
+
+static esp_err_t _conn_event_handler(esp_http_client_event_t *evt)
+{
+    firebase_conn_t *conn = (firebase_conn_t *)evt->user_data;
+    if (!conn)
+    {
+        return ESP_OK;
+    }
+
+    switch (evt->event_id)
+    {
+    case HTTP_EVENT_ON_CONNECTED:
+    {
+        int64_t took = esp_timer_get_time() - conn->open_start_us;
+        conn->connected = true;
+        conn->handshake_seen = true;
+        conn->stats.handshakes++;
+        perf_hist_record(perf_histogram("tls.handshake_us"), (uint32_t)took);
+        conn->stats.last_handshake_us = took;
+        conn->stats.total_handshake_us += took;
+        if (took > conn->stats.max_handshake_us)
+        {
+            conn->stats.max_handshake_us = took;
+        }
+        ESP_LOGI(TAG, "%s: connected in %lld ms (handshake #%" PRIu32 ")",
+                 conn->name, (long long)(took / 1000), conn->stats.handshakes);
+        break;
+    }
+    case HTTP_EVENT_ON_HEADER:
+        if (strcasecmp(evt->header_key, "Connection") == 0 &&
+            strcasecmp(evt->header_value, "close") == 0)
+        {
+            conn->server_close = true;
+        }
+        break;
+    case HTTP_EVENT_DISCONNECTED:
+        conn->connected = false;
+        break;
+    default:
+        break;
+    }
+    return ESP_OK;
+}
+
+esp_err_t firebase_conn_prepare(firebase_conn_t *conn, const char *url, const char *cert_pem)
+{
+    uint32_t generation = config_cache_generation();
+
+    /* The client keeps pointing at our own copy of the cert, so a config
+     * reload in another task cannot pull it away mid-handshake. Only rebuild
+     * when the cert itself changed. */
+    if (conn->client && conn->cfg_generation != generation)
+    {
+        if (strcmp(conn->cert_pem, cert_pem) != 0)
+        {
+            ESP_LOGI(TAG, "%s: certificate changed, recreating client", conn->name);
+            firebase_conn_close(conn);
+        }
+        else
+        {
+            conn->cfg_generation = generation;
+        }
+    }
+
+    if (!conn->client)
+    {
+        conn->cert_pem = strdup(cert_pem);
+        if (!conn->cert_pem)
+        {
+            return ESP_ERR_NO_MEM;
+        }
+        esp_http_client_config_t config = {
+            .url = url,
+            .cert_pem = conn->cert_pem,
+            .timeout_ms = CONN_TIMEOUT_MS,
+            .buffer_size = CONN_BUFFER_SIZE,
+            .buffer_size_tx = CONN_BUFFER_SIZE,
+            .keep_alive_enable = true,
+            .event_handler = _conn_event_handler,
+            .user_data = conn,
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+            .save_client_session = true,
+#endif
+        };
+        conn->client = esp_http_client_init(&config);
+        if (!conn->client)
+        {
+            ESP_LOGE(TAG, "%s: client init failed", conn->name);
+            free(conn->cert_pem);
+            conn->cert_pem = NULL;
+            return ESP_ERR_NO_MEM;
+        }
+        conn->cfg_generation = generation;
+        conn->connected = false;
+    }
+    else
+    {
+        esp_http_client_set_url(conn->client, url);
+    }
+
+    conn->server_close = false;
+    return esp_http_client_set_method(conn->client, HTTP_METHOD_POST);
+}
+
+esp_err_t firebase_conn_set_header(firebase_conn_t *conn, const char *key, const char *value)
+{
+    return esp_http_client_set_header(conn->client, key, value);
+}
+
+esp_err_t firebase_conn_delete_header(firebase_conn_t *conn, const char *key)
+{
+    return esp_http_client_delete_header(conn->client, key);
+}
+
+esp_err_t firebase_conn_open(firebase_conn_t *conn, int content_len)
+{
+    int64_t now = esp_timer_get_time();
+
+    /* Servers drop idle keep-alive sockets; reconnect (resumed) up front
+     * rather than discovering it halfway through the body. */
+    if (conn->connected && (now - conn->last_used_us) > (int64_t)FIREBASE_CONN_IDLE_MS * 1000)
+    {
+        ESP_LOGD(TAG, "%s: idle for %lld ms, reconnecting", conn->name,
+                 (long long)((now - conn->last_used_us) / 1000));
+        esp_http_client_close(conn->client);
+        conn->connected = false;
+    }
+
+    /* The client keeps headers between requests and open() only ever adds
+     * its framing header, so drop the other kind a previous request left */
+    esp_http_client_delete_header(conn->client, content_len >= 0 ? "Transfer-Encoding" : "Content-Length");
+
+    conn->handshake_seen = false;
+    conn->open_start_us = now;
+    esp_err_t err = esp_http_client_open(conn->client, content_len);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "%s: open failed: %s", conn->name, esp_err_to_name(err));
+        return err;
+    }
+
+    conn->last_reused = !conn->handshake_seen;
+    conn->stats.requests++;
+    if (conn->last_reused)
+    {
+        conn->stats.reused++;
+    }
+    return ESP_OK;
+}
+
+int firebase_conn_write(firebase_conn_t *conn, const char *buf, int len)
+{
+    return esp_http_client_write(conn->client, buf, len);
+}
+
+int64_t firebase_conn_fetch_headers(firebase_conn_t *conn, int *out_status)
+{
+    int64_t content_len = esp_http_client_fetch_headers(conn->client);
+    if (out_status)
+    {
+        *out_status = esp_http_client_get_status_code(conn->client);
+    }
+    return content_len;
+}
+
+int firebase_conn_read(firebase_conn_t *conn, char *buf, int len)
+{
+    return esp_http_client_read_response(conn->client, buf, len);
+}
+
+void firebase_conn_finish(firebase_conn_t *conn, bool ok)
+{
+    if (!conn->client)
+    {
+        return;
+    }
+
+    conn->last_used_us = esp_timer_get_time();
+
+    /* Leave the socket clean for the next request */
+    if (ok && esp_http_client_flush_response(conn->client, NULL) != ESP_OK)
+    {
+        ok = false;
+    }
+
+    if (!ok)
+    {
+        conn->stats.failures++;
+    }
+    if (!ok || conn->server_close)
+    {
+        esp_http_client_close(conn->client);
+        conn->connected = false;
+    }
+}
+
+bool firebase_conn_last_reused(const firebase_conn_t *conn)
+{
+    return conn->last_reused;
+}
+
+void firebase_conn_close(firebase_conn_t *conn)
+{
+    if (conn->client)
+    {
+        esp_http_client_cleanup(conn->client);
+        conn->client = NULL;
+    }
+    conn->connected = false;
+    free(conn->cert_pem);
+    conn->cert_pem = NULL;
+}
+
+void firebase_conn_log_stats(const firebase_conn_t *conn)
+{
+    const firebase_conn_stats_t *s = &conn->stats;
+    ESP_LOGI(TAG, "%s: %" PRIu32 " requests, %" PRIu32 " reused, %" PRIu32 " handshakes "
+                  "(last %lld ms, max %lld ms, avg %lld ms), %" PRIu32 " failures",
+             conn->name, s->requests, s->reused, s->handshakes,
+             (long long)(s->last_handshake_us / 1000),
+             (long long)(s->max_handshake_us / 1000),
+             (long long)(s->handshakes ? s->total_handshake_us / s->handshakes / 1000 : 0),
+             s->failures);
+}
@@ -0,0 +1,605 @@
+/* components/firebase/firebase_cred.c
+ *
+ * Credential manager for the Firebase uploader:
+ *  - Parses the service account key once into a long-lived mbedtls_pk_context
+ *    (re-parsed only when cfg.json changes)
+ *  - Signs one throwaway hash at load so the RSA blinding values are already
+ *    computed when the first real JWT is signed
+ *  - Refreshes the OAuth2 token from its own task ahead of expiry, so the
+ *    upload path only ever copies a cached string
+ *  - A refresh builds the JWT, the POST body and the parsed response in one
+ *    arena (cJSON included), reset per refresh; nothing to free or leak
+ */
+
+#include "firebase_cred.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <inttypes.h>
+#include <sys/param.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+
+#include "mbedtls/base64.h"
+#include "mbedtls/md.h"
+#include "mbedtls/pk.h"
+
+#include "cJSON.h"
+
+#include "firebase_conn.h"
+#include "config_cache.h"
+#include "perf_metrics.h"
+#include "arena.h"
+
+/* OAuth2 token endpoint and scope */
+#define TOKEN_URL "https://oauth2.googleapis.com/token"
+#define SCOPE "https://www.googleapis.com/auth/datastore"
+/* JWT expiration interval (seconds) */
+#define EXPIRATION_SEC 3600
+#define TOKEN_REFRESH_MARGIN 60
+#define TOKEN_SIZE 1200
+#define SVC_ACCT_EMAIL_SIZE 128
+
+/* Token request buffers */
+#define PAYLOAD_SIZE 512
+#define PAYLOAD_B64_SIZE 512
+#define HEADER_PAYLOAD_SIZE 1024
+#define SIG_B64_SIZE 1024
+#define JWT_SIZE (HEADER_PAYLOAD_SIZE + SIG_B64_SIZE)
+#define RESPONSE_BUFFER_SIZE 2048
+/* The buffers above twice over leaves room for the POST body and the
+ * cJSON trees of request and response */
+#define CRED_ARENA_SIZE (2 * (PAYLOAD_SIZE + PAYLOAD_B64_SIZE + HEADER_PAYLOAD_SIZE + \
+                              SIG_B64_SIZE + JWT_SIZE + RESPONSE_BUFFER_SIZE))
+
+/* Wall clock before this means SNTP has not set the time yet; a JWT
+ * signed then would be rejected */
+#define MIN_VALID_TIME 1640995200 /* 2022-01-01 */
+
+#define TOKEN_READY_BIT BIT0
+
+static const char *TAG = "FIREBASE_CRED";
+
+/* Guards task/starting, so only one caller ever initialises s_cred */
+static portMUX_TYPE s_start_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static struct
+{
+    TaskHandle_t task;               /* set once everything below exists */
+    bool starting;                   /* firebase_cred_start() in progress */
+    SemaphoreHandle_t lock;          /* guards token/expiry/stats */
+    EventGroupHandle_t events;
+    mbedtls_pk_context pk;
+    bool pk_ready;
+    uint32_t pk_generation;
+    char token[TOKEN_SIZE];
+    time_t expiry;
+    firebase_cred_stats_t stats;
+    breaker_t gate;                  /* token endpoint backoff, under lock */
+    arena_t arena;                   /* scratch of the refresh in progress */
+} s_cred;
+
+static firebase_conn_t s_token_conn = {.name = "oauth2"};
+
+static int _mbedtls_rng(void *ctx, unsigned char *buf, size_t len)
+{
+    (void)ctx;
+    esp_fill_random(buf, len);
+    return 0;
+}
+
+/* Parse the key if we have none or cfg.json was reloaded since */
+static esp_err_t _ensure_key(void)
+{
+    uint32_t generation = config_cache_generation();
+    if (s_cred.pk_ready && generation == s_cred.pk_generation)
+    {
+        return ESP_OK;
+    }
+
+    if (s_cred.pk_ready)
+    {
+        mbedtls_pk_free(&s_cred.pk);
+        s_cred.pk_ready = false;
+    }
+    mbedtls_pk_init(&s_cred.pk);
+
+    /* The PEM lives in the config cache; hold it while parsing */
+    config_cache_lock();
+    const char *pem = config_cache_get("firebase_system_key");
+    int ret = -1;
+    if (pem)
+    {
+        ret = mbedtls_pk_parse_key(&s_cred.pk, (const unsigned char *)pem, strlen(pem) + 1,
+                                   NULL, 0, _mbedtls_rng, NULL);
+    }
+    config_cache_unlock();
+
+    if (!pem)
+    {
+        ESP_LOGE("CONFIG_HELPER", "Did not load firebase_system_key");
+        mbedtls_pk_free(&s_cred.pk);
+        return ESP_FAIL;
+    }
+    if (ret)
+    {
+        ESP_LOGE(TAG, "Private key parse failed: %d", ret);
+        mbedtls_pk_free(&s_cred.pk);
+        return ESP_FAIL;
+    }
+
+    s_cred.pk_ready = true;
+    s_cred.pk_generation = generation;
+    s_cred.stats.key_parses++;
+
+    /* One throwaway private-key operation computes the blinding values;
+     * later signatures only update them */
+    unsigned char hash[32] = {0};
+    unsigned char sig[MBEDTLS_PK_SIGNATURE_MAX_SIZE];
+    size_t sig_len = 0;
+    int64_t start = esp_timer_get_time();
+    mbedtls_pk_sign(&s_cred.pk, MBEDTLS_MD_SHA256, hash, sizeof(hash),
+                    sig, sizeof(sig), &sig_len, _mbedtls_rng, NULL);
+    ESP_LOGI(TAG, "Key parsed, warm-up signature took %lld ms",
+             (long long)((esp_timer_get_time() - start) / 1000));
+    return ESP_OK;
+}
+
+/* RS256-sign `header.payload` and base64-encode the signature */
+static esp_err_t _sign_jwt_rs256(const char *header_payload, char *out_sig_b64, size_t sig_len)
+{
+    if (_ensure_key() != ESP_OK)
+    {
+        return ESP_FAIL;
+    }
+
+    /* SHA256 hash of header.payload */
+    unsigned char hash[32];
+    mbedtls_md(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256),
+               (const unsigned char *)header_payload,
+               strlen(header_payload),
+               hash);
+
+    /* Sign the hash */
+    unsigned char sig[MBEDTLS_PK_SIGNATURE_MAX_SIZE];
+    size_t sig_actual = 0;
+    int64_t start = esp_timer_get_time();
+    int ret = mbedtls_pk_sign(&s_cred.pk, MBEDTLS_MD_SHA256,
+                              hash, sizeof(hash),
+                              sig, sizeof(sig), &sig_actual,
+                              _mbedtls_rng, NULL);
+    int64_t took = esp_timer_get_time() - start;
+    perf_hist_record(perf_histogram("jwt.sign_us"), (uint32_t)took);
+    if (ret)
+    {
+        ESP_LOGE(TAG, "RSA sign failed: %d", ret);
+        return ESP_FAIL;
+    }
+
+    xSemaphoreTake(s_cred.lock, portMAX_DELAY);
+    s_cred.stats.last_sign_us = took;
+    if (took > s_cred.stats.max_sign_us)
+    {
+        s_cred.stats.max_sign_us = took;
+    }
+    xSemaphoreGive(s_cred.lock);
+    ESP_LOGI(TAG, "hash is signed in %lld ms", (long long)(took / 1000));
+
+    /* Base64-encode the signature */
+    size_t olen = 0;
+    if (mbedtls_base64_encode((unsigned char *)out_sig_b64, sig_len, &olen, sig, sig_actual))
+    {
+        return ESP_FAIL;
+    }
+    out_sig_b64[olen] = '\0';
+    return ESP_OK;
+}
+
+/* Build the JWT assertion and the OAuth2 POST body in the arena. Returns
+ * the body or NULL. */
+static char *_build_token_request(time_t now)
+{
+    char svc_acct_email[SVC_ACCT_EMAIL_SIZE];
+    if (!config_cache_copy("svc_acct_email", svc_acct_email, sizeof(svc_acct_email)))
+    {
+        ESP_LOGE("CONFIG_HELPER", "Did not load svc_acct_email");
+        return NULL;
+    }
+
+    /* 1) Base64(header) */
+    const char hdr[] = "{\"alg\":\"RS256\",\"typ\":\"JWT\"}";
+    char hdr_b64[64];
+    size_t hdr_b64_len;
+    mbedtls_base64_encode((unsigned char *)hdr_b64,
+                          sizeof(hdr_b64), &hdr_b64_len,
+                          (const unsigned char *)hdr, strlen(hdr));
+    hdr_b64[hdr_b64_len] = '\0';
+
+    /* 2) Base64(payload) */
+    char *payload = arena_alloc(&s_cred.arena, PAYLOAD_SIZE);
+    char *payload_b64 = arena_alloc(&s_cred.arena, PAYLOAD_B64_SIZE);
+    char *header_payload = arena_alloc(&s_cred.arena, HEADER_PAYLOAD_SIZE);
+    char *sig_b64 = arena_alloc(&s_cred.arena, SIG_B64_SIZE);
+    char *jwt = arena_alloc(&s_cred.arena, JWT_SIZE);
+    if (!payload || !payload_b64 || !header_payload || !sig_b64 || !jwt)
+    {
+        return NULL;
+    }
+
+    snprintf(payload, PAYLOAD_SIZE,
+             "{\"iss\":\"%s\",\"scope\":\"%s\",\"aud\":\"%s\",\"iat\":%lld,\"exp\":%lld}",
+             svc_acct_email, SCOPE, TOKEN_URL,
+             (long long)now, (long long)(now + EXPIRATION_SEC));
+    ESP_LOGD(TAG, "payload: %s", payload);
+
+    size_t payload_b64_len;
+    mbedtls_base64_encode((unsigned char *)payload_b64,
+                          PAYLOAD_B64_SIZE, &payload_b64_len,
+                          (const unsigned char *)payload, strlen(payload));
+    payload_b64[payload_b64_len] = '\0';
+
+    /* 3) Sign header.payload */
+    snprintf(header_payload, HEADER_PAYLOAD_SIZE, "%s.%s", hdr_b64, payload_b64);
+    if (_sign_jwt_rs256(header_payload, sig_b64, SIG_B64_SIZE) != ESP_OK)
+    {
+        return NULL;
+    }
+
+    /* 4) Complete JWT */
+    snprintf(jwt, JWT_SIZE, "%s.%s", header_payload, sig_b64);
+    ESP_LOGD(TAG, "JWT: %s", jwt);
+
+    /* 5) Prepare OAuth2 POST body; cJSON draws from the arena too */
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "grant_type",
+                            "urn:ietf:params:oauth:grant-type:jwt-bearer");
+    cJSON_AddStringToObject(root, "assertion", jwt);
+    return cJSON_PrintUnformatted(root);
+}
+
+/* Sign a fresh JWT and exchange it for an access token; allocates from
+ * s_cred.arena only */
+static esp_err_t _request_token(void)
+{
+    int64_t start = esp_timer_get_time();
+    time_t now = time(NULL);
+
+    char *post_data = _build_token_request(now);
+    if (!post_data)
+    {
+        return ESP_FAIL;
+    }
+
+    /* 6) Perform HTTP POST over the persistent oauth2 connection */
+    config_cache_lock();
+    const char *firebase_cert = config_cache_get("G_ROOT_CA_CERT");
+    esp_err_t err = firebase_cert ? firebase_conn_prepare(&s_token_conn, TOKEN_URL, firebase_cert)
+                                  : ESP_FAIL;
+    config_cache_unlock();
+    if (!firebase_cert)
+    {
+        ESP_LOGE("CONFIG_HELPER", "Did not load firebase_cert");
+        return ESP_FAIL;
+    }
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    firebase_conn_set_header(&s_token_conn, "Content-Type", "application/json");
+    err = firebase_conn_open(&s_token_conn, strlen(post_data));
+
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to open HTTP connection: %s", esp_err_to_name(err));
+        firebase_conn_finish(&s_token_conn, false);
+        return err;
+    }
+
+    int wlen = firebase_conn_write(&s_token_conn, post_data, strlen(post_data));
+    if (wlen < 0)
+    {
+        ESP_LOGE(TAG, "Write failed");
+        firebase_conn_finish(&s_token_conn, false);
+        return ESP_FAIL;
+    }
+
+    int status = 0;
+    int64_t resp_content_len = firebase_conn_fetch_headers(&s_token_conn, &status);
+    if (resp_content_len < 0)
+    {
+        ESP_LOGE(TAG, "HTTP client fetch headers failed");
+        firebase_conn_finish(&s_token_conn, false);
+        return ESP_FAIL;
+    }
+    char *response_buffer = arena_alloc(&s_cred.arena, RESPONSE_BUFFER_SIZE + 1);
+    if (!response_buffer)
+    {
+        firebase_conn_finish(&s_token_conn, false);
+        return ESP_ERR_NO_MEM;
+    }
+    int response_content_len = firebase_conn_read(&s_token_conn, response_buffer, RESPONSE_BUFFER_SIZE);
+    if (response_content_len < 0)
+    {
+        ESP_LOGE(TAG, "No response from HTTP request");
+        firebase_conn_finish(&s_token_conn, false);
+        return ESP_FAIL;
+    }
+    response_buffer[response_content_len] = '\0';
+    firebase_conn_finish(&s_token_conn, true);
+
+    ESP_LOGI(TAG, "HTTP POST Status = %d, content_length = %" PRId64,
+             status, resp_content_len);
+    firebase_conn_log_stats(&s_token_conn);
+
+    /* 7) Parse JSON response */
+    cJSON *resp_json = cJSON_Parse(response_buffer);
+    if (!resp_json)
+    {
+        ESP_LOGE(TAG, "Failed to parse token JSON");
+        return ESP_FAIL;
+    }
+    cJSON *token_item_token = cJSON_GetObjectItem(resp_json, "access_token");
+    cJSON *token_item_expires_in = cJSON_GetObjectItem(resp_json, "expires_in");
+    if (!cJSON_IsString(token_item_token) || !cJSON_IsNumber(token_item_expires_in))
+    {
+        ESP_LOGE(TAG, "Unexpected JSON format");
+        return ESP_FAIL;
+    }
+
+    xSemaphoreTake(s_cred.lock, portMAX_DELAY);
+    strlcpy(s_cred.token, token_item_token->valuestring, sizeof(s_cred.token));
+    s_cred.expiry = now + (time_t)token_item_expires_in->valuedouble;
+    s_cred.stats.refreshes++;
+    s_cred.stats.token_issued = now;
+    s_cred.stats.token_expiry = s_cred.expiry;
+    s_cred.stats.last_refresh_us = esp_timer_get_time() - start;
+    xSemaphoreGive(s_cred.lock);
+    xEventGroupSetBits(s_cred.events, TOKEN_READY_BIT);
+
+    ESP_LOGI(TAG, "Access token obtained, expires in %llds",
+             (long long)(s_cred.expiry - now));
+    return ESP_OK;
+}
+
+static esp_err_t _refresh_token(void)
+{
+    arena_reset(&s_cred.arena);
+    arena_bind_cjson(&s_cred.arena);
+    esp_err_t err = _request_token();
+    arena_bind_cjson(NULL);
+    return err;
+}
+
+static bool _token_valid_locked(time_t now)
+{
+    return s_cred.token[0] != '\0' && now < (s_cred.expiry - TOKEN_REFRESH_MARGIN);
+}
+
+static void _cred_task(void *pvParameters)
+{
+    for (;;)
+    {
+        time_t now = time(NULL);
+        if (now < MIN_VALID_TIME)
+        {
+            /* No wall clock yet, nothing sensible to sign */
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));
+            continue;
+        }
+
+        xSemaphoreTake(s_cred.lock, portMAX_DELAY);
+        time_t due = s_cred.token[0] != '\0'
+                         ? s_cred.expiry - TOKEN_REFRESH_MARGIN - FIREBASE_CRED_LEAD_SEC
+                         : 0;
+        xSemaphoreGive(s_cred.lock);
+
+        time_t wait_s;
+        if (now >= due)
+        {
+            /* A wake-up from firebase_cred_get_token() does not bypass the
+             * backoff; an unreachable endpoint is tried at the gate's pace */
+            xSemaphoreTake(s_cred.lock, portMAX_DELAY);
+            bool allowed = breaker_allow(&s_cred.gate, esp_timer_get_time());
+            xSemaphoreGive(s_cred.lock);
+            if (allowed)
+            {
+                esp_err_t err = _refresh_token();
+                xSemaphoreTake(s_cred.lock, portMAX_DELAY);
+                breaker_state_t before = s_cred.gate.state;
+                breaker_state_t after = err == ESP_OK
+                                            ? breaker_success(&s_cred.gate, esp_timer_get_time())
+                                            : breaker_failure(&s_cred.gate, esp_timer_get_time());
+                if (err != ESP_OK)
+                {
+                    s_cred.stats.failures++;
+                }
+                xSemaphoreGive(s_cred.lock);
+                if (after != before)
+                {
+                    ESP_LOGW(TAG, "Token endpoint breaker %s -> %s",
+                             breaker_state_name(before), breaker_state_name(after));
+                }
+                if (err == ESP_OK)
+                {
+                    continue;
+                }
+            }
+            xSemaphoreTake(s_cred.lock, portMAX_DELAY);
+            int64_t wait_us = breaker_wait_us(&s_cred.gate, esp_timer_get_time());
+            xSemaphoreGive(s_cred.lock);
+            wait_s = MAX(wait_us / 1000000, 1);
+            ESP_LOGW(TAG, "Token refresh failed, next try in %lld s", (long long)wait_s);
+        }
+        else
+        {
+            /* Capped so a wall-clock step (SNTP) is noticed in time */
+            wait_s = MIN(due - now, 60);
+        }
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_s * 1000));
+    }
+}
+
+/* Undo a partial start; only firebase_cred_start() calls this, while it
+ * still holds the `starting` claim */
+static void _cred_cleanup(void)
+{
+    arena_deinit(&s_cred.arena);
+    if (s_cred.events)
+    {
+        vEventGroupDelete(s_cred.events);
+        s_cred.events = NULL;
+    }
+    if (s_cred.lock)
+    {
+        vSemaphoreDelete(s_cred.lock);
+        s_cred.lock = NULL;
+    }
+}
+
+/* The task handle is published last, once everything it uses exists */
+static TaskHandle_t _cred_task_handle(void)
+{
+    taskENTER_CRITICAL(&s_start_lock);
+    TaskHandle_t task = s_cred.task;
+    taskEXIT_CRITICAL(&s_start_lock);
+    return task;
+}
+
+esp_err_t firebase_cred_start(void)
+{
+    /* Only one caller gets to initialise; a concurrent one returns at once
+     * and finds the task published when the winner is done */
+    taskENTER_CRITICAL(&s_start_lock);
+    bool busy = s_cred.task || s_cred.starting;
+    s_cred.starting = true;
+    taskEXIT_CRITICAL(&s_start_lock);
+    if (busy)
+    {
+        return ESP_OK;
+    }
+
+    esp_err_t err = ESP_ERR_NO_MEM;
+    s_cred.lock = xSemaphoreCreateMutex();
+    s_cred.events = xEventGroupCreate();
+    if (s_cred.lock && s_cred.events)
+    {
+        err = arena_init(&s_cred.arena, "cred", CRED_ARENA_SIZE);
+    }
+    if (err != ESP_OK)
+    {
+        _cred_cleanup();
+        taskENTER_CRITICAL(&s_start_lock);
+        s_cred.starting = false;
+        taskEXIT_CRITICAL(&s_start_lock);
+        return err;
+    }
+    const breaker_cfg_t gate = {
+        .base_ms = FIREBASE_CRED_BACKOFF_MIN_MS,
+        .max_ms = FIREBASE_CRED_BACKOFF_MAX_MS,
+        .threshold = FIREBASE_CRED_BREAKER_THRESHOLD,
+        .budget = FIREBASE_CRED_RETRY_BUDGET,
+        .refill_ms = FIREBASE_CRED_BUDGET_REFILL_MS,
+    };
+    breaker_init(&s_cred.gate, &gate, esp_random(), esp_timer_get_time());
+
+    TaskHandle_t task = NULL;
+    if (xTaskCreatePinnedToCore(&_cred_task, "fb_cred", FIREBASE_CRED_STACK_SIZE, NULL,
+                                FIREBASE_CRED_PRIORITY, &task, FIREBASE_CRED_CORE) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Credential task creation failed");
+        _cred_cleanup();
+        taskENTER_CRITICAL(&s_start_lock);
+        s_cred.starting = false;
+        taskEXIT_CRITICAL(&s_start_lock);
+        return ESP_ERR_NO_MEM;
+    }
+    perf_watch_task(task, "fb_cred");
+
+    taskENTER_CRITICAL(&s_start_lock);
+    s_cred.task = task;
+    s_cred.starting = false;
+    taskEXIT_CRITICAL(&s_start_lock);
+    return ESP_OK;
+}
+
+esp_err_t firebase_cred_get_token(char *out_token, size_t max_len, TickType_t wait)
+{
+    /* Started once, by stage_cloud; never from here, where a second
+     * caller could race it */
+    TaskHandle_t task = _cred_task_handle();
+    if (!task)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        time_t now = time(NULL);
+        xSemaphoreTake(s_cred.lock, portMAX_DELAY);
+        bool valid = _token_valid_locked(now);
+        if (valid)
+        {
+            strlcpy(out_token, s_cred.token, max_len);
+        }
+        bool backing_off = s_cred.gate.state != BREAKER_CLOSED ||
+                           breaker_wait_us(&s_cred.gate, esp_timer_get_time()) > 0;
+        xSemaphoreGive(s_cred.lock);
+
+        if (valid)
+        {
+            return ESP_OK;
+        }
+        if (backing_off)
+        {
+            /* The endpoint failed recently; don't hold the caller for a
+             * refresh that will not be tried before the backoff ends */
+            return ESP_ERR_TIMEOUT;
+        }
+        if (pass == 0)
+        {
+            /* Only reached before the first token or after invalidate */
+            ESP_LOGW(TAG, "No valid token, waiting for refresh");
+            xEventGroupClearBits(s_cred.events, TOKEN_READY_BIT);
+            xTaskNotifyGive(task);
+            xEventGroupWaitBits(s_cred.events, TOKEN_READY_BIT, pdFALSE, pdFALSE, wait);
+        }
+    }
+    return ESP_ERR_TIMEOUT;
+}
+
+void firebase_cred_invalidate(void)
+{
+    TaskHandle_t task = _cred_task_handle();
+    if (!task)
+    {
+        return;
+    }
+    xSemaphoreTake(s_cred.lock, portMAX_DELAY);
+    s_cred.token[0] = '\0';
+    s_cred.expiry = 0;
+    xSemaphoreGive(s_cred.lock);
+    xEventGroupClearBits(s_cred.events, TOKEN_READY_BIT);
+    xTaskNotifyGive(task);
+}
+
+void firebase_cred_get_stats(firebase_cred_stats_t *out)
+{
+    if (!_cred_task_handle())
+    {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    xSemaphoreTake(s_cred.lock, portMAX_DELAY);
+    *out = s_cred.stats;
+    breaker_get_stats(&s_cred.gate, esp_timer_get_time(), &out->breaker);
+    xSemaphoreGive(s_cred.lock);
+}
@@ -0,0 +1,274 @@
+/* components/firebase/firestore_reader.c
+ *
+ * Streaming reader for the Firestore documents:commit response. The body is
+ * scanned byte by byte as it comes off the socket; the scanner tracks only
+ * nesting, the current top-level key and the members of "error", and copies
+ * out the few strings the upload decision needs. No heap use, no buffer.
+ */
+
+#include "firestore_reader.h"
+
+#include <string.h>
+
+enum
+{
+    KEY_OTHER,
+    KEY_WRITE_RESULTS, /* top level */
+    KEY_ERROR,
+    KEY_CODE,          /* inside "error" */
+    KEY_STATUS,
+    KEY_MESSAGE,
+};
+
+static uint8_t _top_key(const char *k)
+{
+    if (strcmp(k, "writeResults") == 0)
+    {
+        return KEY_WRITE_RESULTS;
+    }
+    return strcmp(k, "error") == 0 ? KEY_ERROR : KEY_OTHER;
+}
+
+static uint8_t _sub_key(const char *k)
+{
+    if (strcmp(k, "code") == 0)
+    {
+        return KEY_CODE;
+    }
+    if (strcmp(k, "status") == 0)
+    {
+        return KEY_STATUS;
+    }
+    return strcmp(k, "message") == 0 ? KEY_MESSAGE : KEY_OTHER;
+}
+
+static inline bool _is_array(const firestore_resp_t *r, uint8_t depth)
+{
+    return depth < FIRESTORE_RESP_MAX_DEPTH && (r->arrays & (1UL << depth));
+}
+
+/* A member value of "error" starts here */
+static inline bool _in_error(const firestore_resp_t *r)
+{
+    return r->depth == 2 && r->top_key == KEY_ERROR && !_is_array(r, 2);
+}
+
+void firestore_resp_init(firestore_resp_t *r, int http_status)
+{
+    memset(r, 0, sizeof(*r));
+    r->http_status = http_status;
+}
+
+static void _open(firestore_resp_t *r, bool array)
+{
+    // one writeResults entry per object directly inside the array
+    if (!array && r->depth == 2 && r->top_key == KEY_WRITE_RESULTS && _is_array(r, 2))
+    {
+        r->write_results++;
+    }
+    if (r->depth == 0 && array)
+    {
+        r->malformed = true;
+    }
+    r->depth++;
+    if (r->depth < FIRESTORE_RESP_MAX_DEPTH)
+    {
+        if (array)
+        {
+            r->arrays |= 1UL << r->depth;
+        }
+        else
+        {
+            r->arrays &= ~(1UL << r->depth);
+        }
+    }
+    r->expect_key = !array;
+}
+
+static void _close(firestore_resp_t *r)
+{
+    if (r->depth == 0)
+    {
+        r->malformed = true;
+        return;
+    }
+    r->depth--;
+    if (r->depth == 0)
+    {
+        r->complete = true;
+    }
+    else if (r->depth == 1)
+    {
+        r->top_key = KEY_OTHER;
+    }
+}
+
+static void _string_start(firestore_resp_t *r)
+{
+    r->in_string = true;
+    r->string_is_key = r->expect_key;
+    r->expect_key = false;
+    r->key_len = 0;
+    r->capture = NULL;
+    if (!r->string_is_key && _in_error(r))
+    {
+        if (r->sub_key == KEY_STATUS)
+        {
+            r->capture = r->error_status;
+            r->capture_cap = sizeof(r->error_status);
+        }
+        else if (r->sub_key == KEY_MESSAGE)
+        {
+            r->capture = r->error_message;
+            r->capture_cap = sizeof(r->error_message);
+        }
+        r->capture_len = 0;
+    }
+}
+
+static void _string_char(firestore_resp_t *r, char c)
+{
+    if (r->string_is_key)
+    {
+        if (r->key_len < sizeof(r->key) - 1)
+        {
+            r->key[r->key_len] = c;
+        }
+        if (r->key_len < UINT8_MAX)
+        {
+            r->key_len++; // an overlong key matches nothing
+        }
+    }
+    else if (r->capture && r->capture_len < r->capture_cap - 1)
+    {
+        r->capture[r->capture_len++] = c;
+    }
+}
+
+static void _string_end(firestore_resp_t *r)
+{
+    r->in_string = false;
+    if (r->string_is_key)
+    {
+        r->key[r->key_len < sizeof(r->key) ? r->key_len : 0] = '\0';
+        if (r->depth == 1)
+        {
+            r->top_key = _top_key(r->key);
+        }
+        else if (_in_error(r))
+        {
+            r->sub_key = _sub_key(r->key);
+        }
+    }
+    else if (r->capture)
+    {
+        r->capture[r->capture_len] = '\0';
+        r->capture = NULL;
+    }
+}
+
+void firestore_resp_feed(firestore_resp_t *r, const char *data, size_t len)
+{
+    r->bytes += len;
+    for (size_t i = 0; i < len; i++)
+    {
+        char c = data[i];
+        if (r->in_string)
+        {
+            if (r->escape)
+            {
+                r->escape = false;
+                _string_char(r, c);
+            }
+            else if (c == '\\')
+            {
+                r->escape = true;
+            }
+            else if (c == '"')
+            {
+                _string_end(r);
+            }
+            else
+            {
+                _string_char(r, c);
+            }
+            continue;
+        }
+
+        switch (c)
+        {
+        case '{':
+            _open(r, false);
+            break;
+        case '[':
+            _open(r, true);
+            break;
+        case '}':
+        case ']':
+            _close(r);
+            break;
+        case '"':
+            _string_start(r);
+            break;
+        case ',':
+            r->expect_key = !_is_array(r, r->depth);
+            break;
+        default:
+            if (c >= '0' && c <= '9' && _in_error(r) && r->sub_key == KEY_CODE &&
+                r->error_code < 100000)
+            {
+                r->error_code = r->error_code * 10 + (c - '0');
+            }
+            break;
+        }
+    }
+}
+
+firestore_action_t firestore_resp_action(const firestore_resp_t *r)
+{
+    int s = r->http_status;
+    if (s >= 200 && s < 300)
+    {
+        return FIRESTORE_ACK;
+    }
+    if (s <= 0 || s == 408 || s == 429 || s >= 500)
+    {
+        return FIRESTORE_RETRY;
+    }
+    if (s == 401 || strcmp(r->error_status, "UNAUTHENTICATED") == 0)
+    {
+        return FIRESTORE_REAUTH;
+    }
+    // 403: IAM or security rules, 404: database not created yet. Neither
+    // is the data's fault; keep it until someone fixes the project.
+    if (s == 403 || s == 404 || strcmp(r->error_status, "ABORTED") == 0 ||
+        strcmp(r->error_status, "RESOURCE_EXHAUSTED") == 0 ||
+        strcmp(r->error_status, "UNAVAILABLE") == 0)
+    {
+        return FIRESTORE_RETRY;
+    }
+    // INVALID_ARGUMENT, FAILED_PRECONDITION, 413...: resending the same
+    // batch cannot succeed and would block the log behind it
+    return FIRESTORE_DROP;
+}
+
+uint32_t firestore_resp_acked(const firestore_resp_t *r)
+{
+    return r->http_status >= 200 && r->http_status < 300 ? r->write_results : 0;
+}
+
+const char *firestore_action_name(firestore_action_t a)
+{
+    switch (a)
+    {
+    case FIRESTORE_ACK:
+        return "ack";
+    case FIRESTORE_RETRY:
+        return "retry";
+    case FIRESTORE_REAUTH:
+        return "reauth";
+    case FIRESTORE_DROP:
+        return "drop";
+    }
+    return "?";
+}
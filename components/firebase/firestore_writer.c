@@ -0,0 +1,267 @@
+/* components/firebase/firestore_writer.c
+ *
+ * Purpose-built serializer for the Firestore documents:commit body.
+ * Emits what a cJSON tree + cJSON_PrintUnformatted() would produce:
+ *
+ *   {"writes":[{"update":{"name":"projects/<id>/databases/(default)/documents/sensor_data/<ts>",
+ *     "fields":{"timestamp":{"integerValue":"<ts>"},"value":{"doubleValue":"<%.2f>"},
+ *       "min":{...},"max":{...},"stddev":{...},"p50":{...},"p95":{...}}}}, ...]}
+ *
+ * but straight into a caller buffer or a streaming sink, with no heap use.
+ * Records of non-primary channels get the document ID "<ts>-<channel>" and an
+ * extra "channel" integer field; the primary channel keeps the plain <ts> ID.
+ */
+
+#include "firestore_writer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+typedef struct
+{
+    char *buf;            /* output buffer, or staging chunk when streaming */
+    size_t cap;
+    size_t len;           /* bytes currently in buf */
+    size_t total;         /* bytes produced overall */
+    firestore_sink_fn sink;
+    void *ctx;
+    esp_err_t err;
+} emitter_t;
+
+static void _flush(emitter_t *e)
+{
+    if (e->sink && e->len > 0 && e->err == ESP_OK)
+    {
+        e->err = e->sink(e->ctx, e->buf, e->len);
+    }
+    e->len = 0;
+}
+
+static void _emit(emitter_t *e, const char *s, size_t n)
+{
+    e->total += n;
+    if (e->err != ESP_OK || !e->buf)
+    {
+        return;
+    }
+
+    while (n > 0)
+    {
+        size_t room = e->cap - e->len;
+        if (room == 0)
+        {
+            if (!e->sink)
+            {
+                return; /* fixed buffer full: keep counting only */
+            }
+            _flush(e);
+            if (e->err != ESP_OK)
+            {
+                return;
+            }
+            room = e->cap;
+        }
+        size_t take = n < room ? n : room;
+        memcpy(e->buf + e->len, s, take);
+        e->len += take;
+        s += take;
+        n -= take;
+    }
+}
+
+static inline void _emit_lit(emitter_t *e, const char *s)
+{
+    _emit(e, s, strlen(s));
+}
+
+/* JSON string body with the same escaping rules as cJSON */
+static void _emit_escaped(emitter_t *e, const char *s)
+{
+    const char *run = s;
+    for (; *s; s++)
+    {
+        unsigned char c = (unsigned char)*s;
+        const char *esc = NULL;
+        char ubuf[7];
+
+        switch (c)
+        {
+        case '\"':
+            esc = "\\\"";
+            break;
+        case '\\':
+            esc = "\\\\";
+            break;
+        case '\b':
+            esc = "\\b";
+            break;
+        case '\f':
+            esc = "\\f";
+            break;
+        case '\n':
+            esc = "\\n";
+            break;
+        case '\r':
+            esc = "\\r";
+            break;
+        case '\t':
+            esc = "\\t";
+            break;
+        default:
+            if (c < 32)
+            {
+                snprintf(ubuf, sizeof(ubuf), "\\u%04x", c);
+                esc = ubuf;
+            }
+            break;
+        }
+
+        if (esc)
+        {
+            _emit(e, run, (size_t)(s - run));
+            _emit_lit(e, esc);
+            run = s + 1;
+        }
+    }
+    _emit(e, run, (size_t)(s - run));
+}
+
+/* Closes the previous field and emits ,"<name>":{"doubleValue":"<%.2f> */
+static void _emit_double(emitter_t *e, char *num, size_t num_len, const char *name, float v)
+{
+    _emit_lit(e, "\"},\"");
+    _emit_lit(e, name);
+    _emit_lit(e, "\":{\"doubleValue\":\"");
+    _emit(e, num, snprintf(num, num_len, "%.2f", v));
+}
+
+/* One element of "writes"; `first` leaves out the separating comma */
+static void _emit_write(emitter_t *e, const char *proj_id, const avg_sample_t *s, bool first)
+{
+    char num[32];
+    int ts_len = snprintf(num, sizeof(num), "%lld", (long long)s->timestamp);
+
+    if (!first)
+    {
+        _emit_lit(e, ",");
+    }
+
+    char ch[8];
+    int ch_len = 0;
+    if (s->channel != SENSOR_CHANNEL_PRIMARY)
+    {
+        ch_len = snprintf(ch, sizeof(ch), "%u", (unsigned)s->channel);
+    }
+
+    // Document path: use timestamp (and channel) as ID
+    _emit_lit(e, "{\"update\":{\"name\":\"projects/");
+    _emit_escaped(e, proj_id);
+    _emit_lit(e, "/databases/(default)/documents/sensor_data/");
+    _emit(e, num, ts_len);
+    if (ch_len)
+    {
+        _emit_lit(e, "-");
+        _emit(e, ch, ch_len);
+    }
+
+    // timestamp field
+    _emit_lit(e, "\",\"fields\":{\"timestamp\":{\"integerValue\":\"");
+    _emit(e, num, ts_len);
+
+    // channel field
+    if (ch_len)
+    {
+        _emit_lit(e, "\"},\"channel\":{\"integerValue\":\"");
+        _emit(e, ch, ch_len);
+    }
+
+    // value field
+    int val_len = snprintf(num, sizeof(num), "%.2f", s->average);
+    _emit_lit(e, "\"},\"value\":{\"doubleValue\":\"");
+    _emit(e, num, val_len);
+
+    // window statistics
+    _emit_double(e, num, sizeof(num), "min", s->min);
+    _emit_double(e, num, sizeof(num), "max", s->max);
+    _emit_double(e, num, sizeof(num), "stddev", s->stddev);
+    _emit_double(e, num, sizeof(num), "p50", s->p50);
+    _emit_double(e, num, sizeof(num), "p95", s->p95);
+    _emit_lit(e, "\"}}}}");
+}
+
+#define BODY_OPEN "{\"writes\":["
+#define BODY_CLOSE "]}"
+
+static void _emit_body(emitter_t *e, const char *proj_id,
+                       const avg_sample_t *records, size_t count)
+{
+    _emit_lit(e, BODY_OPEN);
+    for (size_t i = 0; i < count; i++)
+    {
+        _emit_write(e, proj_id, &records[i], i == 0);
+    }
+    _emit_lit(e, BODY_CLOSE);
+}
+
+size_t firestore_commit_serialize(const char *proj_id, const avg_sample_t *records,
+                                  size_t count, char *out, size_t out_len)
+{
+    emitter_t e = {
+        .buf = out,
+        .cap = out_len ? out_len - 1 : 0, /* room for the NUL */
+        .err = ESP_OK,
+    };
+    _emit_body(&e, proj_id, records, count);
+    if (out && out_len)
+    {
+        out[e.len] = '\0';
+    }
+    return e.total;
+}
+
+esp_err_t firestore_commit_stream(const char *proj_id, const avg_sample_t *records,
+                                  size_t count, firestore_sink_fn sink, void *ctx,
+                                  size_t *out_total)
+{
+    char chunk[FIRESTORE_WRITER_CHUNK];
+    emitter_t e = {
+        .buf = chunk,
+        .cap = sizeof(chunk),
+        .sink = sink,
+        .ctx = ctx,
+        .err = ESP_OK,
+    };
+    _emit_body(&e, proj_id, records, count);
+    _flush(&e);
+
+    if (out_total)
+    {
+        *out_total = e.total;
+    }
+    return e.err;
+}
+
+size_t firestore_commit_fit(const char *proj_id, const avg_sample_t *records,
+                            size_t count, size_t max_bytes, size_t *out_len)
+{
+    emitter_t e = {.err = ESP_OK}; /* no buffer: measure only */
+    _emit_lit(&e, BODY_OPEN);
+    size_t n = 0;
+    while (n < count && n < FIRESTORE_MAX_WRITES)
+    {
+        size_t before = e.total;
+        _emit_write(&e, proj_id, &records[n], n == 0);
+        if (n > 0 && e.total + strlen(BODY_CLOSE) > max_bytes)
+        {
+            e.total = before;
+            break;
+        }
+        n++;
+    }
+    _emit_lit(&e, BODY_CLOSE);
+    if (out_len)
+    {
+        *out_len = e.total;
+    }
+    return n;
+}
@@ -1,5 +1,46 @@
 #pragma once
 #include "freertos/FreeRTOS.h"
+#include "sensor_record.h"
+#include "firestore_reader.h"
+
+/* Commit bodies at least this long are sent gzip-compressed; cfg.json
+ * "firestore_gzip_min" overrides it, 0 turns compression off */
+#define FIREBASE_GZIP_MIN_BODY 4096
+
+/* Largest uncompressed commit body; cfg.json "firestore_max_body" overrides
+ * it. The body is streamed, so this bounds the time one commit holds the
+ * link (and its timeouts), not RAM. 500 typical records are ~175 KB. */
+#define FIREBASE_MAX_BODY (192 * 1024)
+
+/**
+ * @brief  Reserve the upload arena, and the compressor if compression is
+ *         on, while the heap is still unfragmented. Call once at startup;
+ *         the first commit does it otherwise.
+ */
+esp_err_t firebase_init(void);
+
+/** Outcome of one commit, from the status line and the parsed response body */
+typedef struct
+{
+    firestore_action_t action; /* FIRESTORE_RETRY if no response came back */
+    int http_status;           /* 0 if none */
+    uint32_t acked;            /* writes listed in "writeResults" */
+    uint32_t body_bytes;       /* uncompressed body length */
+} firebase_commit_result_t;
 
-esp_err_t firebase_get_access_token(char *out_token, size_t max_len, char *svc_acct_email);
 esp_err_t send_sensor_data_to_firestore(const char *doc);
+
+/**
+ * @brief  How many of the leading `count` records one commit may carry:
+ *         up to FIRESTORE_MAX_WRITES within the body budget, at least one.
+ */
+size_t firebase_commit_fit(const avg_sample_t *records, size_t count);
+
+/**
+ * @brief  Commit `count` window records. A rejected token is replaced and
+ *         the commit resent once before giving up.
+ * @param  res  Optional; says whether the records may leave the log.
+ * @return ESP_OK only if the commit was acknowledged (FIRESTORE_ACK).
+ */
+esp_err_t firebase_commit_records(const avg_sample_t *records, size_t count,
+                                  firebase_commit_result_t *res);
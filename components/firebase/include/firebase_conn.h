@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_client.h"
+
+/* Connections idle longer than this are re-established up front (using the
+ * saved TLS session) instead of finding out on write that the server
+ * already dropped them. */
+#define FIREBASE_CONN_IDLE_MS 45000
+
+/** Handshake / reuse counters for one long-lived connection. */
+typedef struct
+{
+    uint32_t requests;           /* requests sent on this connection object */
+    uint32_t reused;             /* requests that rode an already open socket */
+    uint32_t handshakes;         /* TCP+TLS connects (first one + reconnects) */
+    uint32_t failures;           /* requests that ended with a forced close */
+    int64_t last_handshake_us;   /* duration of the most recent connect */
+    int64_t max_handshake_us;
+    int64_t total_handshake_us;
+} firebase_conn_stats_t;
+
+/** Long-lived HTTPS connection to a single host. Zero-initialise before use. */
+typedef struct
+{
+    esp_http_client_handle_t client;
+    const char *name;
+    char *cert_pem;              /* private copy of the root CA */
+    uint32_t cfg_generation;     /* config generation cert_pem was checked against */
+    int64_t open_start_us;
+    int64_t last_used_us;
+    bool connected;              /* socket currently open */
+    bool handshake_seen;         /* set by the event handler during open */
+    bool server_close;           /* server answered "Connection: close" */
+    bool last_reused;
+    firebase_conn_stats_t stats;
+} firebase_conn_t;
+
+/**
+ * @brief  Make sure the connection has a client for `url` and reset it for
+ *         a new POST. The socket (if any) is kept.
+ * @param  conn      Connection object.
+ * @param  url       Full request URL (same host on every call).
+ * @param  cert_pem  Root CA; copied, only needs to be valid during the call.
+ */
+esp_err_t firebase_conn_prepare(firebase_conn_t *conn, const char *url, const char *cert_pem);
+
+/** @brief Set a request header for the next request. */
+esp_err_t firebase_conn_set_header(firebase_conn_t *conn, const char *key, const char *value);
+
+/** @brief Remove a header an earlier request on this connection set. */
+esp_err_t firebase_conn_delete_header(firebase_conn_t *conn, const char *key);
+
+/**
+ * @brief  Send the request line and headers. Connects (or resumes the TLS
+ *         session) only if the socket is not already open.
+ * @param  content_len  Body length, or -1 for chunked transfer encoding.
+ */
+esp_err_t firebase_conn_open(firebase_conn_t *conn, int content_len);
+
+/** @brief Write (part of) the request body. Returns bytes written or -1. */
+int firebase_conn_write(firebase_conn_t *conn, const char *buf, int len);
+
+/**
+ * @brief  Finish the request and read the response headers.
+ * @param  out_status  Receives the HTTP status code.
+ * @return Content length (0 if chunked/unknown), or -1 on error.
+ */
+int64_t firebase_conn_fetch_headers(firebase_conn_t *conn, int *out_status);
+
+/** @brief Read (part of) the response body. Returns bytes read or -1. */
+int firebase_conn_read(firebase_conn_t *conn, char *buf, int len);
+
+/**
+ * @brief  Release the connection after a request. On success the rest of the
+ *         body is drained so the socket can be reused; on failure it is
+ *         closed so the next request reconnects.
+ */
+void firebase_conn_finish(firebase_conn_t *conn, bool ok);
+
+/** @brief True if the last open went over an already established socket. */
+bool firebase_conn_last_reused(const firebase_conn_t *conn);
+
+/** @brief Close the socket and free the client. */
+void firebase_conn_close(firebase_conn_t *conn);
+
+/** @brief Log the handshake / reuse counters. */
+void firebase_conn_log_stats(const firebase_conn_t *conn);
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+#include "breaker.h"
+
+#define FIREBASE_CRED_STACK_SIZE CONFIG_FIREBASE_CRED_STACK_SIZE
+#define FIREBASE_CRED_PRIORITY CONFIG_FIREBASE_CRED_PRIORITY
+#define FIREBASE_CRED_CORE CONFIG_FIREBASE_CRED_CORE
+/* Refresh this long before (expiry - TOKEN_REFRESH_MARGIN) */
+#define FIREBASE_CRED_LEAD_SEC 300
+/* Retry gate for the token endpoint: failed refreshes back off from
+ * BACKOFF_MIN to BACKOFF_MAX, and after THRESHOLD in a row only a single
+ * refresh is tried every BACKOFF_MAX (components/breaker) */
+#define FIREBASE_CRED_BACKOFF_MIN_MS 5000
+#define FIREBASE_CRED_BACKOFF_MAX_MS 600000
+#define FIREBASE_CRED_BREAKER_THRESHOLD 4
+#define FIREBASE_CRED_RETRY_BUDGET 8
+#define FIREBASE_CRED_BUDGET_REFILL_MS 900000
+
+typedef struct
+{
+    uint32_t refreshes;       /* tokens obtained */
+    uint32_t failures;        /* refresh attempts that failed */
+    uint32_t key_parses;      /* times the PEM key was parsed */
+    int64_t last_sign_us;     /* duration of the last RS256 signature */
+    int64_t max_sign_us;
+    int64_t last_refresh_us;  /* sign + HTTP round trip of the last refresh */
+    time_t token_issued;      /* wall clock when the current token arrived */
+    time_t token_expiry;
+    breaker_stats_t breaker;  /* token endpoint retry gate */
+} firebase_cred_stats_t;
+
+/**
+ * @brief  Start the credential manager task. It parses the service account
+ *         key once, keeps it in a long-lived mbedtls_pk_context and refreshes
+ *         the OAuth2 token in the background ahead of its expiry. Safe to
+ *         call from several tasks; only the first one initialises.
+ */
+esp_err_t firebase_cred_start(void);
+
+/**
+ * @brief  Copy the current access token.
+ *
+ * In steady state this is a memcpy under a mutex. Only when no valid token
+ * exists yet (first boot, after invalidate) does it wake the manager and
+ * wait up to `wait` ticks. ESP_ERR_INVALID_STATE until firebase_cred_start()
+ * has run; this never starts the manager itself.
+ */
+esp_err_t firebase_cred_get_token(char *out_token, size_t max_len, TickType_t wait);
+
+/** @brief Drop the cached token (e.g. after the server rejected it). */
+void firebase_cred_invalidate(void);
+
+/** @brief Snapshot of signing/refresh counters. */
+void firebase_cred_get_stats(firebase_cred_stats_t *out);
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Longest error.status / error.message kept for the log; the rest is skipped */
+#define FIRESTORE_RESP_STATUS_LEN 24
+#define FIRESTORE_RESP_MESSAGE_LEN 96
+/* Containers nested deeper than this are still skipped correctly, but
+ * nothing inside them is looked at */
+#define FIRESTORE_RESP_MAX_DEPTH 32
+
+/** What the uploader should do with the records of a commit. */
+typedef enum
+{
+    FIRESTORE_ACK,    /* committed; remove them from the log */
+    FIRESTORE_RETRY,  /* transient (no answer, 408, 429, 5xx, ABORTED...); keep them */
+    FIRESTORE_REAUTH, /* token rejected; keep them, sign a new token first */
+    FIRESTORE_DROP,   /* the server will never accept this batch as is; split it, drop what still fails */
+} firestore_action_t;
+
+/**
+ * Incremental reader for a documents:commit response. Bytes are fed as
+ * they arrive off the socket, in pieces of any size; only the parts the
+ * upload decision needs are kept:
+ *
+ *   {"writeResults":[{"updateTime":"..."}, ...],"commitTime":"..."}
+ *   {"error":{"code":429,"message":"...","status":"RESOURCE_EXHAUSTED"}}
+ *
+ * A small fixed-size scanner state replaces the response buffer, so a
+ * commit of any size costs the same RAM.
+ */
+typedef struct
+{
+    int http_status;
+    uint32_t write_results;  /* entries of "writeResults" seen so far */
+    int32_t error_code;      /* "error"."code", 0 if absent */
+    char error_status[FIRESTORE_RESP_STATUS_LEN];
+    char error_message[FIRESTORE_RESP_MESSAGE_LEN];
+    uint32_t bytes;          /* body bytes fed */
+    bool complete;           /* top-level object closed */
+    bool malformed;          /* not the JSON shape above */
+
+    /* scanner */
+    uint8_t depth;
+    uint32_t arrays;         /* bit d set: container at depth d is an array */
+    bool in_string;
+    bool escape;
+    bool string_is_key;
+    bool expect_key;
+    uint8_t top_key;         /* key of the current top-level member */
+    uint8_t sub_key;         /* key of the current member of "error" */
+    char key[16];
+    uint8_t key_len;
+    char *capture;           /* string value being copied, if wanted */
+    size_t capture_len;
+    size_t capture_cap;
+} firestore_resp_t;
+
+/** @brief Start reading the body of a response with HTTP status `http_status`. */
+void firestore_resp_init(firestore_resp_t *r, int http_status);
+
+/** @brief Feed the next `len` bytes of the body. */
+void firestore_resp_feed(firestore_resp_t *r, const char *data, size_t len);
+
+/**
+ * @brief  Decide the fate of the committed records once the body is read
+ *         (or the read failed). A commit is atomic, so any 2xx is
+ *         FIRESTORE_ACK even if the body was cut short; errors are
+ *         classified by error.status where the HTTP status is ambiguous
+ *         (409 is both ABORTED and ALREADY_EXISTS).
+ */
+firestore_action_t firestore_resp_action(const firestore_resp_t *r);
+
+/** @brief Writes the server confirmed: "writeResults" entries, or 0. */
+uint32_t firestore_resp_acked(const firestore_resp_t *r);
+
+/** @brief "ack", "retry", "reauth" or "drop". */
+const char *firestore_action_name(firestore_action_t a);
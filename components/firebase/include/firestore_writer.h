@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "sensor_record.h"
+
+/* Size of the staging chunk used when streaming into a sink */
+#define FIRESTORE_WRITER_CHUNK 512
+/* Firestore rejects commits with more writes than this */
+#define FIRESTORE_MAX_WRITES 500
+
+/**
+ * @brief  Sink for streamed output. Return ESP_OK to continue; any other
+ *         value aborts serialization and is returned to the caller.
+ */
+typedef esp_err_t (*firestore_sink_fn)(void *ctx, const char *data, size_t len);
+
+/**
+ * @brief  Serialize a documents:commit body for `count` records into `out`.
+ *
+ * Output is byte-identical to building the same body with cJSON and
+ * cJSON_PrintUnformatted(), without allocating. Like snprintf(), the
+ * return value is the full body length (excluding the NUL); pass
+ * out = NULL / out_len = 0 to only measure it.
+ */
+size_t firestore_commit_serialize(const char *proj_id, const avg_sample_t *records,
+                                  size_t count, char *out, size_t out_len);
+
+/**
+ * @brief  Stream the same body through `sink` in FIRESTORE_WRITER_CHUNK
+ *         pieces staged on the stack. No heap use.
+ * @param  out_total  Optional, receives the number of bytes produced.
+ */
+esp_err_t firestore_commit_stream(const char *proj_id, const avg_sample_t *records,
+                                  size_t count, firestore_sink_fn sink, void *ctx,
+                                  size_t *out_total);
+
+/**
+ * @brief  How many of the leading `count` records go into one commit: as
+ *         many as fit a body of `max_bytes`, up to FIRESTORE_MAX_WRITES.
+ *         At least one if count > 0, however long its body. Measures
+ *         without writing anything.
+ * @param  out_len  Optional, receives the body length for that many.
+ */
+size_t firestore_commit_fit(const char *proj_id, const avg_sample_t *records,
+                            size_t count, size_t max_bytes, size_t *out_len);
@@ -0,0 +1,302 @@
+/* components/gzip_stream/gzip_stream.c
+ *
+ * Small-window gzip compressor:
+ *  - One deflate block with the fixed Huffman tables (RFC 1951 3.2.6), so
+ *    no symbol statistics have to be buffered before output starts
+ *  - LZ77 over a 2 x GZIP_STREAM_WINDOW buffer that slides by half when
+ *    full, with hash chains capped at GZIP_STREAM_MAX_CHAIN
+ *  - Output is staged in a GZIP_STREAM_OUT_CHUNK buffer and handed to the
+ *    sink, so nothing grows with the input size
+ */
+
+#include "gzip_stream.h"
+
+#include <string.h>
+#include "esp_rom_crc.h"
+
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+#define NIL 0xFFFF
+#define HASH_SIZE (1 << GZIP_STREAM_HASH_BITS)
+
+/* Length codes 257..285: base length and extra bits */
+static const uint16_t s_len_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t s_len_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+
+/* Distance codes 0..29: base distance and extra bits */
+static const uint16_t s_dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t s_dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+/* ---- output ---- */
+
+static void _flush_out(gzip_stream_t *gz)
+{
+    if (gz->out_len > 0 && gz->err == ESP_OK)
+    {
+        gz->err = gz->sink(gz->ctx, gz->out, gz->out_len);
+    }
+    gz->out_total += gz->out_len;
+    gz->out_len = 0;
+}
+
+static void _put_byte(gzip_stream_t *gz, uint8_t b)
+{
+    if (gz->out_len == sizeof(gz->out))
+    {
+        _flush_out(gz);
+    }
+    gz->out[gz->out_len++] = (char)b;
+}
+
+/* Deflate packs bits LSB first */
+static void _put_bits(gzip_stream_t *gz, uint32_t value, uint8_t n)
+{
+    gz->bits |= value << gz->n_bits;
+    gz->n_bits += n;
+    while (gz->n_bits >= 8)
+    {
+        _put_byte(gz, (uint8_t)gz->bits);
+        gz->bits >>= 8;
+        gz->n_bits -= 8;
+    }
+}
+
+/* Huffman codes are sent MSB first, i.e. bit-reversed */
+static void _put_code(gzip_stream_t *gz, uint32_t code, uint8_t len)
+{
+    uint32_t rev = 0;
+    for (uint8_t i = 0; i < len; i++)
+    {
+        rev = (rev << 1) | ((code >> i) & 1);
+    }
+    _put_bits(gz, rev, len);
+}
+
+static void _put_litlen(gzip_stream_t *gz, uint16_t sym)
+{
+    if (sym < 144)
+    {
+        _put_code(gz, 0x30 + sym, 8);
+    }
+    else if (sym < 256)
+    {
+        _put_code(gz, 0x190 + (sym - 144), 9);
+    }
+    else if (sym < 280)
+    {
+        _put_code(gz, sym - 256, 7);
+    }
+    else
+    {
+        _put_code(gz, 0xC0 + (sym - 280), 8);
+    }
+}
+
+static void _put_match(gzip_stream_t *gz, uint16_t len, uint16_t dist)
+{
+    int lc = 28;
+    while (s_len_base[lc] > len)
+    {
+        lc--;
+    }
+    _put_litlen(gz, 257 + lc);
+    _put_bits(gz, len - s_len_base[lc], s_len_extra[lc]);
+
+    int dc = 29;
+    while (s_dist_base[dc] > dist)
+    {
+        dc--;
+    }
+    _put_code(gz, dc, 5);
+    _put_bits(gz, dist - s_dist_base[dc], s_dist_extra[dc]);
+}
+
+/* ---- matching ---- */
+
+static inline uint16_t _hash(const uint8_t *p)
+{
+    uint32_t v = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+    return (uint16_t)((v * 2654435761u) >> (32 - GZIP_STREAM_HASH_BITS));
+}
+
+static void _insert(gzip_stream_t *gz, uint16_t pos)
+{
+    uint16_t h = _hash(&gz->window[pos]);
+    gz->prev[pos & (GZIP_STREAM_WINDOW - 1)] = gz->head[h];
+    gz->head[h] = pos;
+}
+
+static uint16_t _longest_match(gzip_stream_t *gz, uint16_t pos, uint16_t avail, uint16_t *dist)
+{
+    uint16_t best = 0;
+    uint16_t max = avail < MAX_MATCH ? avail : MAX_MATCH;
+    uint16_t cand = gz->head[_hash(&gz->window[pos])];
+    const uint8_t *cur = &gz->window[pos];
+
+    for (int chain = 0; chain < GZIP_STREAM_MAX_CHAIN && cand != NIL && cand < pos; chain++)
+    {
+        if (pos - cand > GZIP_STREAM_WINDOW)
+        {
+            break;
+        }
+        const uint8_t *m = &gz->window[cand];
+        if (m[best] == cur[best])
+        {
+            uint16_t len = 0;
+            while (len < max && m[len] == cur[len])
+            {
+                len++;
+            }
+            if (len > best)
+            {
+                best = len;
+                *dist = pos - cand;
+                if (len == max)
+                {
+                    break;
+                }
+            }
+        }
+        cand = gz->prev[cand & (GZIP_STREAM_WINDOW - 1)];
+    }
+    return best >= MIN_MATCH ? best : 0;
+}
+
+/* Encode window bytes, keeping MAX_MATCH of lookahead unless finishing */
+static void _deflate(gzip_stream_t *gz, bool finish)
+{
+    while (gz->pos < gz->fill && (finish || gz->fill - gz->pos >= MAX_MATCH))
+    {
+        uint16_t avail = gz->fill - gz->pos;
+        uint16_t dist = 0;
+        uint16_t len = avail >= MIN_MATCH ? _longest_match(gz, gz->pos, avail, &dist) : 0;
+
+        if (len)
+        {
+            _put_match(gz, len, dist);
+        }
+        else
+        {
+            _put_litlen(gz, gz->window[gz->pos]);
+            len = 1;
+        }
+
+        /* Index every position we step over so later matches can find it */
+        for (uint16_t i = 0; i < len; i++, gz->pos++)
+        {
+            if (gz->fill - gz->pos >= MIN_MATCH)
+            {
+                _insert(gz, gz->pos);
+            }
+        }
+    }
+}
+
+/* Drop the older half of the window and rebase the hash positions */
+static void _slide(gzip_stream_t *gz)
+{
+    memmove(gz->window, gz->window + GZIP_STREAM_WINDOW, GZIP_STREAM_WINDOW);
+    gz->pos -= GZIP_STREAM_WINDOW;
+    gz->fill -= GZIP_STREAM_WINDOW;
+    for (size_t i = 0; i < HASH_SIZE; i++)
+    {
+        gz->head[i] = (gz->head[i] != NIL && gz->head[i] >= GZIP_STREAM_WINDOW)
+                          ? gz->head[i] - GZIP_STREAM_WINDOW
+                          : NIL;
+    }
+    for (size_t i = 0; i < GZIP_STREAM_WINDOW; i++)
+    {
+        gz->prev[i] = (gz->prev[i] != NIL && gz->prev[i] >= GZIP_STREAM_WINDOW)
+                          ? gz->prev[i] - GZIP_STREAM_WINDOW
+                          : NIL;
+    }
+}
+
+/* ---- public API ---- */
+
+esp_err_t gzip_stream_init(gzip_stream_t *gz, gzip_sink_fn sink, void *ctx)
+{
+    if (!gz || !sink)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(gz->head, 0xFF, sizeof(gz->head));
+    memset(gz->prev, 0xFF, sizeof(gz->prev));
+    gz->out_len = 0;
+    gz->bits = 0;
+    gz->n_bits = 0;
+    gz->pos = 0;
+    gz->fill = 0;
+    gz->crc = 0;
+    gz->in_total = 0;
+    gz->out_total = 0;
+    gz->sink = sink;
+    gz->ctx = ctx;
+    gz->err = ESP_OK;
+
+    /* gzip header: magic, deflate, no flags, no mtime, XFL 0, OS unknown */
+    static const uint8_t header[10] = {0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 0xFF};
+    for (size_t i = 0; i < sizeof(header); i++)
+    {
+        _put_byte(gz, header[i]);
+    }
+    _put_bits(gz, 1, 1); // BFINAL: everything goes in one block
+    _put_bits(gz, 1, 2); // BTYPE 01: fixed Huffman
+    return ESP_OK;
+}
+
+esp_err_t gzip_stream_write(gzip_stream_t *gz, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    gz->crc = esp_rom_crc32_le(gz->crc, p, len);
+    gz->in_total += len;
+
+    while (len > 0 && gz->err == ESP_OK)
+    {
+        if (gz->fill == sizeof(gz->window))
+        {
+            _slide(gz);
+        }
+        size_t take = sizeof(gz->window) - gz->fill;
+        if (take > len)
+        {
+            take = len;
+        }
+        memcpy(gz->window + gz->fill, p, take);
+        gz->fill += take;
+        p += take;
+        len -= take;
+        _deflate(gz, false);
+    }
+    return gz->err;
+}
+
+esp_err_t gzip_stream_finish(gzip_stream_t *gz)
+{
+    _deflate(gz, true);
+    _put_litlen(gz, 256); // end of block
+    if (gz->n_bits > 0)
+    {
+        _put_bits(gz, 0, 8 - gz->n_bits);
+    }
+
+    /* trailer: CRC32 and input size, little endian */
+    for (int i = 0; i < 4; i++)
+    {
+        _put_byte(gz, (uint8_t)(gz->crc >> (8 * i)));
+    }
+    for (int i = 0; i < 4; i++)
+    {
+        _put_byte(gz, (uint8_t)(gz->in_total >> (8 * i)));
+    }
+    _flush_out(gz);
+    return gz->err;
+}
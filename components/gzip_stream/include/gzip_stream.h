@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/* History the matcher can refer back to; 4 KiB spans ~10 Firestore writes */
+#define GZIP_STREAM_WINDOW_BITS 12
+#define GZIP_STREAM_WINDOW (1 << GZIP_STREAM_WINDOW_BITS)
+#define GZIP_STREAM_HASH_BITS 11
+#define GZIP_STREAM_MAX_CHAIN 8     // match candidates tried per position
+#define GZIP_STREAM_OUT_CHUNK 512   // compressed bytes handed to the sink at once
+
+/** @brief Receives compressed output; anything but ESP_OK aborts the stream. */
+typedef esp_err_t (*gzip_sink_fn)(void *ctx, const char *data, size_t len);
+
+/**
+ * Streaming gzip (RFC 1952) compressor with a fixed memory footprint of
+ * sizeof(gzip_stream_t), ~21 KiB: one static-Huffman deflate block and a
+ * small LZ77 window. Meant for repetitive text like request bodies, where
+ * it gets most of zlib's ratio at a fraction of its RAM.
+ */
+typedef struct
+{
+    uint8_t window[2 * GZIP_STREAM_WINDOW];
+    uint16_t head[1 << GZIP_STREAM_HASH_BITS];
+    uint16_t prev[GZIP_STREAM_WINDOW];
+    char out[GZIP_STREAM_OUT_CHUNK];
+    size_t out_len;
+    uint32_t bits;
+    uint8_t n_bits;
+    uint16_t pos;     // next window byte to encode
+    uint16_t fill;    // bytes in window
+    uint32_t crc;
+    uint32_t in_total;
+    uint32_t out_total;
+    gzip_sink_fn sink;
+    void *ctx;
+    esp_err_t err;
+} gzip_stream_t;
+
+/** @brief Start a stream and emit the gzip header. */
+esp_err_t gzip_stream_init(gzip_stream_t *gz, gzip_sink_fn sink, void *ctx);
+
+/** @brief Compress `len` bytes; output reaches the sink in GZIP_STREAM_OUT_CHUNK pieces. */
+esp_err_t gzip_stream_write(gzip_stream_t *gz, const void *data, size_t len);
+
+/** @brief Flush the rest and emit the trailer. `in_total`/`out_total` are final afterwards. */
+esp_err_t gzip_stream_finish(gzip_stream_t *gz);
@@ -1,10 +1,80 @@
 #pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
 #include "mqtt_client.h"
+#include "sensor_record.h"
+#include "payload_codec.h"
 
 #define BROKER_URL_SIZE 64
 #define MQTT_PASSWORD_SIZE 21
 #define MQTT_USERNAME_SIZE 21
 #define MQTT_CERT_SIZE 2049
+#define MQTT_MAX_TOPIC_HANDLERS 8
 
-esp_err_t mqtt_app_start(char *broker_uri, char *mqtt_username, char *mqtt_password, char *verification_cert);
+/* Telemetry publisher */
+#define MQTT_TELEMETRY_TOPIC_SIZE 64
+#define MQTT_TELEMETRY_PAYLOAD_MAX 1024 // one publish
+#define MQTT_TELEMETRY_MAX_INFLIGHT 4   // payloads the outbox may hold before batches are dropped
+#define MQTT_TELEMETRY_BATCH 16         // default records per publish
+#define MQTT_TELEMETRY_MAX_DELAY_S 60   // suggested age of the oldest record before a publish
+#define MQTT_TELEMETRY_POLL_MS 5000     // suggested mqtt_telemetry_poll() period
+
+typedef struct
+{
+    const char *topic;      // copied
+    int qos;                // 0 or 1
+    uint16_t batch_records; // publish once this many records are pending, 0 = MQTT_TELEMETRY_BATCH
+    uint32_t max_delay_s;   // ...or once the oldest pending record is this old, 0 = never
+    const payload_codec_t *codec; // wire format, NULL = payload_codec_json
+} mqtt_telemetry_cfg_t;
+
+typedef struct
+{
+    uint32_t records;   // records accepted into a payload
+    uint32_t publishes; // payloads handed to the outbox
+    uint32_t bytes;     // payload bytes handed to the outbox
+    uint32_t dropped;   // records lost because the in-flight window was full
+    uint32_t acked;     // QoS1 payloads acknowledged by the broker
+} mqtt_telemetry_stats_t;
+
+/* Called from the MQTT task with one complete message on the topic */
+typedef void (*mqtt_topic_handler_t)(const char *data, int len, void *arg);
+
+esp_err_t mqtt_app_start(const char *broker_uri, const char *mqtt_username, const char *mqtt_password, const char *verification_cert);
 esp_mqtt_client_handle_t mqtt_get_client(void);
+
+/**
+ * @brief  Route messages on `topic` to `handler`. May be called before the
+ *         client starts; subscriptions are (re)sent on every connect.
+ */
+esp_err_t mqtt_man_subscribe(const char *topic, int qos, mqtt_topic_handler_t handler, void *arg);
+
+/**
+ * @brief  Enable the telemetry publisher. Window records pushed afterwards
+ *         are coalesced into one payload per publish in the configured
+ *         codec and queued with esp_mqtt_client_enqueue(), so publishing
+ *         never blocks on the network.
+ */
+esp_err_t mqtt_telemetry_start(const mqtt_telemetry_cfg_t *cfg);
+
+/**
+ * @brief  Add records to the pending payload, publishing it when it is full
+ *         or old enough. Call push/flush from one task only.
+ * @return ESP_ERR_INVALID_STATE if the publisher is not started,
+ *         ESP_ERR_NO_MEM if records had to be dropped.
+ */
+esp_err_t mqtt_telemetry_push(const avg_sample_t *recs, size_t count);
+
+/** @brief Publish the pending payload now, if any. */
+esp_err_t mqtt_telemetry_flush(void);
+
+/**
+ * @brief  Publish the pending payload if its oldest record is max_delay_s
+ *         old at wall-clock `now`. push() only checks on the next record,
+ *         which report filtering can hold back for a heartbeat interval;
+ *         call this periodically from the pushing task.
+ */
+esp_err_t mqtt_telemetry_poll(time_t now);
+
+void mqtt_telemetry_get_stats(mqtt_telemetry_stats_t *out);
@@ -1,6 +1,9 @@
 
 #include "mqtt_man.h"
 #include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
 #include "esp_log.h"
 #include "esp_err.h"
 
@@ -9,43 +12,111 @@ static esp_mqtt_client_handle_t client = NULL;
 
 static const char *TAGM = "MQTT";
 
+/* Topic handlers registered through mqtt_man_subscribe() */
+typedef struct
+{
+    const char *topic;
+    int qos;
+    mqtt_topic_handler_t handler;
+    void *arg;
+} topic_route_t;
+
+/* Written by mqtt_man_subscribe() on any task, read on the esp-mqtt task.
+ * Readers copy the table out under the lock and work on the copy, so no
+ * handler or client call ever runs inside the critical section. */
+static portMUX_TYPE routes_lock = portMUX_INITIALIZER_UNLOCKED;
+static topic_route_t routes[MQTT_MAX_TOPIC_HANDLERS];
+static int route_count = 0;
+static bool connected = false;
+
+static int routes_snapshot(topic_route_t *out)
+{
+    taskENTER_CRITICAL(&routes_lock);
+    int n = route_count;
+    memcpy(out, routes, n * sizeof(routes[0]));
+    taskEXIT_CRITICAL(&routes_lock);
+    return n;
+}
+
+/* Telemetry publisher; the payload is only touched by the pushing task */
+static struct
+{
+    bool started;
+    char topic[MQTT_TELEMETRY_TOPIC_SIZE];
+    int qos;
+    uint16_t batch_records;
+    uint32_t max_delay_s;
+    uint8_t payload[MQTT_TELEMETRY_PAYLOAD_MAX];
+    payload_enc_t enc;
+    mqtt_telemetry_stats_t stats;
+} s_tm;
+
+static void dispatch_data(esp_mqtt_event_handle_t event)
+{
+    // fragmented messages (larger than the receive buffer) are not routed
+    if (event->data_len != event->total_data_len)
+    {
+        return;
+    }
+    topic_route_t snap[MQTT_MAX_TOPIC_HANDLERS];
+    int n = routes_snapshot(snap);
+    for (int i = 0; i < n; i++)
+    {
+        if ((int)strlen(snap[i].topic) == event->topic_len &&
+            strncmp(snap[i].topic, event->topic, event->topic_len) == 0)
+        {
+            snap[i].handler(event->data, event->data_len, snap[i].arg);
+        }
+    }
+}
+
+/* On connect: flag it first, so a route added from now on subscribes
+ * itself, then subscribe everything registered so far */
+static void resubscribe_routes(esp_mqtt_client_handle_t client)
+{
+    taskENTER_CRITICAL(&routes_lock);
+    connected = true;
+    taskEXIT_CRITICAL(&routes_lock);
+
+    topic_route_t snap[MQTT_MAX_TOPIC_HANDLERS];
+    int n = routes_snapshot(snap);
+    for (int i = 0; i < n; i++)
+    {
+        esp_mqtt_client_subscribe(client, snap[i].topic, snap[i].qos);
+    }
+}
+
 static esp_err_t mqtt_event_handler_cb(esp_mqtt_event_handle_t event)
 {
     esp_mqtt_client_handle_t client = event->client;
-    int msg_id;
-    // your_context_t *context = event->context;
     switch (event->event_id)
     {
     case MQTT_EVENT_CONNECTED:
         ESP_LOGI(TAGM, "MQTT_EVENT_CONNECTED");
-        msg_id = esp_mqtt_client_subscribe(client, "/topic/qos0", 0);
-        ESP_LOGI(TAGM, "sent subscribe successful, msg_id=%d", msg_id);
-
-        msg_id = esp_mqtt_client_subscribe(client, "/topic/qos1", 1);
-        ESP_LOGI(TAGM, "sent subscribe successful, msg_id=%d", msg_id);
-
-        msg_id = esp_mqtt_client_unsubscribe(client, "/topic/qos1");
-        ESP_LOGI(TAGM, "sent unsubscribe successful, msg_id=%d", msg_id);
+        resubscribe_routes(client);
         break;
     case MQTT_EVENT_DISCONNECTED:
         ESP_LOGI(TAGM, "MQTT_EVENT_DISCONNECTED");
+        taskENTER_CRITICAL(&routes_lock);
+        connected = false;
+        taskEXIT_CRITICAL(&routes_lock);
         break;
 
     case MQTT_EVENT_SUBSCRIBED:
         ESP_LOGI(TAGM, "MQTT_EVENT_SUBSCRIBED, msg_id=%d", event->msg_id);
-        msg_id = esp_mqtt_client_publish(client, "/topic/qos0", "data", 0, 0, 0);
-        ESP_LOGI(TAGM, "sent publish successful, msg_id=%d", msg_id);
         break;
     case MQTT_EVENT_UNSUBSCRIBED:
         ESP_LOGI(TAGM, "MQTT_EVENT_UNSUBSCRIBED, msg_id=%d", event->msg_id);
         break;
     case MQTT_EVENT_PUBLISHED:
-        ESP_LOGI(TAGM, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
+        ESP_LOGD(TAGM, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
+        s_tm.stats.acked++; // telemetry is the only QoS1 publisher
         break;
     case MQTT_EVENT_DATA:
         ESP_LOGI(TAGM, "MQTT_EVENT_DATA");
         printf("TOPIC=%.*s\r\n", event->topic_len, event->topic);
         printf("DATA=%.*s\r\n", event->data_len, event->data);
+        dispatch_data(event);
         break;
     case MQTT_EVENT_ERROR:
         ESP_LOGI(TAGM, "MQTT_EVENT_ERROR");
@@ -63,7 +134,7 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
     mqtt_event_handler_cb(event_data);
 }
 
-esp_err_t mqtt_app_start(char *broker_uri, char *mqtt_username, char *mqtt_password, char *verification_cert)
+esp_err_t mqtt_app_start(const char *broker_uri, const char *mqtt_username, const char *mqtt_password, const char *verification_cert)
 {
     const esp_mqtt_client_config_t mqtt_cfg = {
         .broker.address.uri = broker_uri,
@@ -86,3 +157,155 @@ esp_mqtt_client_handle_t mqtt_get_client(void)
 {
     return client;
 }
+
+esp_err_t mqtt_man_subscribe(const char *topic, int qos, mqtt_topic_handler_t handler, void *arg)
+{
+    if (!topic || !handler)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    taskENTER_CRITICAL(&routes_lock);
+    bool full = route_count == MQTT_MAX_TOPIC_HANDLERS;
+    if (!full)
+    {
+        // filled in before it is counted, so a reader never sees half a route
+        routes[route_count] = (topic_route_t){
+            .topic = topic,
+            .qos = qos,
+            .handler = handler,
+            .arg = arg,
+        };
+        route_count++;
+    }
+    bool subscribe_now = !full && client && connected;
+    taskEXIT_CRITICAL(&routes_lock);
+    if (full)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    // a connect racing this one may subscribe it as well; that is harmless
+    if (subscribe_now)
+    {
+        esp_mqtt_client_subscribe(client, topic, qos);
+    }
+    return ESP_OK;
+}
+
+esp_err_t mqtt_telemetry_start(const mqtt_telemetry_cfg_t *cfg)
+{
+    if (!cfg || !cfg->topic || cfg->qos < 0 || cfg->qos > 1 ||
+        strlen(cfg->topic) >= MQTT_TELEMETRY_TOPIC_SIZE)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    strcpy(s_tm.topic, cfg->topic);
+    s_tm.qos = cfg->qos;
+    s_tm.batch_records = cfg->batch_records ? cfg->batch_records : MQTT_TELEMETRY_BATCH;
+    s_tm.max_delay_s = cfg->max_delay_s;
+    payload_enc_init(&s_tm.enc, cfg->codec ? cfg->codec : &payload_codec_json,
+                     s_tm.payload, sizeof(s_tm.payload));
+    s_tm.started = true;
+    ESP_LOGI(TAGM, "Telemetry on %s, QoS%d, %s, %u records per publish",
+             s_tm.topic, s_tm.qos, s_tm.enc.codec->name, s_tm.batch_records);
+    return ESP_OK;
+}
+
+esp_err_t mqtt_telemetry_flush(void)
+{
+    if (!s_tm.started || !client)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    uint16_t count = s_tm.enc.count;
+    size_t len = payload_enc_finish(&s_tm.enc);
+    if (len == 0)
+    {
+        return ESP_OK;
+    }
+
+    esp_err_t ret = ESP_OK;
+    /* Bound what waits in the outbox (unacked QoS1 or queued while offline)
+     * instead of letting a dead broker eat the heap */
+    int outbox = esp_mqtt_client_get_outbox_size(client);
+    if (outbox > MQTT_TELEMETRY_MAX_INFLIGHT * MQTT_TELEMETRY_PAYLOAD_MAX)
+    {
+        ESP_LOGW(TAGM, "Telemetry outbox full (%d bytes), dropping %u records", outbox, count);
+        s_tm.stats.dropped += count;
+        ret = ESP_ERR_NO_MEM;
+    }
+    else
+    {
+        int msg_id = esp_mqtt_client_enqueue(client, s_tm.topic, (const char *)s_tm.payload,
+                                             (int)len, s_tm.qos, 0, true);
+        if (msg_id < 0)
+        {
+            s_tm.stats.dropped += count;
+            ret = ESP_FAIL;
+        }
+        else
+        {
+            s_tm.stats.publishes++;
+            s_tm.stats.bytes += len;
+            ESP_LOGD(TAGM, "Telemetry msg_id=%d: %u records, %u bytes",
+                     msg_id, count, (unsigned)len);
+        }
+    }
+    return ret;
+}
+
+esp_err_t mqtt_telemetry_poll(time_t now)
+{
+    if (!s_tm.started || !client)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (s_tm.enc.count == 0 || s_tm.max_delay_s == 0 ||
+        now - s_tm.enc.t0 < (time_t)s_tm.max_delay_s)
+    {
+        return ESP_OK;
+    }
+    return mqtt_telemetry_flush();
+}
+
+esp_err_t mqtt_telemetry_push(const avg_sample_t *recs, size_t count)
+{
+    if (!s_tm.started || !client)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t ret = ESP_OK;
+    for (size_t i = 0; i < count; i++)
+    {
+        const avg_sample_t *r = &recs[i];
+        if (s_tm.enc.count > 0 && !payload_enc_has_room(&s_tm.enc))
+        {
+            if (mqtt_telemetry_flush() != ESP_OK)
+            {
+                ret = ESP_ERR_NO_MEM;
+            }
+        }
+        if (!payload_enc_add(&s_tm.enc, r))
+        {
+            s_tm.stats.dropped++;
+            ret = ESP_ERR_NO_MEM;
+            continue;
+        }
+        s_tm.stats.records++;
+
+        if (s_tm.enc.count >= s_tm.batch_records ||
+            (s_tm.max_delay_s && r->timestamp - s_tm.enc.t0 >= (time_t)s_tm.max_delay_s))
+        {
+            if (mqtt_telemetry_flush() != ESP_OK)
+            {
+                ret = ESP_ERR_NO_MEM;
+            }
+        }
+    }
+    return ret;
+}
+
+void mqtt_telemetry_get_stats(mqtt_telemetry_stats_t *out)
+{
+    *out = s_tm.stats;
+}
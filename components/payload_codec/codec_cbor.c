@@ -0,0 +1,249 @@
+/* components/payload_codec/codec_cbor.c
+ *
+ * Compact binary rows as RFC 8949 CBOR, so standard decoders can read
+ * them. Timestamps are delta-encoded, values are fixed point and spread
+ * statistics are stored relative to the average, which keeps almost every
+ * field in CBOR's one- or two-byte integer forms.
+ */
+
+#include "payload_codec.h"
+
+#include <math.h>
+#include <string.h>
+
+#define CBOR_UINT 0
+#define CBOR_NINT 1
+#define CBOR_ARRAY 4
+#define CBOR_SIMPLE 7
+#define CBOR_INDEFINITE 31
+#define CBOR_BREAK 0xFF
+
+#define ROW_FIELDS 9
+
+/* ---- encoding ---- */
+
+static void _put_head(payload_enc_t *enc, uint8_t major, uint64_t val)
+{
+    uint8_t *p = enc->buf + enc->len;
+    major <<= 5;
+    if (val < 24)
+    {
+        *p++ = major | (uint8_t)val;
+    }
+    else if (val <= UINT8_MAX)
+    {
+        *p++ = major | 24;
+        *p++ = (uint8_t)val;
+    }
+    else if (val <= UINT16_MAX)
+    {
+        *p++ = major | 25;
+        *p++ = (uint8_t)(val >> 8);
+        *p++ = (uint8_t)val;
+    }
+    else if (val <= UINT32_MAX)
+    {
+        *p++ = major | 26;
+        for (int s = 24; s >= 0; s -= 8)
+        {
+            *p++ = (uint8_t)(val >> s);
+        }
+    }
+    else
+    {
+        *p++ = major | 27;
+        for (int s = 56; s >= 0; s -= 8)
+        {
+            *p++ = (uint8_t)(val >> s);
+        }
+    }
+    enc->len = p - enc->buf;
+}
+
+static void _put_int(payload_enc_t *enc, int64_t v)
+{
+    if (v >= 0)
+    {
+        _put_head(enc, CBOR_UINT, (uint64_t)v);
+    }
+    else
+    {
+        _put_head(enc, CBOR_NINT, (uint64_t)(-1 - v));
+    }
+}
+
+/* Value in 1/PAYLOAD_CBOR_SCALE units, saturated to int32 */
+static int32_t _fixed(float v)
+{
+    float f = roundf(v * PAYLOAD_CBOR_SCALE);
+    if (!(f > (float)INT32_MIN)) // also catches NaN
+    {
+        return isnan(f) ? 0 : INT32_MIN;
+    }
+    if (f >= (float)INT32_MAX)
+    {
+        return INT32_MAX;
+    }
+    return (int32_t)f;
+}
+
+static void cbor_begin(payload_enc_t *enc)
+{
+    _put_head(enc, CBOR_ARRAY, 4);
+    _put_int(enc, PAYLOAD_CBOR_VERSION);
+    _put_int(enc, enc->t0);
+    _put_int(enc, PAYLOAD_CBOR_SCALE);
+    enc->buf[enc->len++] = (CBOR_ARRAY << 5) | CBOR_INDEFINITE;
+}
+
+static size_t cbor_add(payload_enc_t *enc, const avg_sample_t *r)
+{
+    size_t start = enc->len;
+    int64_t avg = _fixed(r->average);
+
+    _put_head(enc, CBOR_ARRAY, ROW_FIELDS);
+    _put_int(enc, (int64_t)(r->timestamp - enc->t_prev));
+    _put_int(enc, r->channel);
+    _put_int(enc, avg);
+    _put_int(enc, _fixed(r->min) - avg);
+    _put_int(enc, _fixed(r->max) - avg);
+    _put_int(enc, _fixed(r->stddev));
+    _put_int(enc, _fixed(r->p50) - avg);
+    _put_int(enc, _fixed(r->p95) - avg);
+    _put_int(enc, r->samples);
+    return enc->len - start;
+}
+
+static void cbor_end(payload_enc_t *enc)
+{
+    enc->buf[enc->len++] = CBOR_BREAK;
+}
+
+const payload_codec_t payload_codec_cbor = {
+    .name = "cbor",
+    .content_type = "application/cbor",
+    .head_max = 1 + 1 + 9 + 2 + 1,
+    .row_max = 1 + ROW_FIELDS * 9,
+    .tail_max = 1,
+    .begin = cbor_begin,
+    .add = cbor_add,
+    .end = cbor_end,
+};
+
+/* ---- decoding ---- */
+
+typedef struct
+{
+    const uint8_t *p;
+    const uint8_t *end;
+} cbor_reader_t;
+
+static bool _get_head(cbor_reader_t *rd, uint8_t *major, uint64_t *val)
+{
+    if (rd->p >= rd->end)
+    {
+        return false;
+    }
+    uint8_t b = *rd->p++;
+    uint8_t ai = b & 0x1F;
+    *major = b >> 5;
+    if (ai < 24 || ai == CBOR_INDEFINITE)
+    {
+        *val = ai;
+        return true;
+    }
+    if (ai > 27)
+    {
+        return false;
+    }
+    size_t n = (size_t)1 << (ai - 24);
+    if ((size_t)(rd->end - rd->p) < n)
+    {
+        return false;
+    }
+    *val = 0;
+    while (n--)
+    {
+        *val = (*val << 8) | *rd->p++;
+    }
+    return true;
+}
+
+static bool _get_int(cbor_reader_t *rd, int64_t *out)
+{
+    uint8_t major;
+    uint64_t val;
+    if (!_get_head(rd, &major, &val) || val > INT64_MAX)
+    {
+        return false;
+    }
+    if (major == CBOR_UINT)
+    {
+        *out = (int64_t)val;
+    }
+    else if (major == CBOR_NINT)
+    {
+        *out = -1 - (int64_t)val;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+static bool _expect_array(cbor_reader_t *rd, uint64_t len)
+{
+    uint8_t major;
+    uint64_t val;
+    return _get_head(rd, &major, &val) && major == CBOR_ARRAY && val == len;
+}
+
+esp_err_t payload_cbor_decode(const uint8_t *buf, size_t len, avg_sample_t *out, size_t max,
+                              size_t *count)
+{
+    cbor_reader_t rd = {.p = buf, .end = buf + len};
+    int64_t version, t, scale;
+    *count = 0;
+
+    if (!_expect_array(&rd, 4) || !_get_int(&rd, &version) || version != PAYLOAD_CBOR_VERSION ||
+        !_get_int(&rd, &t) || !_get_int(&rd, &scale) || scale <= 0 ||
+        rd.p >= rd.end || *rd.p++ != ((CBOR_ARRAY << 5) | CBOR_INDEFINITE))
+    {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    while (rd.p < rd.end && *rd.p != CBOR_BREAK)
+    {
+        int64_t f[ROW_FIELDS];
+        if (!_expect_array(&rd, ROW_FIELDS))
+        {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        for (int i = 0; i < ROW_FIELDS; i++)
+        {
+            if (!_get_int(&rd, &f[i]))
+            {
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+        }
+        if (*count == max)
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        t += f[0];
+        avg_sample_t *r = &out[(*count)++];
+        memset(r, 0, sizeof(*r));
+        r->timestamp = (time_t)t;
+        r->channel = (uint16_t)f[1];
+        r->average = (float)f[2] / scale;
+        r->min = (float)(f[2] + f[3]) / scale;
+        r->max = (float)(f[2] + f[4]) / scale;
+        r->stddev = (float)f[5] / scale;
+        r->p50 = (float)(f[2] + f[6]) / scale;
+        r->p95 = (float)(f[2] + f[7]) / scale;
+        r->samples = (uint16_t)f[8];
+    }
+    return rd.p < rd.end ? ESP_OK : ESP_ERR_INVALID_RESPONSE; // missing break
+}
@@ -0,0 +1,52 @@
+/* components/payload_codec/codec_json.c
+ *
+ * Compact JSON rows, readable by anything that speaks JSON. Written with
+ * snprintf straight into the payload buffer; no cJSON tree.
+ */
+
+#include "payload_codec.h"
+
+#include <stdio.h>
+
+static void json_begin(payload_enc_t *enc)
+{
+    int n = snprintf((char *)enc->buf, enc->cap, "{\"t\":%lld,\"r\":[", (long long)enc->t0);
+    enc->len = n > 0 ? (size_t)n : 0;
+}
+
+static size_t json_add(payload_enc_t *enc, const avg_sample_t *r)
+{
+    size_t room = enc->cap - enc->len;
+    if (room > payload_codec_json.row_max)
+    {
+        room = payload_codec_json.row_max;
+    }
+    int n = snprintf((char *)enc->buf + enc->len, room,
+                     "%s[%lld,%u,%.2f,%.2f,%.2f,%.3f,%.2f,%.2f,%u]",
+                     enc->count ? "," : "", (long long)(r->timestamp - enc->t0),
+                     r->channel, r->average, r->min, r->max, r->stddev,
+                     r->p50, r->p95, r->samples);
+    if (n <= 0 || (size_t)n >= room)
+    {
+        return 0;
+    }
+    enc->len += n;
+    return n;
+}
+
+static void json_end(payload_enc_t *enc)
+{
+    enc->buf[enc->len++] = ']';
+    enc->buf[enc->len++] = '}';
+}
+
+const payload_codec_t payload_codec_json = {
+    .name = "json",
+    .content_type = "application/json",
+    .head_max = 40,
+    .row_max = 128,
+    .tail_max = 2,
+    .begin = json_begin,
+    .add = json_add,
+    .end = json_end,
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "esp_err.h"
+#include "sensor_record.h"
+
+/* Compact binary codec: values are sent as hundredths */
+#define PAYLOAD_CBOR_VERSION 1
+#define PAYLOAD_CBOR_SCALE 100
+
+typedef struct payload_codec payload_codec_t;
+
+/* One payload being built into a caller-owned buffer */
+typedef struct
+{
+    const payload_codec_t *codec;
+    uint8_t *buf;
+    size_t cap;
+    size_t len;
+    uint16_t count;  // records in the payload
+    time_t t0;       // timestamp of the first record
+    time_t t_prev;   // timestamp of the last record
+} payload_enc_t;
+
+/**
+ * A payload encoding for window records. Sinks hold a pointer to one of
+ * these, so the wire format is chosen per sink.
+ */
+struct payload_codec
+{
+    const char *name;
+    const char *content_type;
+    size_t head_max;  // worst case bytes begin() writes
+    size_t row_max;   // worst case bytes add() appends
+    size_t tail_max;  // bytes end() appends
+    void (*begin)(payload_enc_t *enc);
+    size_t (*add)(payload_enc_t *enc, const avg_sample_t *rec); // 0 if it didn't fit
+    void (*end)(payload_enc_t *enc);
+};
+
+/* {"t":<first ts>,"r":[[dt,ch,avg,min,max,sd,p50,p95,n],...]}, dt from the first record */
+extern const payload_codec_t payload_codec_json;
+
+/**
+ * CBOR [version, t0, scale, [_ rows]] with each row
+ * [dt, ch, avg, min-avg, max-avg, sd, p50-avg, p95-avg, n]: dt is the delta
+ * from the previous record, values are integers in 1/scale units and the
+ * spread statistics are relative to avg, so a typical row is ~15 bytes.
+ */
+extern const payload_codec_t payload_codec_cbor;
+
+/** @brief Codec by name ("json", "cbor"), or NULL. */
+const payload_codec_t *payload_codec_find(const char *name);
+
+/** @brief Start an empty payload in `buf`. */
+void payload_enc_init(payload_enc_t *enc, const payload_codec_t *codec, uint8_t *buf, size_t cap);
+
+/** @brief True if one more record is guaranteed to fit. */
+bool payload_enc_has_room(const payload_enc_t *enc);
+
+/** @brief Append one record. @return false if it didn't fit (payload unchanged). */
+bool payload_enc_add(payload_enc_t *enc, const avg_sample_t *rec);
+
+/** @brief Close the payload. @return Its length; the encoder is then reset. */
+size_t payload_enc_finish(payload_enc_t *enc);
+
+/**
+ * @brief  Decode a payload_codec_cbor payload, for tooling and round-trip
+ *         checks. Values come back rounded to 1/scale.
+ * @param  count  Receives the number of records written to `out`.
+ * @return ESP_ERR_INVALID_RESPONSE on malformed input, ESP_ERR_INVALID_SIZE
+ *         if there are more than `max` records.
+ */
+esp_err_t payload_cbor_decode(const uint8_t *buf, size_t len, avg_sample_t *out, size_t max,
+                              size_t *count);
@@ -0,0 +1,81 @@
+/* components/payload_codec/payload_codec.c
+ *
+ * Payload encoder front end: sinks build payloads through payload_enc_*
+ * and pick the wire format by codec, so adding a format does not touch
+ * the sinks.
+ */
+
+#include "payload_codec.h"
+
+#include <string.h>
+
+static const payload_codec_t *const s_codecs[] = {
+    &payload_codec_json,
+    &payload_codec_cbor,
+};
+
+const payload_codec_t *payload_codec_find(const char *name)
+{
+    if (!name)
+    {
+        return NULL;
+    }
+    for (size_t i = 0; i < sizeof(s_codecs) / sizeof(s_codecs[0]); i++)
+    {
+        if (strcmp(s_codecs[i]->name, name) == 0)
+        {
+            return s_codecs[i];
+        }
+    }
+    return NULL;
+}
+
+void payload_enc_init(payload_enc_t *enc, const payload_codec_t *codec, uint8_t *buf, size_t cap)
+{
+    memset(enc, 0, sizeof(*enc));
+    enc->codec = codec;
+    enc->buf = buf;
+    enc->cap = cap;
+}
+
+bool payload_enc_has_room(const payload_enc_t *enc)
+{
+    const payload_codec_t *c = enc->codec;
+    size_t need = (enc->count ? 0 : c->head_max) + c->row_max + c->tail_max;
+    return enc->len + need <= enc->cap;
+}
+
+bool payload_enc_add(payload_enc_t *enc, const avg_sample_t *rec)
+{
+    if (!payload_enc_has_room(enc))
+    {
+        return false;
+    }
+    if (enc->count == 0)
+    {
+        enc->t0 = rec->timestamp;
+        enc->t_prev = rec->timestamp;
+        enc->codec->begin(enc);
+    }
+    if (enc->codec->add(enc, rec) == 0)
+    {
+        return false;
+    }
+    enc->t_prev = rec->timestamp;
+    enc->count++;
+    return true;
+}
+
+size_t payload_enc_finish(payload_enc_t *enc)
+{
+    if (enc->count == 0)
+    {
+        return 0;
+    }
+    enc->codec->end(enc);
+    size_t len = enc->len;
+    // the bytes stay in buf for the caller; the next add() starts over
+    enc->len = 0;
+    enc->count = 0;
+    return len;
+}
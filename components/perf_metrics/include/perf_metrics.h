@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "esp_timer.h"
+
+#define PERF_MAX_METRICS 64
+#define PERF_MAX_TASKS 8
+#define PERF_HIST_BUCKETS 12     // see perf_hist_bounds_us in perf_metrics.c
+#define PERF_STACK_SIZE CONFIG_PERF_METRICS_STACK_SIZE
+#define PERF_PRIORITY CONFIG_PERF_METRICS_PRIORITY
+#define PERF_CORE CONFIG_PERF_METRICS_CORE
+#define PERF_JSON_MAX 2048
+#define PERF_PUBLISH_INTERVAL_MS 60000
+
+typedef enum
+{
+    PERF_COUNTER,
+    PERF_GAUGE,
+    PERF_HISTOGRAM,
+} perf_kind_t;
+
+/**
+ * One metric. Handles stay valid forever; look one up once (e.g. into a
+ * static) and update it from any task. Updates are a few instructions in
+ * a spinlock, cheap enough to leave on in production.
+ */
+typedef struct
+{
+    const char *name;        // string literal, not copied
+    perf_kind_t kind;
+    uint32_t count;          // counter value, or number of histogram samples
+    int32_t value;           // gauge value
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t sum_us;
+    uint32_t buckets[PERF_HIST_BUCKETS];
+} perf_metric_t;
+
+/**
+ * @brief  Find or register a metric. Returns NULL when the registry is full
+ *         or the name exists with another kind; every update function
+ *         accepts NULL and does nothing.
+ */
+perf_metric_t *perf_counter(const char *name);
+perf_metric_t *perf_gauge(const char *name);
+perf_metric_t *perf_histogram(const char *name);
+
+void perf_count(perf_metric_t *m, uint32_t n);
+void perf_gauge_set(perf_metric_t *m, int32_t value);
+void perf_hist_record(perf_metric_t *m, uint32_t us);
+
+/** @brief Record the time since `start_us` (an esp_timer_get_time() value). */
+static inline void perf_hist_since(perf_metric_t *m, int64_t start_us)
+{
+    perf_hist_record(m, (uint32_t)(esp_timer_get_time() - start_us));
+}
+
+/**
+ * @brief  Report the stack high-water mark of `task` as gauge
+ *         "stack.<name>". Only for tasks that are never deleted.
+ */
+esp_err_t perf_watch_task(TaskHandle_t task, const char *name);
+
+/** @brief Refresh heap gauges and watched task stacks. */
+void perf_sample_system(void);
+
+/** @brief All metrics as one JSON object. @return Length (truncated to len - 1). */
+size_t perf_metrics_json(char *buf, size_t len);
+
+/** @brief Register the `metrics` console command (print, -r to reset histograms). */
+esp_err_t perf_metrics_register_console(void);
+
+/** Receives the JSON snapshot on every reporting period. */
+typedef void (*perf_publish_fn)(const char *json, size_t len, void *arg);
+
+/**
+ * @brief  Start the reporting task: every `period_ms` it samples the system
+ *         gauges and hands a JSON snapshot to `publish` (optional).
+ */
+esp_err_t perf_metrics_start(uint32_t period_ms, perf_publish_fn publish, void *arg);
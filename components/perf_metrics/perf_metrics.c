@@ -0,0 +1,398 @@
+/* components/perf_metrics/perf_metrics.c
+ *
+ * Process-wide metrics registry:
+ *  - Counters, gauges and fixed-bucket latency histograms in one static
+ *    table; no heap, no per-update locking beyond a short spinlock
+ *  - Heap and task stack gauges sampled by a low-priority reporting task,
+ *    which also hands a JSON snapshot to a publisher (MQTT in main)
+ *  - `metrics` console command for on-site inspection
+ */
+
+#include "perf_metrics.h"
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "esp_console.h"
+#include "argtable3/argtable3.h"
+
+static const char *TAG = "PerfMetrics";
+
+/* Upper bucket bounds; the last bucket takes everything above */
+static const uint32_t perf_hist_bounds_us[PERF_HIST_BUCKETS - 1] = {
+    100, 300, 1000, 3000, 10000, 30000, 100000, 300000, 1000000, 3000000, 10000000};
+
+typedef struct
+{
+    TaskHandle_t task;
+    perf_metric_t *gauge;
+} watched_task_t;
+
+static struct
+{
+    portMUX_TYPE lock;
+    perf_metric_t metrics[PERF_MAX_METRICS];
+    uint8_t n_metrics;
+    watched_task_t tasks[PERF_MAX_TASKS];
+    uint8_t n_tasks;
+    perf_metric_t *heap_free;
+    perf_metric_t *heap_min_free;
+    perf_metric_t *heap_largest;
+    TaskHandle_t task;
+    uint32_t period_ms;
+    perf_publish_fn publish;
+    void *publish_arg;
+    char json[PERF_JSON_MAX];
+} s_perf = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static perf_metric_t *_lookup(const char *name, perf_kind_t kind)
+{
+    perf_metric_t *m = NULL;
+    taskENTER_CRITICAL(&s_perf.lock);
+    for (uint8_t i = 0; i < s_perf.n_metrics; i++)
+    {
+        if (strcmp(s_perf.metrics[i].name, name) == 0)
+        {
+            m = s_perf.metrics[i].kind == kind ? &s_perf.metrics[i] : NULL;
+            taskEXIT_CRITICAL(&s_perf.lock);
+            return m;
+        }
+    }
+    if (s_perf.n_metrics < PERF_MAX_METRICS)
+    {
+        m = &s_perf.metrics[s_perf.n_metrics++];
+        memset(m, 0, sizeof(*m));
+        m->name = name;
+        m->kind = kind;
+        m->min_us = UINT32_MAX;
+    }
+    taskEXIT_CRITICAL(&s_perf.lock);
+
+    if (!m)
+    {
+        ESP_LOGW(TAG, "Registry full, %s not recorded", name);
+    }
+    return m;
+}
+
+perf_metric_t *perf_counter(const char *name)
+{
+    return _lookup(name, PERF_COUNTER);
+}
+
+perf_metric_t *perf_gauge(const char *name)
+{
+    return _lookup(name, PERF_GAUGE);
+}
+
+perf_metric_t *perf_histogram(const char *name)
+{
+    return _lookup(name, PERF_HISTOGRAM);
+}
+
+void perf_count(perf_metric_t *m, uint32_t n)
+{
+    if (!m)
+    {
+        return;
+    }
+    taskENTER_CRITICAL(&s_perf.lock);
+    m->count += n;
+    taskEXIT_CRITICAL(&s_perf.lock);
+}
+
+void perf_gauge_set(perf_metric_t *m, int32_t value)
+{
+    if (m)
+    {
+        m->value = value; // single aligned store
+    }
+}
+
+void perf_hist_record(perf_metric_t *m, uint32_t us)
+{
+    if (!m)
+    {
+        return;
+    }
+    int b = 0;
+    while (b < PERF_HIST_BUCKETS - 1 && us > perf_hist_bounds_us[b])
+    {
+        b++;
+    }
+
+    taskENTER_CRITICAL(&s_perf.lock);
+    m->count++;
+    m->sum_us += us;
+    if (us < m->min_us)
+    {
+        m->min_us = us;
+    }
+    if (us > m->max_us)
+    {
+        m->max_us = us;
+    }
+    m->buckets[b]++;
+    taskEXIT_CRITICAL(&s_perf.lock);
+}
+
+esp_err_t perf_watch_task(TaskHandle_t task, const char *name)
+{
+    if (!task || !name)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_perf.n_tasks == PERF_MAX_TASKS)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    /* "stack.<name>"; the registry keeps the pointer, so it must live on */
+    size_t len = strlen("stack.") + strlen(name) + 1;
+    char *gauge_name = malloc(len);
+    if (!gauge_name)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    snprintf(gauge_name, len, "stack.%s", name);
+
+    perf_metric_t *g = perf_gauge(gauge_name);
+    if (!g)
+    {
+        free(gauge_name);
+        return ESP_ERR_NO_MEM;
+    }
+    s_perf.tasks[s_perf.n_tasks++] = (watched_task_t){.task = task, .gauge = g};
+    return ESP_OK;
+}
+
+void perf_sample_system(void)
+{
+    if (!s_perf.heap_free)
+    {
+        s_perf.heap_free = perf_gauge("heap.free");
+        s_perf.heap_min_free = perf_gauge("heap.min_free");
+        s_perf.heap_largest = perf_gauge("heap.largest_block");
+    }
+    perf_gauge_set(s_perf.heap_free, (int32_t)esp_get_free_heap_size());
+    perf_gauge_set(s_perf.heap_min_free, (int32_t)esp_get_minimum_free_heap_size());
+    perf_gauge_set(s_perf.heap_largest,
+                   (int32_t)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+
+    for (uint8_t i = 0; i < s_perf.n_tasks; i++)
+    {
+        perf_gauge_set(s_perf.tasks[i].gauge,
+                       (int32_t)uxTaskGetStackHighWaterMark(s_perf.tasks[i].task));
+    }
+}
+
+/* ---- snapshot ---- */
+
+typedef struct
+{
+    char *buf;
+    size_t cap;
+    size_t len;
+} _out_t;
+
+static void _put(_out_t *o, const char *fmt, ...)
+{
+    if (o->len + 1 >= o->cap)
+    {
+        return;
+    }
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(o->buf + o->len, o->cap - o->len, fmt, ap);
+    va_end(ap);
+    if (n > 0)
+    {
+        o->len += (size_t)n;
+        if (o->len >= o->cap)
+        {
+            o->len = o->cap - 1;
+        }
+    }
+}
+
+/* Copy under the lock so a snapshot never shows a half-updated histogram */
+static void _copy(uint8_t i, perf_metric_t *out)
+{
+    taskENTER_CRITICAL(&s_perf.lock);
+    *out = s_perf.metrics[i];
+    taskEXIT_CRITICAL(&s_perf.lock);
+}
+
+size_t perf_metrics_json(char *buf, size_t len)
+{
+    _out_t o = {.buf = buf, .cap = len};
+    static const char *const sections[] = {"counters", "gauges", "hist"};
+
+    _put(&o, "{\"uptime_s\":%lld", (long long)(esp_timer_get_time() / 1000000));
+    for (int kind = PERF_COUNTER; kind <= PERF_HISTOGRAM; kind++)
+    {
+        _put(&o, ",\"%s\":{", sections[kind]);
+        bool first = true;
+        for (uint8_t i = 0; i < s_perf.n_metrics; i++)
+        {
+            perf_metric_t m;
+            _copy(i, &m);
+            if ((int)m.kind != kind)
+            {
+                continue;
+            }
+            _put(&o, "%s\"%s\":", first ? "" : ",", m.name);
+            first = false;
+            if (kind == PERF_COUNTER)
+            {
+                _put(&o, "%" PRIu32, m.count);
+            }
+            else if (kind == PERF_GAUGE)
+            {
+                _put(&o, "%" PRId32, m.value);
+            }
+            else
+            {
+                _put(&o, "{\"n\":%" PRIu32 ",\"avg\":%" PRIu32 ",\"min\":%" PRIu32 ",\"max\":%" PRIu32 ",\"b\":[",
+                     m.count, m.count ? (uint32_t)(m.sum_us / m.count) : 0,
+                     m.count ? m.min_us : 0, m.max_us);
+                for (int b = 0; b < PERF_HIST_BUCKETS; b++)
+                {
+                    _put(&o, "%s%" PRIu32, b ? "," : "", m.buckets[b]);
+                }
+                _put(&o, "]}");
+            }
+        }
+        _put(&o, "}");
+    }
+    _put(&o, "}");
+    return o.len;
+}
+
+/* ---- console: metrics [-r] ---- */
+
+static struct
+{
+    struct arg_lit *reset;
+    struct arg_end *end;
+} metrics_args;
+
+static int console_metrics(int argc, char **argv)
+{
+    if (arg_parse(argc, argv, (void **)&metrics_args) != 0)
+    {
+        arg_print_errors(stderr, metrics_args.end, argv[0]);
+        return 1;
+    }
+
+    perf_sample_system();
+    for (uint8_t i = 0; i < s_perf.n_metrics; i++)
+    {
+        perf_metric_t m;
+        _copy(i, &m);
+        switch (m.kind)
+        {
+        case PERF_COUNTER:
+            printf("%-24s %" PRIu32 "\n", m.name, m.count);
+            break;
+        case PERF_GAUGE:
+            printf("%-24s %" PRId32 "\n", m.name, m.value);
+            break;
+        case PERF_HISTOGRAM:
+            printf("%-24s n=%" PRIu32 " avg=%" PRIu32 " min=%" PRIu32 " max=%" PRIu32 " us  [",
+                   m.name, m.count, m.count ? (uint32_t)(m.sum_us / m.count) : 0,
+                   m.count ? m.min_us : 0, m.max_us);
+            for (int b = 0; b < PERF_HIST_BUCKETS; b++)
+            {
+                printf("%s%" PRIu32, b ? " " : "", m.buckets[b]);
+            }
+            printf("]\n");
+            break;
+        }
+    }
+    printf("histogram buckets (us): <=100 300 1k 3k 10k 30k 100k 300k 1M 3M 10M >10M\n");
+
+    if (metrics_args.reset->count)
+    {
+        taskENTER_CRITICAL(&s_perf.lock);
+        for (uint8_t i = 0; i < s_perf.n_metrics; i++)
+        {
+            perf_metric_t *m = &s_perf.metrics[i];
+            if (m->kind == PERF_HISTOGRAM)
+            {
+                m->count = 0;
+                m->sum_us = 0;
+                m->min_us = UINT32_MAX;
+                m->max_us = 0;
+                memset(m->buckets, 0, sizeof(m->buckets));
+            }
+        }
+        taskEXIT_CRITICAL(&s_perf.lock);
+        printf("histograms reset\n");
+    }
+    return 0;
+}
+
+esp_err_t perf_metrics_register_console(void)
+{
+    metrics_args.reset = arg_lit0("r", "reset", "reset histograms after printing");
+    metrics_args.end = arg_end(1);
+
+    const esp_console_cmd_t cmd = {
+        .command = "metrics",
+        .help = "print counters, gauges and latency histograms",
+        .hint = NULL,
+        .func = &console_metrics,
+        .argtable = &metrics_args,
+    };
+    return esp_console_cmd_register(&cmd);
+}
+
+/* ---- reporting task ---- */
+
+static void perf_task(void *pvParameters)
+{
+    for (;;)
+    {
+        vTaskDelay(pdMS_TO_TICKS(s_perf.period_ms));
+        perf_sample_system();
+        if (s_perf.publish)
+        {
+            size_t len = perf_metrics_json(s_perf.json, sizeof(s_perf.json));
+            s_perf.publish(s_perf.json, len, s_perf.publish_arg);
+        }
+    }
+}
+
+esp_err_t perf_metrics_start(uint32_t period_ms, perf_publish_fn publish, void *arg)
+{
+    if (s_perf.task)
+    {
+        return ESP_OK;
+    }
+    if (period_ms == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_perf.period_ms = period_ms;
+    s_perf.publish = publish;
+    s_perf.publish_arg = arg;
+
+    if (xTaskCreatePinnedToCore(&perf_task, "perf", PERF_STACK_SIZE, NULL, PERF_PRIORITY,
+                                &s_perf.task, PERF_CORE) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Metrics task creation failed");
+        return ESP_ERR_NO_MEM;
+    }
+    perf_watch_task(s_perf.task, "perf");
+    return ESP_OK;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/* Segment sizing: 16 x 32 KB keeps the log within half of the 1 MB
+ * storage partition and leaves room for cfg.json and friends. */
+#define RECORD_LOG_SEGMENT_BYTES (32 * 1024)
+#define RECORD_LOG_MAX_SEGMENTS 16
+
+typedef struct
+{
+    uint32_t pending;          /* records appended but not yet committed */
+    uint32_t oldest_seg;
+    uint32_t head_seg;
+    uint32_t appended;         /* records appended since boot */
+    uint32_t committed;        /* records committed since boot */
+    uint32_t crc_errors;       /* frames skipped because of a bad CRC/header */
+    uint32_t dropped_segments; /* segments discarded because the log was full */
+    uint32_t read_errors;      /* reads stopped at a segment that failed to open */
+} record_log_stats_t;
+
+/**
+ * @brief  Open (or create) the log in `dir` and restore the commit cursor.
+ *
+ * Records are fixed size. Each one is stored as a small header (magic,
+ * length, CRC32) followed by the payload, appended to numbered segment
+ * files. Consumed segments are deleted whole rather than rewritten, so
+ * flash writes are append-only apart from the tiny cursor file.
+ *
+ * @param  dir       Directory on a mounted FAT volume (e.g. "/data/rlog").
+ * @param  rec_size  Size of one record in bytes.
+ */
+esp_err_t record_log_init(const char *dir, size_t rec_size);
+
+/**
+ * @brief  Durably append one record (flushed and synced before returning).
+ * @return ESP_OK, or an error if the volume is not available (e.g. it is
+ *         currently exposed to a USB host).
+ */
+esp_err_t record_log_append(const void *rec);
+
+/**
+ * @brief  Read up to `max` records starting at the commit cursor without
+ *         consuming them. Call record_log_commit() once they are delivered.
+ * @param  out    Array of at least max * rec_size bytes.
+ * @param  max    Maximum number of records to return.
+ * @param  count  Receives the number of records read.
+ * @return ESP_FAIL if the first segment to read exists but cannot be
+ *         opened (e.g. too many open files); nothing is consumed then.
+ */
+esp_err_t record_log_peek(void *out, size_t max, size_t *count);
+
+/**
+ * @brief  Same read as record_log_peek() but leaves the peek/commit state
+ *         alone, so it can run beside the consumer (diagnostics, benchmarks).
+ */
+esp_err_t record_log_read(void *out, size_t max, size_t *count);
+
+/**
+ * @brief  Consume the records returned by the last record_log_peek(),
+ *         persist the cursor and delete fully consumed segments.
+ */
+esp_err_t record_log_commit(void);
+
+/** @brief Records waiting to be committed. */
+uint32_t record_log_pending(void);
+
+/** @brief Snapshot of the log counters. */
+void record_log_get_stats(record_log_stats_t *out);
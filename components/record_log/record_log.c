@@ -0,0 +1,605 @@
+/* components/record_log/record_log.c
+ *
+ * Append-only store-and-forward log on the FAT storage partition:
+ *  - Records go into numbered segment files (NNNNNNNN.seg, 8.3 safe)
+ *  - Every record carries a CRC32 so torn writes are detected on replay
+ *  - A small cursor file remembers how far the uploader has committed
+ *
+ * A crash between a successful upload and the cursor write re-sends the
+ * last batch; Firestore documents are keyed by timestamp so that is
+ * harmless.
+ *
+ * Appends and peek/commit may come from different tasks (aggregator and
+ * uploader on different cores); every public call holds one mutex.
+ */
+
+#include "record_log.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <strings.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+
+static const char *TAG = "RECORD_LOG";
+
+#define FRAME_MAGIC 0xA55A
+#define CURSOR_MAGIC 0x52434C47 /* "RCLG" */
+#define MAX_REC_SIZE 256
+
+typedef struct __attribute__((packed))
+{
+    uint16_t magic;
+    uint16_t len;
+    uint32_t crc;
+} frame_hdr_t;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t seg;
+    uint32_t off;
+    uint32_t crc;
+} cursor_file_t;
+
+static struct
+{
+    char dir[32];
+    size_t rec_size;
+    bool ready;
+    uint32_t oldest_seg;
+    uint32_t head_seg;
+    uint32_t head_off;
+    uint32_t tail_seg; /* commit cursor */
+    uint32_t tail_off;
+    uint32_t peek_seg; /* position right after the last peek */
+    uint32_t peek_off;
+    size_t peek_count;
+    record_log_stats_t stats;
+} s_log;
+
+/* Outside s_log, which init clears */
+static SemaphoreHandle_t s_lock;
+static StaticSemaphore_t s_lock_buf;
+
+static void _seg_path(uint32_t seg, char *out, size_t len)
+{
+    snprintf(out, len, "%s/%08" PRIx32 ".seg", s_log.dir, seg);
+}
+
+static uint32_t _cursor_crc(const cursor_file_t *c)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)c, offsetof(cursor_file_t, crc));
+}
+
+/* Read one frame at the current file position. Returns 1 on success,
+ * 0 at a clean end of segment, -1 on a corrupt frame. */
+static int _read_frame(FILE *f, void *payload)
+{
+    frame_hdr_t hdr;
+    size_t n = fread(&hdr, 1, sizeof(hdr), f);
+    if (n == 0)
+    {
+        return 0;
+    }
+    if (n != sizeof(hdr) || hdr.magic != FRAME_MAGIC || hdr.len > MAX_REC_SIZE)
+    {
+        return -1;
+    }
+
+    uint8_t buf[MAX_REC_SIZE];
+    if (fread(buf, 1, hdr.len, f) != hdr.len ||
+        esp_rom_crc32_le(0, buf, hdr.len) != hdr.crc)
+    {
+        return -1;
+    }
+    if (hdr.len != s_log.rec_size)
+    {
+        /* Valid frame from another firmware's record layout */
+        ESP_LOGW(TAG, "Skipping record of size %u (expected %u)",
+                 hdr.len, (unsigned)s_log.rec_size);
+        return 2;
+    }
+    if (payload)
+    {
+        memcpy(payload, buf, hdr.len);
+    }
+    return 1;
+}
+
+/* Open a segment for reading. A missing one (ENOENT) yields NULL with
+ * ESP_OK, the caller skips it; any other failure (max_files reached, a
+ * remount) is an error, so nobody moves the cursor past records that are
+ * still on flash. */
+static esp_err_t _open_seg(uint32_t seg, FILE **out)
+{
+    char path[48];
+    _seg_path(seg, path, sizeof(path));
+    *out = fopen(path, "rb");
+    if (*out || errno == ENOENT)
+    {
+        return ESP_OK;
+    }
+    ESP_LOGW(TAG, "Cannot open %s (errno %d)", path, errno);
+    return ESP_FAIL;
+}
+
+/* Count good frames from (seg, off) up to the head */
+static esp_err_t _count_from(uint32_t seg, uint32_t off, uint32_t *count)
+{
+    *count = 0;
+    for (; seg <= s_log.head_seg; seg++, off = 0)
+    {
+        FILE *f;
+        if (_open_seg(seg, &f) != ESP_OK)
+        {
+            return ESP_FAIL;
+        }
+        if (!f)
+        {
+            continue;
+        }
+        fseek(f, off, SEEK_SET);
+        int r;
+        while ((r = _read_frame(f, NULL)) > 0)
+        {
+            if (r == 1)
+            {
+                (*count)++;
+            }
+        }
+        fclose(f);
+    }
+    return ESP_OK;
+}
+
+/* Offset just past the last good frame of a segment */
+static uint32_t _valid_end(uint32_t seg, bool *torn)
+{
+    char path[48];
+    _seg_path(seg, path, sizeof(path));
+    *torn = false;
+
+    FILE *f = fopen(path, "rb");
+    if (!f)
+    {
+        return 0;
+    }
+    long end = 0;
+    int r;
+    while ((r = _read_frame(f, NULL)) > 0)
+    {
+        end = ftell(f);
+    }
+    if (r < 0)
+    {
+        *torn = true;
+    }
+    fclose(f);
+    return (uint32_t)end;
+}
+
+static esp_err_t _write_cursor(void)
+{
+    char path[48];
+    snprintf(path, sizeof(path), "%s/cursor.bin", s_log.dir);
+
+    cursor_file_t c = {
+        .magic = CURSOR_MAGIC,
+        .seg = s_log.tail_seg,
+        .off = s_log.tail_off,
+    };
+    c.crc = _cursor_crc(&c);
+
+    FILE *f = fopen(path, "wb");
+    if (!f)
+    {
+        ESP_LOGE(TAG, "Failed to open %s", path);
+        return ESP_FAIL;
+    }
+    size_t n = fwrite(&c, 1, sizeof(c), f);
+    fflush(f);
+    fsync(fileno(f));
+    fclose(f);
+    return n == sizeof(c) ? ESP_OK : ESP_FAIL;
+}
+
+static void _read_cursor(void)
+{
+    char path[48];
+    snprintf(path, sizeof(path), "%s/cursor.bin", s_log.dir);
+
+    s_log.tail_seg = s_log.oldest_seg;
+    s_log.tail_off = 0;
+
+    FILE *f = fopen(path, "rb");
+    if (!f)
+    {
+        return;
+    }
+    cursor_file_t c;
+    size_t n = fread(&c, 1, sizeof(c), f);
+    fclose(f);
+
+    if (n != sizeof(c) || c.magic != CURSOR_MAGIC || c.crc != _cursor_crc(&c))
+    {
+        ESP_LOGW(TAG, "Cursor file invalid, replaying from oldest segment");
+        return;
+    }
+    if (c.seg >= s_log.oldest_seg && c.seg <= s_log.head_seg)
+    {
+        s_log.tail_seg = c.seg;
+        s_log.tail_off = c.off;
+    }
+}
+
+/* Remove consumed segments below the cursor */
+static void _delete_before(uint32_t seg)
+{
+    char path[48];
+    while (s_log.oldest_seg < seg)
+    {
+        _seg_path(s_log.oldest_seg, path, sizeof(path));
+        unlink(path);
+        s_log.oldest_seg++;
+    }
+}
+
+static esp_err_t _init_locked(const char *dir, size_t rec_size)
+{
+    if (rec_size == 0 || rec_size > MAX_REC_SIZE)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(&s_log, 0, sizeof(s_log));
+    strlcpy(s_log.dir, dir, sizeof(s_log.dir));
+    s_log.rec_size = rec_size;
+
+    if (mkdir(dir, 0775) != 0 && errno != EEXIST)
+    {
+        ESP_LOGE(TAG, "Cannot create %s (errno %d)", dir, errno);
+        return ESP_FAIL;
+    }
+
+    /* Find the range of segment ids on disk */
+    DIR *dh = opendir(dir);
+    if (!dh)
+    {
+        ESP_LOGE(TAG, "Unable to read directory %s", dir);
+        return ESP_FAIL;
+    }
+    bool found = false;
+    struct dirent *d;
+    while ((d = readdir(dh)) != NULL)
+    {
+        uint32_t seg;
+        char ext[4];
+        if (sscanf(d->d_name, "%8" SCNx32 ".%3s", &seg, ext) == 2 &&
+            strcasecmp(ext, "seg") == 0)
+        {
+            if (!found || seg < s_log.oldest_seg)
+            {
+                s_log.oldest_seg = seg;
+            }
+            if (!found || seg > s_log.head_seg)
+            {
+                s_log.head_seg = seg;
+            }
+            found = true;
+        }
+    }
+    closedir(dh);
+
+    if (!found)
+    {
+        s_log.oldest_seg = 1;
+        s_log.head_seg = 1;
+    }
+
+    /* A torn tail record means we lost power mid-append; never write
+     * behind it, start a fresh segment instead */
+    bool torn = false;
+    s_log.head_off = _valid_end(s_log.head_seg, &torn);
+    if (torn)
+    {
+        ESP_LOGW(TAG, "Segment %" PRIu32 " has a torn record, rotating", s_log.head_seg);
+        s_log.stats.crc_errors++;
+        s_log.head_seg++;
+        s_log.head_off = 0;
+    }
+
+    _read_cursor();
+    s_log.peek_seg = s_log.tail_seg;
+    s_log.peek_off = s_log.tail_off;
+    if (_count_from(s_log.tail_seg, s_log.tail_off, &s_log.stats.pending) != ESP_OK)
+    {
+        return ESP_FAIL; // not ready; the caller retries the init
+    }
+    s_log.ready = true;
+
+    ESP_LOGI(TAG, "Log %s: segments %" PRIu32 "..%" PRIu32 ", %" PRIu32 " records pending",
+             dir, s_log.oldest_seg, s_log.head_seg, s_log.stats.pending);
+    return ESP_OK;
+}
+
+static esp_err_t _append_locked(const void *rec)
+{
+    if (!s_log.ready)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    frame_hdr_t hdr = {
+        .magic = FRAME_MAGIC,
+        .len = (uint16_t)s_log.rec_size,
+        .crc = esp_rom_crc32_le(0, rec, s_log.rec_size),
+    };
+    uint32_t frame_len = sizeof(hdr) + s_log.rec_size;
+
+    if (s_log.head_off + frame_len > RECORD_LOG_SEGMENT_BYTES)
+    {
+        s_log.head_seg++;
+        s_log.head_off = 0;
+
+        /* Full: give up the oldest segment rather than the newest data */
+        if (s_log.head_seg - s_log.oldest_seg >= RECORD_LOG_MAX_SEGMENTS)
+        {
+            uint32_t victim = s_log.oldest_seg;
+            if (s_log.tail_seg <= victim)
+            {
+                uint32_t all, kept;
+                if (_count_from(s_log.tail_seg, s_log.tail_off, &all) != ESP_OK ||
+                    _count_from(victim + 1, 0, &kept) != ESP_OK)
+                {
+                    /* Cannot tell what would be lost; keep the segment and
+                     * have the caller retry the append */
+                    s_log.head_seg--;
+                    s_log.head_off = RECORD_LOG_SEGMENT_BYTES;
+                    return ESP_ERR_INVALID_STATE;
+                }
+                uint32_t lost = all - kept;
+                s_log.stats.pending -= lost;
+                s_log.tail_seg = victim + 1;
+                s_log.tail_off = 0;
+                s_log.peek_seg = s_log.tail_seg;
+                s_log.peek_off = 0;
+                s_log.peek_count = 0;
+                _write_cursor();
+                ESP_LOGW(TAG, "Log full, dropped %" PRIu32 " unsent records", lost);
+            }
+            _delete_before(victim + 1);
+            s_log.stats.dropped_segments++;
+        }
+    }
+
+    char path[48];
+    _seg_path(s_log.head_seg, path, sizeof(path));
+    FILE *f = fopen(path, "ab");
+    if (!f)
+    {
+        ESP_LOGW(TAG, "Failed to open %s", path);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    bool ok = fwrite(&hdr, 1, sizeof(hdr), f) == sizeof(hdr) &&
+              fwrite(rec, 1, s_log.rec_size, f) == s_log.rec_size;
+    fflush(f);
+    fsync(fileno(f));
+    fclose(f);
+
+    if (!ok)
+    {
+        /* Partial frame on disk; the CRC check will skip it, but never
+         * append behind it */
+        ESP_LOGE(TAG, "Write to %s failed, rotating segment", path);
+        s_log.head_seg++;
+        s_log.head_off = 0;
+        return ESP_FAIL;
+    }
+
+    s_log.head_off += frame_len;
+    s_log.stats.pending++;
+    s_log.stats.appended++;
+    return ESP_OK;
+}
+
+/* Read up to `max` records from the commit cursor; end_seg/end_off
+ * receive the position right after the last one read. A segment that
+ * cannot be opened for any reason but ENOENT ends the read there; it is
+ * an error only if nothing was read before it. */
+static esp_err_t _read_from_tail(void *out, size_t max, size_t *count,
+                                 uint32_t *end_seg, uint32_t *end_off)
+{
+    uint32_t seg = s_log.tail_seg;
+    uint32_t off = s_log.tail_off;
+    uint8_t *dst = out;
+    esp_err_t err = ESP_OK;
+
+    while (*count < max && seg <= s_log.head_seg)
+    {
+        FILE *f;
+        if (_open_seg(seg, &f) != ESP_OK)
+        {
+            s_log.stats.read_errors++;
+            err = *count ? ESP_OK : ESP_FAIL;
+            break;
+        }
+        if (!f)
+        {
+            if (seg == s_log.head_seg)
+            {
+                break;
+            }
+            seg++;
+            off = 0;
+            continue;
+        }
+
+        fseek(f, off, SEEK_SET);
+        int r = 0;
+        while (*count < max && (r = _read_frame(f, dst + *count * s_log.rec_size)) > 0)
+        {
+            off = (uint32_t)ftell(f);
+            if (r == 1)
+            {
+                (*count)++;
+            }
+        }
+        fclose(f);
+
+        if (r < 0)
+        {
+            ESP_LOGW(TAG, "Corrupt record in segment %" PRIu32 " at %" PRIu32 ", skipping rest",
+                     seg, off);
+            s_log.stats.crc_errors++;
+        }
+        if (*count < max && seg < s_log.head_seg)
+        {
+            /* Segment exhausted (or corrupt from here on) */
+            seg++;
+            off = 0;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    *end_seg = seg;
+    *end_off = off;
+    return err;
+}
+
+static esp_err_t _commit_locked(void)
+{
+    if (!s_log.ready)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    s_log.tail_seg = s_log.peek_seg;
+    s_log.tail_off = s_log.peek_off;
+    s_log.stats.pending -= MIN(s_log.peek_count, s_log.stats.pending);
+    s_log.stats.committed += s_log.peek_count;
+    s_log.peek_count = 0;
+
+    esp_err_t err = _write_cursor();
+    _delete_before(s_log.tail_seg);
+    return err;
+}
+
+/* ---- public API, serialized ---- */
+
+esp_err_t record_log_init(const char *dir, size_t rec_size)
+{
+    if (!s_lock)
+    {
+        s_lock = xSemaphoreCreateMutexStatic(&s_lock_buf);
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t err = _init_locked(dir, rec_size);
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t record_log_append(const void *rec)
+{
+    if (!s_lock)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t err = _append_locked(rec);
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t record_log_peek(void *out, size_t max, size_t *count)
+{
+    *count = 0;
+    if (!s_lock)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t err = ESP_ERR_INVALID_STATE;
+    if (s_log.ready)
+    {
+        uint32_t seg, off;
+        err = _read_from_tail(out, max, count, &seg, &off);
+        if (err == ESP_OK)
+        {
+            s_log.peek_seg = seg;
+            s_log.peek_off = off;
+            s_log.peek_count = *count;
+        }
+        else
+        {
+            /* A commit now must not move the cursor at all */
+            s_log.peek_seg = s_log.tail_seg;
+            s_log.peek_off = s_log.tail_off;
+            s_log.peek_count = 0;
+        }
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t record_log_read(void *out, size_t max, size_t *count)
+{
+    *count = 0;
+    if (!s_lock)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t err = ESP_ERR_INVALID_STATE;
+    if (s_log.ready)
+    {
+        uint32_t seg, off;
+        err = _read_from_tail(out, max, count, &seg, &off);
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t record_log_commit(void)
+{
+    if (!s_lock)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t err = _commit_locked();
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+uint32_t record_log_pending(void)
+{
+    return s_log.stats.pending; // single aligned load
+}
+
+void record_log_get_stats(record_log_stats_t *out)
+{
+    if (s_lock)
+    {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+    }
+    *out = s_log.stats;
+    out->oldest_seg = s_log.oldest_seg;
+    out->head_seg = s_log.head_seg;
+    if (s_lock)
+    {
+        xSemaphoreGive(s_lock);
+    }
+}
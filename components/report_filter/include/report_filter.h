@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sensor_record.h"
+
+/* Pass to report_filter_get_stats() for the sum over all channels */
+#define REPORT_FILTER_ALL_CHANNELS 0xFFFF
+
+typedef enum
+{
+    REPORT_FILTER_NONE,          // every window is reported
+    REPORT_FILTER_DEADBAND,      // report when |avg - last reported| > deadband
+    REPORT_FILTER_SWINGING_DOOR, // report the points a line within ±deadband can't bridge
+} report_filter_mode_t;
+
+typedef struct
+{
+    report_filter_mode_t mode;
+    float deadband;         // deadband, or compression deviation for swinging door
+    uint32_t max_silence_s; // heartbeat: report at least this often, 0 = never
+} report_filter_cfg_t;
+
+typedef struct
+{
+    uint32_t emitted;
+    uint32_t suppressed;
+} report_filter_stats_t;
+
+/**
+ * @brief  Set the filter of one channel and restart its state. Channels
+ *         that were never configured report every window.
+ */
+esp_err_t report_filter_configure(uint16_t channel, const report_filter_cfg_t *cfg);
+
+/**
+ * @brief  Feed one window record and collect what should be reported.
+ *
+ * Swinging door decides on a point only once a later point arrives, so a
+ * call may report the previously held record (with its own timestamp)
+ * followed by the current one; `out` must hold two records.
+ * @return Number of records written to `out` (0..2).
+ */
+size_t report_filter_process(const avg_sample_t *rec, avg_sample_t out[2]);
+
+/**
+ * @brief  Move every stored timestamp by `delta` seconds, e.g. when the
+ *         records fed so far were stamped before the wall clock was known.
+ *         Slopes and deadbands are unaffected.
+ */
+void report_filter_shift_time(time_t delta);
+
+/** @brief Emitted/suppressed counters of a channel, or REPORT_FILTER_ALL_CHANNELS. */
+void report_filter_get_stats(uint16_t channel, report_filter_stats_t *out);
+
+/** @brief Parse "none", "deadband" or "sdt"; returns false on anything else. */
+bool report_filter_mode_from_str(const char *s, report_filter_mode_t *out);
@@ -0,0 +1,178 @@
+/* components/report_filter/report_filter.c
+ *
+ * Per-channel reporting filter between window close and the upload log:
+ *  - deadband: only changes larger than a threshold are reported
+ *  - swinging door: points that lie within ±deviation of a straight line
+ *    between reported points are dropped
+ *  - heartbeat: a point is reported at least every max_silence_s anyway
+ */
+
+#include "report_filter.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+#include <strings.h>
+
+typedef struct
+{
+    report_filter_cfg_t cfg;
+    bool has_archive;
+    bool has_held;
+    avg_sample_t archive;   // last reported point
+    avg_sample_t held;      // latest point not reported yet (swinging door)
+    float slope_up;         // tightest upper door slope from archive
+    float slope_low;        // tightest lower door slope from archive
+    report_filter_stats_t stats;
+} filter_state_t;
+
+static filter_state_t s_filters[SENSOR_MAX_CHANNELS];
+
+static void _open_doors(filter_state_t *f)
+{
+    f->slope_up = INFINITY;
+    f->slope_low = -INFINITY;
+}
+
+static void _archive(filter_state_t *f, const avg_sample_t *rec)
+{
+    f->archive = *rec;
+    f->has_archive = true;
+    _open_doors(f);
+}
+
+/* Narrow the doors from the archived point with `rec`; false when they cross */
+static bool _doors_hold(filter_state_t *f, const avg_sample_t *rec)
+{
+    float dt = (float)(rec->timestamp - f->archive.timestamp);
+    if (dt <= 0)
+    {
+        return true;
+    }
+    float dev = f->cfg.deadband;
+    float up = (rec->average + dev - f->archive.average) / dt;
+    float low = (rec->average - dev - f->archive.average) / dt;
+    f->slope_up = fminf(f->slope_up, up);
+    f->slope_low = fmaxf(f->slope_low, low);
+    return f->slope_low <= f->slope_up;
+}
+
+esp_err_t report_filter_configure(uint16_t channel, const report_filter_cfg_t *cfg)
+{
+    if (channel >= SENSOR_MAX_CHANNELS || !cfg || cfg->deadband < 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    filter_state_t *f = &s_filters[channel];
+    memset(f, 0, sizeof(*f));
+    f->cfg = *cfg;
+    return ESP_OK;
+}
+
+size_t report_filter_process(const avg_sample_t *rec, avg_sample_t out[2])
+{
+    if (rec->channel >= SENSOR_MAX_CHANNELS)
+    {
+        out[0] = *rec;
+        return 1;
+    }
+
+    filter_state_t *f = &s_filters[rec->channel];
+    size_t n = 0;
+    bool report = false;
+
+    if (!f->has_archive || f->cfg.mode == REPORT_FILTER_NONE)
+    {
+        report = true;
+    }
+    else if (f->cfg.mode == REPORT_FILTER_DEADBAND)
+    {
+        report = fabsf(rec->average - f->archive.average) > f->cfg.deadband;
+    }
+    else if (!_doors_hold(f, rec))
+    {
+        /* The held point is the last one a line from the archive could
+         * still reach: report it and restart the doors from there */
+        if (f->has_held)
+        {
+            out[n++] = f->held;
+            f->stats.emitted++;
+            f->stats.suppressed--; // it was counted as suppressed when held
+            _archive(f, &f->held);
+            f->has_held = false;
+            _doors_hold(f, rec);
+        }
+        else
+        {
+            report = true;
+        }
+    }
+
+    if (!report && f->cfg.max_silence_s > 0 &&
+        rec->timestamp - f->archive.timestamp >= (time_t)f->cfg.max_silence_s)
+    {
+        report = true; // heartbeat
+    }
+
+    if (report)
+    {
+        out[n++] = *rec;
+        f->stats.emitted++;
+        _archive(f, rec);
+        f->has_held = false;
+    }
+    else
+    {
+        f->held = *rec;
+        f->has_held = true;
+        f->stats.suppressed++;
+    }
+    return n;
+}
+
+void report_filter_shift_time(time_t delta)
+{
+    for (uint16_t ch = 0; ch < SENSOR_MAX_CHANNELS; ch++)
+    {
+        s_filters[ch].archive.timestamp += delta;
+        s_filters[ch].held.timestamp += delta;
+    }
+}
+
+void report_filter_get_stats(uint16_t channel, report_filter_stats_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    for (uint16_t ch = 0; ch < SENSOR_MAX_CHANNELS; ch++)
+    {
+        if (channel == REPORT_FILTER_ALL_CHANNELS || channel == ch)
+        {
+            out->emitted += s_filters[ch].stats.emitted;
+            out->suppressed += s_filters[ch].stats.suppressed;
+        }
+    }
+}
+
+bool report_filter_mode_from_str(const char *s, report_filter_mode_t *out)
+{
+    if (!s)
+    {
+        return false;
+    }
+    if (strcasecmp(s, "none") == 0)
+    {
+        *out = REPORT_FILTER_NONE;
+    }
+    else if (strcasecmp(s, "deadband") == 0)
+    {
+        *out = REPORT_FILTER_DEADBAND;
+    }
+    else if (strcasecmp(s, "sdt") == 0 || strcasecmp(s, "swinging_door") == 0)
+    {
+        *out = REPORT_FILTER_SWINGING_DOOR;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
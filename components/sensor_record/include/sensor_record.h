@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+/* Channels per node; ids index per-channel tables in the uploader */
+#define SENSOR_MAX_CHANNELS 32
+/* Channel 0 keeps the original single-sensor document layout */
+#define SENSOR_CHANNEL_PRIMARY 0
+
+/* Structure for holding an averaged reading and its window statistics.
+ * This is also the on-flash record format of the upload log, so append new
+ * fields at the end only. */
+typedef struct
+{
+    time_t timestamp;
+    float average;
+    uint16_t channel;  // acquisition channel id
+    uint16_t samples;  // samples that went into the average
+    float min;
+    float max;
+    float stddev;      // sample standard deviation
+    float p50;
+    float p95;
+} avg_sample_t;
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sensor_record.h"
+
+#define SINK_MAX_SINKS 4
+#define SINK_NAME_MAX 12
+#define SINK_STACK_SIZE CONFIG_SINK_ROUTER_STACK_SIZE
+#define SINK_PRIORITY CONFIG_SINK_ROUTER_PRIORITY
+#define SINK_CORE CONFIG_SINK_ROUTER_CORE
+
+/**
+ * Deliver `count` records, oldest first. Called from the sink's own task
+ * only. Return ESP_OK once the records are handed off; any error keeps the
+ * whole batch and retries it after the sink's backoff, so a write must not
+ * partially succeed (use batch 1 when it can).
+ */
+typedef esp_err_t (*sink_write_fn)(void *ctx, const avg_sample_t *recs, size_t count);
+
+/**
+ * Periodic call on the sink's own task, for sinks that buffer past write()
+ * (e.g. a payload that must go out once it is old enough even when no
+ * further record arrives). Runs beside write(), never concurrently.
+ */
+typedef void (*sink_tick_fn)(void *ctx);
+
+typedef struct
+{
+    const char *name;      // task and metric names ("sink.<name>.*"), copied
+    sink_write_fn write;
+    void *ctx;
+    uint16_t queue_len;    // records held while the sink is slow or down, power of two
+    uint16_t batch;        // records per write(), at most queue_len
+    uint32_t max_delay_ms; // write a short batch once its oldest record is this old, 0 = never
+    uint32_t retry_min_ms; // first retry after a failed write
+    uint32_t retry_max_ms; // the delay doubles per failure up to this
+    sink_tick_fn tick;     // optional
+    uint32_t tick_ms;      // tick period, required with tick
+} sink_cfg_t;
+
+typedef struct
+{
+    char name[SINK_NAME_MAX];
+    uint32_t queued;       // records waiting, batch in hand included
+    uint32_t high_water;
+    uint32_t dropped;      // rejected because the queue was full
+    uint32_t written;
+    uint32_t failures;     // failed write() calls
+    uint32_t lag_ms;       // age of the oldest undelivered record
+    uint32_t backoff_ms;   // current retry delay, 0 while writes succeed
+} sink_stats_t;
+
+/**
+ * Fan-out of window records. Every sink has its own queue, task, batch size
+ * and retry policy, so a slow or failing sink only ever fills its own queue
+ * and the others keep flowing. Per sink, the metrics registry gets
+ * sink.<name>.records / .dropped / .failures (counters), .lag_ms (gauge)
+ * and .write_us (histogram).
+ */
+
+/**
+ * @brief  Add a sink and start its task. Sinks may be added at any time;
+ *         records published before a sink exists are not replayed to it.
+ * @param  out_id  Optional, receives the sink id.
+ */
+esp_err_t sink_router_add(const sink_cfg_t *cfg, uint8_t *out_id);
+
+/**
+ * @brief  Queue one record to every sink. Never blocks. Only call from one
+ *         task (each queue is single-producer).
+ * @return Number of sinks that accepted it.
+ */
+size_t sink_router_publish(const avg_sample_t *rec);
+
+/** @brief Wake every sink now and skip any pending retry delay. */
+void sink_router_kick(void);
+
+/** @brief Number of sinks added so far. */
+uint8_t sink_router_count(void);
+
+/** @brief Queue and delivery figures of one sink. */
+esp_err_t sink_router_get_stats(uint8_t id, sink_stats_t *out);
@@ -0,0 +1,339 @@
+/* components/sink_router/sink_router.c
+ *
+ * Fan-out of window records to independent sinks:
+ *  - publish() copies each record into every sink's SPSC ring and wakes
+ *    its task; it never blocks, a full ring drops the record for that sink
+ *  - each sink task takes up to `batch` records into a batch it holds until
+ *    write() succeeds, so a failed batch is retried as is, in order
+ *  - failures back off exponentially per sink; kick() cuts the wait short
+ *    when the caller knows the sink can make progress again
+ *  - an optional tick runs on the sink task every tick_ms, for sinks that
+ *    hold records of their own past write()
+ */
+
+#include "sink_router.h"
+
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "spsc_ring.h"
+#include "perf_metrics.h"
+
+static const char *TAG = "SINK_ROUTER";
+
+#define NOTIFY_DATA BIT0
+#define NOTIFY_KICK BIT1
+#define METRIC_NAME_MAX (SINK_NAME_MAX + 16)
+
+typedef struct
+{
+    avg_sample_t rec;
+    int64_t t_us; // when it was published, for the lag gauge
+} sink_entry_t;
+
+typedef struct
+{
+    sink_cfg_t cfg;
+    char name[SINK_NAME_MAX];
+    atomic_bool ready;
+    TaskHandle_t task;
+    spsc_ring_t ring;
+
+    /* Owned by the sink task */
+    avg_sample_t *batch;
+    size_t n_batch;
+    int64_t oldest_us;
+    int64_t retry_at_us;
+    int64_t tick_at_us;
+
+    /* Written by the sink task, read by get_stats() */
+    volatile uint32_t written;
+    volatile uint32_t failures;
+    volatile uint32_t lag_ms;
+    volatile uint32_t backoff_ms;
+
+    /* The registry keeps name pointers, so the names live here */
+    char metric_names[5][METRIC_NAME_MAX];
+    perf_metric_t *m_records;
+    perf_metric_t *m_dropped;
+    perf_metric_t *m_failures;
+    perf_metric_t *m_lag;
+    perf_metric_t *m_write;
+} sink_t;
+
+static struct
+{
+    portMUX_TYPE lock;
+    sink_t sinks[SINK_MAX_SINKS];
+    uint8_t n_sinks; // slots handed out; a slot is used once `ready`
+} s_router = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static perf_metric_t *_metric(sink_t *s, int i, const char *suffix,
+                              perf_metric_t *(*reg)(const char *))
+{
+    snprintf(s->metric_names[i], METRIC_NAME_MAX, "sink.%s.%s", s->name, suffix);
+    return reg(s->metric_names[i]);
+}
+
+static void _fill(sink_t *s)
+{
+    sink_entry_t e;
+    while (s->n_batch < s->cfg.batch && spsc_ring_pop(&s->ring, &e))
+    {
+        if (s->n_batch == 0)
+        {
+            s->oldest_us = e.t_us;
+        }
+        s->batch[s->n_batch++] = e.rec;
+    }
+}
+
+/* Writes batches until the queue is empty, a batch is short and not yet
+ * due, or a write fails */
+static void _drain(sink_t *s)
+{
+    for (;;)
+    {
+        _fill(s);
+        if (s->n_batch == 0)
+        {
+            return;
+        }
+        int64_t now = esp_timer_get_time();
+        if (now < s->retry_at_us)
+        {
+            return;
+        }
+        if (s->n_batch < s->cfg.batch &&
+            (s->cfg.max_delay_ms == 0 || now - s->oldest_us < (int64_t)s->cfg.max_delay_ms * 1000))
+        {
+            return;
+        }
+
+        esp_err_t err = s->cfg.write(s->cfg.ctx, s->batch, s->n_batch);
+        perf_hist_since(s->m_write, now);
+        if (err != ESP_OK)
+        {
+            s->failures++;
+            perf_count(s->m_failures, 1);
+            uint32_t backoff = s->backoff_ms ? MIN(s->backoff_ms * 2, s->cfg.retry_max_ms)
+                                             : s->cfg.retry_min_ms;
+            s->backoff_ms = backoff;
+            s->retry_at_us = esp_timer_get_time() + (int64_t)backoff * 1000;
+            if (backoff == s->cfg.retry_min_ms)
+            {
+                ESP_LOGW(TAG, "%s: write of %u records failed (%s), retrying",
+                         s->name, (unsigned)s->n_batch, esp_err_to_name(err));
+            }
+            return;
+        }
+        s->written += s->n_batch;
+        perf_count(s->m_records, s->n_batch);
+        if (s->backoff_ms)
+        {
+            ESP_LOGI(TAG, "%s: recovered after %" PRIu32 " failures", s->name, s->failures);
+        }
+        s->n_batch = 0;
+        s->backoff_ms = 0;
+        s->retry_at_us = 0;
+    }
+}
+
+/* Time until the sink has something to do without a new record */
+static TickType_t _wait_ticks(const sink_t *s)
+{
+    int64_t due = INT64_MAX;
+    if (s->n_batch == 0)
+    {
+        // nothing held here; only the tick may be due
+    }
+    else if (s->retry_at_us)
+    {
+        due = s->retry_at_us;
+    }
+    else if (s->n_batch < s->cfg.batch && s->cfg.max_delay_ms)
+    {
+        due = s->oldest_us + (int64_t)s->cfg.max_delay_ms * 1000;
+    }
+    if (s->cfg.tick)
+    {
+        due = MIN(due, s->tick_at_us);
+    }
+    if (due == INT64_MAX)
+    {
+        return portMAX_DELAY;
+    }
+    int64_t now = esp_timer_get_time();
+    return due <= now ? 0 : pdMS_TO_TICKS((due - now) / 1000) + 1;
+}
+
+static void sink_task(void *pvParameters)
+{
+    sink_t *s = pvParameters;
+    for (;;)
+    {
+        uint32_t bits = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &bits, _wait_ticks(s));
+        if (bits & NOTIFY_KICK)
+        {
+            s->retry_at_us = 0;
+        }
+        _drain(s);
+        if (s->cfg.tick && esp_timer_get_time() >= s->tick_at_us)
+        {
+            s->cfg.tick(s->cfg.ctx);
+            s->tick_at_us = esp_timer_get_time() + (int64_t)s->cfg.tick_ms * 1000;
+        }
+
+        uint32_t lag = s->n_batch ? (uint32_t)((esp_timer_get_time() - s->oldest_us) / 1000) : 0;
+        s->lag_ms = lag;
+        perf_gauge_set(s->m_lag, (int32_t)lag);
+    }
+}
+
+esp_err_t sink_router_add(const sink_cfg_t *cfg, uint8_t *out_id)
+{
+    if (!cfg || !cfg->name || !cfg->write || cfg->batch == 0 || cfg->batch > cfg->queue_len ||
+        cfg->retry_min_ms == 0 || cfg->retry_max_ms < cfg->retry_min_ms ||
+        (cfg->tick && cfg->tick_ms == 0))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    taskENTER_CRITICAL(&s_router.lock);
+    uint8_t id = s_router.n_sinks;
+    if (id < SINK_MAX_SINKS)
+    {
+        s_router.n_sinks++;
+    }
+    taskEXIT_CRITICAL(&s_router.lock);
+    if (id == SINK_MAX_SINKS)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    sink_t *s = &s_router.sinks[id];
+    s->cfg = *cfg;
+    strlcpy(s->name, cfg->name, sizeof(s->name));
+    s->cfg.name = s->name;
+    s->tick_at_us = esp_timer_get_time() + (int64_t)cfg->tick_ms * 1000;
+
+    void *storage = calloc(cfg->queue_len, sizeof(sink_entry_t));
+    s->batch = calloc(cfg->batch, sizeof(avg_sample_t));
+    if (!storage || !s->batch)
+    {
+        free(storage);
+        free(s->batch);
+        s->batch = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = spsc_ring_init(&s->ring, storage, sizeof(sink_entry_t), cfg->queue_len);
+    if (err != ESP_OK)
+    {
+        free(storage);
+        free(s->batch);
+        s->batch = NULL;
+        return err;
+    }
+
+    s->m_records = _metric(s, 0, "records", perf_counter);
+    s->m_dropped = _metric(s, 1, "dropped", perf_counter);
+    s->m_failures = _metric(s, 2, "failures", perf_counter);
+    s->m_lag = _metric(s, 3, "lag_ms", perf_gauge);
+    s->m_write = _metric(s, 4, "write_us", perf_histogram);
+
+    char task_name[configMAX_TASK_NAME_LEN];
+    snprintf(task_name, sizeof(task_name), "sink_%s", s->name);
+    if (xTaskCreatePinnedToCore(&sink_task, task_name, SINK_STACK_SIZE, s, SINK_PRIORITY,
+                                &s->task, SINK_CORE) != pdPASS)
+    {
+        ESP_LOGE(TAG, "%s: task creation failed", s->name);
+        free(storage);
+        free(s->batch);
+        s->batch = NULL;
+        return ESP_ERR_NO_MEM; // the slot stays unused
+    }
+    perf_watch_task(s->task, s->name);
+    atomic_store(&s->ready, true);
+
+    ESP_LOGI(TAG, "Sink %s: queue %u, batch %u, max delay %" PRIu32 " ms, retry %" PRIu32
+                  "..%" PRIu32 " ms",
+             s->name, cfg->queue_len, cfg->batch, cfg->max_delay_ms, cfg->retry_min_ms,
+             cfg->retry_max_ms);
+    if (out_id)
+    {
+        *out_id = id;
+    }
+    return ESP_OK;
+}
+
+size_t sink_router_publish(const avg_sample_t *rec)
+{
+    sink_entry_t e = {
+        .rec = *rec,
+        .t_us = esp_timer_get_time(),
+    };
+    size_t accepted = 0;
+    for (uint8_t i = 0; i < SINK_MAX_SINKS; i++)
+    {
+        sink_t *s = &s_router.sinks[i];
+        if (!atomic_load(&s->ready))
+        {
+            continue;
+        }
+        if (!spsc_ring_push(&s->ring, &e))
+        {
+            perf_count(s->m_dropped, 1);
+            continue;
+        }
+        accepted++;
+        xTaskNotify(s->task, NOTIFY_DATA, eSetBits);
+    }
+    return accepted;
+}
+
+void sink_router_kick(void)
+{
+    for (uint8_t i = 0; i < SINK_MAX_SINKS; i++)
+    {
+        sink_t *s = &s_router.sinks[i];
+        if (atomic_load(&s->ready))
+        {
+            xTaskNotify(s->task, NOTIFY_KICK, eSetBits);
+        }
+    }
+}
+
+uint8_t sink_router_count(void)
+{
+    return s_router.n_sinks;
+}
+
+esp_err_t sink_router_get_stats(uint8_t id, sink_stats_t *out)
+{
+    if (id >= SINK_MAX_SINKS || !atomic_load(&s_router.sinks[id].ready))
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    const sink_t *s = &s_router.sinks[id];
+    memcpy(out->name, s->name, sizeof(out->name));
+    out->queued = spsc_ring_count(&s->ring) + (uint32_t)s->n_batch;
+    out->high_water = spsc_ring_high_water(&s->ring);
+    out->dropped = spsc_ring_dropped(&s->ring);
+    out->written = s->written;
+    out->failures = s->failures;
+    out->lag_ms = s->lag_ms;
+    out->backoff_ms = s->backoff_ms;
+    return ESP_OK;
+}
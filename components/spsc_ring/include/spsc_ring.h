@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/**
+ * Lock-free single-producer / single-consumer ring of fixed-size records.
+ *
+ * Exactly one task (or timer callback) may push and exactly one task may
+ * pop. Neither side ever blocks or takes a lock; storage is supplied by the
+ * caller so the ring never touches the heap.
+ */
+typedef struct
+{
+    uint8_t *storage;
+    size_t elem_size;
+    uint32_t mask;            /* capacity - 1, capacity is a power of two */
+    atomic_uint head;          /* next slot to write, owned by the producer */
+    atomic_uint tail;          /* next slot to read, owned by the consumer */
+    atomic_uint dropped;
+    atomic_uint high_water;
+} spsc_ring_t;
+
+/**
+ * @brief  Initialise a ring over caller-provided storage.
+ * @param  ring       Ring to initialise.
+ * @param  storage    Buffer of at least elem_size * capacity bytes.
+ * @param  elem_size  Size of one record in bytes.
+ * @param  capacity   Number of records, must be a power of two.
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG.
+ */
+esp_err_t spsc_ring_init(spsc_ring_t *ring, void *storage, size_t elem_size, uint32_t capacity);
+
+/**
+ * @brief  Producer side: copy one record in.
+ * @return false (and bump the drop counter) if the ring is full.
+ */
+bool spsc_ring_push(spsc_ring_t *ring, const void *elem);
+
+/**
+ * @brief  Consumer side: copy the oldest record out.
+ * @return false if the ring is empty.
+ */
+bool spsc_ring_pop(spsc_ring_t *ring, void *out);
+
+/** @brief Records currently queued (exact from either side). */
+uint32_t spsc_ring_count(const spsc_ring_t *ring);
+
+/** @brief Highest queue depth observed since init. */
+uint32_t spsc_ring_high_water(const spsc_ring_t *ring);
+
+/** @brief Records rejected because the ring was full. */
+uint32_t spsc_ring_dropped(const spsc_ring_t *ring);
@@ -0,0 +1,81 @@
+/* components/spsc_ring/spsc_ring.c
+ *
+ * Single-producer / single-consumer ring buffer. head and tail are free
+ * running counters; the producer publishes a slot with a release store on
+ * head, the consumer frees it with a release store on tail.
+ */
+
+#include "spsc_ring.h"
+
+#include <string.h>
+
+esp_err_t spsc_ring_init(spsc_ring_t *ring, void *storage, size_t elem_size, uint32_t capacity)
+{
+    if (!ring || !storage || elem_size == 0 || capacity == 0 || (capacity & (capacity - 1)) != 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    ring->storage = storage;
+    ring->elem_size = elem_size;
+    ring->mask = capacity - 1;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->dropped, 0);
+    atomic_init(&ring->high_water, 0);
+    return ESP_OK;
+}
+
+bool spsc_ring_push(spsc_ring_t *ring, const void *elem)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    uint32_t used = head - tail;
+
+    if (used > ring->mask)
+    {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return false;
+    }
+
+    memcpy(ring->storage + (size_t)(head & ring->mask) * ring->elem_size, elem, ring->elem_size);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+    if (used + 1 > atomic_load_explicit(&ring->high_water, memory_order_relaxed))
+    {
+        atomic_store_explicit(&ring->high_water, used + 1, memory_order_relaxed);
+    }
+    return true;
+}
+
+bool spsc_ring_pop(spsc_ring_t *ring, void *out)
+{
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    if (head == tail)
+    {
+        return false;
+    }
+
+    memcpy(out, ring->storage + (size_t)(tail & ring->mask) * ring->elem_size, ring->elem_size);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+uint32_t spsc_ring_count(const spsc_ring_t *ring)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    return head - tail;
+}
+
+uint32_t spsc_ring_high_water(const spsc_ring_t *ring)
+{
+    return atomic_load_explicit(&ring->high_water, memory_order_relaxed);
+}
+
+uint32_t spsc_ring_dropped(const spsc_ring_t *ring)
+{
+    return atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+}
@@ -0,0 +1,310 @@
+/* components/usb_helper/config_cache.c
+ *
+ * Parsed, in-RAM view of cfg.json:
+ *  - The file is read and run through cJSON once, then flattened into a
+ *    single packed blob ("key\0value\0...") plus a small hash index.
+ *  - Lookups are served from RAM without touching the heap.
+ *  - The table is only rebuilt when the file's mtime/size change or the
+ *    USB MSC host hands the storage back to the application.
+ */
+
+#include "config_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "tusb_msc_storage.h"
+#include "cJSON.h"
+
+static const char *TAG = "CONFIG_CACHE";
+
+typedef struct
+{
+    uint32_t hash;    /* FNV-1a of the key, checked before strcmp */
+    uint16_t key_off; /* offset of the key inside blob */
+    uint16_t val_off; /* offset of the value inside blob */
+} cfg_entry_t;
+
+static struct
+{
+    SemaphoreHandle_t lock;
+    char path[64];
+    char *blob;
+    cfg_entry_t entries[CONFIG_CACHE_MAX_KEYS];
+    uint8_t count;
+    time_t mtime;
+    off_t size;
+    volatile bool stale;
+    uint32_t generation;
+} s_cfg;
+
+static uint32_t _hash_key(const char *key)
+{
+    uint32_t h = 2166136261u;
+    while (*key)
+    {
+        h ^= (uint8_t)*key++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* Render a cJSON leaf the same way load_config_from_fat() always has */
+static const char *_leaf_to_str(const cJSON *item, char *num_buf, size_t num_len)
+{
+    if (cJSON_IsString(item) && item->valuestring)
+    {
+        return item->valuestring;
+    }
+    if (cJSON_IsNumber(item))
+    {
+        if ((double)item->valueint == item->valuedouble)
+        {
+            snprintf(num_buf, num_len, "%d", item->valueint);
+        }
+        else
+        {
+            snprintf(num_buf, num_len, "%f", item->valuedouble);
+        }
+        return num_buf;
+    }
+    return NULL;
+}
+
+static char *_read_whole_file(const char *path, size_t len)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+    {
+        ESP_LOGE(TAG, "Failed to open %s", path);
+        return NULL;
+    }
+
+    char *buf = malloc(len + 1);
+    if (!buf)
+    {
+        ESP_LOGE(TAG, "Out of memory for %u bytes", (unsigned)(len + 1));
+        fclose(f);
+        return NULL;
+    }
+
+    size_t read = fread(buf, 1, len, f);
+    buf[read] = '\0';
+    fclose(f);
+    return buf;
+}
+
+/* Build a fresh blob + index from the file. Caller holds the lock. */
+static esp_err_t _load_locked(const struct stat *st)
+{
+    char *json = _read_whole_file(s_cfg.path, (size_t)st->st_size);
+    if (!json)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    cJSON *root = cJSON_Parse(json);
+    free(json);
+    if (!root)
+    {
+        ESP_LOGE(TAG, "JSON parse error in %s", s_cfg.path);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    /* 1) Size the packed blob */
+    char num_buf[32];
+    size_t blob_len = 0;
+    uint8_t count = 0;
+    const cJSON *item = NULL;
+    cJSON_ArrayForEach(item, root)
+    {
+        const char *val = _leaf_to_str(item, num_buf, sizeof(num_buf));
+        if (!val || !item->string)
+        {
+            continue;
+        }
+        if (count == CONFIG_CACHE_MAX_KEYS)
+        {
+            ESP_LOGW(TAG, "More than %d keys, ignoring '%s'", CONFIG_CACHE_MAX_KEYS, item->string);
+            continue;
+        }
+        blob_len += strlen(item->string) + 1 + strlen(val) + 1;
+        count++;
+    }
+
+    if (blob_len > CONFIG_CACHE_MAX_BLOB)
+    {
+        ESP_LOGE(TAG, "Config too large (%u bytes)", (unsigned)blob_len);
+        cJSON_Delete(root);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    char *blob = malloc(blob_len ? blob_len : 1);
+    if (!blob)
+    {
+        cJSON_Delete(root);
+        return ESP_ERR_NO_MEM;
+    }
+
+    /* 2) Pack keys and values, index them */
+    size_t off = 0;
+    uint8_t idx = 0;
+    cJSON_ArrayForEach(item, root)
+    {
+        const char *val = _leaf_to_str(item, num_buf, sizeof(num_buf));
+        if (!val || !item->string || idx == count)
+        {
+            continue;
+        }
+        size_t klen = strlen(item->string) + 1;
+        size_t vlen = strlen(val) + 1;
+
+        s_cfg.entries[idx].hash = _hash_key(item->string);
+        s_cfg.entries[idx].key_off = (uint16_t)off;
+        memcpy(blob + off, item->string, klen);
+        off += klen;
+        s_cfg.entries[idx].val_off = (uint16_t)off;
+        memcpy(blob + off, val, vlen);
+        off += vlen;
+        idx++;
+    }
+    cJSON_Delete(root);
+
+    free(s_cfg.blob);
+    s_cfg.blob = blob;
+    s_cfg.count = count;
+    s_cfg.mtime = st->st_mtime;
+    s_cfg.size = st->st_size;
+    s_cfg.stale = false;
+    s_cfg.generation++;
+
+    ESP_LOGI(TAG, "Loaded %u keys (%u bytes) from %s, generation %" PRIu32,
+             count, (unsigned)blob_len, s_cfg.path, s_cfg.generation);
+    return ESP_OK;
+}
+
+esp_err_t config_cache_init(const char *path)
+{
+    if (!s_cfg.lock)
+    {
+        s_cfg.lock = xSemaphoreCreateRecursiveMutex();
+        if (!s_cfg.lock)
+        {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    strlcpy(s_cfg.path, path, sizeof(s_cfg.path));
+    s_cfg.stale = true;
+    return config_cache_refresh();
+}
+
+esp_err_t config_cache_refresh(void)
+{
+    if (!s_cfg.lock)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    /* The FAT volume belongs to the USB host while it is mounted there;
+     * keep serving the last good table until it comes back. */
+    if (tinyusb_msc_storage_in_use_by_usb_host())
+    {
+        return s_cfg.blob ? ESP_OK : ESP_ERR_INVALID_STATE;
+    }
+
+    struct stat st;
+    if (stat(s_cfg.path, &st) != 0)
+    {
+        ESP_LOGW(TAG, "Cannot stat %s", s_cfg.path);
+        return s_cfg.blob ? ESP_OK : ESP_ERR_NOT_FOUND;
+    }
+
+    esp_err_t err = ESP_OK;
+    xSemaphoreTakeRecursive(s_cfg.lock, portMAX_DELAY);
+    if (s_cfg.stale || !s_cfg.blob ||
+        st.st_mtime != s_cfg.mtime || st.st_size != s_cfg.size)
+    {
+        err = _load_locked(&st);
+        if (err != ESP_OK && s_cfg.blob)
+        {
+            ESP_LOGW(TAG, "Reload failed, keeping previous config");
+            err = ESP_OK;
+        }
+    }
+    xSemaphoreGiveRecursive(s_cfg.lock);
+    return err;
+}
+
+void config_cache_invalidate(void)
+{
+    s_cfg.stale = true;
+}
+
+const char *config_cache_find(const char *key)
+{
+    if (!s_cfg.lock || !key)
+    {
+        return NULL;
+    }
+
+    uint32_t h = _hash_key(key);
+    const char *result = NULL;
+
+    xSemaphoreTakeRecursive(s_cfg.lock, portMAX_DELAY);
+    for (uint8_t i = 0; i < s_cfg.count; i++)
+    {
+        const cfg_entry_t *e = &s_cfg.entries[i];
+        if (e->hash == h && strcmp(s_cfg.blob + e->key_off, key) == 0)
+        {
+            result = s_cfg.blob + e->val_off;
+            break;
+        }
+    }
+    xSemaphoreGiveRecursive(s_cfg.lock);
+    return result;
+}
+
+const char *config_cache_get(const char *key)
+{
+    const char *result = config_cache_find(key);
+    if (!result)
+    {
+        ESP_LOGW(TAG, "Key '%s' not found or unsupported type", key ? key : "(null)");
+    }
+    return result;
+}
+
+bool config_cache_copy(const char *key, char *out_buf, size_t buf_len)
+{
+    config_cache_lock();
+    const char *val = config_cache_get(key);
+    bool ok = val && strlcpy(out_buf, val, buf_len) < buf_len;
+    config_cache_unlock();
+    return ok;
+}
+
+void config_cache_lock(void)
+{
+    if (s_cfg.lock)
+    {
+        xSemaphoreTakeRecursive(s_cfg.lock, portMAX_DELAY);
+    }
+}
+
+void config_cache_unlock(void)
+{
+    if (s_cfg.lock)
+    {
+        xSemaphoreGiveRecursive(s_cfg.lock);
+    }
+}
+
+uint32_t config_cache_generation(void)
+{
+    return s_cfg.generation;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/* Default location of the device configuration on the FAT partition */
+#define CONFIG_FILE_PATH "/data/cfg.json"
+
+/* Limits of the in-RAM table (keys are top-level members of cfg.json) */
+#define CONFIG_CACHE_MAX_KEYS 24
+#define CONFIG_CACHE_MAX_BLOB 0xFFFF
+
+/**
+ * @brief  Parse the configuration file once into the in-RAM key/value table.
+ * @param  path  Full path to the JSON file (e.g. CONFIG_FILE_PATH).
+ * @return ESP_OK on success, otherwise an error code. On failure the cache
+ *         stays empty and is retried on the next config_cache_refresh().
+ */
+esp_err_t config_cache_init(const char *path);
+
+/**
+ * @brief  Reload the table if the file changed (mtime/size) or the cache was
+ *         invalidated by a USB MSC host unmount. Otherwise only costs a stat().
+ *
+ * Pointers previously returned by config_cache_get() stay valid until a
+ * refresh actually reloads the file (see config_cache_generation()).
+ * @return ESP_OK if the cache holds a valid table, otherwise an error code.
+ */
+esp_err_t config_cache_refresh(void);
+
+/**
+ * @brief  Mark the cache stale so the next refresh re-reads the file.
+ */
+void config_cache_invalidate(void);
+
+/**
+ * @brief  Look up a required top-level key. Served from RAM, never allocates.
+ *         A missing key is logged as a warning.
+ * @param  key  Key to look up (case sensitive).
+ * @return Pointer to the value string (numbers are stringified), or NULL.
+ */
+const char *config_cache_get(const char *key);
+
+/**
+ * @brief  Same as config_cache_get() for an optional key with a built-in
+ *         default: a missing key is not logged, as it is normal.
+ */
+const char *config_cache_find(const char *key);
+
+/**
+ * @brief  Copy a value into a caller-provided buffer.
+ * @return true if the key exists and fit into out_buf.
+ */
+bool config_cache_copy(const char *key, char *out_buf, size_t buf_len);
+
+/**
+ * @brief  Hold off reloads while using a pointer from config_cache_get()
+ *         from a task other than the one calling config_cache_refresh().
+ *         Recursive; pair every lock with an unlock and keep it short.
+ */
+void config_cache_lock(void);
+void config_cache_unlock(void);
+
+/**
+ * @brief  Counter bumped every time the table is (re)loaded. Consumers that
+ *         derive state from config values (parsed keys, TLS clients) compare
+ *         it to rebuild that state.
+ */
+uint32_t config_cache_generation(void);
@@ -1,4 +1,10 @@
+#pragma once
+#include "esp_err.h"
 
+/* Boot in stages (see main/boot.c) or all at once with usb_helper_init() */
+esp_err_t usb_helper_storage_init(void); // FAT on wear levelling at /data, config cache
+esp_err_t usb_helper_usb_init(void);     // TinyUSB MSC, after the storage
+esp_err_t usb_helper_console_init(void); // REPL with the file commands
 
 void usb_helper_init(void);
-char *load_config_from_fat(const char *path, const char *item_key);
\ No newline at end of file
+char *load_config_from_fat(const char *path, const char *item_key);
@@ -1,4 +1,5 @@
 #include "usb_helper.h"
+#include "config_cache.h"
 #include <stdio.h>
 #include <errno.h>
 #include <dirent.h>
@@ -125,8 +126,8 @@ static void _mount(void)
     ESP_LOGI(TAG, "Mount storage...");
     ESP_ERROR_CHECK(tinyusb_msc_storage_mount(BASE_PATH));
 
-    // List all the files in this directory
-    ESP_LOGI(TAG, "\nls command output:");
+    // List all the files in this directory (debug level, it slows the boot)
+    ESP_LOGD(TAG, "ls command output:");
     struct dirent *d;
     DIR *dh = opendir(BASE_PATH);
     if (!dh)
@@ -146,8 +147,9 @@ static void _mount(void)
     // While the next entry is not readable we will print directory files
     while ((d = readdir(dh)) != NULL)
     {
-        printf("%s\n", d->d_name);
+        ESP_LOGD(TAG, "%s", d->d_name);
     }
+    closedir(dh);
     return;
 }
 
@@ -237,6 +239,12 @@ static int console_exit(int argc, char **argv)
 static void storage_mount_changed_cb(tinyusb_msc_event_t *event)
 {
     ESP_LOGI(TAG, "Storage mounted to application: %s", event->mount_changed_data.is_mounted ? "Yes" : "No");
+
+    // the host may have edited cfg.json while it owned the volume
+    if (event->mount_changed_data.is_mounted)
+    {
+        config_cache_invalidate();
+    }
 }
 
 static esp_err_t storage_init_spiflash(wl_handle_t *wl_handle)
@@ -340,37 +348,66 @@ char *load_config_from_fat(const char *path, const char *item_key)
     return result;
 }
 
-void usb_helper_init(void)
+esp_err_t usb_helper_storage_init(void)
 {
     ESP_LOGI(TAG, "Initializing storage...");
     static wl_handle_t wl_handle = WL_INVALID_HANDLE;
 
-    ESP_ERROR_CHECK(storage_init_spiflash(&wl_handle));
+    esp_err_t err = storage_init_spiflash(&wl_handle);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
     const tinyusb_msc_spiflash_config_t config_spi = {
         .wl_handle = wl_handle,
         .callback_mount_changed = storage_mount_changed_cb, /* First way to register the callback. This is while initializing the storage. */
         .mount_config.max_files = 5,
     };
 
-    ESP_ERROR_CHECK(tinyusb_msc_storage_init_spiflash(&config_spi));
+    err = tinyusb_msc_storage_init_spiflash(&config_spi);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
     _mount();
 
+    if (config_cache_init(CONFIG_FILE_PATH) != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Config cache not loaded, will retry on next refresh");
+    }
+    return ESP_OK;
+}
+
+esp_err_t usb_helper_usb_init(void)
+{
     ESP_LOGI(TAG, "USB MSC initialization");
 
-    ESP_ERROR_CHECK(tinyusb_driver_install(&tusb_cfg));
-    ESP_LOGI(TAG, "USB MSC initialization DONE");
+    esp_err_t err = tinyusb_driver_install(&tusb_cfg);
+    if (err == ESP_OK)
+    {
+        ESP_LOGI(TAG, "USB MSC initialization DONE");
+    }
+    return err;
+}
 
+esp_err_t usb_helper_console_init(void)
+{
     esp_console_repl_config_t repl_config = ESP_CONSOLE_REPL_CONFIG_DEFAULT();
     /* Prompt to be printed before each line.
      * This can be customized, made dynamic, etc.
      */
     repl_config.prompt = PROMPT_STR ">";
-    repl_config.max_cmdline_length = 64;
+    repl_config.max_cmdline_length = 256;
+    // diagnostics commands (diag.c, bench) do flash I/O and formatted output
+    repl_config.task_stack_size = 6144;
 
 #if defined(CONFIG_ESP_CONSOLE_UART_DEFAULT)
     esp_console_dev_uart_config_t hw_config = ESP_CONSOLE_DEV_UART_CONFIG_DEFAULT();
-    ESP_ERROR_CHECK(esp_console_new_repl_uart(&hw_config, &repl_config, &repl));
-
+    esp_err_t err = esp_console_new_repl_uart(&hw_config, &repl_config, &repl);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
 #endif
 
     for (int count = 0; count < sizeof(cmds) / sizeof(esp_console_cmd_t); count++)
@@ -378,5 +415,12 @@ void usb_helper_init(void)
         ESP_ERROR_CHECK(esp_console_cmd_register(&cmds[count]));
     }
 
-    ESP_ERROR_CHECK(esp_console_start_repl(repl));
+    return esp_console_start_repl(repl);
+}
+
+void usb_helper_init(void)
+{
+    ESP_ERROR_CHECK(usb_helper_storage_init());
+    ESP_ERROR_CHECK(usb_helper_usb_init());
+    ESP_ERROR_CHECK(usb_helper_console_init());
 }
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Streaming per-window statistics in O(1) memory:
+ *  - count/min/max
+ *  - mean and variance with Welford's update in double precision
+ *  - p50/p95 exact while the window holds up to WIN_STATS_EXACT_MAX
+ *    samples, then the P² estimator (Jain & Chlamtac), five markers each
+ *
+ * P² needs a few dozen samples before its tail markers settle, so short
+ * windows (12 samples per minute at 5 s) are answered from the buffer.
+ */
+
+/* Samples kept verbatim before switching to the P² sketches */
+#define WIN_STATS_EXACT_MAX 16
+
+/* P² sketch for one quantile */
+typedef struct
+{
+    float p;          /* target quantile, 0..1 */
+    uint32_t count;   /* samples seen */
+    float q[5];       /* marker heights (the samples themselves while count < 5) */
+    uint32_t n[5];    /* marker positions, 0-based */
+} p2_quantile_t;
+
+typedef struct
+{
+    uint32_t count;
+    double mean;
+    double m2;        /* sum of squared deviations from the mean */
+    float min;
+    float max;
+    float exact[WIN_STATS_EXACT_MAX];
+    p2_quantile_t p50;  /* fed once count exceeds WIN_STATS_EXACT_MAX */
+    p2_quantile_t p95;
+} win_stats_t;
+
+typedef struct
+{
+    uint32_t count;
+    float mean;
+    float min;
+    float max;
+    float stddev;     /* sample standard deviation, 0 for count < 2 */
+    float p50;
+    float p95;
+} win_stats_summary_t;
+
+/** @brief Start a new, empty window. */
+void win_stats_reset(win_stats_t *ws);
+
+/** @brief Add one sample. Constant time, no allocation. */
+void win_stats_add(win_stats_t *ws, float x);
+
+/** @brief Summarise the window; all fields are 0 when it is empty. */
+void win_stats_summary(const win_stats_t *ws, win_stats_summary_t *out);
+
+/* Single-quantile sketch, usable on its own */
+void p2_quantile_init(p2_quantile_t *pq, float p);
+void p2_quantile_add(p2_quantile_t *pq, float x);
+float p2_quantile_get(const p2_quantile_t *pq);
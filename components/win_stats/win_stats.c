@@ -0,0 +1,218 @@
+/* components/win_stats/win_stats.c
+ *
+ * Streaming window statistics: Welford mean/variance and P² quantiles.
+ */
+
+#include "win_stats.h"
+
+#include <math.h>
+#include <string.h>
+
+/* Desired position of marker i after `count` samples, 0-based. Derived from
+ * the count rather than accumulated, so it does not drift in long windows. */
+static float _p2_desired(const p2_quantile_t *pq, int i)
+{
+    const float f[5] = {0.0f, pq->p / 2.0f, pq->p, (1.0f + pq->p) / 2.0f, 1.0f};
+    return (float)(pq->count - 1) * f[i];
+}
+
+/* Insertion sort, n is at most WIN_STATS_EXACT_MAX */
+static void _sort(float *v, int n)
+{
+    for (int i = 1; i < n; i++)
+    {
+        float x = v[i];
+        int j = i - 1;
+        while (j >= 0 && v[j] > x)
+        {
+            v[j + 1] = v[j];
+            j--;
+        }
+        v[j + 1] = x;
+    }
+}
+
+/* Linear interpolation between closest ranks of a sorted array */
+static float _exact_quantile(const float *sorted, uint32_t n, float p)
+{
+    float pos = p * (float)(n - 1);
+    uint32_t lo = (uint32_t)pos;
+    if (lo + 1 >= n)
+    {
+        return sorted[n - 1];
+    }
+    return sorted[lo] + (pos - (float)lo) * (sorted[lo + 1] - sorted[lo]);
+}
+
+void p2_quantile_init(p2_quantile_t *pq, float p)
+{
+    memset(pq, 0, sizeof(*pq));
+    pq->p = p;
+}
+
+void p2_quantile_add(p2_quantile_t *pq, float x)
+{
+    /* Collect the first five samples, then seed the markers from them */
+    if (pq->count < 5)
+    {
+        pq->q[pq->count++] = x;
+        if (pq->count == 5)
+        {
+            _sort(pq->q, 5);
+            for (int i = 0; i < 5; i++)
+            {
+                pq->n[i] = i;
+            }
+        }
+        return;
+    }
+
+    /* Cell k that x falls into, extending the extremes if needed */
+    int k;
+    if (x < pq->q[0])
+    {
+        pq->q[0] = x;
+        k = 0;
+    }
+    else if (x >= pq->q[4])
+    {
+        pq->q[4] = x;
+        k = 3;
+    }
+    else
+    {
+        k = 0;
+        while (k < 3 && x >= pq->q[k + 1])
+        {
+            k++;
+        }
+    }
+
+    for (int i = k + 1; i < 5; i++)
+    {
+        pq->n[i]++;
+    }
+    pq->count++;
+
+    /* Move the middle markers towards their desired positions */
+    for (int i = 1; i <= 3; i++)
+    {
+        float d = _p2_desired(pq, i) - (float)pq->n[i];
+        int32_t right = (int32_t)(pq->n[i + 1] - pq->n[i]);
+        int32_t left = (int32_t)(pq->n[i - 1] - pq->n[i]);
+        if ((d >= 1.0f && right > 1) || (d <= -1.0f && left < -1))
+        {
+            int s = d > 0 ? 1 : -1;
+            float ni = (float)pq->n[i];
+            float nl = (float)pq->n[i - 1];
+            float nr = (float)pq->n[i + 1];
+
+            /* Piecewise-parabolic prediction */
+            float qp = pq->q[i] + (float)s / (nr - nl) *
+                                      ((ni - nl + s) * (pq->q[i + 1] - pq->q[i]) / (nr - ni) +
+                                       (nr - ni - s) * (pq->q[i] - pq->q[i - 1]) / (ni - nl));
+            if (pq->q[i - 1] < qp && qp < pq->q[i + 1])
+            {
+                pq->q[i] = qp;
+            }
+            else
+            {
+                /* Linear fallback keeps the markers ordered */
+                pq->q[i] += (float)s * (pq->q[i + s] - pq->q[i]) /
+                            (float)((int32_t)pq->n[i + s] - (int32_t)pq->n[i]);
+            }
+            pq->n[i] += s;
+        }
+    }
+}
+
+float p2_quantile_get(const p2_quantile_t *pq)
+{
+    if (pq->count == 0)
+    {
+        return 0.0f;
+    }
+    if (pq->count < 5)
+    {
+        /* Exact over the few samples we have */
+        float v[5];
+        memcpy(v, pq->q, sizeof(float) * pq->count);
+        _sort(v, pq->count);
+        return _exact_quantile(v, pq->count, pq->p);
+    }
+    return pq->q[2];
+}
+
+void win_stats_reset(win_stats_t *ws)
+{
+    ws->count = 0;
+    ws->mean = 0.0;
+    ws->m2 = 0.0;
+    ws->min = 0.0f;
+    ws->max = 0.0f;
+    p2_quantile_init(&ws->p50, 0.50f);
+    p2_quantile_init(&ws->p95, 0.95f);
+}
+
+void win_stats_add(win_stats_t *ws, float x)
+{
+    if (ws->count == 0 || x < ws->min)
+    {
+        ws->min = x;
+    }
+    if (ws->count == 0 || x > ws->max)
+    {
+        ws->max = x;
+    }
+
+    ws->count++;
+    double delta = (double)x - ws->mean;
+    ws->mean += delta / (double)ws->count;
+    ws->m2 += delta * ((double)x - ws->mean);
+
+    if (ws->count <= WIN_STATS_EXACT_MAX)
+    {
+        ws->exact[ws->count - 1] = x;
+        return;
+    }
+    if (ws->count == WIN_STATS_EXACT_MAX + 1)
+    {
+        /* Window outgrew the buffer: replay it into the sketches */
+        for (int i = 0; i < WIN_STATS_EXACT_MAX; i++)
+        {
+            p2_quantile_add(&ws->p50, ws->exact[i]);
+            p2_quantile_add(&ws->p95, ws->exact[i]);
+        }
+    }
+    p2_quantile_add(&ws->p50, x);
+    p2_quantile_add(&ws->p95, x);
+}
+
+void win_stats_summary(const win_stats_t *ws, win_stats_summary_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (ws->count == 0)
+    {
+        return;
+    }
+
+    out->count = ws->count;
+    out->mean = (float)ws->mean;
+    out->min = ws->min;
+    out->max = ws->max;
+    out->stddev = ws->count > 1 ? (float)sqrt(ws->m2 / (double)(ws->count - 1)) : 0.0f;
+
+    if (ws->count <= WIN_STATS_EXACT_MAX)
+    {
+        float sorted[WIN_STATS_EXACT_MAX];
+        memcpy(sorted, ws->exact, sizeof(float) * ws->count);
+        _sort(sorted, ws->count);
+        out->p50 = _exact_quantile(sorted, ws->count, 0.50f);
+        out->p95 = _exact_quantile(sorted, ws->count, 0.95f);
+    }
+    else
+    {
+        out->p50 = p2_quantile_get(&ws->p50);
+        out->p95 = p2_quantile_get(&ws->p95);
+    }
+}
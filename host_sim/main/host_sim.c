@@ -0,0 +1,606 @@
+// host_sim.c — days of sampling in seconds, on the ESP-IDF linux target
+//
+// Drives the same components the firmware uses (spsc_ring, win_stats,
+// report_filter, record_log, firestore_writer, gzip_stream, payload_codec)
+// on a simulated clock, with a fake AHT21 and a fake HTTPS link that has a
+// daily outage. Sampling, window close, logging and upload run in the same
+// order as main/uploader.c; the real CPU time of each stage is measured.
+//
+// Environment:
+//   SIM_DAYS            simulated days (default 7, soak 365)
+//   SIM_OUTAGE_S        length of the daily link outage in seconds (default 3600)
+//   SIM_LOG_DIR         record log directory, emptied first (default /tmp/host_sim_rlog)
+//   SIM_HTTP_FAIL_PPM   requests refused at random, per million (default 0, soak 20000)
+//   SIM_HTTP_CUT_PPM    requests cut off mid-body, per million (default 0, soak 10000)
+//   SIM_SENSOR_FAIL_PPM sensor reads that fail, per million (default 1000, soak 10000)
+//   SIM_SOAK            1 = soak run: the defaults above, and exit 1 if the
+//                       traced heap (sim_heap.c) grew between the end of
+//                       the first simulated day and the end of the run
+//   SIM_SOAK_SLACK      growth in bytes a soak run tolerates (default 0)
+//   SIM_MODE            run one stand-alone check instead of the pipeline
+//                       (sim_modes.h); the HTTP and slack variables above
+//                       apply to it too:
+//     upload_soak       SIM_UPLOADS (default 10000) commits and token
+//                       refreshes on the upload and credential arenas;
+//                       exit 1 on any heap call after warm-up
+//     sinks             SIM_SINK_RECORDS (default 3000) records fanned out
+//                       in real time to a fast, a slow and a failing sink;
+//                       exit 1 if the fast one is held back or any sink
+//                       loses records it did not count as dropped
+//     stats             win_stats on synthetic series against exact mean,
+//                       stddev and sorted p50/p95, plus ns per sample;
+//                       exit 1 past the error limits in sim_stats.c
+//     codec             json and cbor publishes encoded and decoded again,
+//                       and bytes and ns per record next to the Firestore
+//                       body and the cJSON tree it replaced; exit 1 if a
+//                       record does not come back or the bodies differ
+//     config            config_cache lookups next to a cfg.json read and
+//                       parse per key, ns and heap calls per lookup; exit
+//                       1 if a cached lookup allocates, a value differs or
+//                       an edit of the file is missed
+//     writer            Firestore commit bodies of 5 to 500 writes from a
+//                       cJSON tree, firestore_commit_serialize() and
+//                       firestore_commit_stream(): MB/s, heap calls and
+//                       peak heap; exit 1 if the bodies differ or the
+//                       writer allocates
+//     mqtt              mqtt_man telemetry, one record per publish up to
+//                       full batches, into a broker stand-in: wire bytes
+//                       and push ns per record; exit 1 if records are lost
+//                       uncounted, reordered or unacked, or the outbox
+//                       outgrows its bound while the broker stalls
+//     gzip              commit bodies of 5 to 500 writes gzipped and
+//                       inflated again: ratio, CPU time and modelled
+//                       upload time; exit 1 if a body does not come back
+//                       or one the firmware gzips uploads slower for it
+//
+// The last line is a single "RESULT key=value ..." line meant to be kept
+// per commit and compared.
+
+#include <dirent.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "esp_log.h"
+
+#include "sensor_record.h"
+#include "spsc_ring.h"
+#include "win_stats.h"
+#include "report_filter.h"
+#include "record_log.h"
+#include "firestore_writer.h"
+#include "gzip_stream.h"
+#include "payload_codec.h"
+
+#include "sim_sensor.h"
+#include "sim_http.h"
+#include "sim_heap.h"
+#include "breaker.h"
+#include "sim_modes.h"
+
+static const char *TAG = "HostSim";
+
+static const struct
+{
+    const char *name;
+    sim_mode_fn run;
+} s_modes[] = {
+    {"upload_soak", sim_upload_soak},
+    {"sinks", sim_sinks},
+    {"stats", sim_stats},
+    {"codec", sim_codec},
+    {"config", sim_config},
+    {"writer", sim_writer},
+    {"mqtt", sim_mqtt},
+    {"gzip", sim_gzip},
+};
+
+/* Same defaults as main/uploader.h and firebase.h */
+#define SIM_SAMPLE_MS 5000
+#define SIM_WINDOW_MS 60000
+#define SIM_BATCH_SIZE 5
+#define SIM_MAX_RECORDS 500            // UPLOAD_MAX_RECORDS
+#define SIM_MAX_BODY (192 * 1024)     // FIREBASE_MAX_BODY
+#define SIM_RING_LEN 256
+#define SIM_GZIP_MIN_BODY 4096
+#define SIM_EPOCH 1760000000 // wall clock at simulated t = 0
+#define SIM_PROJ_ID "host-sim-project"
+#define SIM_CHANNELS 2
+#define SIM_DAY_US (86400LL * 1000000)
+#define SIM_SOAK_DAYS 365 // ~6.3 M samples, ~1 M windows
+#define SIM_SOAK_HTTP_FAIL_PPM 20000
+#define SIM_SOAK_HTTP_CUT_PPM 10000
+#define SIM_SOAK_SENSOR_FAIL_PPM 10000
+#define SIM_DUMP_CALLERS 10
+/* Upload retry gate, as UPLOAD_* in main/uploader.h */
+#define SIM_BACKOFF_MIN_MS 2000
+#define SIM_BACKOFF_MAX_MS 300000
+#define SIM_BREAKER_THRESHOLD 5
+#define SIM_RETRY_BUDGET 10
+#define SIM_BUDGET_REFILL_MS 600000
+
+/* Mirrors sample_rec_t in main/uploader.h */
+typedef struct
+{
+    int64_t t_us;
+    float value;
+    uint8_t channel;
+} sim_sample_t;
+
+/* Wall-clock cost of one pipeline stage */
+typedef struct
+{
+    const char *name;
+    uint64_t n;
+    uint64_t total_ns;
+    uint64_t max_ns;
+} stage_t;
+
+static int64_t s_now_us; // the simulated clock
+static sim_sensor_t s_sensor;
+static sim_http_t s_http = {
+    .rtt_ms = 250,
+    .kbit_s = 2000,
+    .outage_start_s = 3 * 3600,
+    .timeout_ms = 5000, // CONN_TIMEOUT_MS in firebase_conn.c
+    .rng = 0x2545F4914F6CDD1DULL,
+};
+
+static breaker_t s_gate;
+
+static sim_sample_t s_ring_storage[SIM_RING_LEN];
+static spsc_ring_t s_ring;
+static win_stats_t s_windows[SIM_CHANNELS];
+static avg_sample_t s_upload_buffer[SIM_MAX_RECORDS];
+static gzip_stream_t s_gz;
+
+static uint8_t s_mqtt_payload[1024];
+static payload_enc_t s_mqtt_enc;
+
+static stage_t s_st_sensor = {"sensor"};
+static stage_t s_st_window = {"window"};
+static stage_t s_st_log = {"log"};
+static stage_t s_st_body = {"body"};
+
+static struct
+{
+    uint64_t samples;
+    uint64_t windows;
+    uint64_t records;
+    uint64_t uploads;
+    uint64_t failed_uploads; // refused or cut off; the records stay in the log
+    uint64_t body_bytes;
+    uint64_t wire_bytes;
+    uint64_t mqtt_payloads;
+    uint64_t mqtt_bytes;
+    uint32_t max_pending;
+    int64_t max_latency_us; // window close to upload, simulated
+    size_t heap_peak;
+} s_res;
+
+/* Traced heap per simulated day, for the soak verdict */
+static struct
+{
+    uint32_t day;
+    sim_heap_stats_t base; // end of day 1, once everything is warmed up
+    sim_heap_stats_t last;
+    size_t max_holes;
+} s_heap;
+
+uint64_t sim_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void _stage_add(stage_t *st, uint64_t start_ns)
+{
+    uint64_t ns = sim_now_ns() - start_ns;
+    st->n++;
+    st->total_ns += ns;
+    if (ns > st->max_ns)
+    {
+        st->max_ns = ns;
+    }
+}
+
+static void _sample_heap(void)
+{
+#ifdef __GLIBC__
+    struct mallinfo2 mi = mallinfo2();
+    if (mi.uordblks > s_res.heap_peak)
+    {
+        s_res.heap_peak = mi.uordblks;
+    }
+#endif
+}
+
+uint32_t sim_env_u32(const char *name, uint32_t fallback)
+{
+    const char *val = getenv(name);
+    return val ? (uint32_t)strtoul(val, NULL, 10) : fallback;
+}
+
+static void _clear_dir(const char *dir)
+{
+    DIR *dh = opendir(dir);
+    if (!dh)
+    {
+        return;
+    }
+    struct dirent *de;
+    char path[512];
+    while ((de = readdir(dh)) != NULL)
+    {
+        if (de->d_name[0] != '.')
+        {
+            snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+            unlink(path);
+        }
+    }
+    closedir(dh);
+}
+
+static esp_err_t _gzip_sink(void *ctx, const char *data, size_t len)
+{
+    return gzip_stream_write(ctx, data, len);
+}
+
+/* ---- upload, as drain_log() ---- */
+static void drain_log(void)
+{
+    while (record_log_pending() >= SIM_BATCH_SIZE)
+    {
+        if (!breaker_allow(&s_gate, s_now_us))
+        {
+            return; // backing off; the records wait in the log
+        }
+        bool probe = s_gate.state == BREAKER_HALF_OPEN;
+
+        size_t count = 0;
+        uint64_t t0 = sim_now_ns();
+        record_log_peek(s_upload_buffer, probe ? 1 : SIM_MAX_RECORDS, &count);
+        size_t fit = firestore_commit_fit(SIM_PROJ_ID, s_upload_buffer, count, SIM_MAX_BODY, NULL);
+        if (fit < count)
+        {
+            record_log_peek(s_upload_buffer, fit, &count);
+        }
+        _stage_add(&s_st_log, t0);
+        if (count == 0)
+        {
+            breaker_cancel(&s_gate); // a local read problem, not the link's
+            return;
+        }
+        if (sim_http_begin(&s_http, s_now_us) != ESP_OK)
+        {
+            s_now_us += sim_http_end(&s_http);
+            s_res.failed_uploads++;
+            breaker_failure(&s_gate, s_now_us);
+            return; // retried once the gate allows
+        }
+
+        t0 = sim_now_ns();
+        size_t body_len = firestore_commit_serialize(SIM_PROJ_ID, s_upload_buffer, count, NULL, 0);
+        esp_err_t err;
+        if (body_len >= SIM_GZIP_MIN_BODY)
+        {
+            err = gzip_stream_init(&s_gz, sim_http_sink, &s_http);
+            if (err == ESP_OK)
+            {
+                err = firestore_commit_stream(SIM_PROJ_ID, s_upload_buffer, count, _gzip_sink, &s_gz, NULL);
+            }
+            if (err == ESP_OK)
+            {
+                err = gzip_stream_finish(&s_gz);
+            }
+        }
+        else
+        {
+            err = firestore_commit_stream(SIM_PROJ_ID, s_upload_buffer, count, sim_http_sink, &s_http, NULL);
+        }
+        _stage_add(&s_st_body, t0);
+        s_res.wire_bytes += s_http.body_bytes;
+
+        // the upload blocks the uploader task for this long, failed or not
+        s_now_us += sim_http_end(&s_http);
+        if (err != ESP_OK)
+        {
+            s_res.failed_uploads++;
+            breaker_failure(&s_gate, s_now_us);
+            return; // retried once the gate allows
+        }
+        breaker_success(&s_gate, s_now_us);
+        s_res.body_bytes += body_len;
+
+        int64_t latency_us = (s_now_us / 1000000 + SIM_EPOCH - s_upload_buffer[0].timestamp) * 1000000;
+        if (latency_us > s_res.max_latency_us)
+        {
+            s_res.max_latency_us = latency_us;
+        }
+
+        t0 = sim_now_ns();
+        record_log_commit();
+        _stage_add(&s_st_log, t0);
+        s_res.uploads++;
+    }
+}
+
+/* ---- window close, as close_window() ---- */
+static void close_window(void)
+{
+    uint64_t t0 = sim_now_ns();
+    time_t now = SIM_EPOCH + s_now_us / 1000000;
+
+    for (uint16_t ch = 0; ch < SIM_CHANNELS; ch++)
+    {
+        if (s_windows[ch].count == 0)
+        {
+            continue;
+        }
+        win_stats_summary_t sum;
+        win_stats_summary(&s_windows[ch], &sum);
+        win_stats_reset(&s_windows[ch]);
+
+        avg_sample_t rec;
+        memset(&rec, 0, sizeof(rec));
+        rec.timestamp = now;
+        rec.average = sum.mean;
+        rec.channel = ch;
+        rec.samples = sum.count;
+        rec.min = sum.min;
+        rec.max = sum.max;
+        rec.stddev = sum.stddev;
+        rec.p50 = sum.p50;
+        rec.p95 = sum.p95;
+        s_res.windows++;
+
+        avg_sample_t out[2];
+        size_t n = report_filter_process(&rec, out);
+        for (size_t i = 0; i < n; i++)
+        {
+            uint64_t tl = sim_now_ns();
+            record_log_append(&out[i]);
+            _stage_add(&s_st_log, tl);
+            s_res.records++;
+
+            if (!payload_enc_add(&s_mqtt_enc, &out[i]))
+            {
+                s_res.mqtt_bytes += payload_enc_finish(&s_mqtt_enc);
+                s_res.mqtt_payloads++;
+                payload_enc_add(&s_mqtt_enc, &out[i]);
+            }
+        }
+    }
+    _stage_add(&s_st_window, t0);
+
+    if (record_log_pending() > s_res.max_pending)
+    {
+        s_res.max_pending = record_log_pending();
+    }
+    drain_log();
+    _sample_heap();
+}
+
+/* ---- end of a simulated day: heap trend ---- */
+static void _checkpoint(bool soak)
+{
+    sim_heap_stats_t hs;
+    sim_heap_get_stats(&hs);
+    s_heap.day++;
+    if (s_heap.day == 1)
+    {
+        s_heap.base = hs;
+    }
+    if (hs.holes > s_heap.max_holes)
+    {
+        s_heap.max_holes = hs.holes;
+    }
+    s_heap.last = hs;
+    if (soak)
+    {
+        printf("day %4" PRIu32 ": live %zu B in %" PRIu32 " blocks, holes %zu B, %" PRIu64
+               " allocs, log pending %" PRIu32 "\n",
+               s_heap.day, hs.live_bytes, hs.live_blocks, hs.holes, hs.allocs,
+               record_log_pending());
+    }
+}
+
+/* ---- soak verdict: any traced growth after day 1 is a leak ---- */
+static bool _soak_verdict(uint32_t slack)
+{
+    const sim_heap_stats_t *b = &s_heap.base;
+    const sim_heap_stats_t *l = &s_heap.last;
+    long long growth = (long long)l->live_bytes - (long long)b->live_bytes;
+    printf("Heap after day 1: live %zu -> %zu B (%+lld), blocks %" PRIu32 " -> %" PRIu32
+           ", holes %zu -> %zu B (max %zu), peak %zu B\n",
+           b->live_bytes, l->live_bytes, growth, b->live_blocks, l->live_blocks,
+           b->holes, l->holes, s_heap.max_holes, l->peak_bytes);
+    if (l->untracked)
+    {
+        printf("warning: %" PRIu32 " allocations were not traced (table full)\n", l->untracked);
+    }
+    if (growth > (long long)slack)
+    {
+        printf("SOAK FAIL: heap grew by %lld B over %" PRIu32 " days; live blocks by caller:\n",
+               growth, s_heap.day - 1);
+        sim_heap_dump(SIM_DUMP_CALLERS);
+        return false;
+    }
+    printf("SOAK PASS\n");
+    return true;
+}
+
+static void _print_stage(const stage_t *st)
+{
+    printf("  %-7s n=%-9" PRIu64 " avg=%8.0f ns  max=%8" PRIu64 " ns\n", st->name, st->n,
+           st->n ? (double)st->total_ns / st->n : 0.0, st->max_ns);
+}
+
+static void _run_mode(const char *name)
+{
+    for (size_t i = 0; i < sizeof(s_modes) / sizeof(s_modes[0]); i++)
+    {
+        if (strcmp(s_modes[i].name, name) == 0)
+        {
+            bool pass = s_modes[i].run();
+            fflush(stdout);
+            exit(pass ? 0 : 1);
+        }
+    }
+    ESP_LOGE(TAG, "Unknown SIM_MODE %s", name);
+    exit(2);
+}
+
+void app_main(void)
+{
+    // everything project code allocates from here on is traced
+    sim_heap_start();
+
+    const char *mode = getenv("SIM_MODE");
+    if (mode && strcmp(mode, "pipeline") != 0)
+    {
+        _run_mode(mode);
+    }
+
+    bool soak = sim_env_u32("SIM_SOAK", 0) != 0;
+    uint32_t days = sim_env_u32("SIM_DAYS", soak ? SIM_SOAK_DAYS : 7);
+    s_http.outage_len_s = sim_env_u32("SIM_OUTAGE_S", 3600);
+    s_http.fail_ppm = sim_env_u32("SIM_HTTP_FAIL_PPM", soak ? SIM_SOAK_HTTP_FAIL_PPM : 0);
+    s_http.cut_ppm = sim_env_u32("SIM_HTTP_CUT_PPM", soak ? SIM_SOAK_HTTP_CUT_PPM : 0);
+    uint32_t sensor_fail_ppm = sim_env_u32("SIM_SENSOR_FAIL_PPM", soak ? SIM_SOAK_SENSOR_FAIL_PPM : 1000);
+    uint32_t slack = sim_env_u32("SIM_SOAK_SLACK", 0);
+    const char *log_dir = getenv("SIM_LOG_DIR") ? getenv("SIM_LOG_DIR") : "/tmp/host_sim_rlog";
+
+    _clear_dir(log_dir);
+    if (record_log_init(log_dir, sizeof(avg_sample_t)) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Cannot open record log in %s", log_dir);
+        exit(1);
+    }
+    spsc_ring_init(&s_ring, s_ring_storage, sizeof(sim_sample_t), SIM_RING_LEN);
+    const breaker_cfg_t gate = {
+        .base_ms = SIM_BACKOFF_MIN_MS,
+        .max_ms = SIM_BACKOFF_MAX_MS,
+        .threshold = SIM_BREAKER_THRESHOLD,
+        .budget = SIM_RETRY_BUDGET,
+        .refill_ms = SIM_BUDGET_REFILL_MS,
+    };
+    breaker_init(&s_gate, &gate, 1, s_now_us);
+    for (int ch = 0; ch < SIM_CHANNELS; ch++)
+    {
+        win_stats_reset(&s_windows[ch]);
+    }
+    sim_sensor_init(&s_sensor, &s_now_us, 1);
+    s_sensor.fail_rate = sensor_fail_ppm / 1e6f;
+
+    // firmware defaults from main/esp-sensorControl.c
+    const report_filter_cfg_t temp_filter = {REPORT_FILTER_SWINGING_DOOR, 0.2f, 900};
+    const report_filter_cfg_t rh_filter = {REPORT_FILTER_SWINGING_DOOR, 0.5f, 900};
+    report_filter_configure(0, &temp_filter);
+    report_filter_configure(1, &rh_filter);
+    payload_enc_init(&s_mqtt_enc, &payload_codec_cbor, s_mqtt_payload, sizeof(s_mqtt_payload));
+
+    printf("Simulating %" PRIu32 " days, %d ms samples, %d ms windows, %" PRIu32 " s daily outage\n",
+           days, SIM_SAMPLE_MS, SIM_WINDOW_MS, s_http.outage_len_s);
+    if (soak)
+    {
+        printf("Soak: %" PRIu32 " ppm refused, %" PRIu32 " ppm cut requests, %" PRIu32
+               " ppm failed reads, slack %" PRIu32 " B\n",
+               s_http.fail_ppm, s_http.cut_ppm, sensor_fail_ppm, slack);
+    }
+
+    uint64_t wall_start = sim_now_ns();
+    int64_t end_us = (int64_t)days * 86400 * 1000000;
+    int64_t next_sample_us = 0;
+    int64_t window_end_us = (int64_t)SIM_WINDOW_MS * 1000;
+    int64_t day_end_us = SIM_DAY_US;
+
+    while (next_sample_us < end_us)
+    {
+        // an upload may have pushed the clock past several sample times
+        if (s_now_us < next_sample_us)
+        {
+            s_now_us = next_sample_us;
+        }
+
+        float values[2];
+        uint64_t t0 = sim_now_ns();
+        esp_err_t err = sim_sensor_read(&s_sensor, values, 2);
+        _stage_add(&s_st_sensor, t0);
+        if (err == ESP_OK)
+        {
+            const sim_sample_t temp = {.t_us = s_now_us, .value = values[0] * 9.0f / 5.0f + 32.0f, .channel = 0};
+            const sim_sample_t rh = {.t_us = s_now_us, .value = values[1], .channel = 1};
+            spsc_ring_push(&s_ring, &temp);
+            spsc_ring_push(&s_ring, &rh);
+        }
+
+        sim_sample_t rec;
+        while (spsc_ring_pop(&s_ring, &rec))
+        {
+            while (rec.t_us >= window_end_us)
+            {
+                close_window();
+                window_end_us += (int64_t)SIM_WINDOW_MS * 1000;
+            }
+            win_stats_add(&s_windows[rec.channel], rec.value);
+            s_res.samples++;
+        }
+        next_sample_us += (int64_t)SIM_SAMPLE_MS * 1000;
+
+        while (next_sample_us >= day_end_us)
+        {
+            _checkpoint(soak);
+            day_end_us += SIM_DAY_US;
+        }
+    }
+    double wall_s = (sim_now_ns() - wall_start) / 1e9;
+    if (s_mqtt_enc.count)
+    {
+        s_res.mqtt_bytes += payload_enc_finish(&s_mqtt_enc);
+        s_res.mqtt_payloads++;
+    }
+
+    report_filter_stats_t fs;
+    report_filter_get_stats(REPORT_FILTER_ALL_CHANNELS, &fs);
+    record_log_stats_t ls;
+    record_log_get_stats(&ls);
+
+    printf("Stages (host CPU time):\n");
+    _print_stage(&s_st_sensor);
+    _print_stage(&s_st_window);
+    _print_stage(&s_st_log);
+    _print_stage(&s_st_body);
+    printf("Link: %" PRIu32 " requests, %" PRIu32 " failed (%" PRIu32 " cut mid-body), %.1f s busy\n",
+           s_http.requests, s_http.failures, s_http.cuts, s_http.busy_us / 1e6);
+    breaker_stats_t gs;
+    breaker_get_stats(&s_gate, s_now_us, &gs);
+    printf("Gate: %" PRIu32 " attempts, %" PRIu32 " failed, opened %" PRIu32 " times, %" PRIu32
+           " attempts skipped while backing off\n",
+           gs.attempts, gs.failures, gs.opens, gs.rejected);
+    bool pass = !soak || _soak_verdict(slack);
+    printf("RESULT days=%" PRIu32 " wall_s=%.2f samples=%" PRIu64 " windows=%" PRIu64
+           " records=%" PRIu64 " suppressed=%" PRIu32 " uploads=%" PRIu64
+           " body_bytes=%" PRIu64 " wire_bytes=%" PRIu64 " mqtt_bytes=%" PRIu64
+           " pending=%" PRIu32 " max_pending=%" PRIu32 " max_latency_s=%lld"
+           " sensor_ns=%.0f window_ns=%.0f body_ns=%.0f heap_peak=%zu"
+           " failed_uploads=%" PRIu64 " heap_live=%zu heap_holes=%zu gate_opens=%" PRIu32
+           " gate_skipped=%" PRIu32 "\n",
+           days, wall_s, s_res.samples, s_res.windows, s_res.records, fs.suppressed,
+           s_res.uploads, s_res.body_bytes, s_res.wire_bytes, s_res.mqtt_bytes,
+           ls.pending, s_res.max_pending, (long long)(s_res.max_latency_us / 1000000),
+           s_st_sensor.n ? (double)s_st_sensor.total_ns / s_st_sensor.n : 0.0,
+           s_st_window.n ? (double)s_st_window.total_ns / s_st_window.n : 0.0,
+           s_st_body.n ? (double)s_st_body.total_ns / s_st_body.n : 0.0,
+           s_res.heap_peak, s_res.failed_uploads, s_heap.last.live_bytes, s_heap.last.holes,
+           gs.opens, gs.rejected);
+    fflush(stdout);
+    exit(pass ? 0 : 1);
+}
@@ -0,0 +1,349 @@
+// sim_codec.c — payload codec round trip and size/speed against cJSON
+//
+// Window records like the ones the report filter lets through (two
+// channels, irregular gaps), plus edge cases (below zero, a large gap, the
+// highest channel, empty and full sample counts), are encoded in MQTT
+// publishes of MQTT_TELEMETRY_BATCH records and decoded again:
+//   cbor  with payload_cbor_decode()
+//   json  with cJSON_Parse(), as any consumer would
+// Every field must come back within the rounding of its format.
+//
+// Sizes and encode times are compared per record with the Firestore commit
+// body: firestore_commit_serialize(), and the cJSON tree it replaced, built
+// and printed the way the firmware used to. The two bodies must be
+// byte-identical.
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cJSON.h"
+#include "payload_codec.h"
+#include "firestore_writer.h"
+#include "sim_modes.h"
+
+#define CODEC_RECORDS 10000
+#define CODEC_BATCH 16           // MQTT_TELEMETRY_BATCH
+#define CODEC_PAYLOAD_MAX 1024   // MQTT_TELEMETRY_PAYLOAD_MAX
+#define CODEC_COMMIT_BATCH 5     // default batch_size of the uploader
+#define CODEC_REPEAT 20          // timing passes over the records
+#define CODEC_PROJ_ID "host-sim-project"
+#define CODEC_BODY_MAX (CODEC_COMMIT_BATCH * 1024)
+
+typedef struct
+{
+    const char *name;
+    uint64_t bytes;
+    uint64_t records;
+    uint64_t encode_ns;
+    uint64_t decode_ns;
+    double decode_ns_rec; // from the checked pass
+    double max_err;
+} codec_res_t;
+
+static avg_sample_t s_recs[CODEC_RECORDS];
+static avg_sample_t s_decoded[CODEC_BATCH];
+static uint8_t s_payload[CODEC_PAYLOAD_MAX + 1]; // + NUL for the JSON parser
+static char s_body[CODEC_BODY_MAX];
+
+static void _make_records(void)
+{
+    uint64_t rng = 0x2545F4914F6CDD1DULL;
+    time_t t = 1760000000;
+    for (size_t i = 0; i < CODEC_RECORDS; i++)
+    {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        uint16_t ch = i % 2;
+        if (ch == 0)
+        {
+            t += 60 * (1 + rng % 15); // heartbeat at 15 min
+        }
+        float avg = ch ? 45.0f + (float)(rng % 2000) / 100.0f : 68.0f + (float)(rng % 800) / 100.0f;
+        float sd = (float)(rng % 300) / 1000.0f;
+        s_recs[i] = (avg_sample_t){
+            .timestamp = t,
+            .average = avg,
+            .channel = ch,
+            .samples = 12,
+            .min = avg - 2 * sd,
+            .max = avg + 2.5f * sd,
+            .stddev = sd,
+            .p50 = avg - 0.1f * sd,
+            .p95 = avg + 1.7f * sd,
+        };
+    }
+    // edge cases the formats must survive
+    s_recs[1].channel = SENSOR_MAX_CHANNELS - 1;
+    s_recs[2] = (avg_sample_t){
+        .timestamp = s_recs[2].timestamp,
+        .average = -40.25f,
+        .min = -40.5f,
+        .max = -39.75f,
+        .p50 = -40.25f,
+        .p95 = -39.8f,
+    };
+    s_recs[3].samples = UINT16_MAX;
+    for (size_t i = 4; i < CODEC_RECORDS; i++)
+    {
+        s_recs[i].timestamp += 30 * 86400; // a month offline
+    }
+}
+
+/* Largest field error of a decoded record, or -1 if an integer field differs */
+static double _field_err(const avg_sample_t *a, const avg_sample_t *b)
+{
+    if (a->timestamp != b->timestamp || a->channel != b->channel || a->samples != b->samples)
+    {
+        return -1;
+    }
+    const float fa[] = {a->average, a->min, a->max, a->stddev, a->p50, a->p95};
+    const float fb[] = {b->average, b->min, b->max, b->stddev, b->p50, b->p95};
+    double err = 0;
+    for (size_t i = 0; i < sizeof(fa) / sizeof(fa[0]); i++)
+    {
+        err = fmax(err, fabs((double)fa[i] - fb[i]));
+    }
+    return err;
+}
+
+/* payload_codec_json rows back into records */
+static size_t _json_decode(const char *json, avg_sample_t *out, size_t max)
+{
+    cJSON *root = cJSON_Parse(json);
+    cJSON *t0 = cJSON_GetObjectItem(root, "t");
+    cJSON *rows = cJSON_GetObjectItem(root, "r");
+    size_t n = 0;
+    cJSON *row;
+    if (cJSON_IsNumber(t0) && cJSON_IsArray(rows))
+    {
+        cJSON_ArrayForEach(row, rows)
+        {
+            double f[9];
+            if (n == max || cJSON_GetArraySize(row) != 9)
+            {
+                n = 0;
+                break;
+            }
+            for (int i = 0; i < 9; i++)
+            {
+                f[i] = cJSON_GetArrayItem(row, i)->valuedouble;
+            }
+            out[n++] = (avg_sample_t){
+                .timestamp = (time_t)t0->valuedouble + (time_t)f[0],
+                .channel = (uint16_t)f[1],
+                .average = (float)f[2],
+                .min = (float)f[3],
+                .max = (float)f[4],
+                .stddev = (float)f[5],
+                .p50 = (float)f[6],
+                .p95 = (float)f[7],
+                .samples = (uint16_t)f[8],
+            };
+        }
+    }
+    cJSON_Delete(root);
+    return n;
+}
+
+/* Encodes every record in publishes of up to CODEC_BATCH; with `check`,
+ * decodes each publish and compares. Returns false on a mismatch. */
+static bool _run_codec(const payload_codec_t *codec, codec_res_t *res, bool check)
+{
+    payload_enc_t enc;
+    payload_enc_init(&enc, codec, s_payload, CODEC_PAYLOAD_MAX);
+    size_t i = 0;
+    while (i < CODEC_RECORDS)
+    {
+        size_t first = i;
+        uint64_t t0 = sim_now_ns();
+        while (i < CODEC_RECORDS && enc.count < CODEC_BATCH && payload_enc_add(&enc, &s_recs[i]))
+        {
+            i++;
+        }
+        size_t count = enc.count;
+        size_t len = payload_enc_finish(&enc);
+        res->encode_ns += sim_now_ns() - t0;
+        if (count == 0)
+        {
+            printf("CODEC FAIL: record %zu does not fit an empty %s publish\n", i, codec->name);
+            return false;
+        }
+        res->bytes += len;
+        res->records += count;
+        if (!check)
+        {
+            continue;
+        }
+
+        size_t got = 0;
+        t0 = sim_now_ns();
+        if (codec == &payload_codec_cbor)
+        {
+            if (payload_cbor_decode(s_payload, len, s_decoded, CODEC_BATCH, &got) != ESP_OK)
+            {
+                got = 0;
+            }
+        }
+        else
+        {
+            s_payload[len] = '\0';
+            got = _json_decode((const char *)s_payload, s_decoded, CODEC_BATCH);
+        }
+        res->decode_ns += sim_now_ns() - t0;
+        if (got != count)
+        {
+            printf("CODEC FAIL: %s publish at record %zu decoded to %zu of %zu records\n",
+                   codec->name, first, got, count);
+            return false;
+        }
+        for (size_t k = 0; k < count; k++)
+        {
+            double err = _field_err(&s_recs[first + k], &s_decoded[k]);
+            if (err < 0)
+            {
+                printf("CODEC FAIL: %s record %zu: timestamp, channel or samples changed\n",
+                       codec->name, first + k);
+                return false;
+            }
+            res->max_err = fmax(res->max_err, err);
+        }
+    }
+    return true;
+}
+
+char *sim_cjson_commit_body(const char *proj_id, const avg_sample_t *recs, size_t count)
+{
+    cJSON *root = cJSON_CreateObject();
+    cJSON *writes = cJSON_AddArrayToObject(root, "writes");
+    for (size_t i = 0; i < count; i++)
+    {
+        const avg_sample_t *s = &recs[i];
+        char name[160], ts[24], ch[8], num[32];
+        snprintf(ts, sizeof(ts), "%lld", (long long)s->timestamp);
+        snprintf(ch, sizeof(ch), "%u", (unsigned)s->channel);
+        snprintf(name, sizeof(name), "projects/%s/databases/(default)/documents/sensor_data/%s%s%s",
+                 proj_id, ts, s->channel ? "-" : "", s->channel ? ch : "");
+
+        cJSON *write = cJSON_CreateObject();
+        cJSON *update = cJSON_AddObjectToObject(write, "update");
+        cJSON_AddStringToObject(update, "name", name);
+        cJSON *fields = cJSON_AddObjectToObject(update, "fields");
+        cJSON_AddStringToObject(cJSON_AddObjectToObject(fields, "timestamp"), "integerValue", ts);
+        if (s->channel)
+        {
+            cJSON_AddStringToObject(cJSON_AddObjectToObject(fields, "channel"), "integerValue", ch);
+        }
+        const char *names[] = {"value", "min", "max", "stddev", "p50", "p95"};
+        const float vals[] = {s->average, s->min, s->max, s->stddev, s->p50, s->p95};
+        for (size_t f = 0; f < sizeof(vals) / sizeof(vals[0]); f++)
+        {
+            snprintf(num, sizeof(num), "%.2f", vals[f]);
+            cJSON_AddStringToObject(cJSON_AddObjectToObject(fields, names[f]), "doubleValue", num);
+        }
+        cJSON_AddItemToArray(writes, write);
+    }
+    char *body = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return body;
+}
+
+static bool _run_commit(codec_res_t *writer, codec_res_t *cjson, bool check)
+{
+    for (size_t i = 0; i + CODEC_COMMIT_BATCH <= CODEC_RECORDS; i += CODEC_COMMIT_BATCH)
+    {
+        uint64_t t0 = sim_now_ns();
+        size_t len = firestore_commit_serialize(CODEC_PROJ_ID, &s_recs[i], CODEC_COMMIT_BATCH,
+                                                s_body, sizeof(s_body));
+        writer->encode_ns += sim_now_ns() - t0;
+        writer->bytes += len;
+        writer->records += CODEC_COMMIT_BATCH;
+
+        t0 = sim_now_ns();
+        char *body = sim_cjson_commit_body(CODEC_PROJ_ID, &s_recs[i], CODEC_COMMIT_BATCH);
+        cjson->encode_ns += sim_now_ns() - t0;
+        size_t cjson_len = body ? strlen(body) : 0;
+        cjson->bytes += cjson_len;
+        cjson->records += CODEC_COMMIT_BATCH;
+        bool same = body && len < sizeof(s_body) && cjson_len == len && memcmp(body, s_body, len) == 0;
+        cJSON_free(body);
+        if (check && !same)
+        {
+            printf("CODEC FAIL: commit body at record %zu differs from the cJSON one\n", i);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void _print(const codec_res_t *r)
+{
+    printf("  %-9s %9.1f %13.0f", r->name, (double)r->bytes / r->records,
+           (double)r->encode_ns / r->records);
+    if (r->decode_ns_rec)
+    {
+        printf(" %13.0f %11.4f\n", r->decode_ns_rec, r->max_err);
+    }
+    else
+    {
+        printf(" %13s %11s\n", "-", "-");
+    }
+}
+
+bool sim_codec(void)
+{
+    _make_records();
+    codec_res_t cjson = {"cjson"}, writer = {"firestore"}, json = {"json"}, cbor = {"cbor"};
+
+    // one checked pass for the decode figures and errors, then encode timing
+    bool pass = _run_codec(&payload_codec_json, &json, true) &&
+                _run_codec(&payload_codec_cbor, &cbor, true) && _run_commit(&writer, &cjson, true);
+    codec_res_t *all[] = {&cjson, &writer, &json, &cbor};
+    for (size_t k = 0; pass && k < sizeof(all) / sizeof(all[0]); k++)
+    {
+        all[k]->decode_ns_rec = all[k]->decode_ns ? (double)all[k]->decode_ns / all[k]->records : 0;
+        all[k]->bytes = all[k]->records = all[k]->encode_ns = 0;
+    }
+    for (int rep = 0; pass && rep < CODEC_REPEAT; rep++)
+    {
+        _run_codec(&payload_codec_json, &json, false);
+        _run_codec(&payload_codec_cbor, &cbor, false);
+        _run_commit(&writer, &cjson, false);
+    }
+
+    // json rows carry 2 decimals (stddev 3), cbor hundredths; float rounding on top
+    double json_tol = 0.005 + 1e-4;
+    double cbor_tol = 0.5 / PAYLOAD_CBOR_SCALE + 1e-4;
+    if (pass && (json.max_err > json_tol || cbor.max_err > cbor_tol))
+    {
+        printf("CODEC FAIL: round trip off by %.4f (json) / %.4f (cbor)\n", json.max_err, cbor.max_err);
+        pass = false;
+    }
+    if (pass)
+    {
+        printf("  format    bytes/rec  encode ns/rec  decode ns/rec  max error\n");
+        _print(&cjson);
+        _print(&writer);
+        _print(&json);
+        _print(&cbor);
+    }
+    printf("%s: %d records, publishes of %d, commits of %d\n", pass ? "CODEC PASS" : "CODEC FAIL",
+           CODEC_RECORDS, CODEC_BATCH, CODEC_COMMIT_BATCH);
+    printf("RESULT mode=codec records=%d cjson_bytes=%.1f cjson_ns=%.0f firestore_bytes=%.1f"
+           " firestore_ns=%.0f json_bytes=%.1f json_ns=%.0f json_decode_ns=%.0f cbor_bytes=%.1f"
+           " cbor_ns=%.0f cbor_decode_ns=%.0f json_max_err=%.4f cbor_max_err=%.4f\n",
+           CODEC_RECORDS, cjson.records ? (double)cjson.bytes / cjson.records : 0.0,
+           cjson.records ? (double)cjson.encode_ns / cjson.records : 0.0,
+           writer.records ? (double)writer.bytes / writer.records : 0.0,
+           writer.records ? (double)writer.encode_ns / writer.records : 0.0,
+           json.records ? (double)json.bytes / json.records : 0.0,
+           json.records ? (double)json.encode_ns / json.records : 0.0,
+           json.decode_ns_rec,
+           cbor.records ? (double)cbor.bytes / cbor.records : 0.0,
+           cbor.records ? (double)cbor.encode_ns / cbor.records : 0.0,
+           cbor.decode_ns_rec, json.max_err, cbor.max_err);
+    return pass;
+}
@@ -0,0 +1,262 @@
+// sim_config.c — config_cache against per-key cfg.json reads
+//
+// A cfg.json shaped like the device's (project, service account, two PEM
+// certificates, MQTT and uploader settings) is written to a temp file and
+// read both ways:
+//   file   load_config_from_fat() as usb_helper.c has it: open, read,
+//          cJSON_Parse and strdup for every key (copied here, usb_helper.c
+//          needs esp_tinyusb)
+//   cache  the real config_cache.c: one parse, then lookups from RAM and a
+//          stat() per config_cache_refresh()
+// One round is the keys an upload and an MQTT connect look up. Time and
+// traced heap calls (sim_heap.c) are reported per lookup.
+//
+// The run fails if a cached value differs from the file path, a cached
+// lookup touches the heap, a changed file is not picked up on refresh, or
+// the cache reloads while the USB host owns the volume.
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cJSON.h"
+#include "config_cache.h"
+#include "tusb_msc_storage.h"
+#include "sim_heap.h"
+#include "sim_modes.h"
+
+#define CONFIG_PATH "/tmp/host_sim_cfg.json"
+#define CONFIG_ROUNDS 2000
+#define CONFIG_PEM_LINES 28 // a 2048-bit RSA certificate
+
+static bool s_usb_host;
+
+/* What an upload and an MQTT connect look up (firebase.c, esp-sensorControl.c) */
+static const char *const s_keys[] = {
+    "proj_id", "svc_acct_email", "G_ROOT_CA_CERT", "proj_id", "G_ROOT_CA_CERT", "firebase_system_key",
+    "mqtt_url", "mqtt_username", "mqtt_password", "mqtt_v_cert",
+};
+#define CONFIG_KEYS (sizeof(s_keys) / sizeof(s_keys[0]))
+
+bool tinyusb_msc_storage_in_use_by_usb_host(void)
+{
+    return s_usb_host;
+}
+
+static void _pem(FILE *f, const char *key, char fill)
+{
+    fprintf(f, "  \"%s\": \"-----BEGIN CERTIFICATE-----\\n", key);
+    for (int i = 0; i < CONFIG_PEM_LINES; i++)
+    {
+        for (int k = 0; k < 64; k++)
+        {
+            fputc(k % 7 ? fill : 'A' + (i + k) % 26, f);
+        }
+        fputs("\\n", f);
+    }
+    fprintf(f, "-----END CERTIFICATE-----\\n\",\n");
+}
+
+static bool _write_cfg(const char *proj_id)
+{
+    FILE *f = fopen(CONFIG_PATH, "w");
+    if (!f)
+    {
+        return false;
+    }
+    fprintf(f, "{\n  \"proj_id\": \"%s\",\n", proj_id);
+    fprintf(f, "  \"svc_acct_email\": \"sensor-uploader@%s.iam.gserviceaccount.com\",\n", proj_id);
+    fprintf(f, "  \"firebase_system_key\": \"AIzaSyD4-host-sim-0123456789abcdefghij\",\n");
+    _pem(f, "G_ROOT_CA_CERT", 'g');
+    _pem(f, "mqtt_v_cert", 'm');
+    fprintf(f, "  \"mqtt_url\": \"mqtts://broker.local:8883\",\n"
+               "  \"mqtt_username\": \"sensor-01\",\n"
+               "  \"mqtt_password\": \"s3cret-host-sim\",\n"
+               "  \"mqtt_telemetry_topic\": \"sensors/01/telemetry\",\n"
+               "  \"mqtt_telemetry_codec\": \"cbor\",\n"
+               "  \"mqtt_telemetry_qos\": 1,\n"
+               "  \"firestore_gzip_min\": 4096,\n"
+               "  \"firestore_max_body\": 16384,\n"
+               "  \"report_mode\": \"deadband\"\n}\n");
+    return fclose(f) == 0;
+}
+
+/* usb_helper.c's read_file() and load_config_from_fat(), without the logging */
+static char *_load_config_from_fat(const char *path, const char *item_key)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+    {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *json = malloc(len + 1);
+    if (!json)
+    {
+        fclose(f);
+        return NULL;
+    }
+    size_t read = fread(json, 1, len, f);
+    json[read] = '\0';
+    fclose(f);
+
+    cJSON *root = cJSON_Parse(json);
+    free(json);
+    if (!root)
+    {
+        return NULL;
+    }
+    cJSON *config_item = cJSON_GetObjectItemCaseSensitive(root, item_key);
+    char *result = NULL;
+    if (cJSON_IsString(config_item) && config_item->valuestring)
+    {
+        result = strdup(config_item->valuestring);
+    }
+    else if (cJSON_IsNumber(config_item))
+    {
+        char buf[32];
+        if ((double)config_item->valueint == config_item->valuedouble)
+        {
+            snprintf(buf, sizeof(buf), "%d", config_item->valueint);
+        }
+        else
+        {
+            snprintf(buf, sizeof(buf), "%f", config_item->valuedouble);
+        }
+        result = strdup(buf);
+    }
+    cJSON_Delete(root);
+    return result;
+}
+
+static bool _cached_is(const char *key, const char *want)
+{
+    const char *val = config_cache_get(key);
+    return val && strcmp(val, want) == 0;
+}
+
+bool sim_config(void)
+{
+    if (!_write_cfg("host-sim-project"))
+    {
+        printf("CONFIG FAIL: cannot write %s\n", CONFIG_PATH);
+        return false;
+    }
+    bool pass = true;
+    sim_heap_stats_t h0, h1;
+
+    // file path: every lookup reads and parses the whole file
+    sim_heap_start();
+    sim_heap_get_stats(&h0);
+    uint64_t t0 = sim_now_ns();
+    for (int r = 0; r < CONFIG_ROUNDS; r++)
+    {
+        for (size_t k = 0; k < CONFIG_KEYS; k++)
+        {
+            free(_load_config_from_fat(CONFIG_PATH, s_keys[k]));
+        }
+    }
+    double file_ns = (double)(sim_now_ns() - t0) / (CONFIG_ROUNDS * CONFIG_KEYS);
+    sim_heap_get_stats(&h1);
+    double file_allocs = (double)(h1.allocs - h0.allocs) / (CONFIG_ROUNDS * CONFIG_KEYS);
+    size_t file_peak = h1.peak_bytes;
+
+    // cache: one parse, a refresh per round as upload_batch() does
+    sim_heap_start();
+    t0 = sim_now_ns();
+    if (config_cache_init(CONFIG_PATH) != ESP_OK)
+    {
+        printf("CONFIG FAIL: config_cache_init(%s) failed\n", CONFIG_PATH);
+        return false;
+    }
+    double load_ns = (double)(sim_now_ns() - t0);
+    sim_heap_get_stats(&h0);
+    size_t cache_bytes = h0.live_bytes;
+    size_t cache_peak = h0.peak_bytes;
+
+    for (size_t k = 0; k < CONFIG_KEYS; k++)
+    {
+        char *want = _load_config_from_fat(CONFIG_PATH, s_keys[k]);
+        if (!want || !_cached_is(s_keys[k], want))
+        {
+            printf("CONFIG FAIL: cached %s differs from the file\n", s_keys[k]);
+            pass = false;
+        }
+        free(want);
+    }
+    char *num = _load_config_from_fat(CONFIG_PATH, "mqtt_telemetry_qos");
+    if (!num || !_cached_is("mqtt_telemetry_qos", num))
+    {
+        printf("CONFIG FAIL: cached mqtt_telemetry_qos differs from the file\n");
+        pass = false;
+    }
+    free(num);
+
+    sim_heap_get_stats(&h0);
+    uint64_t refresh_total = 0;
+    volatile size_t sink = 0;
+    t0 = sim_now_ns();
+    for (int r = 0; r < CONFIG_ROUNDS; r++)
+    {
+        uint64_t tr = sim_now_ns();
+        config_cache_refresh();
+        refresh_total += sim_now_ns() - tr;
+        for (size_t k = 0; k < CONFIG_KEYS; k++)
+        {
+            sink += strlen(config_cache_get(s_keys[k]));
+        }
+    }
+    uint64_t cache_total = sim_now_ns() - t0 - refresh_total;
+    sim_heap_get_stats(&h1);
+    double cache_ns = (double)cache_total / (CONFIG_ROUNDS * CONFIG_KEYS);
+    double refresh_ns = (double)refresh_total / CONFIG_ROUNDS;
+    uint64_t cache_allocs = h1.allocs - h0.allocs;
+    if (cache_allocs)
+    {
+        printf("CONFIG FAIL: %" PRIu64 " heap calls in %d rounds of cached lookups\n", cache_allocs,
+               CONFIG_ROUNDS);
+        pass = false;
+    }
+
+    // an edit is picked up by size (mtime only has whole seconds here)
+    uint32_t gen = config_cache_generation();
+    _write_cfg("host-sim-project-2");
+    config_cache_refresh();
+    if (config_cache_generation() != gen + 1 || !_cached_is("proj_id", "host-sim-project-2"))
+    {
+        printf("CONFIG FAIL: an edited cfg.json was not reloaded\n");
+        pass = false;
+    }
+
+    // while the USB host owns the volume the last table is kept, and the
+    // remount invalidates it (usb_helper.c storage_mount_changed_cb)
+    s_usb_host = true;
+    _write_cfg("host-sim-project-3");
+    config_cache_refresh();
+    bool held = _cached_is("proj_id", "host-sim-project-2");
+    s_usb_host = false;
+    config_cache_invalidate();
+    config_cache_refresh();
+    if (!held || !_cached_is("proj_id", "host-sim-project-3"))
+    {
+        printf("CONFIG FAIL: cfg.json %s while the USB host had the volume\n",
+               held ? "was not reloaded after it came back" : "was reloaded");
+        pass = false;
+    }
+    remove(CONFIG_PATH);
+
+    printf("  path    ns/lookup  heap calls/lookup  peak heap\n");
+    printf("  file    %9.0f  %17.1f  %9zu\n", file_ns, file_allocs, file_peak);
+    printf("  cache   %9.0f  %17.1f  %9zu  (+%.0f ns refresh per round, %.0f ns first load)\n",
+           cache_ns, (double)cache_allocs / (CONFIG_ROUNDS * CONFIG_KEYS), cache_peak, refresh_ns, load_ns);
+    printf("%s: %d rounds of %zu lookups, cache holds %zu bytes\n", pass ? "CONFIG PASS" : "CONFIG FAIL",
+           CONFIG_ROUNDS, CONFIG_KEYS, cache_bytes);
+    printf("RESULT mode=config lookups=%zu file_ns=%.0f file_allocs=%.1f file_peak=%zu cache_ns=%.0f"
+           " cache_allocs=%" PRIu64 " cache_peak=%zu cache_bytes=%zu refresh_ns=%.0f load_ns=%.0f\n",
+           CONFIG_ROUNDS * CONFIG_KEYS, file_ns, file_allocs, file_peak, cache_ns, cache_allocs, cache_peak,
+           cache_bytes, refresh_ns, load_ns);
+    return pass;
+}
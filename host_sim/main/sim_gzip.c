@@ -0,0 +1,222 @@
+// sim_gzip.c — gzip_stream on Firestore commit bodies
+//
+// Commit bodies of GZIP_BATCHES writes are streamed through gzip_stream
+// into a stand-in for the HTTPS server: it counts the bytes on the
+// modelled link (sim_http.c) and inflates the body with zlib, as a server
+// honouring Content-Encoding: gzip would, to compare it with the plain one.
+// Reported per batch size: plain and compressed bytes, the ratio, the CPU
+// time gzip adds to streaming the body, and the upload time on each link
+// in s_links, plain against compressed (round trip, transfer and the
+// compression CPU time measured here; a device spends more of the latter).
+//
+// The run fails if an inflated body differs from the plain one, or if a
+// body at or above FIREBASE_GZIP_MIN_BODY, which the firmware compresses,
+// does not upload faster compressed on every link.
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "firestore_writer.h"
+#include "firebase.h"
+#include "gzip_stream.h"
+#include "sim_http.h"
+#include "sim_modes.h"
+
+#define GZIP_PROJ_ID "host-sim-project"
+#define GZIP_BODY_BYTES 4000000 // plain body bytes compressed per batch size, for timing
+#define GZIP_REC_MAX 400        // bound on one record's share of a body
+
+static const size_t s_batches[] = {5, 12, 20, 100, 500};
+
+static const struct
+{
+    const char *name;
+    uint32_t rtt_ms;
+    uint32_t kbit_s;
+} s_links[] = {
+    {"wifi", 250, 2000}, // the pipeline's link (host_sim.c)
+    {"cell", 600, 250},
+};
+#define GZIP_LINKS (sizeof(s_links) / sizeof(s_links[0]))
+
+typedef struct
+{
+    sim_http_t *link;
+    char *out;  // compressed body as the server received it, or NULL
+    size_t len;
+    size_t cap;
+} server_t;
+
+static avg_sample_t s_recs[FIRESTORE_MAX_WRITES];
+static char s_plain[FIRESTORE_MAX_WRITES * GZIP_REC_MAX];
+static char s_inflated[FIRESTORE_MAX_WRITES * GZIP_REC_MAX];
+static char s_received[FIRESTORE_MAX_WRITES * GZIP_REC_MAX];
+static gzip_stream_t s_gz;
+
+static void _make_records(void)
+{
+    time_t t = 1760000000;
+    for (size_t i = 0; i < FIRESTORE_MAX_WRITES; i++)
+    {
+        // a backfill after an outage: one record per window, two channels
+        uint16_t ch = i % 2;
+        t += ch ? 0 : 60 + (i * 7919) % 840;
+        float avg = ch ? 45.0f + (float)((i * 37) % 2000) / 100.0f : 68.0f + (float)((i * 53) % 800) / 100.0f;
+        float sd = (float)((i * 11) % 300) / 1000.0f;
+        s_recs[i] = (avg_sample_t){
+            .timestamp = t,
+            .average = avg,
+            .channel = ch,
+            .samples = 12,
+            .min = avg - 2 * sd,
+            .max = avg + 2.5f * sd,
+            .stddev = sd,
+            .p50 = avg - 0.1f * sd,
+            .p95 = avg + 1.7f * sd,
+        };
+    }
+}
+
+static esp_err_t _server_sink(void *ctx, const char *data, size_t len)
+{
+    server_t *s = ctx;
+    if (s->out)
+    {
+        if (s->len + len > s->cap)
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        memcpy(s->out + s->len, data, len);
+    }
+    s->len += len;
+    return s->link ? sim_http_sink(s->link, data, len) : ESP_OK;
+}
+
+static esp_err_t _gzip_sink(void *ctx, const char *data, size_t len)
+{
+    return gzip_stream_write(ctx, data, len);
+}
+
+/* One body through gzip into `server`; false on a stream error */
+static bool _compress(size_t batch, server_t *server)
+{
+    server->len = 0;
+    return gzip_stream_init(&s_gz, _server_sink, server) == ESP_OK &&
+           firestore_commit_stream(GZIP_PROJ_ID, s_recs, batch, _gzip_sink, &s_gz, NULL) == ESP_OK &&
+           gzip_stream_finish(&s_gz) == ESP_OK;
+}
+
+/* What the server does with Content-Encoding: gzip */
+static size_t _inflate(const char *in, size_t len, char *out, size_t cap)
+{
+    z_stream zs = {
+        .next_in = (Bytef *)in,
+        .avail_in = (uInt)len,
+        .next_out = (Bytef *)out,
+        .avail_out = (uInt)cap,
+    };
+    if (inflateInit2(&zs, 16 + MAX_WBITS) != Z_OK)
+    {
+        return 0;
+    }
+    int ret = inflate(&zs, Z_FINISH);
+    size_t n = zs.total_out;
+    inflateEnd(&zs);
+    return ret == Z_STREAM_END ? n : 0;
+}
+
+/* Modelled upload of `len` body bytes, in ms */
+static double _upload_ms(size_t l, size_t len)
+{
+    sim_http_t link = {.rtt_ms = s_links[l].rtt_ms, .kbit_s = s_links[l].kbit_s};
+    sim_http_begin(&link, 0);
+    sim_http_sink(&link, NULL, len);
+    return sim_http_end(&link) / 1e3;
+}
+
+bool sim_gzip(void)
+{
+    _make_records();
+    bool pass = true;
+    char result[1024];
+    int rlen = snprintf(result, sizeof(result), "RESULT mode=gzip");
+
+    printf("  writes   plain   gzip  ratio  gzip us  MB/s  gzipped");
+    for (size_t l = 0; l < GZIP_LINKS; l++)
+    {
+        printf("  %s ms plain/gzip", s_links[l].name);
+    }
+    printf("\n");
+    for (size_t b = 0; b < sizeof(s_batches) / sizeof(s_batches[0]); b++)
+    {
+        size_t batch = s_batches[b];
+        size_t plain = firestore_commit_serialize(GZIP_PROJ_ID, s_recs, batch, s_plain, sizeof(s_plain));
+
+        // checked pass, over the modelled link
+        sim_http_t link = {.rtt_ms = s_links[0].rtt_ms, .kbit_s = s_links[0].kbit_s};
+        server_t server = {.link = &link, .out = s_received, .cap = sizeof(s_received)};
+        sim_http_begin(&link, 0);
+        bool ok = _compress(batch, &server);
+        sim_http_end(&link);
+        size_t gz = server.len;
+        if (!ok || link.body_bytes != gz || plain >= sizeof(s_plain) ||
+            _inflate(s_received, gz, s_inflated, sizeof(s_inflated)) != plain ||
+            memcmp(s_inflated, s_plain, plain) != 0)
+        {
+            printf("GZIP FAIL: the %zu-write body does not inflate to the plain one\n", batch);
+            pass = false;
+            continue;
+        }
+
+        // CPU time gzip adds to streaming the body
+        uint32_t reps = GZIP_BODY_BYTES / plain + 1;
+        server_t counter = {0};
+        uint64_t t0 = sim_now_ns();
+        for (uint32_t r = 0; r < reps; r++)
+        {
+            firestore_commit_stream(GZIP_PROJ_ID, s_recs, batch, _server_sink, &counter, NULL);
+        }
+        uint64_t stream_ns = sim_now_ns() - t0;
+        t0 = sim_now_ns();
+        for (uint32_t r = 0; r < reps; r++)
+        {
+            _compress(batch, &counter);
+        }
+        uint64_t gzip_ns = sim_now_ns() - t0;
+        double gzip_us = gzip_ns > stream_ns ? (gzip_ns - stream_ns) / 1e3 / reps : 0.0;
+        double mb_s = gzip_ns ? (double)plain * reps * 1e3 / gzip_ns : 0.0;
+        bool gzipped = plain >= FIREBASE_GZIP_MIN_BODY;
+
+        printf("  %6zu %7zu %6zu %6.2f %8.0f %5.1f  %-7s", batch, plain, gz, (double)plain / gz, gzip_us, mb_s,
+               gzipped ? "yes" : "no");
+        if (rlen > 0 && (size_t)rlen < sizeof(result))
+        {
+            rlen += snprintf(result + rlen, sizeof(result) - rlen,
+                             " w%zu_plain=%zu w%zu_gzip=%zu w%zu_ratio=%.2f w%zu_gzip_us=%.0f", batch, plain, batch,
+                             gz, batch, (double)plain / gz, batch, gzip_us);
+        }
+        for (size_t l = 0; l < GZIP_LINKS; l++)
+        {
+            double plain_ms = _upload_ms(l, plain);
+            double gz_ms = _upload_ms(l, gz) + gzip_us / 1e3;
+            printf("  %9.0f/%.0f", plain_ms, gz_ms);
+            if (gzipped && gz_ms >= plain_ms)
+            {
+                printf("\nGZIP FAIL: the %zu-write body uploads slower compressed on %s", batch, s_links[l].name);
+                pass = false;
+            }
+            if (rlen > 0 && (size_t)rlen < sizeof(result))
+            {
+                rlen += snprintf(result + rlen, sizeof(result) - rlen, " w%zu_%s_ms=%.0f/%.0f", batch,
+                                 s_links[l].name, plain_ms, gz_ms);
+            }
+        }
+        printf("\n");
+    }
+    printf("%s: gzip from %d body bytes, state %zu bytes\n", pass ? "GZIP PASS" : "GZIP FAIL",
+           FIREBASE_GZIP_MIN_BODY, sizeof(gzip_stream_t));
+    printf("%s\n", result);
+    return pass;
+}
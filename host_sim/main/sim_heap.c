@@ -0,0 +1,266 @@
+// sim_heap.c — live-block heap tracer for the host simulator
+
+#define _GNU_SOURCE // dladdr()
+#include "sim_heap.h"
+
+#include <dlfcn.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#define TABLE_BITS 16
+#define TABLE_LEN (1u << TABLE_BITS)
+#define TOMBSTONE ((void *)1)
+#define DUMP_CALLERS 64
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t size);
+void __real_free(void *p);
+
+typedef struct
+{
+    void *ptr;
+    size_t size;
+    void *caller;
+} block_t;
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool s_tracing;
+static block_t s_tables[2][TABLE_LEN];
+static block_t *s_table = s_tables[0];
+static uint32_t s_tombstones;
+static sim_heap_stats_t s_stats;
+
+static uint32_t _hash(const void *p)
+{
+    uint64_t x = (uint64_t)(uintptr_t)p;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return (uint32_t)x & (TABLE_LEN - 1);
+}
+
+static uint32_t _slot(const block_t *table, const void *p)
+{
+    uint32_t i = _hash(p);
+    while (table[i].ptr && table[i].ptr != TOMBSTONE)
+    {
+        i = (i + 1) & (TABLE_LEN - 1);
+    }
+    return i;
+}
+
+/* Tombstones end no probe, so lookups of blocks that are not in the table
+ * get longer as they pile up; move the live blocks to a clean table */
+static void _rehash(void)
+{
+    block_t *fresh = s_table == s_tables[0] ? s_tables[1] : s_tables[0];
+    memset(fresh, 0, sizeof(s_tables[0]));
+    for (uint32_t i = 0; i < TABLE_LEN; i++)
+    {
+        if (s_table[i].ptr && s_table[i].ptr != TOMBSTONE)
+        {
+            fresh[_slot(fresh, s_table[i].ptr)] = s_table[i];
+        }
+    }
+    s_table = fresh;
+    s_tombstones = 0;
+}
+
+static void _track(void *p, size_t size, void *caller)
+{
+    if (!p)
+    {
+        return;
+    }
+    pthread_mutex_lock(&s_lock);
+    if (s_tracing)
+    {
+        if (s_stats.live_blocks + s_tombstones >= TABLE_LEN * 3 / 4)
+        {
+            _rehash();
+        }
+        if (s_stats.live_blocks >= TABLE_LEN * 3 / 4)
+        {
+            s_stats.untracked++;
+        }
+        else
+        {
+            uint32_t i = _slot(s_table, p);
+            if (s_table[i].ptr == TOMBSTONE)
+            {
+                s_tombstones--;
+            }
+            s_table[i] = (block_t){p, size, caller};
+            s_stats.allocs++;
+            s_stats.live_blocks++;
+            s_stats.live_bytes += size;
+            if (s_stats.live_bytes > s_stats.peak_bytes)
+            {
+                s_stats.peak_bytes = s_stats.live_bytes;
+            }
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+}
+
+static void _untrack(void *p)
+{
+    if (!p)
+    {
+        return;
+    }
+    pthread_mutex_lock(&s_lock);
+    uint32_t i = _hash(p);
+    for (uint32_t n = 0; n < TABLE_LEN && s_table[i].ptr; n++)
+    {
+        if (s_table[i].ptr == p)
+        {
+            s_stats.frees++;
+            s_stats.live_blocks--;
+            s_stats.live_bytes -= s_table[i].size;
+            s_table[i].ptr = TOMBSTONE;
+            s_tombstones++;
+            break;
+        }
+        i = (i + 1) & (TABLE_LEN - 1);
+    }
+    pthread_mutex_unlock(&s_lock);
+}
+
+void *__wrap_malloc(size_t size)
+{
+    void *p = __real_malloc(size);
+    _track(p, size, __builtin_return_address(0));
+    return p;
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    void *p = __real_calloc(n, size);
+    _track(p, n * size, __builtin_return_address(0));
+    return p;
+}
+
+void *__wrap_realloc(void *old, size_t size)
+{
+    void *p = __real_realloc(old, size);
+    if (p || size == 0)
+    {
+        _untrack(old);
+        _track(p, size, __builtin_return_address(0));
+    }
+    return p;
+}
+
+void __wrap_free(void *p)
+{
+    _untrack(p);
+    __real_free(p);
+}
+
+char *__wrap_strdup(const char *s)
+{
+    size_t len = strlen(s) + 1;
+    char *p = __real_malloc(len);
+    if (p)
+    {
+        memcpy(p, s, len);
+        _track(p, len, __builtin_return_address(0));
+    }
+    return p;
+}
+
+void sim_heap_start(void)
+{
+    pthread_mutex_lock(&s_lock);
+    memset(s_table, 0, sizeof(s_tables[0]));
+    s_tombstones = 0;
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_tracing = true;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void sim_heap_get_stats(sim_heap_stats_t *out)
+{
+    pthread_mutex_lock(&s_lock);
+    *out = s_stats;
+    pthread_mutex_unlock(&s_lock);
+#ifdef __GLIBC__
+    // free chunks the allocator cannot give back, i.e. fragmentation
+    struct mallinfo2 mi = mallinfo2();
+    out->holes = mi.fordblks > mi.keepcost ? mi.fordblks - mi.keepcost : 0;
+#else
+    out->holes = 0;
+#endif
+}
+
+void sim_heap_dump(int max)
+{
+    static struct
+    {
+        void *caller;
+        size_t bytes;
+        uint32_t blocks;
+    } callers[DUMP_CALLERS];
+    int n = 0;
+
+    pthread_mutex_lock(&s_lock);
+    for (uint32_t i = 0; i < TABLE_LEN; i++)
+    {
+        const block_t *b = &s_table[i];
+        if (!b->ptr || b->ptr == TOMBSTONE)
+        {
+            continue;
+        }
+        int c = 0;
+        while (c < n && callers[c].caller != b->caller)
+        {
+            c++;
+        }
+        if (c == n)
+        {
+            if (n == DUMP_CALLERS)
+            {
+                continue;
+            }
+            callers[n++] = (typeof(callers[0])){b->caller, 0, 0};
+        }
+        callers[c].bytes += b->size;
+        callers[c].blocks++;
+    }
+    pthread_mutex_unlock(&s_lock);
+
+    for (int shown = 0; shown < max && shown < n; shown++)
+    {
+        int best = shown;
+        for (int c = shown + 1; c < n; c++)
+        {
+            if (callers[c].bytes > callers[best].bytes)
+            {
+                best = c;
+            }
+        }
+        typeof(callers[0]) t = callers[shown];
+        callers[shown] = callers[best];
+        callers[best] = t;
+        // offset into the object, which is what addr2line wants for a PIE
+        Dl_info info;
+        uintptr_t at = (uintptr_t)callers[shown].caller;
+        const char *obj = "?";
+        if (dladdr(callers[shown].caller, &info) && info.dli_fname)
+        {
+            at -= (uintptr_t)info.dli_fbase;
+            obj = strrchr(info.dli_fname, '/') ? strrchr(info.dli_fname, '/') + 1 : info.dli_fname;
+        }
+        printf("  %s+0x%" PRIxPTR "  %8zu bytes in %" PRIu32 " blocks\n", obj, at,
+               callers[shown].bytes, callers[shown].blocks);
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Heap tracer for the host build. The simulator links with
+ * --wrap=malloc/calloc/realloc/free/strdup, so every allocation made by
+ * project code (not by libc internally) passes through here and is kept in
+ * a table of live blocks with its size and caller. Tracing starts at
+ * sim_heap_start(); frees of blocks from before that are passed through.
+ */
+typedef struct
+{
+    uint64_t allocs;      // traced allocations since start
+    uint64_t frees;
+    size_t live_bytes;    // traced, still allocated
+    uint32_t live_blocks;
+    size_t peak_bytes;
+    uint32_t untracked;   // allocations the table had no room for
+    size_t holes;         // free bytes the allocator holds below its top
+} sim_heap_stats_t;
+
+void sim_heap_start(void);
+
+void sim_heap_get_stats(sim_heap_stats_t *out);
+
+/**
+ * @brief  Print up to `max` callers holding live blocks, largest first, as
+ *         object+offset; resolve with addr2line -e build/host_sim.elf <offset>.
+ */
+void sim_heap_dump(int max);
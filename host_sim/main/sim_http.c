@@ -0,0 +1,69 @@
+// sim_http.c — fake HTTPS client for the host simulator
+
+#include "sim_http.h"
+
+/* xorshift64, uniform in [0, 1e6) */
+static uint32_t _ppm(sim_http_t *h)
+{
+    h->rng ^= h->rng << 13;
+    h->rng ^= h->rng >> 7;
+    h->rng ^= h->rng << 17;
+    return (uint32_t)(h->rng % 1000000);
+}
+
+esp_err_t sim_http_begin(sim_http_t *h, int64_t now_us)
+{
+    h->body_bytes = 0;
+    h->cut_at = 0;
+    h->cut = false;
+    h->timed_out = false;
+    h->requests++;
+    uint32_t day_s = (uint32_t)((now_us / 1000000) % 86400);
+    if (h->outage_len_s && day_s >= h->outage_start_s &&
+        day_s < h->outage_start_s + h->outage_len_s)
+    {
+        h->failures++;
+        h->timed_out = true;
+        return ESP_ERR_TIMEOUT;
+    }
+    if (h->fail_ppm && _ppm(h) < h->fail_ppm)
+    {
+        h->failures++;
+        return ESP_FAIL;
+    }
+    if (h->cut_ppm && _ppm(h) < h->cut_ppm)
+    {
+        h->cut_at = 1 + _ppm(h) % 4096;
+    }
+    return ESP_OK;
+}
+
+esp_err_t sim_http_sink(void *ctx, const char *data, size_t len)
+{
+    sim_http_t *h = ctx;
+    if (h->cut)
+    {
+        return ESP_FAIL;
+    }
+    if (h->cut_at && h->body_bytes + len > h->cut_at)
+    {
+        h->cut = true;
+        h->cuts++;
+        h->failures++;
+        return ESP_FAIL;
+    }
+    h->body_bytes += len;
+    return ESP_OK;
+}
+
+int64_t sim_http_end(sim_http_t *h)
+{
+    int64_t us = (int64_t)(h->timed_out ? h->timeout_ms : h->rtt_ms) * 1000;
+    if (h->kbit_s)
+    {
+        us += (int64_t)h->body_bytes * 8 * 1000 / h->kbit_s;
+    }
+    h->bytes += h->body_bytes;
+    h->busy_us += us;
+    return us;
+}
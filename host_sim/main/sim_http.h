@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * Stand-in for the Firestore HTTPS connection. Bodies are counted, not
+ * sent; each request costs a modelled round trip plus transfer time on the
+ * simulated clock, and times out during a daily outage window. On top of that,
+ * requests can be refused or cut off mid-body at random, to drive the
+ * error paths.
+ */
+typedef struct
+{
+    uint32_t rtt_ms;
+    uint32_t kbit_s;
+    uint32_t outage_start_s; // seconds into each day
+    uint32_t outage_len_s;   // 0 = link never fails
+    uint32_t timeout_ms;     // what a request into the outage costs
+    uint32_t fail_ppm;       // requests refused at random, per million
+    uint32_t cut_ppm;        // requests whose body write fails part way, per million
+    uint64_t rng;            // seed, non-zero
+    /* current request */
+    size_t body_bytes;
+    size_t cut_at;           // body write fails past this many bytes, 0 = never
+    bool cut;                // connection dropped, every further write fails
+    bool timed_out;
+    /* totals */
+    uint32_t requests;
+    uint32_t failures;
+    uint32_t cuts;
+    uint64_t bytes;
+    int64_t busy_us;
+} sim_http_t;
+
+/** @brief Start a request at simulated time `now_us`; fails inside the outage. */
+esp_err_t sim_http_begin(sim_http_t *h, int64_t now_us);
+
+/** @brief firestore_sink_fn / gzip_sink_fn compatible body sink; fails once cut off. */
+esp_err_t sim_http_sink(void *ctx, const char *data, size_t len);
+
+/**
+ * @brief  Finish the request, failed (including a failed begin) or not.
+ * @return Its modelled duration in microseconds.
+ */
+int64_t sim_http_end(sim_http_t *h);
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sensor_record.h"
+
+/**
+ * Stand-alone runs of the simulator, picked with SIM_MODE (see the list in
+ * host_sim.c). Each one prints its own "RESULT mode=<name> ..." line last
+ * and returns false if a check it makes failed, which exits 1.
+ */
+typedef bool (*sim_mode_fn)(void);
+
+/* Shared with host_sim.c */
+uint64_t sim_now_ns(void);
+uint32_t sim_env_u32(const char *name, uint32_t fallback);
+
+/* The commit body as the firmware built it before firestore_writer.c: a
+ * cJSON tree and cJSON_PrintUnformatted(); free with cJSON_free() (sim_codec.c) */
+char *sim_cjson_commit_body(const char *proj_id, const avg_sample_t *recs, size_t count);
+
+/** @brief 10,000 commits and token refreshes on the arenas; no heap call may remain. */
+bool sim_upload_soak(void);
+
+/** @brief Sink router fan-out with a slow and a failing sink beside a fast one. */
+bool sim_sinks(void);
+
+/** @brief win_stats (Welford, P²) against an exact reference, and its cost. */
+bool sim_stats(void);
+
+/** @brief JSON/CBOR payload round trip; bytes and ns per record against cJSON. */
+bool sim_codec(void);
+
+/** @brief config_cache lookups against a cfg.json read and parse per key. */
+bool sim_config(void);
+
+/** @brief Firestore commit bodies of 5..500 writes: cJSON, buffer and stream. */
+bool sim_writer(void);
+
+/** @brief mqtt_man telemetry batching against an in-process broker. */
+bool sim_mqtt(void);
+
+/** @brief gzip_stream ratio, CPU time and upload time on commit bodies. */
+bool sim_gzip(void);
@@ -0,0 +1,327 @@
+// sim_mqtt.c — telemetry publisher against a broker stand-in
+//
+// The real mqtt_man.c runs on top of the esp-mqtt calls it uses
+// (mqtt_client.h here), implemented below with an in-process broker in
+// place of a local mosquitto: esp_mqtt_client_enqueue() copies the packet
+// into an outbox, the broker takes everything queued after each push and
+// acknowledges QoS1 with MQTT_EVENT_PUBLISHED. It decodes every telemetry
+// payload and checks the records arrive once and in order.
+//
+// MQTT_RECORDS window records (sequence number in `samples`) are pushed
+// one by one for each case in s_cases, from one record per publish (what
+// a plain publisher sends) to full batches. Reported per record: bytes on
+// the wire (PUBLISH packets and PUBACKs) and CPU time in
+// mqtt_telemetry_push(). In the "stall" case the broker stops taking
+// messages for a while: the outbox must stay within its bound, the excess
+// must be counted as dropped, and the rest delivered after it resumes.
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "cJSON.h"
+#include "mqtt_man.h"
+#include "sim_modes.h"
+
+#define MQTT_RECORDS 20000
+#define MQTT_TOPIC "sensors/host-sim/telemetry"
+#define MQTT_STALL_FROM 5000 // records pushed while the broker takes nothing
+#define MQTT_STALL_TO 10000
+#define MQTT_PUBACK_BYTES 4
+#define MQTT_DECODE_MAX 128
+/* mqtt_man checks the bound before each enqueue, so one packet and its
+ * headers may go past it */
+#define MQTT_OUTBOX_MAX ((MQTT_TELEMETRY_MAX_INFLIGHT + 1) * MQTT_TELEMETRY_PAYLOAD_MAX + 64)
+
+typedef struct sim_msg
+{
+    struct sim_msg *next;
+    int msg_id;
+    int qos;
+    int len;
+    int wire;         // PUBLISH packet bytes
+    bool telemetry;
+    uint8_t data[];
+} sim_msg_t;
+
+struct esp_mqtt_client
+{
+    esp_event_handler_t handler;
+    void *handler_arg;
+    sim_msg_t *head;
+    sim_msg_t **tail;
+    int outbox_bytes;
+    int next_id;
+};
+
+static struct esp_mqtt_client s_client;
+
+static struct
+{
+    bool stalled;
+    uint64_t wire_bytes;
+    uint32_t publishes;
+    uint32_t records;
+    int32_t last_seq;
+    uint32_t out_of_order;
+    uint32_t bad_payloads;
+    int outbox_peak;
+} s_broker;
+
+static const struct
+{
+    const char *name;
+    const payload_codec_t *codec;
+    uint16_t batch;
+    int qos;
+    bool stall;
+} s_cases[] = {
+    {"json1", &payload_codec_json, 1, 1, false},
+    {"json16", &payload_codec_json, 16, 1, false},
+    {"cbor1", &payload_codec_cbor, 1, 1, false},
+    {"cbor16", &payload_codec_cbor, 16, 1, false},
+    {"cbor16q0", &payload_codec_cbor, 16, 0, false},
+    {"cbor64", &payload_codec_cbor, 64, 1, false},
+    {"stall", &payload_codec_cbor, 16, 1, true},
+};
+
+static avg_sample_t s_decoded[MQTT_DECODE_MAX];
+static char s_json[MQTT_TELEMETRY_PAYLOAD_MAX + 1];
+
+static void _event(esp_mqtt_event_id_t id, int msg_id)
+{
+    esp_mqtt_event_t event = {.event_id = id, .client = &s_client, .msg_id = msg_id};
+    if (s_client.handler)
+    {
+        s_client.handler(s_client.handler_arg, "MQTT_EVENTS", id, &event);
+    }
+}
+
+/* Records in a telemetry payload, by sequence number; -1 if malformed */
+static int _decode(const sim_msg_t *m, const payload_codec_t *codec)
+{
+    size_t n = 0;
+    if (codec == &payload_codec_cbor)
+    {
+        return payload_cbor_decode(m->data, m->len, s_decoded, MQTT_DECODE_MAX, &n) == ESP_OK ? (int)n : -1;
+    }
+    memcpy(s_json, m->data, m->len);
+    s_json[m->len] = '\0';
+    cJSON *root = cJSON_Parse(s_json);
+    cJSON *rows = cJSON_GetObjectItem(root, "r");
+    cJSON *row;
+    int ret = cJSON_IsArray(rows) ? 0 : -1;
+    cJSON_ArrayForEach(row, rows)
+    {
+        cJSON *seq = cJSON_GetArrayItem(row, 8);
+        if (n == MQTT_DECODE_MAX || !cJSON_IsNumber(seq))
+        {
+            ret = -1;
+            break;
+        }
+        s_decoded[n++].samples = (uint16_t)seq->valuedouble;
+    }
+    cJSON_Delete(root);
+    return ret < 0 ? -1 : (int)n;
+}
+
+/* The broker takes everything in the outbox, unless stalled */
+static void _broker_service(const payload_codec_t *codec)
+{
+    while (!s_broker.stalled && s_client.head)
+    {
+        sim_msg_t *m = s_client.head;
+        s_client.head = m->next;
+        if (!s_client.head)
+        {
+            s_client.tail = &s_client.head;
+        }
+        s_client.outbox_bytes -= m->wire;
+        s_broker.wire_bytes += m->wire;
+        if (m->telemetry)
+        {
+            int n = _decode(m, codec);
+            if (n <= 0)
+            {
+                s_broker.bad_payloads++;
+            }
+            for (int i = 0; i < n; i++)
+            {
+                if ((int32_t)s_decoded[i].samples <= s_broker.last_seq)
+                {
+                    s_broker.out_of_order++;
+                }
+                s_broker.last_seq = s_decoded[i].samples;
+            }
+            s_broker.records += n > 0 ? n : 0;
+            s_broker.publishes++;
+        }
+        if (m->qos)
+        {
+            s_broker.wire_bytes += MQTT_PUBACK_BYTES;
+            _event(MQTT_EVENT_PUBLISHED, m->msg_id);
+        }
+        free(m);
+    }
+}
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config)
+{
+    s_client.tail = &s_client.head;
+    return &s_client;
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event,
+                                         esp_event_handler_t event_handler, void *event_handler_arg)
+{
+    client->handler = event_handler;
+    client->handler_arg = event_handler_arg;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client)
+{
+    _event(MQTT_EVENT_CONNECTED, 0);
+    return ESP_OK;
+}
+
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char *topic, int qos)
+{
+    return ++client->next_id;
+}
+
+int esp_mqtt_client_enqueue(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len,
+                            int qos, int retain, bool store)
+{
+    sim_msg_t *m = malloc(sizeof(*m) + len);
+    if (!m)
+    {
+        return -1;
+    }
+    // fixed header, remaining length, topic, packet id for QoS1
+    int rest = 2 + (int)strlen(topic) + (qos ? 2 : 0) + len;
+    *m = (sim_msg_t){
+        .msg_id = qos ? ++client->next_id : 0,
+        .qos = qos,
+        .len = len,
+        .wire = 1 + (rest < 128 ? 1 : rest < 16384 ? 2 : 3) + rest,
+        .telemetry = strcmp(topic, MQTT_TOPIC) == 0,
+    };
+    memcpy(m->data, data, len);
+    *client->tail = m;
+    client->tail = &m->next;
+    client->outbox_bytes += m->wire;
+    if (client->outbox_bytes > s_broker.outbox_peak)
+    {
+        s_broker.outbox_peak = client->outbox_bytes;
+    }
+    return m->msg_id;
+}
+
+int esp_mqtt_client_get_outbox_size(esp_mqtt_client_handle_t client)
+{
+    return client->outbox_bytes;
+}
+
+bool sim_mqtt(void)
+{
+    // the stall case drops hundreds of payloads and mqtt_man logs each one
+    esp_log_level_set("MQTT", ESP_LOG_ERROR);
+    if (mqtt_app_start("mqtt://127.0.0.1:1883", "host-sim", "host-sim", NULL) != ESP_OK)
+    {
+        return false;
+    }
+    bool pass = true;
+    char result[1024];
+    int rlen = snprintf(result, sizeof(result), "RESULT mode=mqtt records=%d", MQTT_RECORDS);
+
+    printf("  case       wire bytes/rec  publishes  push ns/rec  dropped  outbox peak\n");
+    for (size_t c = 0; c < sizeof(s_cases) / sizeof(s_cases[0]); c++)
+    {
+        const mqtt_telemetry_cfg_t cfg = {
+            .topic = MQTT_TOPIC,
+            .qos = s_cases[c].qos,
+            .batch_records = s_cases[c].batch,
+            .codec = s_cases[c].codec,
+        };
+        mqtt_telemetry_stats_t st0, st1;
+        mqtt_telemetry_start(&cfg);
+        mqtt_telemetry_get_stats(&st0);
+        memset(&s_broker, 0, sizeof(s_broker));
+        s_broker.last_seq = -1;
+
+        uint64_t push_ns = 0;
+        time_t t = 1760000000;
+        for (int i = 0; i < MQTT_RECORDS; i++)
+        {
+            s_broker.stalled = s_cases[c].stall && i >= MQTT_STALL_FROM && i < MQTT_STALL_TO;
+            t += 60;
+            float avg = 68.0f + (float)(i % 50) * 0.1f;
+            const avg_sample_t rec = {
+                .timestamp = t,
+                .average = avg,
+                .samples = (uint16_t)i,
+                .min = avg - 0.4f,
+                .max = avg + 0.6f,
+                .stddev = 0.2f,
+                .p50 = avg,
+                .p95 = avg + 0.5f,
+            };
+            uint64_t t0 = sim_now_ns();
+            mqtt_telemetry_push(&rec, 1);
+            push_ns += sim_now_ns() - t0;
+            _broker_service(s_cases[c].codec);
+        }
+        s_broker.stalled = false;
+        mqtt_telemetry_flush();
+        _broker_service(s_cases[c].codec);
+        mqtt_telemetry_get_stats(&st1);
+
+        uint32_t dropped = st1.dropped - st0.dropped;
+        uint32_t publishes = st1.publishes - st0.publishes;
+        uint32_t acked = st1.acked - st0.acked;
+        double bytes_rec = s_broker.records ? (double)s_broker.wire_bytes / s_broker.records : 0.0;
+        double ns_rec = (double)push_ns / MQTT_RECORDS;
+        printf("  %-9s %15.1f %10" PRIu32 " %12.0f %8" PRIu32 " %12d\n", s_cases[c].name, bytes_rec,
+               publishes, ns_rec, dropped, s_broker.outbox_peak);
+
+        if (s_broker.records + dropped != MQTT_RECORDS || s_broker.out_of_order || s_broker.bad_payloads ||
+            s_broker.publishes != publishes)
+        {
+            printf("MQTT FAIL: %s delivered %" PRIu32 " + dropped %" PRIu32 " of %d records, %" PRIu32
+                   " out of order, %" PRIu32 " bad payloads\n",
+                   s_cases[c].name, s_broker.records, dropped, MQTT_RECORDS, s_broker.out_of_order,
+                   s_broker.bad_payloads);
+            pass = false;
+        }
+        if (s_cases[c].qos && acked != publishes)
+        {
+            printf("MQTT FAIL: %s had %" PRIu32 " of %" PRIu32 " QoS1 publishes acked\n", s_cases[c].name, acked,
+                   publishes);
+            pass = false;
+        }
+        if (s_broker.outbox_peak > MQTT_OUTBOX_MAX)
+        {
+            printf("MQTT FAIL: %s let the outbox grow to %d bytes\n", s_cases[c].name, s_broker.outbox_peak);
+            pass = false;
+        }
+        if (s_cases[c].stall ? !dropped || s_broker.last_seq != MQTT_RECORDS - 1 : dropped != 0)
+        {
+            printf("MQTT FAIL: %s dropped %" PRIu32 " records%s\n", s_cases[c].name, dropped,
+                   s_cases[c].stall ? " and did not resume" : "");
+            pass = false;
+        }
+        if (rlen > 0 && (size_t)rlen < sizeof(result))
+        {
+            rlen += snprintf(result + rlen, sizeof(result) - rlen,
+                             " %s_bytes=%.1f %s_publishes=%" PRIu32 " %s_ns=%.0f %s_dropped=%" PRIu32,
+                             s_cases[c].name, bytes_rec, s_cases[c].name, publishes, s_cases[c].name, ns_rec,
+                             s_cases[c].name, dropped);
+        }
+    }
+    printf("%s\n", pass ? "MQTT PASS" : "MQTT FAIL");
+    printf("%s\n", result);
+    return pass;
+}
@@ -0,0 +1,52 @@
+// sim_sensor.c — fake AHT21 for the host simulator
+
+#include "sim_sensor.h"
+
+#include <math.h>
+#include <string.h>
+
+#define DAY_S 86400.0
+
+/* xorshift64*, uniform in [0, 1) */
+static float _uniform(sim_sensor_t *s)
+{
+    s->rng ^= s->rng >> 12;
+    s->rng ^= s->rng << 25;
+    s->rng ^= s->rng >> 27;
+    return (float)((s->rng * 2685821657736338717ULL) >> 40) / (float)(1 << 24);
+}
+
+static float _noise(sim_sensor_t *s, float amplitude)
+{
+    return (_uniform(s) * 2.0f - 1.0f) * amplitude;
+}
+
+void sim_sensor_init(sim_sensor_t *s, const int64_t *clock_us, uint32_t seed)
+{
+    memset(s, 0, sizeof(*s));
+    s->clock_us = clock_us;
+    s->rng = 0x9E3779B97F4A7C15ULL ^ seed;
+}
+
+esp_err_t sim_sensor_read(void *ctx, float *out, size_t n_out)
+{
+    sim_sensor_t *s = ctx;
+    s->reads++;
+    if (s->fail_rate > 0 && _uniform(s) < s->fail_rate)
+    {
+        s->failures++;
+        return ESP_FAIL;
+    }
+
+    double day = fmod(*s->clock_us / 1e6, DAY_S) / DAY_S;
+    s->drift_c += _noise(s, 0.01f);
+    s->drift_c *= 0.999f; // stay around the daily cycle
+
+    float temp = 21.0f + 3.0f * (float)sin(2 * M_PI * (day - 0.3)) + s->drift_c;
+    out[0] = temp + _noise(s, 0.05f);
+    if (n_out > 1)
+    {
+        out[1] = 45.0f - 2.0f * (temp - 21.0f) + _noise(s, 0.3f);
+    }
+    return ESP_OK;
+}
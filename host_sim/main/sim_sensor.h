@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * Stand-in for the AHT21: a diurnal temperature swing with a slow random
+ * walk and read noise, humidity moving against it. read() has the
+ * acq_driver_t signature, so it can replace the real driver as is.
+ */
+typedef struct
+{
+    const int64_t *clock_us; // simulated time the values follow
+    uint64_t rng;
+    float drift_c;           // random walk on top of the daily cycle
+    float fail_rate;         // fraction of reads that fail like an I2C NACK
+    uint32_t reads;
+    uint32_t failures;
+} sim_sensor_t;
+
+void sim_sensor_init(sim_sensor_t *s, const int64_t *clock_us, uint32_t seed);
+
+/** @brief out[0] = temperature (°C), out[1] = relative humidity (%). */
+esp_err_t sim_sensor_read(void *ctx, float *out, size_t n_out);
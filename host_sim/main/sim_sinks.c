@@ -0,0 +1,219 @@
+// sim_sinks.c — sink router fan-out under a slow and a failing sink
+//
+// Three sinks take the same stream of records on their own tasks, in real
+// time (the router runs on esp_timer and FreeRTOS, which the linux target
+// provides):
+//   fast   batch 1, writes at once: stands in for the local log
+//   slow   batch 10, every write takes SINKS_SLOW_WRITE_MS: a link slower
+//          than the record rate, so its queue fills and drops
+//   flaky  batch 20, every write fails for SINKS_OUTAGE_MS: an outage it
+//          must retry through and recover from
+//
+// Every record carries its sequence number and publish time, so each sink
+// checks its own order and measures publish-to-write latency. The run
+// fails if the fast sink loses a record or lags behind by more than
+// SINKS_FAST_MAX_LAG_MS (the others held it back), if any sink gets its
+// records out of order or loses some without counting them as dropped, or
+// if the flaky sink does not recover.
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+#include "sink_router.h"
+#include "sim_modes.h"
+
+#define SINKS_RECORDS 3000
+#define SINKS_BURST 5                // records published per millisecond
+#define SINKS_SLOW_WRITE_MS 5
+#define SINKS_OUTAGE_START_MS 100
+#define SINKS_OUTAGE_MS 300
+#define SINKS_FAST_MAX_LAG_MS 50
+#define SINKS_DRAIN_MS 3000          // time the queues get to empty afterwards
+
+typedef struct
+{
+    const char *name;
+    uint32_t write_ms;        // time a write takes
+    bool outage;              // fails inside the outage window
+    uint8_t id;
+    /* owned by the sink task */
+    uint32_t written;
+    uint32_t writes;
+    uint32_t failed_writes;
+    int32_t last_seq;
+    uint32_t out_of_order;
+    int64_t max_latency_us;
+    uint64_t total_latency_us;
+    int64_t first_us;
+    int64_t last_us;
+} sim_sink_t;
+
+static int64_t s_start_us;
+
+static sim_sink_t s_fast = {.name = "fast"};
+static sim_sink_t s_slow = {.name = "slow", .write_ms = SINKS_SLOW_WRITE_MS};
+static sim_sink_t s_flaky = {.name = "flaky", .outage = true};
+static sim_sink_t *const s_sinks[] = {&s_fast, &s_slow, &s_flaky};
+
+static esp_err_t _write(void *ctx, const avg_sample_t *recs, size_t count)
+{
+    sim_sink_t *k = ctx;
+    if (k->write_ms)
+    {
+        vTaskDelay(pdMS_TO_TICKS(k->write_ms));
+    }
+    int64_t now = esp_timer_get_time();
+    int64_t t = (now - s_start_us) / 1000;
+    if (k->outage && t >= SINKS_OUTAGE_START_MS && t < SINKS_OUTAGE_START_MS + SINKS_OUTAGE_MS)
+    {
+        k->failed_writes++;
+        return ESP_FAIL;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        // publish time in timestamp (us), sequence number in samples
+        int64_t latency = now - recs[i].timestamp;
+        if (latency > k->max_latency_us)
+        {
+            k->max_latency_us = latency;
+        }
+        k->total_latency_us += latency;
+        if ((int32_t)recs[i].samples <= k->last_seq)
+        {
+            k->out_of_order++;
+        }
+        k->last_seq = recs[i].samples;
+    }
+    if (!k->written)
+    {
+        k->first_us = now;
+    }
+    k->last_us = now;
+    k->written += count;
+    k->writes++;
+    return ESP_OK;
+}
+
+static bool _drained(void)
+{
+    for (size_t i = 0; i < sizeof(s_sinks) / sizeof(s_sinks[0]); i++)
+    {
+        sink_stats_t st;
+        if (sink_router_get_stats(s_sinks[i]->id, &st) != ESP_OK || st.queued)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool sim_sinks(void)
+{
+    uint32_t records = sim_env_u32("SIM_SINK_RECORDS", SINKS_RECORDS);
+    if (records > UINT16_MAX)
+    {
+        records = UINT16_MAX; // sequence numbers travel in `samples`
+    }
+    const sink_cfg_t cfgs[] = {
+        {.name = "fast", .write = _write, .ctx = &s_fast, .queue_len = 64, .batch = 1,
+         .retry_min_ms = 10, .retry_max_ms = 100},
+        {.name = "slow", .write = _write, .ctx = &s_slow, .queue_len = 256, .batch = 10,
+         .max_delay_ms = 50, .retry_min_ms = 10, .retry_max_ms = 100},
+        {.name = "flaky", .write = _write, .ctx = &s_flaky, .queue_len = 1024, .batch = 20,
+         .max_delay_ms = 50, .retry_min_ms = 10, .retry_max_ms = 80},
+    };
+    for (size_t i = 0; i < sizeof(cfgs) / sizeof(cfgs[0]); i++)
+    {
+        s_sinks[i]->last_seq = -1;
+        if (sink_router_add(&cfgs[i], &s_sinks[i]->id) != ESP_OK)
+        {
+            printf("Cannot add sink %s\n", cfgs[i].name);
+            return false;
+        }
+    }
+    printf("Sinks: %" PRIu32 " records at %d/ms; slow writes take %d ms, flaky fails %d..%d ms\n",
+           records, SINKS_BURST, SINKS_SLOW_WRITE_MS, SINKS_OUTAGE_START_MS,
+           SINKS_OUTAGE_START_MS + SINKS_OUTAGE_MS);
+
+    s_start_us = esp_timer_get_time();
+    uint32_t max_lag_ms[3] = {0};
+    for (uint32_t seq = 0; seq < records;)
+    {
+        for (int b = 0; b < SINKS_BURST && seq < records; b++, seq++)
+        {
+            avg_sample_t rec = {
+                .timestamp = esp_timer_get_time(),
+                .average = 20.0f,
+                .samples = (uint16_t)seq,
+            };
+            sink_router_publish(&rec);
+        }
+        for (size_t i = 0; i < sizeof(s_sinks) / sizeof(s_sinks[0]); i++)
+        {
+            sink_stats_t st;
+            if (sink_router_get_stats(s_sinks[i]->id, &st) == ESP_OK && st.lag_ms > max_lag_ms[i])
+            {
+                max_lag_ms[i] = st.lag_ms;
+            }
+        }
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    int64_t published_us = esp_timer_get_time() - s_start_us;
+    for (int ms = 0; ms < SINKS_DRAIN_MS && !_drained(); ms += 10)
+    {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+
+    bool pass = true;
+    char result[512];
+    int len = snprintf(result, sizeof(result), "RESULT mode=sinks records=%" PRIu32 " publish_ms=%.0f",
+                       records, published_us / 1e3);
+    printf("  sink   written dropped failures  rec/s   lag max   latency avg/max\n");
+    for (size_t i = 0; i < sizeof(s_sinks) / sizeof(s_sinks[0]); i++)
+    {
+        const sim_sink_t *k = s_sinks[i];
+        sink_stats_t st;
+        sink_router_get_stats(k->id, &st);
+        double span_s = (k->last_us - k->first_us) / 1e6;
+        double rate = span_s > 0 ? k->written / span_s : 0.0;
+        printf("  %-6s %7" PRIu32 " %7" PRIu32 " %8" PRIu32 " %7.0f %6" PRIu32 " ms %6.1f/%.1f ms\n",
+               k->name, k->written, st.dropped, st.failures, rate, max_lag_ms[i],
+               k->written ? k->total_latency_us / 1e3 / k->written : 0.0, k->max_latency_us / 1e3);
+        if (k->out_of_order || k->written + st.dropped != records || st.queued)
+        {
+            printf("SINKS FAIL: %s delivered %" PRIu32 " + dropped %" PRIu32 " of %" PRIu32
+                   ", %" PRIu32 " still queued, %" PRIu32 " out of order\n",
+                   k->name, k->written, st.dropped, records, st.queued, k->out_of_order);
+            pass = false;
+        }
+        if (len > 0 && (size_t)len < sizeof(result))
+        {
+            len += snprintf(result + len, sizeof(result) - len,
+                            " %s_written=%" PRIu32 " %s_dropped=%" PRIu32 " %s_failures=%" PRIu32
+                            " %s_rec_s=%.0f %s_lag_ms=%" PRIu32 " %s_latency_ms=%.1f",
+                            k->name, k->written, k->name, st.dropped, k->name, st.failures,
+                            k->name, rate, k->name, max_lag_ms[i], k->name, k->max_latency_us / 1e3);
+        }
+    }
+    sink_stats_t fast;
+    sink_router_get_stats(s_fast.id, &fast);
+    if (fast.dropped || s_fast.max_latency_us > (int64_t)SINKS_FAST_MAX_LAG_MS * 1000)
+    {
+        printf("SINKS FAIL: the fast sink was held back (%" PRIu32 " dropped, %.1f ms latency)\n",
+               fast.dropped, s_fast.max_latency_us / 1e3);
+        pass = false;
+    }
+    if (!s_flaky.failed_writes || !s_flaky.written)
+    {
+        printf("SINKS FAIL: the flaky sink %s\n", s_flaky.failed_writes ? "never recovered" : "never failed");
+        pass = false;
+    }
+    printf("%s\n", pass ? "SINKS PASS" : "SINKS FAIL");
+    printf("%s\n", result);
+    return pass;
+}
@@ -0,0 +1,312 @@
+// sim_stats.c — win_stats against an exact reference
+//
+// Synthetic series, cut into windows of the lengths the firmware uses
+// (12 samples = one minute at 5 s, up to a day), go through win_stats and
+// through an exact reference: two-pass mean and variance in double, and
+// p50/p95 from the sorted window with the same interpolation win_stats
+// uses. Mean and stddev are compared as relative errors. Quantiles are
+// compared by rank, the fraction of the window between the estimate and
+// the exact value, which does not depend on the units or spread of the
+// series; samples tied with either value count for neither, so a series
+// coarse in float is not penalised for landing between two levels.
+// Windows of up to WIN_STATS_EXACT_MAX samples must match exactly.
+//
+// P² assumes a stationary window. On a falling trend its upper markers
+// keep the early highs while the estimate is pulled into the bulk, so
+// hour-long windows of the drift series miss p95 by up to half the window
+// (a textbook double-precision P² does the same). Trend series are
+// reported but not held to the limits.
+//
+// Throughput is measured separately on one long window: ns per
+// win_stats_add() and per win_stats_summary().
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "win_stats.h"
+#include "sim_modes.h"
+
+#define STATS_SAMPLES_PER_CASE 200000
+#define STATS_MAX_WINDOW 17280       // one day at 5 s
+#define STATS_THROUGHPUT_SAMPLES 10000000
+/* Pass limits, above what P² reaches on the stationary series; a port
+ * that mixes up markers or positions lands far past them */
+#define STATS_MOMENT_REL_ERR 1e-5    // float output of a double accumulator
+#define STATS_RANK_ERR_MEAN 0.05     // per series and window length
+#define STATS_RANK_ERR_MAX 0.25      // any single window
+
+typedef float (*series_fn)(uint32_t i);
+
+typedef struct
+{
+    double sum;
+    double max;
+    uint32_t n;
+} stats_err_t;
+
+static float s_window[STATS_MAX_WINDOW];
+static float s_sorted[STATS_MAX_WINDOW];
+static uint64_t s_rng;
+
+/* xorshift64 in [0, 1) */
+static double _uniform(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 7;
+    s_rng ^= s_rng << 17;
+    return (double)(s_rng >> 11) / (double)(1ULL << 53);
+}
+
+static double _gauss(void)
+{
+    double u = _uniform();
+    double v = _uniform();
+    return sqrt(-2.0 * log(u > 0 ? u : 1e-300)) * cos(2.0 * M_PI * v);
+}
+
+/* Indoor temperature, °F: noise only */
+static float _gauss_series(uint32_t i)
+{
+    return (float)(70.0 + 0.5 * _gauss());
+}
+
+/* A daily cycle under the noise: windows see a trend */
+static float _drift_series(uint32_t i)
+{
+    return (float)(68.0 + 4.0 * sin(2.0 * M_PI * i / 17280.0) + 0.1 * _gauss());
+}
+
+/* A door opening now and then: a heavy upper tail for p95 */
+static float _spike_series(uint32_t i)
+{
+    return (float)(45.0 + 0.3 * _gauss() + (_uniform() < 0.03 ? 10.0 + 5.0 * _uniform() : 0.0));
+}
+
+static float _uniform_series(uint32_t i)
+{
+    return (float)(100.0 * _uniform());
+}
+
+/* A small spread on a large offset, where a float running sum drifts */
+static float _offset_series(uint32_t i)
+{
+    return (float)(10000.0 + 0.01 * _gauss());
+}
+
+static const struct
+{
+    const char *name;
+    series_fn next;
+    bool trend; // reported only, see above
+} s_series[] = {
+    {"gauss", _gauss_series, false},
+    {"drift", _drift_series, true},
+    {"spikes", _spike_series, false},
+    {"uniform", _uniform_series, false},
+    {"offset", _offset_series, false},
+};
+
+static const uint32_t s_lengths[] = {12, 16, 60, 720, STATS_MAX_WINDOW};
+
+static int _cmp_float(const void *a, const void *b)
+{
+    float x = *(const float *)a;
+    float y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+/* Same interpolation as win_stats.c */
+static float _exact_quantile(const float *sorted, uint32_t n, float p)
+{
+    float pos = p * (float)(n - 1);
+    uint32_t lo = (uint32_t)pos;
+    if (lo + 1 >= n)
+    {
+        return sorted[n - 1];
+    }
+    return sorted[lo] + (pos - (float)lo) * (sorted[lo + 1] - sorted[lo]);
+}
+
+/* Samples below `x` and samples up to `x` in the sorted window */
+static void _rank(const float *sorted, uint32_t n, float x, uint32_t *below, uint32_t *upto)
+{
+    uint32_t lo = 0;
+    uint32_t hi = n;
+    while (lo < hi) // first >= x
+    {
+        uint32_t mid = (lo + hi) / 2;
+        if (sorted[mid] < x)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    *below = lo;
+    hi = n;
+    while (lo < hi) // first > x
+    {
+        uint32_t mid = (lo + hi) / 2;
+        if (sorted[mid] <= x)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    *upto = lo;
+}
+
+/* Fraction of the window strictly between the estimate and the exact
+ * quantile; tied samples (a coarse series in float) count for neither */
+static double _rank_err(const float *sorted, uint32_t n, float est, float exact)
+{
+    uint32_t eb, eu, xb, xu;
+    _rank(sorted, n, est, &eb, &eu);
+    _rank(sorted, n, exact, &xb, &xu);
+    uint32_t gap = eb > xu ? eb - xu : xb > eu ? xb - eu : 0;
+    return (double)gap / n;
+}
+
+static void _err_add(stats_err_t *e, double v)
+{
+    e->sum += v;
+    e->n++;
+    if (v > e->max)
+    {
+        e->max = v;
+    }
+}
+
+static double _rel(double est, double exact)
+{
+    return fabs(est - exact) / (fabs(exact) > 1e-12 ? fabs(exact) : 1.0);
+}
+
+/* One window through both; returns false if an exact-path window differs */
+static bool _check_window(uint32_t n, stats_err_t *mean, stats_err_t *sd, stats_err_t *p50, stats_err_t *p95)
+{
+    win_stats_t ws;
+    win_stats_reset(&ws);
+    double sum = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        win_stats_add(&ws, s_window[i]);
+        sum += s_window[i];
+    }
+    win_stats_summary_t got;
+    win_stats_summary(&ws, &got);
+
+    double m = sum / n;
+    double ss = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        ss += (s_window[i] - m) * (s_window[i] - m);
+    }
+    double stddev = n > 1 ? sqrt(ss / (n - 1)) : 0.0;
+    memcpy(s_sorted, s_window, n * sizeof(float));
+    qsort(s_sorted, n, sizeof(float), _cmp_float);
+    float q50 = _exact_quantile(s_sorted, n, 0.50f);
+    float q95 = _exact_quantile(s_sorted, n, 0.95f);
+
+    _err_add(mean, _rel(got.mean, m));
+    _err_add(sd, _rel(got.stddev, stddev));
+    _err_add(p50, _rank_err(s_sorted, n, got.p50, q50));
+    _err_add(p95, _rank_err(s_sorted, n, got.p95, q95));
+    if (n <= WIN_STATS_EXACT_MAX && (got.p50 != q50 || got.p95 != q95 ||
+                                     got.min != s_sorted[0] || got.max != s_sorted[n - 1]))
+    {
+        printf("STATS FAIL: a %" PRIu32 "-sample window is not exact (p50 %g vs %g, p95 %g vs %g)\n",
+               n, got.p50, q50, got.p95, q95);
+        return false;
+    }
+    return true;
+}
+
+bool sim_stats(void)
+{
+    bool pass = true;
+    double moment = 0;          // worst relative error of mean or stddev
+    stats_err_t rank = {0};     // sum: worst per-case average, max: worst window
+    stats_err_t trend = {0};
+    uint32_t windows = 0;
+
+    printf("  series  window  windows  mean rel max  sd rel max  p50 rank avg/max  p95 rank avg/max\n");
+    for (size_t s = 0; s < sizeof(s_series) / sizeof(s_series[0]); s++)
+    {
+        for (size_t l = 0; l < sizeof(s_lengths) / sizeof(s_lengths[0]); l++)
+        {
+            uint32_t n = s_lengths[l];
+            stats_err_t mean = {0}, sd = {0}, p50 = {0}, p95 = {0};
+            s_rng = 0x2545F4914F6CDD1DULL + s;
+            uint32_t i = 0;
+            for (uint32_t w = 0; w < STATS_SAMPLES_PER_CASE / n || w == 0; w++)
+            {
+                for (uint32_t k = 0; k < n; k++)
+                {
+                    s_window[k] = s_series[s].next(i++);
+                }
+                pass &= _check_window(n, &mean, &sd, &p50, &p95);
+            }
+            bool checked = !s_series[s].trend;
+            printf("  %-7s %6" PRIu32 " %8" PRIu32 "  %12.2e  %10.2e  %7.4f/%.4f  %7.4f/%.4f%s\n",
+                   s_series[s].name, n, mean.n, mean.max, sd.max, p50.sum / p50.n, p50.max,
+                   p95.sum / p95.n, p95.max, checked ? "" : "  (trend, not checked)");
+            windows += mean.n;
+            moment = fmax(moment, fmax(mean.max, sd.max));
+            stats_err_t *q = checked ? &rank : &trend;
+            // each case counts once, however many windows it has
+            q->sum = fmax(q->sum, fmax(p50.sum / p50.n, p95.sum / p95.n));
+            q->max = fmax(q->max, fmax(p50.max, p95.max));
+        }
+    }
+
+    // throughput on one long window, so summary() sees the P² path
+    win_stats_t ws;
+    win_stats_reset(&ws);
+    s_rng = 1;
+    for (uint32_t k = 0; k < STATS_MAX_WINDOW; k++)
+    {
+        s_window[k] = _spike_series(k);
+    }
+    uint64_t t0 = sim_now_ns();
+    for (uint32_t k = 0; k < STATS_THROUGHPUT_SAMPLES; k++)
+    {
+        win_stats_add(&ws, s_window[k % STATS_MAX_WINDOW]);
+    }
+    double add_ns = (double)(sim_now_ns() - t0) / STATS_THROUGHPUT_SAMPLES;
+    win_stats_summary_t sum;
+    volatile float sink = 0;
+    t0 = sim_now_ns();
+    for (uint32_t k = 0; k < 100000; k++)
+    {
+        win_stats_summary(&ws, &sum);
+        sink += sum.p95;
+    }
+    double summary_ns = (double)(sim_now_ns() - t0) / 100000;
+
+    if (moment > STATS_MOMENT_REL_ERR)
+    {
+        printf("STATS FAIL: Welford mean or stddev off by %.2e\n", moment);
+        pass = false;
+    }
+    if (rank.sum > STATS_RANK_ERR_MEAN || rank.max > STATS_RANK_ERR_MAX)
+    {
+        printf("STATS FAIL: P² rank error %.4f on average, %.4f in one window\n", rank.sum, rank.max);
+        pass = false;
+    }
+    printf("%s: %" PRIu32 " windows; %.1f ns per sample, %.0f ns per summary\n",
+           pass ? "STATS PASS" : "STATS FAIL", windows, add_ns, summary_ns);
+    printf("RESULT mode=stats windows=%" PRIu32 " moment_rel_err=%.2e rank_err=%.4f"
+           " rank_err_max=%.4f trend_rank_err=%.4f trend_rank_err_max=%.4f add_ns=%.1f"
+           " summary_ns=%.0f\n",
+           windows, moment, rank.sum, rank.max, trend.sum, trend.max, add_ns, summary_ns);
+    return pass;
+}
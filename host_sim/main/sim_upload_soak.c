@@ -0,0 +1,317 @@
+// sim_upload_soak.c — the upload path's allocations over 10,000 commits
+//
+// Replays what one Firestore commit and one token refresh allocate
+// (firebase.c, firebase_cred.c) on arenas of the same sizes: the auth
+// header from the upload arena; the JWT buffers, the response buffer and
+// the cJSON trees of the token request and reply from the credential
+// arena; the commit body streamed (gzip from FIREBASE_GZIP_MIN_BODY) into
+// sim_http, which refuses and cuts requests at random, and the reply fed to
+// the response reader. Signing and sockets are not on the host and are
+// left out.
+//
+// On the device the soak would watch the largest free block. The traced
+// heap (sim_heap.c) allows a stricter check: once warmed up the loop may
+// not make a single heap call, so no block can move, and the allocator's
+// holes may not grow.
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cJSON.h"
+#include "arena.h"
+#include "firestore_writer.h"
+#include "firestore_reader.h"
+#include "gzip_stream.h"
+
+#include "sim_modes.h"
+#include "sim_http.h"
+#include "sim_heap.h"
+
+#define SOAK_UPLOADS 10000
+#define SOAK_WARMUP 100          // uploads before the baseline is taken
+#define SOAK_REPORT_EVERY 1000
+#define SOAK_TOKEN_EVERY 12      // one-hour tokens, a commit every 5 min
+#define SOAK_UPLOAD_PERIOD_S 300
+#define SOAK_PROJ_ID "host-sim-project"
+#define SOAK_MAX_RECORDS 500     // UPLOAD_MAX_RECORDS
+#define SOAK_GZIP_MIN_BODY 4096  // FIREBASE_GZIP_MIN_BODY
+#define SOAK_HTTP_FAIL_PPM 20000
+#define SOAK_HTTP_CUT_PPM 10000
+#define SOAK_SIG_B64_LEN 342     // base64 of a 2048-bit RS256 signature
+
+/* As in firebase.c */
+#define TOKEN_SIZE 1200
+#define AUTH_HEADER_SIZE (TOKEN_SIZE + sizeof("Bearer "))
+#define UPLOAD_ARENA_SIZE (AUTH_HEADER_SIZE + 2 * ARENA_ALIGN)
+/* As in firebase_cred.c */
+#define PAYLOAD_SIZE 512
+#define PAYLOAD_B64_SIZE 512
+#define HEADER_PAYLOAD_SIZE 1024
+#define SIG_B64_SIZE 1024
+#define JWT_SIZE (HEADER_PAYLOAD_SIZE + SIG_B64_SIZE)
+#define RESPONSE_BUFFER_SIZE 2048
+#define CRED_ARENA_SIZE (2 * (PAYLOAD_SIZE + PAYLOAD_B64_SIZE + HEADER_PAYLOAD_SIZE + \
+                              SIG_B64_SIZE + JWT_SIZE + RESPONSE_BUFFER_SIZE))
+
+static const char s_token_reply[] =
+    "{\"access_token\":\"ya29.c.host-sim-token\",\"expires_in\":3599,\"token_type\":\"Bearer\"}";
+static const char s_write_result[] = "{\"updateTime\":\"2025-10-09T08:53:20.123456Z\"}";
+
+static arena_t s_upload_arena;
+static arena_t s_cred_arena;
+static gzip_stream_t s_gz; // allocated once by firebase_init() on the device
+static avg_sample_t s_recs[SOAK_MAX_RECORDS];
+static char s_token[TOKEN_SIZE];
+static sim_http_t s_link = {
+    .rtt_ms = 250,
+    .kbit_s = 2000,
+    .timeout_ms = 5000,
+    .rng = 0x9E3779B97F4A7C15ULL,
+};
+
+static struct
+{
+    uint32_t uploads;
+    uint32_t acked;
+    uint32_t failed;
+    uint32_t gzipped;
+    uint32_t refreshes;
+    uint32_t refresh_failures;
+    uint64_t records;
+} s_soak;
+
+/* As _build_token_request() and _request_token(), minus base64, signing
+ * and the socket; the buffers are filled to their usual lengths */
+static bool _refresh_token(time_t now)
+{
+    arena_reset(&s_cred_arena);
+    arena_bind_cjson(&s_cred_arena);
+    bool ok = false;
+    char *payload = arena_alloc(&s_cred_arena, PAYLOAD_SIZE);
+    char *payload_b64 = arena_alloc(&s_cred_arena, PAYLOAD_B64_SIZE);
+    char *header_payload = arena_alloc(&s_cred_arena, HEADER_PAYLOAD_SIZE);
+    char *sig_b64 = arena_alloc(&s_cred_arena, SIG_B64_SIZE);
+    char *jwt = arena_alloc(&s_cred_arena, JWT_SIZE);
+    if (payload && payload_b64 && header_payload && sig_b64 && jwt)
+    {
+        snprintf(payload, PAYLOAD_SIZE,
+                 "{\"iss\":\"%s\",\"scope\":\"%s\",\"aud\":\"%s\",\"iat\":%lld,\"exp\":%lld}",
+                 "host-sim@host-sim-project.iam.gserviceaccount.com",
+                 "https://www.googleapis.com/auth/datastore", "https://oauth2.googleapis.com/token",
+                 (long long)now, (long long)(now + 3600));
+        strlcpy(payload_b64, payload, PAYLOAD_B64_SIZE);
+        snprintf(header_payload, HEADER_PAYLOAD_SIZE, "eyJhbGciOiJSUzI1NiIsInR5cCI6IkpXVCJ9.%s",
+                 payload_b64);
+        memset(sig_b64, 'S', SOAK_SIG_B64_LEN);
+        sig_b64[SOAK_SIG_B64_LEN] = '\0';
+        snprintf(jwt, JWT_SIZE, "%s.%s", header_payload, sig_b64);
+
+        cJSON *root = cJSON_CreateObject();
+        cJSON_AddStringToObject(root, "grant_type", "urn:ietf:params:oauth:grant-type:jwt-bearer");
+        cJSON_AddStringToObject(root, "assertion", jwt);
+        char *post_data = cJSON_PrintUnformatted(root);
+
+        char *response_buffer = arena_alloc(&s_cred_arena, RESPONSE_BUFFER_SIZE + 1);
+        if (post_data && response_buffer)
+        {
+            strlcpy(response_buffer, s_token_reply, RESPONSE_BUFFER_SIZE + 1);
+            cJSON *resp_json = cJSON_Parse(response_buffer);
+            cJSON *token = cJSON_GetObjectItem(resp_json, "access_token");
+            if (cJSON_IsString(token))
+            {
+                strlcpy(s_token, token->valuestring, sizeof(s_token));
+                ok = true;
+            }
+        }
+    }
+    arena_bind_cjson(NULL);
+    return ok;
+}
+
+static esp_err_t _gzip_sink(void *ctx, const char *data, size_t len)
+{
+    return gzip_stream_write(ctx, data, len);
+}
+
+/* The reply a commit of `count` writes gets, fed in the pieces a socket
+ * read would return */
+static firestore_action_t _read_reply(size_t count)
+{
+    firestore_resp_t resp;
+    firestore_resp_init(&resp, 200);
+    firestore_resp_feed(&resp, "{\"writeResults\":[", 17);
+    for (size_t i = 0; i < count; i++)
+    {
+        if (i)
+        {
+            firestore_resp_feed(&resp, ",", 1);
+        }
+        firestore_resp_feed(&resp, s_write_result, sizeof(s_write_result) - 1);
+    }
+    static const char tail[] = "],\"commitTime\":\"2025-10-09T08:53:20.123456Z\"}";
+    firestore_resp_feed(&resp, tail, sizeof(tail) - 1);
+    return firestore_resp_action(&resp);
+}
+
+/* As _firestore_commit(); returns the modelled request time */
+static int64_t _commit(size_t count, int64_t now_us)
+{
+    arena_reset(&s_upload_arena);
+    char *auth_header = arena_alloc(&s_upload_arena, AUTH_HEADER_SIZE);
+    if (!auth_header)
+    {
+        s_soak.failed++;
+        return 0;
+    }
+    snprintf(auth_header, AUTH_HEADER_SIZE, "Bearer %s", s_token);
+
+    size_t body_len = firestore_commit_serialize(SOAK_PROJ_ID, s_recs, count, NULL, 0);
+    esp_err_t err = sim_http_begin(&s_link, now_us);
+    if (err == ESP_OK && body_len >= SOAK_GZIP_MIN_BODY)
+    {
+        s_soak.gzipped++;
+        err = gzip_stream_init(&s_gz, sim_http_sink, &s_link);
+        if (err == ESP_OK)
+        {
+            err = firestore_commit_stream(SOAK_PROJ_ID, s_recs, count, _gzip_sink, &s_gz, NULL);
+        }
+        if (err == ESP_OK)
+        {
+            err = gzip_stream_finish(&s_gz);
+        }
+    }
+    else if (err == ESP_OK)
+    {
+        err = firestore_commit_stream(SOAK_PROJ_ID, s_recs, count, sim_http_sink, &s_link, NULL);
+    }
+    if (err == ESP_OK && _read_reply(count) == FIRESTORE_ACK)
+    {
+        s_soak.acked++;
+        s_soak.records += count;
+    }
+    else
+    {
+        s_soak.failed++;
+    }
+    s_soak.uploads++;
+    return sim_http_end(&s_link);
+}
+
+static void _fill_records(void)
+{
+    for (size_t i = 0; i < SOAK_MAX_RECORDS; i++)
+    {
+        float v = 68.0f + (float)(i % 37) * 0.137f;
+        s_recs[i] = (avg_sample_t){
+            .timestamp = 1760000000 + (time_t)(i / 2) * 60,
+            .average = v,
+            .channel = i % 2,
+            .samples = 12,
+            .min = v - 0.4f,
+            .max = v + 0.6f,
+            .stddev = 0.21f,
+            .p50 = v - 0.05f,
+            .p95 = v + 0.5f,
+        };
+    }
+}
+
+static void _report(uint32_t n, const sim_heap_stats_t *hs, const sim_heap_stats_t *base)
+{
+    printf("upload %5" PRIu32 ": heap calls %+" PRId64 ", live %zu B in %" PRIu32
+           " blocks, holes %zu B, arena high water %zu/%zu B\n",
+           n, (int64_t)(hs->allocs - base->allocs), hs->live_bytes, hs->live_blocks, hs->holes,
+           s_upload_arena.high_water, s_cred_arena.high_water);
+}
+
+bool sim_upload_soak(void)
+{
+    uint32_t uploads = sim_env_u32("SIM_UPLOADS", SOAK_UPLOADS);
+    uint32_t slack = sim_env_u32("SIM_SOAK_SLACK", 0);
+    s_link.fail_ppm = sim_env_u32("SIM_HTTP_FAIL_PPM", SOAK_HTTP_FAIL_PPM);
+    s_link.cut_ppm = sim_env_u32("SIM_HTTP_CUT_PPM", SOAK_HTTP_CUT_PPM);
+
+    // sized once at start-up, as firebase_init() and firebase_cred_start()
+    if (arena_init(&s_upload_arena, "upload", UPLOAD_ARENA_SIZE) != ESP_OK ||
+        arena_init(&s_cred_arena, "cred", CRED_ARENA_SIZE) != ESP_OK)
+    {
+        printf("Cannot set up the arenas\n");
+        return false;
+    }
+    _fill_records();
+    printf("Upload soak: %" PRIu32 " commits, a token refresh every %d, %" PRIu32
+           " ppm refused, %" PRIu32 " ppm cut, slack %" PRIu32 " B\n",
+           uploads, SOAK_TOKEN_EVERY, s_link.fail_ppm, s_link.cut_ppm, slack);
+
+    sim_heap_stats_t base = {0};
+    sim_heap_stats_t hs = {0};
+    size_t max_holes = 0;
+    int64_t now_us = 0;
+    uint64_t rng = 0x2545F4914F6CDD1DULL;
+    uint64_t t0 = sim_now_ns();
+    for (uint32_t n = 0; n < uploads; n++)
+    {
+        if (n == SOAK_WARMUP)
+        {
+            sim_heap_get_stats(&base);
+        }
+        time_t now = 1760000000 + now_us / 1000000;
+        if (n % SOAK_TOKEN_EVERY == 0)
+        {
+            s_soak.refreshes++;
+            if (!_refresh_token(now))
+            {
+                s_soak.refresh_failures++;
+            }
+        }
+
+        // chunk sizes as the uploader sees them: mostly a few records,
+        // now and then a backlog after an outage
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        size_t count = rng % 8 ? 5 + rng % 20 : 1 + rng % SOAK_MAX_RECORDS;
+        now_us += _commit(count, now_us) + (int64_t)SOAK_UPLOAD_PERIOD_S * 1000000;
+
+        if (n >= SOAK_WARMUP)
+        {
+            sim_heap_get_stats(&hs);
+            if (hs.holes > max_holes)
+            {
+                max_holes = hs.holes;
+            }
+            if ((n + 1) % SOAK_REPORT_EVERY == 0)
+            {
+                _report(n + 1, &hs, &base);
+            }
+        }
+    }
+    double wall_s = (sim_now_ns() - t0) / 1e9;
+
+    int64_t heap_calls = (int64_t)(hs.allocs - base.allocs) + (int64_t)(hs.frees - base.frees);
+    long long live_growth = (long long)hs.live_bytes - (long long)base.live_bytes;
+    long long holes_growth = (long long)max_holes - (long long)base.holes;
+    uint32_t fallbacks = s_upload_arena.fallbacks + s_cred_arena.fallbacks;
+    uint32_t overflows = s_upload_arena.failures + s_cred_arena.failures;
+    bool pass = uploads > SOAK_WARMUP && heap_calls == 0 && live_growth == 0 &&
+                holes_growth <= (long long)slack && fallbacks == 0 && overflows == 0 &&
+                s_soak.refresh_failures == 0 && s_soak.acked > 0;
+    if (!pass && heap_calls)
+    {
+        printf("Heap calls after warm-up; live blocks by caller:\n");
+        sim_heap_dump(10);
+    }
+    printf("%s: %" PRIu32 " commits (%" PRIu32 " acked, %" PRIu32 " failed, %" PRIu32
+           " gzip), %" PRIu32 " refreshes\n",
+           pass ? "UPLOAD SOAK PASS" : "UPLOAD SOAK FAIL", s_soak.uploads, s_soak.acked,
+           s_soak.failed, s_soak.gzipped, s_soak.refreshes);
+    printf("RESULT mode=upload_soak uploads=%" PRIu32 " acked=%" PRIu32 " failed=%" PRIu32
+           " records=%" PRIu64 " refreshes=%" PRIu32 " wall_s=%.2f heap_calls=%" PRId64
+           " live_growth=%lld holes=%zu max_holes=%zu arena_upload_hw=%zu arena_cred_hw=%zu"
+           " arena_fallbacks=%" PRIu32 " arena_overflows=%" PRIu32 "\n",
+           s_soak.uploads, s_soak.acked, s_soak.failed, s_soak.records, s_soak.refreshes,
+           wall_s, heap_calls, live_growth, hs.holes, max_holes, s_upload_arena.high_water,
+           s_cred_arena.high_water, fallbacks, overflows);
+    return pass;
+}
@@ -0,0 +1,194 @@
+// sim_writer.c — Firestore commit bodies: cJSON tree against firestore_writer
+//
+// Commit bodies of WRITER_BATCHES writes (5, the uploader default, up to the
+// 500 Firestore allows) are produced three ways:
+//   cjson      a cJSON tree and cJSON_PrintUnformatted(), as the firmware
+//              did before firestore_writer.c (sim_cjson_commit_body())
+//   buffer     firestore_commit_serialize() into a caller buffer
+//   stream     firestore_commit_stream() into a sink standing in for
+//              esp_http_client_write(), which copies each chunk
+// For each: MB/s of body produced, traced heap calls per body and the peak
+// of traced heap while building one (sim_heap.c).
+//
+// The run fails if the three bodies are not byte-identical or the writer
+// touches the heap.
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cJSON.h"
+#include "firestore_writer.h"
+#include "sim_heap.h"
+#include "sim_modes.h"
+
+#define WRITER_PROJ_ID "host-sim-project"
+#define WRITER_BODY_BYTES 2000000 // body bytes produced per path and batch size
+#define WRITER_REC_MAX 400        // bound on one record's share of a body
+
+static const size_t s_batches[] = {5, 20, 100, 500};
+
+typedef struct
+{
+    uint64_t bytes;
+    uint64_t ns;
+    uint64_t allocs;
+    uint32_t bodies;
+    size_t peak;
+} writer_res_t;
+
+typedef struct
+{
+    char *out;     // collects the streamed body in the checked pass
+    size_t len;
+    size_t cap;
+    char wire[FIRESTORE_WRITER_CHUNK];
+} wire_t;
+
+static avg_sample_t s_recs[FIRESTORE_MAX_WRITES];
+static char s_body[FIRESTORE_MAX_WRITES * WRITER_REC_MAX];
+static char s_streamed[FIRESTORE_MAX_WRITES * WRITER_REC_MAX];
+
+static void _make_records(void)
+{
+    time_t t = 1760000000;
+    for (size_t i = 0; i < FIRESTORE_MAX_WRITES; i++)
+    {
+        float avg = 60.0f + (float)(i % 97) * 0.37f;
+        t += 60 + (i * 7919) % 840;
+        s_recs[i] = (avg_sample_t){
+            .timestamp = t,
+            .average = avg,
+            .channel = i % 3 == 2 ? 1 : 0,
+            .samples = 12,
+            .min = avg - 0.8f,
+            .max = avg + 1.1f,
+            .stddev = 0.35f,
+            .p50 = avg - 0.05f,
+            .p95 = avg + 0.9f,
+        };
+    }
+}
+
+/* What esp_http_client_write() costs the caller: a copy of the chunk */
+static esp_err_t _wire_sink(void *ctx, const char *data, size_t len)
+{
+    wire_t *w = ctx;
+    memcpy(w->wire, data, len);
+    if (w->out)
+    {
+        if (w->len + len > w->cap)
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        memcpy(w->out + w->len, data, len);
+    }
+    w->len += len;
+    return ESP_OK;
+}
+
+/* One body on path `path`; returns its length, 0 on failure */
+static size_t _body(int path, size_t batch, wire_t *w)
+{
+    switch (path)
+    {
+    case 0:
+    {
+        char *body = sim_cjson_commit_body(WRITER_PROJ_ID, s_recs, batch);
+        size_t len = body ? strlen(body) : 0;
+        if (body && w->out && len < w->cap)
+        {
+            memcpy(w->out, body, len + 1);
+        }
+        cJSON_free(body);
+        return len;
+    }
+    case 1:
+    {
+        size_t len = firestore_commit_serialize(WRITER_PROJ_ID, s_recs, batch, s_body, sizeof(s_body));
+        return len < sizeof(s_body) ? len : 0;
+    }
+    default:
+    {
+        size_t total = 0;
+        w->len = 0;
+        return firestore_commit_stream(WRITER_PROJ_ID, s_recs, batch, _wire_sink, w, &total) == ESP_OK
+                   ? total
+                   : 0;
+    }
+    }
+}
+
+bool sim_writer(void)
+{
+    static const char *const paths[] = {"cjson", "buffer", "stream"};
+    _make_records();
+    bool pass = true;
+    char result[768];
+    int rlen = snprintf(result, sizeof(result), "RESULT mode=writer");
+
+    printf("  writes  path     body bytes    MB/s  heap calls/body  peak heap\n");
+    for (size_t b = 0; b < sizeof(s_batches) / sizeof(s_batches[0]); b++)
+    {
+        size_t batch = s_batches[b];
+        writer_res_t res[3] = {0};
+        size_t lens[3] = {0};
+
+        // checked pass: every path must give the cJSON body
+        static char cjson_body[sizeof(s_body)];
+        wire_t check = {.out = cjson_body, .cap = sizeof(cjson_body)};
+        lens[0] = _body(0, batch, &check);
+        lens[1] = _body(1, batch, &check);
+        check.out = s_streamed;
+        check.cap = sizeof(s_streamed);
+        lens[2] = _body(2, batch, &check);
+        if (!lens[0] || lens[1] != lens[0] || lens[2] != lens[0] ||
+            memcmp(s_body, cjson_body, lens[0]) != 0 || memcmp(s_streamed, cjson_body, lens[0]) != 0)
+        {
+            printf("WRITER FAIL: %zu-write bodies differ (cjson %zu, buffer %zu, stream %zu bytes)\n",
+                   batch, lens[0], lens[1], lens[2]);
+            pass = false;
+            continue;
+        }
+
+        uint32_t reps = WRITER_BODY_BYTES / lens[0] + 1;
+        for (int p = 0; p < 3; p++)
+        {
+            wire_t wire = {0};
+            sim_heap_stats_t h0, h1;
+            sim_heap_start();
+            sim_heap_get_stats(&h0);
+            uint64_t t0 = sim_now_ns();
+            for (uint32_t r = 0; r < reps; r++)
+            {
+                res[p].bytes += _body(p, batch, &wire);
+            }
+            res[p].ns = sim_now_ns() - t0;
+            sim_heap_get_stats(&h1);
+            res[p].allocs = h1.allocs - h0.allocs;
+            res[p].bodies = reps;
+            res[p].peak = h1.peak_bytes;
+            printf("  %6zu  %-7s %11zu %7.1f %16.1f %10zu\n", batch, paths[p], lens[0],
+                   res[p].bytes * 1e3 / res[p].ns, (double)res[p].allocs / reps, res[p].peak);
+            if (p && (res[p].allocs || res[p].peak))
+            {
+                printf("WRITER FAIL: %s made %" PRIu64 " heap calls for %" PRIu32 " bodies\n", paths[p],
+                       res[p].allocs, reps);
+                pass = false;
+            }
+        }
+        if (rlen > 0 && (size_t)rlen < sizeof(result))
+        {
+            rlen += snprintf(result + rlen, sizeof(result) - rlen,
+                             " w%zu_bytes=%zu w%zu_cjson_mb_s=%.1f w%zu_cjson_allocs=%.0f w%zu_cjson_peak=%zu"
+                             " w%zu_buffer_mb_s=%.1f w%zu_stream_mb_s=%.1f",
+                             batch, lens[0], batch, res[0].bytes * 1e3 / res[0].ns, batch,
+                             (double)res[0].allocs / res[0].bodies, batch, res[0].peak, batch,
+                             res[1].bytes * 1e3 / res[1].ns, batch, res[2].bytes * 1e3 / res[2].ns);
+        }
+    }
+    printf("%s\n", pass ? "WRITER PASS" : "WRITER FAIL");
+    printf("%s\n", result);
+    return pass;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stdbool.h>
+
+/**
+ * The part of esp_tinyusb's tusb_msc_storage.h that config_cache.c uses,
+ * for the linux target (sim_config.c). The simulator decides when the USB
+ * host owns the volume.
+ */
+bool tinyusb_msc_storage_in_use_by_usb_host(void);
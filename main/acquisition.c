@@ -0,0 +1,449 @@
+// acquisition.c — channel registry and sampling scheduler
+//
+// Every sensor quantity is a channel in a static table; devices on the shared
+// I2C bus are registered once and may feed several channels (the AHT21
+// yields temperature and humidity from one transaction). A single task wakes
+// once per scheduler tick, reads every device that has a channel due and
+// pushes one sample_rec_t per due channel to the uploader. Adding a channel
+// costs a table row, not a timer and a global.
+
+#include "acquisition.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "uploader.h"
+#include "cadence.h"
+#include "config_cache.h"
+#include "perf_metrics.h"
+#include "boot.h"
+
+static const char *TAG = "Acquisition";
+
+typedef struct
+{
+    acq_driver_t drv;
+    void *ctx;
+    uint8_t n_outputs;
+    bool due;
+    bool ok;       // start() and read() succeeded this tick; values are fresh
+    float values[ACQ_MAX_OUTPUTS];
+    uint32_t errors;
+} acq_device_t;
+
+typedef struct
+{
+    acq_channel_cfg_t cfg;
+    uint32_t period_ms;      // effective period (cfg or cadence)
+    uint32_t period_ticks;
+    uint32_t countdown;      // ticks until the next sample
+} acq_channel_t;
+
+static struct
+{
+    acq_device_t devices[ACQ_MAX_DEVICES];
+    uint8_t n_devices;
+    acq_channel_t channels[SENSOR_MAX_CHANNELS];
+    uint8_t n_channels;
+    uint32_t tick_ms;
+    uint32_t cadence_gen;
+    TaskHandle_t task;
+    SemaphoreHandle_t bus_lock; // one start..read sequence on the bus at a time
+    perf_metric_t *m_read;
+    perf_metric_t *m_errors;
+    portMUX_TYPE stats_lock;
+    acq_stats_t stats;          // since boot or the last acq_reset_stats()
+} s_acq = {
+    .stats_lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static uint32_t _gcd(uint32_t a, uint32_t b)
+{
+    while (b)
+    {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+esp_err_t acq_register_device(const acq_driver_t *drv, void *ctx, uint8_t n_outputs,
+                              uint8_t *out_id)
+{
+    if (!drv || !drv->read || n_outputs == 0 || n_outputs > ACQ_MAX_OUTPUTS || !out_id)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_acq.task || s_acq.n_devices == ACQ_MAX_DEVICES)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    acq_device_t *dev = &s_acq.devices[s_acq.n_devices];
+    dev->drv = *drv;
+    dev->ctx = ctx;
+    dev->n_outputs = n_outputs;
+    *out_id = s_acq.n_devices++;
+    return ESP_OK;
+}
+
+/* Per-channel report filter overrides from cfg.json */
+static void _load_report_cfg(const char *name, report_filter_cfg_t *cfg)
+{
+    char key[48];
+    const char *val;
+
+    // the values are parsed in place; hold off a reload by the uploader
+    config_cache_lock();
+    snprintf(key, sizeof(key), "%s_filter", name);
+    if ((val = config_cache_find(key)) != NULL && !report_filter_mode_from_str(val, &cfg->mode))
+    {
+        ESP_LOGW(TAG, "%s: unknown filter \"%s\"", key, val);
+    }
+    snprintf(key, sizeof(key), "%s_deadband", name);
+    if ((val = config_cache_find(key)) != NULL)
+    {
+        cfg->deadband = strtof(val, NULL);
+    }
+    snprintf(key, sizeof(key), "%s_heartbeat_s", name);
+    if ((val = config_cache_find(key)) != NULL)
+    {
+        cfg->max_silence_s = strtoul(val, NULL, 10);
+    }
+    config_cache_unlock();
+}
+
+esp_err_t acq_register_channel(const acq_channel_cfg_t *cfg, uint8_t *out_id)
+{
+    if (!cfg || !cfg->name || cfg->device >= s_acq.n_devices ||
+        cfg->output >= s_acq.devices[cfg->device].n_outputs)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_acq.task || s_acq.n_channels == SENSOR_MAX_CHANNELS)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    report_filter_cfg_t report = cfg->report;
+    _load_report_cfg(cfg->name, &report);
+    esp_err_t err = report_filter_configure(s_acq.n_channels, &report);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "%s: invalid report filter", cfg->name);
+        return err;
+    }
+
+    s_acq.channels[s_acq.n_channels].cfg = *cfg;
+    s_acq.channels[s_acq.n_channels].cfg.report = report;
+    if (out_id)
+    {
+        *out_id = s_acq.n_channels;
+    }
+    s_acq.n_channels++;
+    return ESP_OK;
+}
+
+uint8_t acq_channel_count(void)
+{
+    return s_acq.n_channels;
+}
+
+const acq_channel_cfg_t *acq_channel_get(uint8_t id)
+{
+    return id < s_acq.n_channels ? &s_acq.channels[id].cfg : NULL;
+}
+
+uint8_t acq_device_count(void)
+{
+    return s_acq.n_devices;
+}
+
+const char *acq_device_name(uint8_t id)
+{
+    return id < s_acq.n_devices ? s_acq.devices[id].drv.name : NULL;
+}
+
+esp_err_t acq_read_device(uint8_t id, float *out, size_t n_out, int64_t *read_us)
+{
+    if (id >= s_acq.n_devices || !out || n_out < s_acq.devices[id].n_outputs)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_acq.bus_lock)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    acq_device_t *dev = &s_acq.devices[id];
+    xSemaphoreTake(s_acq.bus_lock, portMAX_DELAY);
+    esp_err_t err = ESP_OK;
+    if (dev->drv.start)
+    {
+        err = dev->drv.start(dev->ctx);
+        if (err == ESP_OK && dev->drv.conversion_ms > 0)
+        {
+            vTaskDelay(pdMS_TO_TICKS(dev->drv.conversion_ms));
+        }
+    }
+    if (err == ESP_OK)
+    {
+        int64_t start = esp_timer_get_time();
+        err = dev->drv.read(dev->ctx, out, dev->n_outputs);
+        if (read_us)
+        {
+            *read_us = esp_timer_get_time() - start;
+        }
+    }
+    xSemaphoreGive(s_acq.bus_lock);
+    return err;
+}
+
+/* ----------------------------------------------------------------------------
+ * acq_run_tick
+ *   Reads every device with a due channel in one pass over the bus, then
+ *   queues one sample per due channel
+ * ------------------------------------------------------------------------- */
+static void acq_run_tick(int64_t t_us, int32_t jitter_us)
+{
+    bool any_due = false;
+    for (uint8_t i = 0; i < s_acq.n_channels; i++)
+    {
+        acq_channel_t *ch = &s_acq.channels[i];
+        if (ch->countdown == 0)
+        {
+            s_acq.devices[ch->cfg.device].due = true;
+            any_due = true;
+        }
+    }
+    if (!any_due)
+    {
+        return;
+    }
+
+    /* Trigger all conversions first, then wait once for the slowest */
+    xSemaphoreTake(s_acq.bus_lock, portMAX_DELAY);
+    uint32_t wait_ms = 0;
+    for (uint8_t d = 0; d < s_acq.n_devices; d++)
+    {
+        acq_device_t *dev = &s_acq.devices[d];
+        if (!dev->due)
+        {
+            continue;
+        }
+        dev->ok = true;
+        if (dev->drv.start)
+        {
+            esp_err_t err = dev->drv.start(dev->ctx);
+            if (err != ESP_OK)
+            {
+                // nothing was triggered; a read now would return an old conversion
+                dev->ok = false;
+                dev->errors++;
+                perf_count(s_acq.m_errors, 1);
+                ESP_LOGW(TAG, "%s start failed: %s (%" PRIu32 " errors)",
+                         dev->drv.name, esp_err_to_name(err), dev->errors);
+            }
+            else if (dev->drv.conversion_ms > wait_ms)
+            {
+                wait_ms = dev->drv.conversion_ms;
+            }
+        }
+    }
+    if (wait_ms > 0)
+    {
+        vTaskDelay(pdMS_TO_TICKS(wait_ms));
+    }
+
+    for (uint8_t d = 0; d < s_acq.n_devices; d++)
+    {
+        acq_device_t *dev = &s_acq.devices[d];
+        if (!dev->due || !dev->ok)
+        {
+            continue;
+        }
+        int64_t read_start = esp_timer_get_time();
+        esp_err_t err = dev->drv.read(dev->ctx, dev->values, dev->n_outputs);
+        perf_hist_since(s_acq.m_read, read_start);
+        dev->ok = err == ESP_OK;
+        if (!dev->ok)
+        {
+            dev->errors++;
+            perf_count(s_acq.m_errors, 1);
+            ESP_LOGW(TAG, "%s read failed: %s (%" PRIu32 " errors)",
+                     dev->drv.name, esp_err_to_name(err), dev->errors);
+        }
+    }
+    xSemaphoreGive(s_acq.bus_lock);
+
+    for (uint8_t i = 0; i < s_acq.n_channels; i++)
+    {
+        acq_channel_t *ch = &s_acq.channels[i];
+        if (ch->countdown > 0)
+        {
+            ch->countdown--;
+            continue;
+        }
+        ch->countdown = ch->period_ticks - 1;
+
+        const acq_device_t *dev = &s_acq.devices[ch->cfg.device];
+        if (!dev->ok)
+        {
+            continue;
+        }
+        sample_rec_t rec = {
+            .t_us = t_us,
+            .jitter_us = jitter_us,
+            .value = dev->values[ch->cfg.output] * ch->cfg.scale + ch->cfg.offset,
+            .channel = i,
+        };
+        if (!uploader_push_sample(&rec))
+        {
+            ESP_LOGW(TAG, "Sample queue full, %s sample dropped", ch->cfg.name);
+        }
+        else
+        {
+            boot_mark(BOOT_MILESTONE_FIRST_SAMPLE);
+        }
+    }
+
+    for (uint8_t d = 0; d < s_acq.n_devices; d++)
+    {
+        s_acq.devices[d].due = false;
+    }
+}
+
+/* ----------------------------------------------------------------------------
+ * acq_reschedule
+ *   Derives every channel's period and the scheduler tick from the current
+ *   cadence. A channel keeps its phase unless its new period is shorter
+ *   than the time it still had to wait.
+ * ------------------------------------------------------------------------- */
+static void acq_reschedule(bool first)
+{
+    cadence_t cad;
+    cadence_get(&cad);
+    s_acq.cadence_gen = cadence_generation();
+
+    uint32_t tick_ms = 0;
+    for (uint8_t i = 0; i < s_acq.n_channels; i++)
+    {
+        acq_channel_t *ch = &s_acq.channels[i];
+        ch->period_ms = ch->cfg.period_ms != ACQ_PERIOD_NODE ? ch->cfg.period_ms : cad.sample_ms;
+        tick_ms = _gcd(tick_ms, ch->period_ms);
+    }
+
+    for (uint8_t i = 0; i < s_acq.n_channels; i++)
+    {
+        acq_channel_t *ch = &s_acq.channels[i];
+        uint32_t remaining_ms = ch->countdown * s_acq.tick_ms;
+        ch->period_ticks = ch->period_ms / tick_ms;
+        ch->countdown = first ? 0 : MIN(remaining_ms / tick_ms, ch->period_ticks - 1);
+        ESP_LOGI(TAG, "Channel %u: %s on %s[%u], every %" PRIu32 " ms",
+                 i, ch->cfg.name, s_acq.devices[ch->cfg.device].drv.name,
+                 ch->cfg.output, ch->period_ms);
+    }
+    s_acq.tick_ms = tick_ms;
+    ESP_LOGI(TAG, "%u channels on %u devices, tick %" PRIu32 " ms",
+             s_acq.n_channels, s_acq.n_devices, tick_ms);
+}
+
+static void _account_tick(int32_t jitter_us)
+{
+    taskENTER_CRITICAL(&s_acq.stats_lock);
+    s_acq.stats.ticks++;
+    if (jitter_us > s_acq.stats.max_jitter_us)
+    {
+        s_acq.stats.max_jitter_us = jitter_us;
+    }
+    if (jitter_us > ACQ_DEADLINE_US)
+    {
+        s_acq.stats.missed++;
+    }
+    taskEXIT_CRITICAL(&s_acq.stats_lock);
+}
+
+static void acq_task(void *pvParameters)
+{
+    cadence_subscribe(xTaskGetCurrentTaskHandle());
+    int64_t next_due_us = esp_timer_get_time();
+
+    for (;;)
+    {
+        int64_t now_us = esp_timer_get_time();
+        if (now_us < next_due_us)
+        {
+            /* Sleep until the next tick; a cadence change wakes us early */
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS((next_due_us - now_us) / 1000) + 1);
+            if (cadence_generation() != s_acq.cadence_gen)
+            {
+                acq_reschedule(false);
+                next_due_us = esp_timer_get_time();
+            }
+            continue;
+        }
+
+        int32_t jitter_us = (int32_t)(now_us - next_due_us);
+        _account_tick(jitter_us);
+        next_due_us += (int64_t)s_acq.tick_ms * 1000;
+        if (next_due_us < now_us)
+        {
+            next_due_us = now_us; // overran by more than a tick, don't burst
+        }
+
+        acq_run_tick(now_us, jitter_us);
+    }
+}
+
+esp_err_t acq_start(void)
+{
+    if (s_acq.task)
+    {
+        return ESP_OK;
+    }
+    if (s_acq.n_channels == 0)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    s_acq.bus_lock = xSemaphoreCreateMutex();
+    if (!s_acq.bus_lock)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    acq_reschedule(true);
+    s_acq.m_read = perf_histogram("sensor.read_us");
+    s_acq.m_errors = perf_counter("sensor.errors");
+
+    if (xTaskCreatePinnedToCore(&acq_task, "acquisition", ACQ_STACK_SIZE, NULL,
+                                ACQ_PRIORITY, &s_acq.task, ACQ_CORE) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Acquisition task creation failed");
+        return ESP_ERR_NO_MEM;
+    }
+    perf_watch_task(s_acq.task, "acquisition");
+    return ESP_OK;
+}
+
+void acq_get_stats(acq_stats_t *out)
+{
+    taskENTER_CRITICAL(&s_acq.stats_lock);
+    *out = s_acq.stats;
+    taskEXIT_CRITICAL(&s_acq.stats_lock);
+}
+
+void acq_reset_stats(void)
+{
+    taskENTER_CRITICAL(&s_acq.stats_lock);
+    s_acq.stats = (acq_stats_t){0};
+    taskEXIT_CRITICAL(&s_acq.stats_lock);
+}
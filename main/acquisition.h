@@ -0,0 +1,113 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "sensor_record.h"
+#include "report_filter.h"
+
+#define ACQ_MAX_DEVICES 8
+#define ACQ_MAX_OUTPUTS 4        // values one device read can produce
+#define ACQ_STACK_SIZE CONFIG_SENSORCTL_ACQ_STACK_SIZE
+#define ACQ_PRIORITY CONFIG_SENSORCTL_ACQ_PRIORITY // highest on its core, sampling must win
+#define ACQ_CORE CONFIG_SENSORCTL_ACQ_CORE
+#define ACQ_DEADLINE_US CONFIG_SENSORCTL_ACQ_DEADLINE_US
+#define ACQ_PERIOD_NODE 0        // channel period follows cadence sample_ms
+
+/* Scheduler timing, for checking sampling deadlines under load */
+typedef struct
+{
+    uint32_t ticks;
+    int32_t max_jitter_us;   // latest start of a tick after its due time
+    uint32_t missed;         // ticks that started more than ACQ_DEADLINE_US late
+} acq_stats_t;
+
+/* Physical quantity a channel carries, for logs and unit handling */
+typedef enum
+{
+    ACQ_QTY_TEMPERATURE,
+    ACQ_QTY_HUMIDITY,
+    ACQ_QTY_PRESSURE,
+    ACQ_QTY_OTHER,
+} acq_quantity_t;
+
+/**
+ * Driver for one device on the shared I2C bus. On every tick the scheduler
+ * calls start() on all due devices, waits once for the longest
+ * conversion_ms, then calls read() on each of them, so N devices cost one
+ * task wake-up and one conversion wait per tick.
+ */
+typedef struct
+{
+    const char *name;
+    esp_err_t (*start)(void *ctx);                   // optional, trigger a conversion
+    esp_err_t (*read)(void *ctx, float *out, size_t n_out);
+    uint32_t conversion_ms;                          // wait between start() and read()
+} acq_driver_t;
+
+/* One typed value stream, e.g. "humidity of the AHT21 at 0x38" */
+typedef struct
+{
+    const char *name;        // short, used in logs and document names
+    acq_quantity_t quantity;
+    uint8_t device;          // id returned by acq_register_device()
+    uint8_t output;          // index into the device's read() values
+    uint32_t period_ms;      // sample period, ACQ_PERIOD_NODE to follow the cadence
+    float scale;             // value = raw * scale + offset
+    float offset;
+    report_filter_cfg_t report; // what reaches the upload log, see report_filter.h
+} acq_channel_cfg_t;
+
+/**
+ * @brief  Add a device to the registry.
+ * @param  n_outputs  Number of values the driver's read() fills.
+ * @param  out_id     Receives the device id for acq_channel_cfg_t.device.
+ */
+esp_err_t acq_register_device(const acq_driver_t *drv, void *ctx, uint8_t n_outputs,
+                              uint8_t *out_id);
+
+/**
+ * @brief  Add a channel. Ids are assigned in registration order, so the
+ *         first channel registered is SENSOR_CHANNEL_PRIMARY. The report
+ *         filter can be overridden from cfg.json with "<name>_filter"
+ *         (none|deadband|sdt), "<name>_deadband" and "<name>_heartbeat_s".
+ * @param  out_id  Optional, receives the channel id.
+ */
+esp_err_t acq_register_channel(const acq_channel_cfg_t *cfg, uint8_t *out_id);
+
+/** @brief Number of registered channels. */
+uint8_t acq_channel_count(void);
+
+/** @brief Registered channel config, or NULL for an unknown id. */
+const acq_channel_cfg_t *acq_channel_get(uint8_t id);
+
+/** @brief Number of registered devices. */
+uint8_t acq_device_count(void);
+
+/** @brief Driver name of a registered device, or NULL for an unknown id. */
+const char *acq_device_name(uint8_t id);
+
+/**
+ * @brief  Run one start/wait/read cycle on a device outside the schedule
+ *         (console diagnostics). Serialized with the acquisition task on
+ *         the bus, so it may wait up to one tick's conversion time.
+ * @param  n_out    Size of `out`, at least the device's n_outputs.
+ * @param  read_us  Optional, receives the duration of read() alone.
+ * @return ESP_ERR_INVALID_STATE before acq_start().
+ */
+esp_err_t acq_read_device(uint8_t id, float *out, size_t n_out, int64_t *read_us);
+
+/**
+ * @brief  Start the acquisition task on ACQ_CORE. The scheduler tick is the greatest
+ *         common divisor of all channel periods and is recomputed whenever
+ *         the cadence changes; register everything first.
+ */
+esp_err_t acq_start(void);
+
+/** @brief Tick count, worst jitter and missed deadlines since the last reset. */
+void acq_get_stats(acq_stats_t *out);
+
+/** @brief Zero the acq_get_stats() counters, e.g. before a stress run. */
+void acq_reset_stats(void);
@@ -0,0 +1,213 @@
+// boot.c — boot orchestrator
+//
+// app_main used to do everything in sequence: storage mount, USB, console,
+// then Ethernet, and only after an IP the SNTP/MQTT/sensor setup. The boot
+// is now a static table of stages with explicit dependencies; each stage
+// runs in its own short-lived task pinned to a core, so the flash mount,
+// PHY bring-up and sensor init overlap. Every stage and a few later
+// milestones are timestamped, which gives the cold-boot-to-first-upload
+// figure in the log, on the console (`boot`) and as metrics.
+
+#include "boot.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "freertos/event_groups.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_console.h"
+
+#include "perf_metrics.h"
+
+static const char *TAG = "Boot";
+
+typedef struct
+{
+    int64_t ready_us; // dependencies met
+    int64_t start_us;
+    int64_t end_us;
+    esp_err_t err;
+    bool skipped;
+} stage_result_t;
+
+static const char *const milestone_names[BOOT_MILESTONE_COUNT] = {
+    "ip", "time_sync", "first_sample", "first_upload"};
+static const char *const milestone_gauges[BOOT_MILESTONE_COUNT] = {
+    "boot.ip_ms", "boot.time_sync_ms", "boot.first_sample_ms", "boot.first_upload_ms"};
+
+static struct
+{
+    const boot_stage_t *stages;
+    size_t count;
+    EventGroupHandle_t done;  // one bit per finished (or skipped) stage
+    EventBits_t all;
+    stage_result_t results[BOOT_MAX_STAGES];
+    int64_t start_us;
+    int64_t milestones_us[BOOT_MILESTONE_COUNT];
+} s_boot;
+
+static void _finish(size_t i)
+{
+    EventBits_t bits = xEventGroupSetBits(s_boot.done, BOOT_STAGE(i));
+    if ((bits & s_boot.all) == s_boot.all)
+    {
+        int64_t now = esp_timer_get_time();
+        ESP_LOGI(TAG, "All %u stages done in %lld ms (%lld ms since timer start)",
+                 (unsigned)s_boot.count, (long long)((now - s_boot.start_us) / 1000),
+                 (long long)(now / 1000));
+        perf_gauge_set(perf_gauge("boot.stages_ms"), (int32_t)(now / 1000));
+        boot_report();
+    }
+}
+
+static void boot_stage_task(void *pvParameters)
+{
+    size_t i = (size_t)pvParameters;
+    const boot_stage_t *st = &s_boot.stages[i];
+    stage_result_t *res = &s_boot.results[i];
+
+    if (st->deps)
+    {
+        xEventGroupWaitBits(s_boot.done, st->deps, pdFALSE, pdTRUE, portMAX_DELAY);
+    }
+    res->ready_us = esp_timer_get_time();
+
+    for (size_t d = 0; d < s_boot.count; d++)
+    {
+        if ((st->deps & BOOT_STAGE(d)) && (s_boot.results[d].err != ESP_OK || s_boot.results[d].skipped))
+        {
+            ESP_LOGE(TAG, "%s skipped, %s did not complete", st->name, s_boot.stages[d].name);
+            res->skipped = true;
+            res->start_us = res->end_us = res->ready_us;
+            _finish(i);
+            vTaskDelete(NULL);
+        }
+    }
+
+    res->start_us = esp_timer_get_time();
+    res->err = st->run();
+    res->end_us = esp_timer_get_time();
+    if (res->err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "%s failed: %s", st->name, esp_err_to_name(res->err));
+    }
+    _finish(i);
+    vTaskDelete(NULL);
+}
+
+esp_err_t boot_run(const boot_stage_t *stages, size_t count)
+{
+    if (!stages || count == 0 || count > BOOT_MAX_STAGES || s_boot.stages)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        if (stages[i].deps >> i) // only earlier stages, so the graph has no cycles
+        {
+            ESP_LOGE(TAG, "%s depends on a later stage", stages[i].name);
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    s_boot.done = xEventGroupCreate();
+    if (!s_boot.done)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    s_boot.stages = stages;
+    s_boot.count = count;
+    s_boot.all = BOOT_STAGE(count) - 1;
+    s_boot.start_us = esp_timer_get_time();
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (xTaskCreatePinnedToCore(&boot_stage_task, stages[i].name, stages[i].stack_size,
+                                    (void *)i, stages[i].priority, NULL, stages[i].core) != pdPASS)
+        {
+            // the dependants of a stage that never runs would wait forever
+            ESP_LOGE(TAG, "%s: task creation failed", stages[i].name);
+            s_boot.results[i].err = ESP_ERR_NO_MEM;
+            _finish(i);
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t boot_wait(TickType_t timeout)
+{
+    if (!s_boot.done)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    EventBits_t bits = xEventGroupWaitBits(s_boot.done, s_boot.all, pdFALSE, pdTRUE, timeout);
+    return (bits & s_boot.all) == s_boot.all ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+void boot_mark(boot_milestone_t m)
+{
+    if (m >= BOOT_MILESTONE_COUNT || s_boot.milestones_us[m])
+    {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    s_boot.milestones_us[m] = now;
+    perf_gauge_set(perf_gauge(milestone_gauges[m]), (int32_t)(now / 1000));
+    ESP_LOGI(TAG, "Milestone %s at %lld ms", milestone_names[m], (long long)(now / 1000));
+}
+
+static int _core(const boot_stage_t *st)
+{
+    return st->core == tskNO_AFFINITY ? -1 : (int)st->core;
+}
+
+void boot_report(void)
+{
+    ESP_LOGI(TAG, "%-12s %4s %8s %8s %8s  %s", "stage", "core", "ready", "start", "took", "result");
+    for (size_t i = 0; i < s_boot.count; i++)
+    {
+        const boot_stage_t *st = &s_boot.stages[i];
+        const stage_result_t *res = &s_boot.results[i];
+        if (!res->end_us && !res->skipped && res->err == ESP_OK)
+        {
+            ESP_LOGI(TAG, "%-12s %4d  running", st->name, _core(st));
+            continue;
+        }
+        ESP_LOGI(TAG, "%-12s %4d %8lld %8lld %8lld  %s", st->name, _core(st),
+                 (long long)(res->ready_us / 1000), (long long)(res->start_us / 1000),
+                 (long long)((res->end_us - res->start_us) / 1000),
+                 res->skipped ? "skipped" : esp_err_to_name(res->err));
+    }
+    for (int m = 0; m < BOOT_MILESTONE_COUNT; m++)
+    {
+        if (s_boot.milestones_us[m])
+        {
+            ESP_LOGI(TAG, "%-12s %lld ms", milestone_names[m],
+                     (long long)(s_boot.milestones_us[m] / 1000));
+        }
+        else
+        {
+            ESP_LOGI(TAG, "%-12s not yet", milestone_names[m]);
+        }
+    }
+}
+
+static int console_boot(int argc, char **argv)
+{
+    boot_report();
+    printf("times in ms since the esp_timer started; core -1 = no affinity\n");
+    return 0;
+}
+
+esp_err_t boot_register_console(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "boot",
+        .help = "boot stage timeline and time to first sample/upload",
+        .hint = NULL,
+        .func = &console_boot,
+    };
+    return esp_console_cmd_register(&cmd);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+
+#define BOOT_MAX_STAGES 16
+#define BOOT_STAGE(id) (1UL << (id)) // dependency mask of one stage
+
+/**
+ * One step of the boot. Every stage gets its own task, pinned to `core`,
+ * which waits until all stages in `deps` have finished, runs `run` once
+ * and exits. Independent stages therefore overlap across both cores.
+ * A stage whose dependency failed is skipped, and so on down the graph.
+ */
+typedef struct
+{
+    const char *name;
+    esp_err_t (*run)(void);
+    uint32_t deps;         // BOOT_STAGE() of every prerequisite, by index in the table
+    BaseType_t core;       // 0, 1 or tskNO_AFFINITY
+    uint32_t stack_size;
+    UBaseType_t priority;
+} boot_stage_t;
+
+/* Milestones after the boot graph, each recorded once */
+typedef enum
+{
+    BOOT_MILESTONE_IP,           // Ethernet got an address
+    BOOT_MILESTONE_TIME_SYNC,    // wall clock valid
+    BOOT_MILESTONE_FIRST_SAMPLE, // first sample queued by acquisition
+    BOOT_MILESTONE_FIRST_UPLOAD, // first successful Firestore commit
+    BOOT_MILESTONE_COUNT,
+} boot_milestone_t;
+
+/**
+ * @brief  Start the stage graph and return without waiting. `stages` must
+ *         outlive the boot (a static table) and be ordered so that every
+ *         dependency has a lower index.
+ */
+esp_err_t boot_run(const boot_stage_t *stages, size_t count);
+
+/** @brief Wait until every stage has finished or been skipped. */
+esp_err_t boot_wait(TickType_t timeout);
+
+/**
+ * @brief  Record a milestone, in ms since the esp_timer started, the first
+ *         time it is reached; also exported as a "boot.<milestone>_ms"
+ *         gauge. Cheap enough to call on every pass of a hot loop.
+ */
+void boot_mark(boot_milestone_t m);
+
+/** @brief Log the stage timeline and the milestones reached so far. */
+void boot_report(void);
+
+/** @brief Register the `boot` console command (prints boot_report()). */
+esp_err_t boot_register_console(void);
@@ -0,0 +1,306 @@
+// cadence.c — runtime sample/window/batch cadence
+//
+// The cadence used to be compile-time #defines. It is now loaded at boot
+// (defaults < cfg.json < NVS) and can be changed live from the console or
+// over MQTT. Changes are persisted to NVS and pushed to the acquisition and
+// uploader tasks, which re-arm without dropping the window in progress.
+
+#include "cadence.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/semphr.h"
+
+#include "esp_log.h"
+#include "esp_console.h"
+#include "argtable3/argtable3.h"
+#include "cJSON.h"
+
+#include "uploader.h"
+#include "nvs_helper.h"
+#include "config_cache.h"
+#include "mqtt_man.h"
+
+static const char *TAG = "Cadence";
+
+/* NVS keys (max 15 chars) */
+#define NVS_SAMPLE_KEY "sample_ms"
+#define NVS_WINDOW_KEY "window_ms"
+#define NVS_BATCH_KEY "batch_size"
+#define NVS_ADAPTIVE_KEY "adaptive_batch"
+
+static struct
+{
+    SemaphoreHandle_t lock;
+    cadence_t current;
+    volatile uint32_t generation;
+    TaskHandle_t subscribers[CADENCE_MAX_SUBSCRIBERS];
+    uint8_t n_subscribers;
+} s_cad = {
+    .current = {
+        .sample_ms = SAMPLE_INTERVAL_MS,
+        .window_ms = WINDOW_INTERVAL_MS,
+        .batch_size = BATCH_SIZE,
+        .adaptive = false,
+    },
+};
+
+static esp_err_t _validate(const cadence_t *c)
+{
+    if (c->sample_ms < CADENCE_SAMPLE_MIN_MS || c->sample_ms > CADENCE_SAMPLE_MAX_MS)
+    {
+        ESP_LOGE(TAG, "sample_ms must be %u..%u", CADENCE_SAMPLE_MIN_MS, CADENCE_SAMPLE_MAX_MS);
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (c->window_ms < CADENCE_WINDOW_MIN_MS || c->window_ms < c->sample_ms ||
+        c->window_ms > CADENCE_WINDOW_MAX_MS || c->window_ms % 1000 != 0)
+    {
+        ESP_LOGE(TAG, "window_ms must be whole seconds, %u..%u and at least sample_ms",
+                 CADENCE_WINDOW_MIN_MS, CADENCE_WINDOW_MAX_MS);
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (c->batch_size < 1 || c->batch_size > UPLOAD_MAX_RECORDS)
+    {
+        ESP_LOGE(TAG, "batch_size must be 1..%u", UPLOAD_MAX_RECORDS);
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+static uint32_t _cfg_u32(const char *key, uint32_t fallback)
+{
+    // parsed in place, so the uploader must not reload the table meanwhile
+    config_cache_lock();
+    const char *val = config_cache_find(key);
+    uint32_t out = fallback;
+    if (val)
+    {
+        char *end;
+        unsigned long v = strtoul(val, &end, 10);
+        if (end != val)
+        {
+            out = (uint32_t)v;
+        }
+    }
+    config_cache_unlock();
+    return out;
+}
+
+void cadence_load(void)
+{
+    if (!s_cad.lock)
+    {
+        s_cad.lock = xSemaphoreCreateMutex();
+    }
+
+    cadence_t c = s_cad.current;
+    c.sample_ms = _cfg_u32("sample_interval_ms", c.sample_ms);
+    c.window_ms = _cfg_u32("window_interval_ms", c.window_ms);
+    c.batch_size = _cfg_u32("batch_size", c.batch_size);
+    c.adaptive = _cfg_u32("adaptive_batch", c.adaptive) != 0;
+
+    c.sample_ms = (uint32_t)load_config_int(NVS_SAMPLE_KEY, (int32_t)c.sample_ms);
+    c.window_ms = (uint32_t)load_config_int(NVS_WINDOW_KEY, (int32_t)c.window_ms);
+    c.batch_size = (uint32_t)load_config_int(NVS_BATCH_KEY, (int32_t)c.batch_size);
+    c.adaptive = load_config_int(NVS_ADAPTIVE_KEY, c.adaptive) != 0;
+
+    if (_validate(&c) != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Stored cadence invalid, using defaults");
+        return;
+    }
+    s_cad.current = c;
+    ESP_LOGI(TAG, "sample %" PRIu32 " ms, window %" PRIu32 " ms, batch %" PRIu32 "%s",
+             c.sample_ms, c.window_ms, c.batch_size, c.adaptive ? " (adaptive)" : "");
+}
+
+void cadence_get(cadence_t *out)
+{
+    if (s_cad.lock)
+    {
+        xSemaphoreTake(s_cad.lock, portMAX_DELAY);
+    }
+    *out = s_cad.current;
+    if (s_cad.lock)
+    {
+        xSemaphoreGive(s_cad.lock);
+    }
+}
+
+esp_err_t cadence_set(const cadence_t *c, bool persist)
+{
+    esp_err_t err = _validate(c);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    if (!s_cad.lock)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(s_cad.lock, portMAX_DELAY);
+    cadence_t old = s_cad.current;
+    s_cad.current = *c;
+    s_cad.generation++;
+    xSemaphoreGive(s_cad.lock);
+
+    if (persist)
+    {
+        if (c->sample_ms != old.sample_ms)
+        {
+            save_config_int(NVS_SAMPLE_KEY, (int32_t)c->sample_ms);
+        }
+        if (c->window_ms != old.window_ms)
+        {
+            save_config_int(NVS_WINDOW_KEY, (int32_t)c->window_ms);
+        }
+        if (c->batch_size != old.batch_size)
+        {
+            save_config_int(NVS_BATCH_KEY, (int32_t)c->batch_size);
+        }
+        if (c->adaptive != old.adaptive)
+        {
+            save_config_int(NVS_ADAPTIVE_KEY, c->adaptive);
+        }
+    }
+
+    ESP_LOGI(TAG, "Applied: sample %" PRIu32 " ms, window %" PRIu32 " ms, batch %" PRIu32 "%s",
+             c->sample_ms, c->window_ms, c->batch_size, c->adaptive ? " (adaptive)" : "");
+
+    for (uint8_t i = 0; i < s_cad.n_subscribers; i++)
+    {
+        xTaskNotifyGive(s_cad.subscribers[i]);
+    }
+    return ESP_OK;
+}
+
+uint32_t cadence_generation(void)
+{
+    return s_cad.generation;
+}
+
+esp_err_t cadence_subscribe(TaskHandle_t task)
+{
+    if (s_cad.n_subscribers == CADENCE_MAX_SUBSCRIBERS)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    s_cad.subscribers[s_cad.n_subscribers++] = task;
+    return ESP_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * Console: cadence [-s <ms>] [-w <ms>] [-b <n>] [-a <0|1>]
+ * ------------------------------------------------------------------------- */
+static struct
+{
+    struct arg_int *sample;
+    struct arg_int *window;
+    struct arg_int *batch;
+    struct arg_int *adaptive;
+    struct arg_end *end;
+} cadence_args;
+
+static int console_cadence(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **)&cadence_args);
+    if (nerrors != 0)
+    {
+        arg_print_errors(stderr, cadence_args.end, argv[0]);
+        return 1;
+    }
+
+    cadence_t c;
+    cadence_get(&c);
+    bool changed = false;
+    if (cadence_args.sample->count)
+    {
+        c.sample_ms = cadence_args.sample->ival[0];
+        changed = true;
+    }
+    if (cadence_args.window->count)
+    {
+        c.window_ms = cadence_args.window->ival[0];
+        changed = true;
+    }
+    if (cadence_args.batch->count)
+    {
+        c.batch_size = cadence_args.batch->ival[0];
+        changed = true;
+    }
+    if (cadence_args.adaptive->count)
+    {
+        c.adaptive = cadence_args.adaptive->ival[0] != 0;
+        changed = true;
+    }
+
+    if (changed && cadence_set(&c, true) != ESP_OK)
+    {
+        return 1;
+    }
+    cadence_get(&c);
+    printf("sample %" PRIu32 " ms, window %" PRIu32 " ms, batch %" PRIu32 ", adaptive %s\n",
+           c.sample_ms, c.window_ms, c.batch_size, c.adaptive ? "on" : "off");
+    return 0;
+}
+
+esp_err_t cadence_register_console(void)
+{
+    cadence_args.sample = arg_int0("s", "sample", "<ms>", "sample period");
+    cadence_args.window = arg_int0("w", "window", "<ms>", "averaging window, whole seconds");
+    cadence_args.batch = arg_int0("b", "batch", "<n>", "records per upload");
+    cadence_args.adaptive = arg_int0("a", "adaptive", "<0|1>", "adaptive batch size");
+    cadence_args.end = arg_end(4);
+
+    const esp_console_cmd_t cmd = {
+        .command = "cadence",
+        .help = "show or change sample/window/batch cadence (saved to NVS)",
+        .hint = NULL,
+        .func = &console_cadence,
+        .argtable = &cadence_args,
+    };
+    return esp_console_cmd_register(&cmd);
+}
+
+/* ----------------------------------------------------------------------------
+ * MQTT: JSON object with any of sample_ms, window_ms, batch, adaptive
+ * ------------------------------------------------------------------------- */
+static void mqtt_cadence_cb(const char *data, int len, void *arg)
+{
+    cJSON *root = cJSON_ParseWithLength(data, len);
+    if (!root)
+    {
+        ESP_LOGW(TAG, "Ignoring malformed cadence message");
+        return;
+    }
+
+    cadence_t c;
+    cadence_get(&c);
+    cJSON *item;
+    if (cJSON_IsNumber(item = cJSON_GetObjectItem(root, "sample_ms")))
+    {
+        c.sample_ms = (uint32_t)item->valuedouble;
+    }
+    if (cJSON_IsNumber(item = cJSON_GetObjectItem(root, "window_ms")))
+    {
+        c.window_ms = (uint32_t)item->valuedouble;
+    }
+    if (cJSON_IsNumber(item = cJSON_GetObjectItem(root, "batch")))
+    {
+        c.batch_size = (uint32_t)item->valuedouble;
+    }
+    if ((item = cJSON_GetObjectItem(root, "adaptive")) != NULL)
+    {
+        c.adaptive = cJSON_IsTrue(item) || (cJSON_IsNumber(item) && item->valuedouble != 0);
+    }
+    cJSON_Delete(root);
+
+    cadence_set(&c, true);
+}
+
+esp_err_t cadence_register_mqtt(void)
+{
+    return mqtt_man_subscribe(CADENCE_MQTT_TOPIC, 1, mqtt_cadence_cb, NULL);
+}
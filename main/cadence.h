@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+
+/* Accepted ranges for live changes */
+#define CADENCE_SAMPLE_MIN_MS 100
+#define CADENCE_SAMPLE_MAX_MS 3600000
+/* Windows are whole seconds: record timestamps, and the Firestore document
+ * IDs built from them, have one-second resolution, so two windows closing
+ * within the same second would overwrite each other */
+#define CADENCE_WINDOW_MIN_MS 1000
+#define CADENCE_WINDOW_MAX_MS 86400000
+#define CADENCE_MAX_SUBSCRIBERS 4
+
+/* MQTT topic that accepts {"sample_ms":..,"window_ms":..,"batch":..,"adaptive":..} */
+#define CADENCE_MQTT_TOPIC "sensorControl/cadence/set"
+
+/* Node-wide sampling/upload cadence */
+typedef struct
+{
+    uint32_t sample_ms;  // default period of acquisition channels
+    uint32_t window_ms;  // averaging window length
+    uint32_t batch_size; // records pending before an upload (floor in adaptive mode)
+    bool adaptive;       // let the uploader grow the batch when the link is slow
+} cadence_t;
+
+/**
+ * @brief  Load the cadence at boot. Compile-time defaults are overridden by
+ *         cfg.json ("sample_interval_ms", "window_interval_ms", "batch_size",
+ *         "adaptive_batch"), which is in turn overridden by values saved in
+ *         NVS by earlier live changes. Call after init_nvs() and the config
+ *         cache are up.
+ */
+void cadence_load(void);
+
+/** @brief Copy of the current cadence. */
+void cadence_get(cadence_t *out);
+
+/**
+ * @brief  Validate and apply a new cadence, optionally persisting it to NVS,
+ *         then wake every subscribed task.
+ * @return ESP_ERR_INVALID_ARG if a value is out of range (nothing changes).
+ */
+esp_err_t cadence_set(const cadence_t *c, bool persist);
+
+/** @brief Bumped on every applied change; tasks compare it to re-arm. */
+uint32_t cadence_generation(void);
+
+/**
+ * @brief  Have `task` notified (xTaskNotifyGive) on every change, so a task
+ *         sleeping for a long period picks the new cadence up immediately.
+ */
+esp_err_t cadence_subscribe(TaskHandle_t task);
+
+/** @brief Register the `cadence` console command. */
+esp_err_t cadence_register_console(void);
+
+/** @brief Accept cadence changes on CADENCE_MQTT_TOPIC. */
+esp_err_t cadence_register_mqtt(void);
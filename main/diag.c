@@ -0,0 +1,603 @@
+// diag.c — field diagnostics on the USB console
+//
+// Everything needed to look at a misbehaving unit on site without a
+// debugger: per-task CPU share and stack headroom, heap fragmentation,
+// upload backlog and latencies, token age, and in-place timings of the
+// three hot paths (sensor read, JSON build, flash read), and a stress run
+// that saturates the network core while checking the sampling deadlines.
+// Commands only read shared state through the owning module's accessors, so
+// they are safe to run while the node keeps sampling and uploading.
+
+#include "diag.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_console.h"
+#include "esp_rom_crc.h"
+#include "argtable3/argtable3.h"
+
+#include "sensor_record.h"
+#include "record_log.h"
+#include "firestore_writer.h"
+#include "firestore_reader.h"
+#include "firebase_cred.h"
+#include "config_cache.h"
+#include "acquisition.h"
+#include "uploader.h"
+#include "mqtt_man.h"
+#include "sink_router.h"
+
+static const char *TAG = "Diag";
+
+/* ----------------------------------------------------------------------------
+ * tasks [-w <ms>]
+ *   Two snapshots of the scheduler's task list, `w` ms apart; CPU % is the
+ *   share of one core each task ran in between, as in vTaskGetRunTimeStats()
+ * ------------------------------------------------------------------------- */
+static struct
+{
+    struct arg_int *window;
+    struct arg_end *end;
+} tasks_args;
+
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY
+static char _state_char(eTaskState s)
+{
+    switch (s)
+    {
+    case eRunning:
+        return 'X';
+    case eReady:
+        return 'R';
+    case eBlocked:
+        return 'B';
+    case eSuspended:
+        return 'S';
+    case eDeleted:
+        return 'D';
+    default:
+        return '?';
+    }
+}
+
+static TaskStatus_t *_snapshot(UBaseType_t *n, configRUN_TIME_COUNTER_TYPE *total)
+{
+    // room for a few tasks created between the count and the copy
+    UBaseType_t cap = uxTaskGetNumberOfTasks() + 4;
+    TaskStatus_t *st = malloc(cap * sizeof(TaskStatus_t));
+    if (st)
+    {
+        *n = uxTaskGetSystemState(st, cap, total);
+    }
+    return st;
+}
+#endif
+
+static int console_tasks(int argc, char **argv)
+{
+    if (arg_parse(argc, argv, (void **)&tasks_args) != 0)
+    {
+        arg_print_errors(stderr, tasks_args.end, argv[0]);
+        return 1;
+    }
+
+#if !CONFIG_FREERTOS_USE_TRACE_FACILITY
+    printf("needs CONFIG_FREERTOS_USE_TRACE_FACILITY\n");
+    return 1;
+#else
+    int window_ms = tasks_args.window->count ? tasks_args.window->ival[0] : DIAG_CPU_WINDOW_MS;
+    if (window_ms < 10)
+    {
+        window_ms = 10;
+    }
+
+    UBaseType_t n0 = 0, n1 = 0;
+    configRUN_TIME_COUNTER_TYPE total0 = 0, total1 = 0;
+    TaskStatus_t *before = _snapshot(&n0, &total0);
+    vTaskDelay(pdMS_TO_TICKS(window_ms));
+    TaskStatus_t *after = _snapshot(&n1, &total1);
+    if (!before || !after)
+    {
+        free(before);
+        free(after);
+        printf("out of memory\n");
+        return 1;
+    }
+
+    uint64_t elapsed = (uint64_t)(total1 - total0);
+    printf("%-16s %c %4s %6s %12s %6s\n", "task", 'S', "prio", "stack", "runtime", "cpu%");
+    for (UBaseType_t i = 0; i < n1; i++)
+    {
+        const TaskStatus_t *t = &after[i];
+        uint64_t ran = (uint64_t)t->ulRunTimeCounter;
+        for (UBaseType_t j = 0; j < n0; j++)
+        {
+            if (before[j].xHandle == t->xHandle)
+            {
+                ran -= (uint64_t)before[j].ulRunTimeCounter;
+                break;
+            }
+        }
+        // runtime counters need CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+        unsigned tenths = elapsed ? (unsigned)(ran * 1000 / elapsed) : 0;
+        printf("%-16s %c %4u %6u %12" PRIu64 " %3u.%u\n",
+               t->pcTaskName, _state_char(t->eCurrentState), (unsigned)t->uxCurrentPriority,
+               (unsigned)t->usStackHighWaterMark, (uint64_t)t->ulRunTimeCounter,
+               tenths / 10, tenths % 10);
+    }
+    printf("%u tasks, window %d ms; S: X running R ready B blocked S suspended, "
+           "stack = words never used\n",
+           (unsigned)n1, window_ms);
+
+    free(before);
+    free(after);
+    return 0;
+#endif
+}
+
+/* ----------------------------------------------------------------------------
+ * heap
+ *   Fragmentation is the share of free memory that is not in the largest
+ *   free block: 0 % means one contiguous hole
+ * ------------------------------------------------------------------------- */
+static void _print_heap(const char *label, uint32_t caps)
+{
+    size_t total = heap_caps_get_total_size(caps);
+    if (total == 0)
+    {
+        return;
+    }
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, caps);
+
+    unsigned frag = info.total_free_bytes
+                        ? (unsigned)(100 - info.largest_free_block * 100 / info.total_free_bytes)
+                        : 0;
+    printf("%-9s total %7u  free %7u  min %7u  largest %7u  frag %3u%%  blocks %u/%u\n",
+           label, (unsigned)total, (unsigned)info.total_free_bytes,
+           (unsigned)info.minimum_free_bytes, (unsigned)info.largest_free_block, frag,
+           (unsigned)info.allocated_blocks, (unsigned)info.free_blocks);
+}
+
+static int console_heap(int argc, char **argv)
+{
+    _print_heap("internal", MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    _print_heap("dma", MALLOC_CAP_DMA);
+    _print_heap("psram", MALLOC_CAP_SPIRAM);
+    printf("blocks = allocated/free\n");
+    return 0;
+}
+
+/* ----------------------------------------------------------------------------
+ * uploads
+ * ------------------------------------------------------------------------- */
+static void _print_breaker(const char *name, const breaker_stats_t *b)
+{
+    printf("%s gate: %s, %" PRIu32 " failures in a row, next try in %" PRIu32
+           " ms, budget %" PRIu32 ", %" PRIu32 " attempts, %" PRIu32 " failed, %" PRIu32
+           " opens, %" PRIu32 " skipped\n",
+           name, breaker_state_name(b->state), b->consecutive, b->wait_ms, b->budget,
+           b->attempts, b->failures, b->opens, b->rejected);
+}
+
+static int console_uploads(int argc, char **argv)
+{
+    uploader_status_t *st = malloc(sizeof(*st));
+    if (!st)
+    {
+        printf("out of memory\n");
+        return 1;
+    }
+    uploader_get_status(st);
+    printf("queue %" PRIu32 " samples, log %" PRIu32 " windows, batch %" PRIu32 "\n",
+           st->queue_depth, st->log_pending, st->batch_size);
+
+    printf("%-10s %6s %6s %7s %8s %8s %8s %8s\n", "sink", "queued", "max", "dropped",
+           "written", "failures", "lag ms", "retry ms");
+    for (uint8_t i = 0; i < sink_router_count(); i++)
+    {
+        sink_stats_t ss;
+        if (sink_router_get_stats(i, &ss) == ESP_OK)
+        {
+            printf("%-10s %6" PRIu32 " %6" PRIu32 " %7" PRIu32 " %8" PRIu32 " %8" PRIu32
+                   " %8" PRIu32 " %8" PRIu32 "\n",
+                   ss.name, ss.queued, ss.high_water, ss.dropped, ss.written, ss.failures,
+                   ss.lag_ms, ss.backoff_ms);
+        }
+    }
+
+    uint32_t sum_ms = 0, max_ms = 0;
+    for (uint8_t i = 0; i < st->history_count; i++)
+    {
+        const upload_result_t *r = &st->history[i];
+        struct tm tm;
+        localtime_r(&r->at, &tm);
+        printf("  %02d:%02d:%02d %5" PRIu32 " ms %3u records %3u acked %5" PRIu32
+               " rec/s  HTTP %3d %s\n",
+               tm.tm_hour, tm.tm_min, tm.tm_sec, r->took_ms, r->records, r->acked,
+               r->took_ms ? (uint32_t)r->records * 1000 / r->took_ms : 0,
+               r->http_status, r->ok ? "ok" : firestore_action_name(r->action));
+        sum_ms += r->took_ms;
+        if (r->took_ms > max_ms)
+        {
+            max_ms = r->took_ms;
+        }
+    }
+    if (st->history_count)
+    {
+        printf("last %u commits: avg %" PRIu32 " ms, max %" PRIu32 " ms\n",
+               st->history_count, sum_ms / st->history_count, max_ms);
+    }
+    else
+    {
+        printf("no commits since boot\n");
+    }
+    breaker_stats_t st_breaker = st->breaker;
+    free(st);
+
+    firebase_cred_stats_t cs;
+    firebase_cred_get_stats(&cs);
+    if (cs.token_issued == 0)
+    {
+        printf("token: none yet (%" PRIu32 " failures)\n", cs.failures);
+    }
+    else
+    {
+        time_t now = time(NULL);
+        printf("token: age %lld s, expires in %lld s, %" PRIu32 " refreshes, %" PRIu32
+               " failures, last sign %lld ms\n",
+               (long long)(now - cs.token_issued), (long long)(cs.token_expiry - now),
+               cs.refreshes, cs.failures, (long long)(cs.last_sign_us / 1000));
+    }
+    _print_breaker("firestore", &st_breaker);
+    _print_breaker("oauth2", &cs.breaker);
+    return 0;
+}
+
+/* ----------------------------------------------------------------------------
+ * bench [-n <iterations>]
+ *   Runs the hot paths in place on the console task. The sensor read waits
+ *   for the bus like any other tick; JSON and flash reads work on copies
+ *   and never touch the uploader's state.
+ * ------------------------------------------------------------------------- */
+static struct
+{
+    struct arg_int *iterations;
+    struct arg_end *end;
+} bench_args;
+
+typedef struct
+{
+    int64_t min;
+    int64_t max;
+    int64_t sum;
+    uint32_t n;
+} bench_acc_t;
+
+static void _acc_add(bench_acc_t *a, int64_t us)
+{
+    if (a->n == 0 || us < a->min)
+    {
+        a->min = us;
+    }
+    if (us > a->max)
+    {
+        a->max = us;
+    }
+    a->sum += us;
+    a->n++;
+}
+
+static void _acc_print(const char *label, const bench_acc_t *a)
+{
+    if (a->n == 0)
+    {
+        printf("%-22s no successful runs\n", label);
+        return;
+    }
+    printf("%-22s n=%-4" PRIu32 " min %7lld  avg %7lld  max %7lld us\n",
+           label, a->n, (long long)a->min, (long long)(a->sum / a->n), (long long)a->max);
+}
+
+static void _bench_sensors(int iterations)
+{
+    float values[ACQ_MAX_OUTPUTS];
+    for (uint8_t d = 0; d < acq_device_count(); d++)
+    {
+        bench_acc_t acc = {0};
+        esp_err_t err = ESP_OK;
+        for (int i = 0; i < iterations; i++)
+        {
+            int64_t us = 0;
+            err = acq_read_device(d, values, ACQ_MAX_OUTPUTS, &us);
+            if (err != ESP_OK)
+            {
+                break;
+            }
+            _acc_add(&acc, us);
+        }
+        char label[32];
+        snprintf(label, sizeof(label), "read %s", acq_device_name(d));
+        _acc_print(label, &acc);
+        if (err != ESP_OK)
+        {
+            printf("  stopped: %s\n", esp_err_to_name(err));
+        }
+    }
+}
+
+static void _bench_json(int iterations, avg_sample_t *recs)
+{
+    time_t now = time(NULL);
+    for (int i = 0; i < UPLOAD_MAX_RECORDS; i++)
+    {
+        recs[i] = (avg_sample_t){
+            .timestamp = now - (UPLOAD_MAX_RECORDS - i) * 60,
+            .average = 71.25f + i * 0.01f,
+            .channel = i % 2,
+            .samples = 12,
+            .min = 70.9f,
+            .max = 71.6f,
+            .stddev = 0.21f,
+            .p50 = 71.2f,
+            .p95 = 71.5f,
+        };
+    }
+    // a copy: the uploader may reload cfg.json while the bench runs
+    char proj_id[64];
+    if (!config_cache_copy("proj_id", proj_id, sizeof(proj_id)))
+    {
+        strcpy(proj_id, "bench");
+    }
+
+    bench_acc_t acc = {0};
+    size_t len = 0;
+    for (int i = 0; i < iterations; i++)
+    {
+        int64_t start = esp_timer_get_time();
+        len = firestore_commit_serialize(proj_id, recs, UPLOAD_MAX_RECORDS, NULL, 0);
+        _acc_add(&acc, esp_timer_get_time() - start);
+    }
+    char label[32];
+    snprintf(label, sizeof(label), "json %d records", UPLOAD_MAX_RECORDS);
+    _acc_print(label, &acc);
+    printf("  %u bytes, %u bytes/record\n", (unsigned)len, (unsigned)(len / UPLOAD_MAX_RECORDS));
+}
+
+static void _bench_flash(int iterations, avg_sample_t *recs)
+{
+    bench_acc_t acc = {0};
+    size_t count = 0;
+    esp_err_t err = ESP_OK;
+    for (int i = 0; i < iterations; i++)
+    {
+        int64_t start = esp_timer_get_time();
+        err = record_log_read(recs, UPLOAD_MAX_RECORDS, &count);
+        if (err != ESP_OK)
+        {
+            break;
+        }
+        _acc_add(&acc, esp_timer_get_time() - start);
+    }
+    if (err != ESP_OK)
+    {
+        printf("%-22s %s\n", "flash read", esp_err_to_name(err));
+        return;
+    }
+    char label[32];
+    snprintf(label, sizeof(label), "flash %u records", (unsigned)count);
+    _acc_print(label, &acc);
+    if (count == 0)
+    {
+        printf("  log is empty, timing covers the open/seek only\n");
+    }
+}
+
+static int console_bench(int argc, char **argv)
+{
+    if (arg_parse(argc, argv, (void **)&bench_args) != 0)
+    {
+        arg_print_errors(stderr, bench_args.end, argv[0]);
+        return 1;
+    }
+    int iterations = bench_args.iterations->count ? bench_args.iterations->ival[0]
+                                                  : DIAG_BENCH_ITERATIONS;
+    if (iterations < 1 || iterations > DIAG_BENCH_MAX_ITERATIONS)
+    {
+        printf("iterations must be 1..%d\n", DIAG_BENCH_MAX_ITERATIONS);
+        return 1;
+    }
+
+    // one scratch buffer, shared by the JSON and flash steps
+    avg_sample_t *recs = malloc(UPLOAD_MAX_RECORDS * sizeof(avg_sample_t));
+    if (!recs)
+    {
+        printf("out of memory\n");
+        return 1;
+    }
+    ESP_LOGI(TAG, "bench: %d iterations", iterations);
+    _bench_sensors(iterations);
+    _bench_json(iterations, recs);
+    _bench_flash(iterations, recs);
+    free(recs);
+    return 0;
+}
+
+/* ----------------------------------------------------------------------------
+ * stress [-s <seconds>] [-t <tasks>]
+ *   Busy tasks on the network core, above the uploader, publish 1 KB QoS0
+ *   messages back to back (or hash a buffer while MQTT is down). Sampling
+ *   runs on the other core and must keep its deadline throughout.
+ * ------------------------------------------------------------------------- */
+static struct
+{
+    struct arg_int *seconds;
+    struct arg_int *tasks;
+    struct arg_end *end;
+} stress_args;
+
+typedef struct
+{
+    TaskHandle_t owner;    // notified when the task exits
+    int64_t until_us;
+    uint32_t publishes;
+    uint32_t spins;
+} stress_task_t;
+
+static char stress_payload[DIAG_STRESS_PAYLOAD]; // filled before the tasks start
+
+static void stress_task(void *pvParameters)
+{
+    stress_task_t *st = pvParameters;
+    int64_t yield_at = esp_timer_get_time() + DIAG_STRESS_YIELD_MS * 1000;
+
+    while (esp_timer_get_time() < st->until_us)
+    {
+        esp_mqtt_client_handle_t client = mqtt_get_client();
+        if (client && esp_mqtt_client_publish(client, DIAG_STRESS_TOPIC, stress_payload,
+                                              sizeof(stress_payload), 0, 0) >= 0)
+        {
+            st->publishes++;
+        }
+        else
+        {
+            esp_rom_crc32_le(st->spins, (const uint8_t *)stress_payload, sizeof(stress_payload));
+            st->spins++;
+        }
+        // one tick now and then keeps the idle task (and its watchdog) alive
+        if (esp_timer_get_time() >= yield_at)
+        {
+            vTaskDelay(1);
+            yield_at = esp_timer_get_time() + DIAG_STRESS_YIELD_MS * 1000;
+        }
+    }
+    xTaskNotifyGive(st->owner);
+    vTaskDelete(NULL);
+}
+
+static int console_stress(int argc, char **argv)
+{
+    if (arg_parse(argc, argv, (void **)&stress_args) != 0)
+    {
+        arg_print_errors(stderr, stress_args.end, argv[0]);
+        return 1;
+    }
+    int seconds = stress_args.seconds->count ? stress_args.seconds->ival[0] : DIAG_STRESS_SECONDS;
+    int n_tasks = stress_args.tasks->count ? stress_args.tasks->ival[0] : DIAG_STRESS_TASKS;
+    if (seconds < 1 || seconds > DIAG_STRESS_MAX_SECONDS || n_tasks < 1 ||
+        n_tasks > DIAG_STRESS_MAX_TASKS)
+    {
+        printf("seconds must be 1..%d, tasks 1..%d\n", DIAG_STRESS_MAX_SECONDS,
+               DIAG_STRESS_MAX_TASKS);
+        return 1;
+    }
+
+    stress_task_t tasks[DIAG_STRESS_MAX_TASKS] = {0};
+    int64_t until_us = esp_timer_get_time() + (int64_t)seconds * 1000000;
+    ESP_LOGW(TAG, "stress: %d tasks on core %d at priority %d for %d s", n_tasks,
+             CONFIG_SENSORCTL_NET_CORE, DIAG_STRESS_PRIORITY, seconds);
+    memset(stress_payload, 'x', sizeof(stress_payload));
+    acq_reset_stats();
+
+    int started = 0;
+    for (int i = 0; i < n_tasks; i++)
+    {
+        tasks[i].owner = xTaskGetCurrentTaskHandle();
+        tasks[i].until_us = until_us;
+        if (xTaskCreatePinnedToCore(&stress_task, "stress", DIAG_STRESS_STACK_SIZE, &tasks[i],
+                                    DIAG_STRESS_PRIORITY, NULL,
+                                    CONFIG_SENSORCTL_NET_CORE) != pdPASS)
+        {
+            printf("task %d: creation failed\n", i);
+            break;
+        }
+        started++;
+    }
+    for (int i = 0; i < started; i++)
+    {
+        ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
+    }
+
+    acq_stats_t acq;
+    acq_get_stats(&acq);
+    uint32_t publishes = 0;
+    uint32_t spins = 0;
+    for (int i = 0; i < started; i++)
+    {
+        publishes += tasks[i].publishes;
+        spins += tasks[i].spins;
+    }
+    printf("load: %d tasks, %" PRIu32 " publishes (%" PRIu32 " KB), %" PRIu32 " hash rounds\n",
+           started, publishes, publishes * DIAG_STRESS_PAYLOAD / 1024, spins);
+    printf("sampling: %" PRIu32 " ticks, max jitter %" PRId32 " us, %" PRIu32
+           " over the %d us deadline\n",
+           acq.ticks, acq.max_jitter_us, acq.missed, ACQ_DEADLINE_US);
+    bool pass = acq.ticks > 0 && acq.missed == 0;
+    printf("%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
+
+esp_err_t diag_register_console(void)
+{
+    tasks_args.window = arg_int0("w", "window", "<ms>", "CPU sampling window");
+    tasks_args.end = arg_end(1);
+    bench_args.iterations = arg_int0("n", "iterations", "<n>", "runs of each step");
+    bench_args.end = arg_end(1);
+    stress_args.seconds = arg_int0("s", "seconds", "<s>", "duration");
+    stress_args.tasks = arg_int0("t", "tasks", "<n>", "load tasks on the network core");
+    stress_args.end = arg_end(2);
+
+    const esp_console_cmd_t cmds[] = {
+        {
+            .command = "tasks",
+            .help = "task states, priorities, stack headroom and CPU %",
+            .hint = NULL,
+            .func = &console_tasks,
+            .argtable = &tasks_args,
+        },
+        {
+            .command = "heap",
+            .help = "free memory, largest block and fragmentation per region",
+            .hint = NULL,
+            .func = &console_heap,
+        },
+        {
+            .command = "uploads",
+            .help = "sample queue, upload log, sinks, recent commit latencies and token age",
+            .hint = NULL,
+            .func = &console_uploads,
+        },
+        {
+            .command = "bench",
+            .help = "time sensor reads, JSON build and flash reads in place",
+            .hint = NULL,
+            .func = &console_bench,
+            .argtable = &bench_args,
+        },
+        {
+            .command = "stress",
+            .help = "saturate the network core and check sampling deadlines",
+            .hint = NULL,
+            .func = &console_stress,
+            .argtable = &stress_args,
+        },
+    };
+    for (size_t i = 0; i < sizeof(cmds) / sizeof(cmds[0]); i++)
+    {
+        esp_err_t err = esp_console_cmd_register(&cmds[i]);
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "sdkconfig.h"
+#include "esp_err.h"
+
+#define DIAG_CPU_WINDOW_MS 1000  // default sampling window of `tasks`
+#define DIAG_BENCH_ITERATIONS 10 // default repetitions of each `bench` step
+#define DIAG_BENCH_MAX_ITERATIONS 1000
+
+#define DIAG_STRESS_SECONDS 30     // default duration of `stress`
+#define DIAG_STRESS_MAX_SECONDS 600
+#define DIAG_STRESS_TASKS 2        // default load tasks
+#define DIAG_STRESS_MAX_TASKS 4
+#define DIAG_STRESS_PRIORITY (CONFIG_SENSORCTL_UPLOADER_PRIORITY + 1)
+#define DIAG_STRESS_STACK_SIZE 3072
+#define DIAG_STRESS_PAYLOAD 1024   // bytes per publish
+#define DIAG_STRESS_TOPIC "diag/stress"
+#define DIAG_STRESS_YIELD_MS 100
+
+/**
+ * @brief  Register the field diagnostics console commands:
+ *         `tasks [-w <ms>]`  per-task state, priority, stack and CPU %
+ *         `heap`             free/largest block per region, fragmentation
+ *         `uploads`          queue, log and sink depths, recent commits, token age
+ *         `bench [-n <n>]`   sensor read, JSON build and flash read timings
+ *         `stress [-s <s>] [-t <n>]`  load the network core, check sampling
+ */
+esp_err_t diag_register_console(void);
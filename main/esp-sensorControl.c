@@ -7,7 +7,6 @@
 #include <dirent.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/timers.h"
 #include "freertos/event_groups.h"
 
 #include "driver/gpio.h"
@@ -16,25 +15,35 @@
 #include "esp_event.h"
 #include "esp_netif.h"
 #include "esp_eth.h"
-#include "esp_sntp.h"
 #include "esp_partition.h"
 #include "ethernet_init.h"
 #include "mqtt_man.h"
 #include "mqtt_client.h"
 #include "ahtxx.h"
 #include "firebase.h"
+#include "firebase_cred.h"
 #include "nvs_helper.h"
 #include "usb_helper.h"
+#include "config_cache.h"
+#include "uploader.h"
+#include "acquisition.h"
+#include "cadence.h"
+#include "perf_metrics.h"
+#include "diag.h"
+#include "timebase.h"
+#include "boot.h"
+#include "sinks.h"
 #include "esp_console.h"
 #include "cJSON.h"
 // === Defines ===
 #define GOT_IP_BIT BIT0
-#define STACK_SIZE 10240
-#define SAMPLE_INTERVAL_MS 5000  // read sensor every 5 s
-#define WINDOW_INTERVAL_MS 60000 // average window = 60 s
-#define BATCH_SIZE 5
+#define STACK_SIZE CONFIG_SENSORCTL_ONLINE_STACK_SIZE // online stage: MQTT start and config parsing
+#define BOOT_STAGE_PRIORITY CONFIG_SENSORCTL_BOOT_PRIORITY
+#define NET_CORE CONFIG_SENSORCTL_NET_CORE // Ethernet driver, lwIP, TLS, MQTT
 #define BASE_PATH "/littlefs" // base path to mount the partition
 
+#define METRICS_MQTT_TOPIC "sensorControl/metrics"
+
 #define EPNUM_MSC 1
 #define TUSB_DESC_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_MSC_DESC_LEN)
 
@@ -48,273 +57,169 @@ static const char *TAG_USB = "Averaging";
 
 // === Globals ===
 static EventGroupHandle_t eth_event_group;
-ahtxx_handle_t dev_hdl;
-float temperature, humidity;
-static float window_sum;
-static uint32_t window_count;
-static const char *config_path = "/data/cfg.json";
-
-/* Structure for holding an averaged reading */
-typedef struct
-{
-    time_t timestamp;
-    float average;
-} avg_sample_t;
-
-/* Simple in-RAM circular buffer for a batch of averages */
-static avg_sample_t batch_buffer[BATCH_SIZE];
-static uint8_t batch_index;
-
-/* Forward declarations */
-static void sample_timer_cb(TimerHandle_t xTimer);
-static void window_timer_cb(TimerHandle_t xTimer);
-static void send_batch(void);
+static ahtxx_handle_t aht_hdl;
 
-/* Create two timers in app_main() or initialization routine: */
-void setup_averaging(void)
+/* AHTxx adapter for the acquisition registry: one transaction yields
+ * out[0] = temperature (°C) and out[1] = relative humidity (%) */
+static esp_err_t aht_read(void *ctx, float *out, size_t n_out)
 {
-    TimerHandle_t sample_timer = xTimerCreate(
-        "sampleTimer", pdMS_TO_TICKS(SAMPLE_INTERVAL_MS),
-        pdTRUE, NULL, sample_timer_cb);
-    TimerHandle_t window_timer = xTimerCreate(
-        "windowTimer", pdMS_TO_TICKS(WINDOW_INTERVAL_MS),
-        pdTRUE, NULL, window_timer_cb);
-
-    if (sample_timer == NULL || window_timer == NULL)
-    {
-        ESP_LOGE(TAG, "Timer creation failed");
-        return;
-    }
-    xTimerStart(sample_timer, 0);
-    xTimerStart(window_timer, 0);
+    return ahtxx_get_measurement((ahtxx_handle_t)ctx, &out[0], &out[1]);
 }
 
-/* ----------------------------------------------------------------------------
- * sample_timer_cb
- *   Runs every SAMPLE_INTERVAL_MS:
- *   - Reads AHT21
- *   - Accumulates into window_sum and window_count
- * ------------------------------------------------------------------------- */
-static void sample_timer_cb(TimerHandle_t xTimer)
-{
-    esp_err_t err = ahtxx_get_measurement(dev_hdl, &temperature, &humidity);
+static const acq_driver_t aht_driver = {
+    .name = "AHT21",
+    .read = aht_read,
+};
 
-    if (err == ESP_OK)
-    {
-        window_sum += (temperature * 9.0 / 5.0) + 32.0;
-        window_count += 1;
-        ESP_LOGD(TAG, "Sampled: %.2f  (sum=%.2f count=%" PRIu32 ")",
-                 temperature, window_sum, window_count);
-    }
-    else
+/* Periodic metrics snapshot, dropped quietly while MQTT is down */
+static void publish_metrics(const char *json, size_t len, void *arg)
+{
+    esp_mqtt_client_handle_t client = mqtt_get_client();
+    if (client)
     {
-        ESP_LOGW(TAG, "Sensor read failed: %s", esp_err_to_name(err));
+        esp_mqtt_client_enqueue(client, METRICS_MQTT_TOPIC, json, (int)len, 0, 0, false);
     }
 }
 
-/* ----------------------------------------------------------------------------
- * window_timer_cb
- *   Runs every WINDOW_INTERVAL_MS:
- *   - Computes average
- *   - Resets sum/count
- *   - Appends to batch_buffer
- *   - If buffer full, calls send_batch()
- * ------------------------------------------------------------------------- */
-static void window_timer_cb(TimerHandle_t xTimer)
+/* Register the sensor channels and start the uploader and acquisition tasks */
+void setup_averaging(ahtxx_handle_t aht_hdl)
 {
-    if (window_count == 0)
+    if (uploader_start() != ESP_OK)
     {
-        ESP_LOGW(TAG, "No samples in this window");
+        ESP_LOGE(TAG, "Uploader start failed");
         return;
     }
-
-    /* Compute average and reset */
-    float avg = window_sum / (float)window_count;
-    window_sum = 0;
-    window_count = 0;
-
-    /* Record timestamped average */
-    time_t now = time(NULL);
-    batch_buffer[batch_index].timestamp = now;
-    batch_buffer[batch_index].average = avg;
-    batch_index++;
-
-    ESP_LOGI(TAG, "Window avg: %.2f at %lld  (buffer=%u/%u)",
-             avg, (long long)now, batch_index, BATCH_SIZE);
-
-    /* If we’ve collected enough, send them */
-    if (batch_index >= BATCH_SIZE)
+    if (sinks_add_csv() != ESP_OK)
     {
-        char *proj_id = load_config_from_fat(config_path, "proj_id");
-        if (!proj_id)
-        {
-            ESP_LOGE("CONFIG_HELPER", "Did not load proj_id");
-            return;
-        }
-        // send_batch();
-        cJSON *root = cJSON_CreateObject();
-        cJSON *writes = cJSON_AddArrayToObject(root, "writes");
-
-        for (uint8_t i = 0; i < batch_index; i++)
-        {
-            avg_sample_t *s = &batch_buffer[i];
-
-            // Document path: use timestamp as ID
-            char name[256];
-            snprintf(name, sizeof(name),
-                     "projects/%s/databases/(default)/documents/sensor_data/%lld",
-                     proj_id, (long long)s->timestamp);
-
-            // Build one write object
-            cJSON *write = cJSON_CreateObject();
-            cJSON *update = cJSON_AddObjectToObject(write, "update");
-            cJSON_AddStringToObject(update, "name", name);
-
-            // Build fields sub-object
-            cJSON *fields = cJSON_AddObjectToObject(update, "fields");
-
-            // timestamp field
-            char ts_str[32];
-            snprintf(ts_str, sizeof(ts_str), "%lld", (long long)s->timestamp);
-            cJSON *t = cJSON_CreateObject();
-            cJSON_AddStringToObject(t, "integerValue", ts_str);
-            cJSON_AddItemToObject(fields, "timestamp", t);
-
-            // value field
-            char val_str[32];
-            snprintf(val_str, sizeof(val_str), "%.2f", s->average);
-            cJSON *v = cJSON_CreateObject();
-            cJSON_AddStringToObject(v, "doubleValue", val_str);
-            cJSON_AddItemToObject(fields, "value", v);
-
-            // Tell Firestore to create/update
-            // (optional) you can add a precondition here if you need
-
-            cJSON_AddItemToArray(writes, write);
-        }
-        free(proj_id);
-        char *body = cJSON_PrintUnformatted(root);
-        cJSON_Delete(root);
-        if (send_sensor_data_to_firestore(body) != ESP_OK)
-        {
-            ESP_LOGE("FIREBASE_HELPER", "failed to send to firestore");
-        }
-        else
-        {
-            batch_index = 0;
-        }
-
-        free(body);
+        ESP_LOGE(TAG, "Local CSV log failed to start");
     }
-}
-
-/* ----------------------------------------------------------------------------
- * send_batch
- *   Iterates buffered averages and sends each to Firestore
- *   (you could also build a single batched JSON payload if you prefer)
- * ------------------------------------------------------------------------- */
-static void send_batch(void)
-{
-    ESP_LOGI(TAG, "Sending batch of %u samples", BATCH_SIZE);
-
-    // for (uint8_t i = 0; i < BATCH_SIZE; i++) {
-    //     avg_sample_t *s = &batch_buffer[i];
-
-    //     /* Option A: modify your existing function to accept parameters */
-    //     // send_sensor_data_to_firestore(s->timestamp, s->average);
-
-    //     /* Option B: temporarily set a global or use a struct */
-    //     set_fake_sensor_data(s->average);       // if your send fn reads from a global
-    //     override_timestamp(s->timestamp);       // likewise for timestamp
-    //     send_sensor_data_to_firestore();        // existing no-arg sender
 
-    //     vTaskDelay(pdMS_TO_TICKS(100));         // small delay to avoid back-to-back HTTP
-    // }
+    uint8_t aht_dev;
+    ESP_ERROR_CHECK(acq_register_device(&aht_driver, aht_hdl, 2, &aht_dev));
+
+    // registered first, so it is SENSOR_CHANNEL_PRIMARY
+    const acq_channel_cfg_t temperature_ch = {
+        .name = "temperature",
+        .quantity = ACQ_QTY_TEMPERATURE,
+        .device = aht_dev,
+        .output = 0,
+        .period_ms = ACQ_PERIOD_NODE,
+        .scale = 9.0f / 5.0f, // °C -> °F
+        .offset = 32.0f,
+        .report = {
+            .mode = REPORT_FILTER_SWINGING_DOOR,
+            .deadband = 0.2f, // °F
+            .max_silence_s = 900,
+        },
+    };
+    const acq_channel_cfg_t humidity_ch = {
+        .name = "humidity",
+        .quantity = ACQ_QTY_HUMIDITY,
+        .device = aht_dev,
+        .output = 1,
+        .period_ms = ACQ_PERIOD_NODE,
+        .scale = 1.0f,
+        .report = {
+            .mode = REPORT_FILTER_SWINGING_DOOR,
+            .deadband = 0.5f, // %RH
+            .max_silence_s = 900,
+        },
+    };
+    ESP_ERROR_CHECK(acq_register_channel(&temperature_ch, NULL));
+    ESP_ERROR_CHECK(acq_register_channel(&humidity_ch, NULL));
+
+    if (acq_start() != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Acquisition start failed");
+    }
 }
 
-// === Function: Time Sync ===
-void obtain_time(void)
+// === Stage: AHT21 on I2C ===
+// Independent of storage and networking, so it overlaps both
+static esp_err_t stage_sensor(void)
 {
-    ESP_LOGI(TAG_NTP, "Initializing SNTP...");
-    esp_sntp_setoperatingmode(SNTP_OPMODE_POLL);
-    esp_sntp_setservername(0, "pool.ntp.org");
-    esp_sntp_init();
-    // Switch to “smooth” mode to slewing‐adjust the clock
-    esp_sntp_set_sync_mode(SNTP_SYNC_MODE_SMOOTH);
-
-    // Re‑sync every hour (3600s), in milliseconds
-    esp_sntp_set_sync_interval(3600 * 1000);
-
-    // === time sync callback ===
-    void time_sync_notification_cb(struct timeval * tv)
+    ESP_LOGI(TAG_AHT, "Initializing AHT21 sensor");
+    ahtxx_config_t dev_cfg = I2C_AHT21_CONFIG_DEFAULT;
+    i2c_master_bus_handle_t bus_handle;
+    i2c_master_bus_config_t bus_cfg = {
+        .sda_io_num = 1,
+        .scl_io_num = 2,
+        .i2c_port = I2C_NUM_0,
+        .clk_source = I2C_CLK_SRC_DEFAULT};
+    esp_err_t err = i2c_new_master_bus(&bus_cfg, &bus_handle);
+    if (err != ESP_OK)
     {
-        time_t now = time(NULL);
-        ESP_LOGI("SNTP_CB", "Time synchronized: %s", ctime(&now));
+        return err;
     }
+    ahtxx_init(bus_handle, &dev_cfg, &aht_hdl);
 
-    // setup callback to notify of time-sync
-    esp_sntp_set_time_sync_notification_cb(time_sync_notification_cb);
-
-    time_t now = 0;
-    struct tm timeinfo = {0};
-    int retry = 0;
-    const int max_retries = 10;
-
-    while (timeinfo.tm_year < (2022 - 1900) && ++retry < max_retries)
+    if (aht_hdl == NULL)
     {
-        ESP_LOGI(TAG_NTP, "Waiting for system time to be set... (%d/%d)", retry, max_retries);
-        vTaskDelay(pdMS_TO_TICKS(2000));
-        time(&now);
-        localtime_r(&now, &timeinfo);
+        ESP_LOGE(TAG_AHT, "ahtxx handle init failed");
+        return ESP_FAIL;
     }
+    ESP_LOGI(TAG_AHT, "AHT21 initialized");
 
-    if (retry >= max_retries)
-    {
-        ESP_LOGW(TAG_NTP, "System time was not set via SNTP");
-    }
-    else
-    {
-        ESP_LOGI(TAG_NTP, "System time set successfully");
-    }
+    // Read and log temperature/humidity
+    float temperature = 0, humidity = 0;
+    ahtxx_get_measurement(aht_hdl, &temperature, &humidity);
+    ESP_LOGI(TAG_AHT, "Temperature: %.2f C, Humidity: %.2f %%", temperature, humidity);
+    return ESP_OK;
 }
 
-// === Task: Post-IP Setup ===
-void post_ip_task(void *pvParameters)
+// === Stage: acquisition and uploader ===
+// Sample from boot; timestamps are monotonic until SNTP syncs
+static esp_err_t stage_pipeline(void)
 {
+    setup_averaging(aht_hdl);
+    return ESP_OK;
+}
 
-    ESP_LOGI(TAG_POSTIP, "starting post-ip");
-    UBaseType_t watermark = uxTaskGetStackHighWaterMark(NULL);
-    ESP_LOGI(TAG_POSTIP, "Sub task stack remaining: %u bytes", watermark);
-
+// === Stage: Post-IP Setup ===
+static esp_err_t stage_online(void)
+{
     ESP_LOGI(TAG_POSTIP, "Waiting for IP...");
     xEventGroupWaitBits(eth_event_group, GOT_IP_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
 
-    obtain_time();
+    // sampling is already running; windows are rebased once SNTP syncs
+    if (timebase_start() != ESP_OK)
+    {
+        ESP_LOGE(TAG_NTP, "SNTP failed to start");
+    }
 
-    // Startup MQTT
+    // Startup MQTT. The values are used in place until the client and the
+    // telemetry publisher have copied them, so the uploader must not reload
+    // cfg.json meanwhile
     static bool have_all_config = true;
-    char *mqtt_url = load_config_from_fat(config_path, "mqtt_url");
+    config_cache_lock();
+    const char *mqtt_url = config_cache_get("mqtt_url");
     if (!mqtt_url)
     {
         ESP_LOGE("CONFIG_HELPER", "Did not load mqtt_url");
         have_all_config = false;
     }
 
-    char *mqtt_password = load_config_from_fat(config_path, "mqtt_password");
+    const char *mqtt_password = config_cache_get("mqtt_password");
     if (!mqtt_password)
     {
         ESP_LOGE("CONFIG_HELPER", "Did not load mqtt_password");
         have_all_config = false;
     }
 
-    char *mqtt_username = load_config_from_fat(config_path, "mqtt_username");
+    const char *mqtt_username = config_cache_get("mqtt_username");
     if (!mqtt_username)
     {
         ESP_LOGE("CONFIG_HELPER", "Did not load mqtt_username");
         have_all_config = false;
     }
 
-    char *mqtt_v_cert = load_config_from_fat(config_path, "mqtt_v_cert");
+    // the MQTT client keeps a reference to the CA cert, so it needs its own copy
+    char *mqtt_v_cert = NULL;
+    const char *cached_cert = config_cache_get("mqtt_v_cert");
+    if (cached_cert)
+    {
+        mqtt_v_cert = strdup(cached_cert);
+    }
     if (!mqtt_v_cert)
     {
         ESP_LOGE("CONFIG_HELPER", "Did not load mqtt_v_cert");
@@ -326,42 +231,61 @@ void post_ip_task(void *pvParameters)
         if (mqtt_app_start(mqtt_url, mqtt_username, mqtt_password, mqtt_v_cert) != ESP_OK)
         {
             ESP_LOGE(TAG_POSTIP, "MQTT failed to start");
-            free(mqtt_url);
-            free(mqtt_password);
             free(mqtt_v_cert);
-            free(mqtt_username);
         }
+        else
+        {
+            // window records also go out over MQTT, for local consumers
+            const char *topic = config_cache_find("mqtt_telemetry_topic");
+            const char *qos = config_cache_find("mqtt_telemetry_qos");
+            const char *codec = config_cache_find("mqtt_telemetry_codec");
+            const mqtt_telemetry_cfg_t tm_cfg = {
+                .topic = topic ? topic : "sensorControl/telemetry",
+                .qos = qos ? atoi(qos) : 1,
+                .batch_records = MQTT_TELEMETRY_BATCH,
+                .max_delay_s = MQTT_TELEMETRY_MAX_DELAY_S,
+                .codec = payload_codec_find(codec ? codec : "cbor"),
+            };
+            if (mqtt_telemetry_start(&tm_cfg) != ESP_OK || sinks_add_mqtt() != ESP_OK)
+            {
+                ESP_LOGE(TAG_POSTIP, "MQTT telemetry failed to start");
+            }
+        }
+    }
+    else
+    {
+        free(mqtt_v_cert);
     }
+    config_cache_unlock();
 
-    // Initialize AHT21 sensor
-    ESP_LOGI(TAG_AHT, "Initializing AHT21 sensor");
-    ahtxx_config_t dev_cfg = I2C_AHT21_CONFIG_DEFAULT;
-    i2c_master_bus_handle_t bus_handle;
-    i2c_master_bus_config_t bus_cfg = {
-        .sda_io_num = 1,
-        .scl_io_num = 2,
-        .i2c_port = I2C_NUM_0,
-        .clk_source = I2C_CLK_SRC_DEFAULT};
-    i2c_new_master_bus(&bus_cfg, &bus_handle);
-    ahtxx_init(bus_handle, &dev_cfg, &dev_hdl);
+    // metrics snapshot over MQTT; the console `metrics` command works regardless
+    if (perf_metrics_start(PERF_PUBLISH_INTERVAL_MS, publish_metrics, NULL) != ESP_OK)
+    {
+        ESP_LOGE(TAG_POSTIP, "Metrics reporting failed to start");
+    }
 
-    if (dev_hdl == NULL)
+    // this task is about to go away, so record its stack use once
+    perf_gauge_set(perf_gauge("stack.online"), (int32_t)uxTaskGetStackHighWaterMark(NULL));
+    return ESP_OK;
+}
+
+// === Stage: Firebase credentials, once the wall clock is valid ===
+static esp_err_t stage_cloud(void)
+{
+    // the OAuth2 JWT carries iat/exp, so signing waits for the wall clock
+    while (!timebase_wait(pdMS_TO_TICKS(30000)))
     {
-        ESP_LOGE(TAG_AHT, "ahtxx handle init failed");
-        assert(dev_hdl);
+        ESP_LOGW(TAG_NTP, "Still waiting for SNTP, windows are held in RAM");
     }
-    ESP_LOGI(TAG_POSTIP, "AHT21 initialized");
-    watermark = uxTaskGetStackHighWaterMark(NULL);
-    ESP_LOGI(TAG_POSTIP, "Sub task stack remaining: %u bytes", watermark);
+    boot_mark(BOOT_MILESTONE_TIME_SYNC);
 
-    // Read and log temperature/humidity
-    esp_err_t err = ahtxx_get_measurement(dev_hdl, &temperature, &humidity);
-    ESP_LOGI(TAG_AHT, "Temperature: %.2f C, Humidity: %.2f %%", temperature, humidity);
-    // send_sensor_data_to_firestore(temperature, humidity);
-    //  TODO Upload to Firebase
-    //  firebase_upload_temperature(temperature, humidity);
-    setup_averaging();
-    vTaskDelete(NULL);
+    // Sign the first OAuth2 token now rather than on the first upload
+    esp_err_t err = firebase_cred_start();
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_POSTIP, "Failed to start Firebase credential manager");
+    }
+    return err;
 }
 
 // === Ethernet Event Callback ===
@@ -369,6 +293,7 @@ void on_got_ip(void *arg, esp_event_base_t event_base, int32_t event_id, void *e
 {
     ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
     ESP_LOGI(TAG_ETH, "Got IP: " IPSTR, IP2STR(&event->ip_info.ip));
+    boot_mark(BOOT_MILESTONE_IP);
     xEventGroupSetBits(eth_event_group, GOT_IP_BIT);
 }
 
@@ -391,20 +316,97 @@ void ethernet_init()
     ESP_LOGI(TAG_ETH, "Pins: cs: %d, intr: %d", info.pin.eth_spi_cs, info.pin.eth_spi_int);
 }
 
-// === Main App Entry ===
-void app_main(void)
+// === Stage: NVS, holds cadence changes made at runtime ===
+static esp_err_t stage_nvs(void)
 {
-    ESP_LOGI(TAG_ETH, "Starting app_main");
-
-    // initialize flash msc, NVS, console, and mount storage
-    usb_helper_init();
+    return init_nvs();
+}
 
-    // default loop
+// === Stage: default event loop and Ethernet, no IP wait ===
+static esp_err_t stage_netif(void)
+{
     ESP_ERROR_CHECK(esp_event_loop_create_default());
-
-    // initialize ethernet
     ethernet_init();
+    return ESP_OK;
+}
 
-    // Start post-IP task
-    xTaskCreate(&post_ip_task, "post_ip_task", STACK_SIZE, NULL, 4, NULL);
+// === Stage: sample/window/batch cadence: defaults < cfg.json < NVS ===
+static esp_err_t stage_config(void)
+{
+    cadence_load();
+    // subscriptions are sent once MQTT connects in stage_online
+    if (cadence_register_mqtt() != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Cadence MQTT control not registered");
+    }
+    return ESP_OK;
+}
+
+// === Stage: REPL and every console command ===
+static esp_err_t stage_console(void)
+{
+    esp_err_t err = usb_helper_console_init();
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    if (cadence_register_console() != ESP_OK)
+    {
+        ESP_LOGW(TAG, "cadence command not registered");
+    }
+    if (perf_metrics_register_console() != ESP_OK)
+    {
+        ESP_LOGW(TAG, "metrics command not registered");
+    }
+    if (diag_register_console() != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Diagnostics commands not registered");
+    }
+    if (boot_register_console() != ESP_OK)
+    {
+        ESP_LOGW(TAG, "boot command not registered");
+    }
+    return ESP_OK;
+}
+
+/* ------------------------------------------------------------------------
+ * Boot graph. Network stages on the network core (where the Ethernet
+ * driver and lwIP run), storage and sensor stages on the acquisition core,
+ * so the flash mount and sensor init overlap the PHY link-up and DHCP.
+ * ------------------------------------------------------------------------ */
+enum
+{
+    STAGE_NVS,
+    STAGE_STORAGE,
+    STAGE_NETIF,
+    STAGE_SENSOR,
+    STAGE_CONFIG,
+    STAGE_USB,
+    STAGE_CONSOLE,
+    STAGE_PIPELINE,
+    STAGE_ONLINE,
+    STAGE_CLOUD,
+};
+
+static const boot_stage_t boot_stages[] = {
+    [STAGE_NVS] = {"nvs", stage_nvs, 0, ACQ_CORE, 4096, BOOT_STAGE_PRIORITY},
+    [STAGE_STORAGE] = {"storage", usb_helper_storage_init, 0, ACQ_CORE, 6144, BOOT_STAGE_PRIORITY},
+    [STAGE_NETIF] = {"netif", stage_netif, 0, NET_CORE, 4096, BOOT_STAGE_PRIORITY},
+    [STAGE_SENSOR] = {"sensor", stage_sensor, 0, ACQ_CORE, 4096, BOOT_STAGE_PRIORITY},
+    [STAGE_CONFIG] = {"config", stage_config,
+                      BOOT_STAGE(STAGE_NVS) | BOOT_STAGE(STAGE_STORAGE), ACQ_CORE, 4096, BOOT_STAGE_PRIORITY},
+    [STAGE_USB] = {"usb", usb_helper_usb_init, BOOT_STAGE(STAGE_STORAGE), NET_CORE, 4096, BOOT_STAGE_PRIORITY},
+    [STAGE_CONSOLE] = {"console", stage_console, BOOT_STAGE(STAGE_CONFIG), ACQ_CORE, 4096, BOOT_STAGE_PRIORITY},
+    [STAGE_PIPELINE] = {"pipeline", stage_pipeline,
+                        BOOT_STAGE(STAGE_SENSOR) | BOOT_STAGE(STAGE_CONFIG), ACQ_CORE, 4096, BOOT_STAGE_PRIORITY},
+    [STAGE_ONLINE] = {"online", stage_online,
+                      BOOT_STAGE(STAGE_NETIF) | BOOT_STAGE(STAGE_CONFIG), NET_CORE, STACK_SIZE, BOOT_STAGE_PRIORITY},
+    [STAGE_CLOUD] = {"cloud", stage_cloud, BOOT_STAGE(STAGE_ONLINE), NET_CORE, 4096, BOOT_STAGE_PRIORITY},
+};
+
+// === Main App Entry ===
+void app_main(void)
+{
+    ESP_LOGI(TAG_ETH, "Starting app_main");
+    ESP_ERROR_CHECK(boot_run(boot_stages, sizeof(boot_stages) / sizeof(boot_stages[0])));
 }
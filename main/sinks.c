@@ -0,0 +1,170 @@
+// sinks.c — MQTT and local CSV sinks for the sink router
+//
+// The Firestore sink lives with the flash log in uploader.c. These two are
+// the other destinations of every window record; each has its own queue and
+// retry policy in the router, so neither waits on Firestore or on the other.
+
+#include "sinks.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "esp_log.h"
+#include "esp_vfs_fat.h"
+
+#include "sensor_record.h"
+#include "sink_router.h"
+#include "mqtt_man.h"
+#include "acquisition.h"
+#include "timebase.h"
+
+static const char *TAG = "Sinks";
+
+/* ----------------------------------------------------------------------------
+ * MQTT
+ * ------------------------------------------------------------------------- */
+static esp_err_t mqtt_sink_write(void *ctx, const avg_sample_t *recs, size_t count)
+{
+    if (!timebase_synced())
+    {
+        return ESP_ERR_INVALID_STATE; // consumers expect wall-clock stamps
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        avg_sample_t rec = recs[i];
+        rec.timestamp = timebase_rebase(rec.timestamp);
+        esp_err_t err = mqtt_telemetry_push(&rec, 1);
+        // NO_MEM: the outbox was full and the publisher dropped (and counted)
+        // a payload; retrying would resend what it did take
+        if (err != ESP_OK && err != ESP_ERR_NO_MEM)
+        {
+            return err;
+        }
+    }
+    return ESP_OK;
+}
+
+/* A partial payload goes out once it is max_delay_s old, even when the
+ * report filter holds the next record back for a heartbeat interval */
+static void mqtt_sink_tick(void *ctx)
+{
+    if (timebase_synced())
+    {
+        mqtt_telemetry_poll(time(NULL));
+    }
+}
+
+esp_err_t sinks_add_mqtt(void)
+{
+    const sink_cfg_t cfg = {
+        .name = "mqtt",
+        .write = mqtt_sink_write,
+        .queue_len = MQTT_SINK_QUEUE_LEN,
+        .batch = 1, // mqtt_telemetry_push() batches into payloads itself
+        .retry_min_ms = MQTT_SINK_RETRY_MIN_MS,
+        .retry_max_ms = MQTT_SINK_RETRY_MAX_MS,
+        .tick = mqtt_sink_tick, // same task as write(), as push/flush require
+        .tick_ms = MQTT_TELEMETRY_POLL_MS,
+    };
+    return sink_router_add(&cfg, NULL);
+}
+
+/* ----------------------------------------------------------------------------
+ * Local CSV log
+ *   One line per window. The file is opened per batch, not kept open, so a
+ *   USB host can take the volume between writes; while it has it, fopen()
+ *   fails and the router retries.
+ * ------------------------------------------------------------------------- */
+static void _csv_rotate(void)
+{
+    struct stat st;
+    if (stat(CSV_SINK_PATH, &st) == 0 && st.st_size >= CSV_SINK_MAX_BYTES)
+    {
+        remove(CSV_SINK_OLD_PATH);
+        if (rename(CSV_SINK_PATH, CSV_SINK_OLD_PATH) != 0)
+        {
+            ESP_LOGW(TAG, "Could not rotate %s", CSV_SINK_PATH);
+        }
+    }
+}
+
+/* The record log holds the unsent backfill; the CSV is only a convenience */
+static bool _csv_room(void)
+{
+    uint64_t total = 0;
+    uint64_t free_bytes = 0;
+    if (esp_vfs_fat_info(CSV_SINK_BASE_PATH, &total, &free_bytes) != ESP_OK)
+    {
+        return true; // unknown (USB host has the volume); fopen() decides
+    }
+    if (free_bytes < CSV_SINK_MIN_FREE_BYTES)
+    {
+        ESP_LOGW(TAG, "Only %llu bytes free on %s, not writing %s",
+                 (unsigned long long)free_bytes, CSV_SINK_BASE_PATH, CSV_SINK_PATH);
+        return false;
+    }
+    return true;
+}
+
+static esp_err_t csv_sink_write(void *ctx, const avg_sample_t *recs, size_t count)
+{
+    _csv_rotate();
+    if (!_csv_room())
+    {
+        return ESP_ERR_NO_MEM; // retried; the router drops what overflows
+    }
+    FILE *f = fopen(CSV_SINK_PATH, "a");
+    if (!f)
+    {
+        return ESP_FAIL;
+    }
+    if (ftell(f) == 0)
+    {
+        fputs("time,clock,channel,average,min,max,stddev,p50,p95,samples\n", f);
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const avg_sample_t *r = &recs[i];
+        time_t t = timebase_rebase(r->timestamp);
+        char when[24];
+        if (timebase_is_wall(t))
+        {
+            struct tm tm;
+            gmtime_r(&t, &tm);
+            strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%SZ,utc", &tm);
+        }
+        else
+        {
+            snprintf(when, sizeof(when), "%lld,boot", (long long)t);
+        }
+        const acq_channel_cfg_t *ch = acq_channel_get(r->channel);
+        fprintf(f, "%s,%s,%.2f,%.2f,%.2f,%.3f,%.2f,%.2f,%u\n", when,
+                ch ? ch->name : "?", r->average, r->min, r->max, r->stddev, r->p50, r->p95,
+                r->samples);
+    }
+
+    // a failed close may leave some of the lines; a retry duplicates them
+    bool ok = !ferror(f);
+    if (fclose(f) != 0 || !ok)
+    {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t sinks_add_csv(void)
+{
+    const sink_cfg_t cfg = {
+        .name = "csv",
+        .write = csv_sink_write,
+        .queue_len = CSV_SINK_QUEUE_LEN,
+        .batch = CSV_SINK_BATCH,
+        .max_delay_ms = CSV_SINK_MAX_DELAY_MS,
+        .retry_min_ms = CSV_SINK_RETRY_MIN_MS,
+        .retry_max_ms = CSV_SINK_RETRY_MAX_MS,
+    };
+    return sink_router_add(&cfg, NULL);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "esp_err.h"
+#include "record_log.h"
+
+/* MQTT telemetry sink; the publisher coalesces records into payloads */
+#define MQTT_SINK_QUEUE_LEN 64
+#define MQTT_SINK_RETRY_MIN_MS 1000
+#define MQTT_SINK_RETRY_MAX_MS 60000
+
+/* Local CSV log on the USB-visible volume. It shares the 1 MB storage
+ * partition with the record log (512 KB) and cfg.json, so the pair of
+ * files is kept to 128 KB, and nothing is written once free space drops
+ * to what the record log may still need to grow by a couple of segments. */
+#define CSV_SINK_BASE_PATH "/data"
+#define CSV_SINK_PATH CSV_SINK_BASE_PATH "/windows.csv"
+#define CSV_SINK_OLD_PATH CSV_SINK_BASE_PATH "/windows0.csv" // previous file, 8.3 safe
+#define CSV_SINK_MAX_BYTES (64 * 1024)                        // rotate beyond this
+#define CSV_SINK_MIN_FREE_BYTES (2 * RECORD_LOG_SEGMENT_BYTES) // leave to the record log
+#define CSV_SINK_QUEUE_LEN 64
+#define CSV_SINK_BATCH 10                        // lines per open/write/close
+#define CSV_SINK_MAX_DELAY_MS (5 * 60 * 1000)
+#define CSV_SINK_RETRY_MIN_MS 5000
+#define CSV_SINK_RETRY_MAX_MS 60000
+
+/**
+ * @brief  Add the MQTT sink. Call once mqtt_telemetry_start() succeeded;
+ *         windows are held until the wall clock is known, then rebased.
+ */
+esp_err_t sinks_add_mqtt(void);
+
+/**
+ * @brief  Add the local CSV log. Works offline: windows closed before SNTP
+ *         are written with seconds since boot and marked as such.
+ */
+esp_err_t sinks_add_csv(void);
@@ -0,0 +1,126 @@
+// timebase.c — monotonic sample clock with SNTP rebase
+//
+// Sampling no longer waits for SNTP. Windows closed before the wall clock
+// is known are stamped with monotonic esp_timer seconds and held back;
+// when the first sync lands, subscribers are woken and rebase what they
+// hold by the wall-clock time of boot. On a soft reset the RTC keeps the
+// wall clock, so the node counts as synced from the start.
+
+#include "timebase.h"
+
+#include <inttypes.h>
+#include <sys/time.h>
+#include "freertos/event_groups.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_sntp.h"
+
+static const char *TAG = "SNTP";
+
+#define SYNCED_BIT BIT0
+
+static struct
+{
+    EventGroupHandle_t events;
+    TaskHandle_t subscribers[TIMEBASE_MAX_SUBSCRIBERS];
+    uint8_t n_subscribers;
+    uint32_t syncs;
+} s_tb;
+
+static void time_sync_notification_cb(struct timeval *tv)
+{
+    s_tb.syncs++;
+    time_t now = tv->tv_sec;
+    struct tm tm;
+    gmtime_r(&now, &tm);
+    ESP_LOGI(TAG, "Time synchronized: %04d-%02d-%02dT%02d:%02d:%02dZ (sync %" PRIu32 ")",
+             tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec,
+             s_tb.syncs);
+
+    xEventGroupSetBits(s_tb.events, SYNCED_BIT);
+    for (uint8_t i = 0; i < s_tb.n_subscribers; i++)
+    {
+        xTaskNotifyGive(s_tb.subscribers[i]);
+    }
+}
+
+esp_err_t timebase_start(void)
+{
+    if (s_tb.events)
+    {
+        return ESP_OK;
+    }
+    s_tb.events = xEventGroupCreate();
+    if (!s_tb.events)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    if (timebase_synced())
+    {
+        xEventGroupSetBits(s_tb.events, SYNCED_BIT);
+        ESP_LOGI(TAG, "Wall clock kept across reset, SNTP only refines it");
+    }
+
+    ESP_LOGI(TAG, "Initializing SNTP...");
+    esp_sntp_setoperatingmode(SNTP_OPMODE_POLL);
+    esp_sntp_setservername(0, TIMEBASE_SNTP_SERVER);
+    esp_sntp_set_time_sync_notification_cb(time_sync_notification_cb);
+    // slew rather than step once the clock is close; the first sync steps
+    esp_sntp_set_sync_mode(SNTP_SYNC_MODE_SMOOTH);
+    esp_sntp_set_sync_interval(TIMEBASE_SYNC_INTERVAL_MS);
+    esp_sntp_init();
+    return ESP_OK;
+}
+
+bool timebase_synced(void)
+{
+    return timebase_is_wall(time(NULL));
+}
+
+bool timebase_wait(TickType_t timeout)
+{
+    if (timebase_synced())
+    {
+        return true;
+    }
+    if (!s_tb.events)
+    {
+        return false;
+    }
+    xEventGroupWaitBits(s_tb.events, SYNCED_BIT, pdFALSE, pdFALSE, timeout);
+    return timebase_synced();
+}
+
+time_t timebase_monotonic(int64_t t_us)
+{
+    return (time_t)(t_us / 1000000);
+}
+
+time_t timebase_wall_at(int64_t t_us)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    int64_t wall_us = (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+    return (time_t)((wall_us - (esp_timer_get_time() - t_us)) / 1000000);
+}
+
+time_t timebase_offset(void)
+{
+    return timebase_synced() ? timebase_wall_at(0) : 0;
+}
+
+time_t timebase_rebase(time_t t)
+{
+    return timebase_is_wall(t) ? t : t + timebase_offset();
+}
+
+esp_err_t timebase_subscribe(TaskHandle_t task)
+{
+    if (s_tb.n_subscribers == TIMEBASE_MAX_SUBSCRIBERS)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    s_tb.subscribers[s_tb.n_subscribers++] = task;
+    return ESP_OK;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+
+/* Anything earlier means the RTC was never set (cold boot, no SNTP yet) */
+#define TIMEBASE_MIN_VALID_EPOCH 1704067200 // 2024-01-01T00:00:00Z
+#define TIMEBASE_SNTP_SERVER "pool.ntp.org"
+#define TIMEBASE_SYNC_INTERVAL_MS (3600 * 1000)
+#define TIMEBASE_MAX_SUBSCRIBERS 4
+
+/**
+ * Records are stamped in one of two time bases. Until the wall clock is
+ * known they carry monotonic seconds since boot (esp_timer), which are far
+ * below TIMEBASE_MIN_VALID_EPOCH; once it is known, they carry wall-clock
+ * seconds. timebase_rebase() turns the former into the latter, so buffered
+ * records can be fixed up after the first SNTP sync.
+ */
+
+/**
+ * @brief  Start SNTP in the background. Never waits for the first sync;
+ *         subscribers are notified when it (and every later sync) lands.
+ *         Call once the network stack is up.
+ */
+esp_err_t timebase_start(void);
+
+/** @brief True once the wall clock is valid (SNTP, or kept across a soft reset). */
+bool timebase_synced(void);
+
+/** @brief Wait up to `timeout` for the wall clock; true if it is valid. */
+bool timebase_wait(TickType_t timeout);
+
+/** @brief Monotonic stamp of an esp_timer instant: seconds since boot. */
+time_t timebase_monotonic(int64_t t_us);
+
+/** @brief Wall-clock stamp of an esp_timer instant. Only meaningful once synced. */
+time_t timebase_wall_at(int64_t t_us);
+
+/** @brief Wall clock minus monotonic time, in seconds; 0 until synced. */
+time_t timebase_offset(void);
+
+/** @brief True if `t` is a wall-clock stamp rather than a monotonic one. */
+static inline bool timebase_is_wall(time_t t)
+{
+    return t >= TIMEBASE_MIN_VALID_EPOCH;
+}
+
+/**
+ * @brief  Convert a monotonic stamp to wall clock. Wall-clock stamps, and
+ *         any stamp while still unsynced, are returned unchanged.
+ */
+time_t timebase_rebase(time_t t);
+
+/** @brief Have `task` notified (xTaskNotifyGive) on every SNTP sync. */
+esp_err_t timebase_subscribe(TaskHandle_t task);
@@ -0,0 +1,749 @@
+// uploader.c — window aggregation and Firestore upload, off the timer daemon
+//
+// The acquisition task only pushes sample_rec_t records into a lock-free SPSC
+// ring. The aggregator task, on the acquisition core, drains the ring and
+// closes averaging windows (one per channel) on the esp_timer clock. The
+// uploader task, on the network core, uploads full batches, so network
+// latency and TLS work can no longer delay or drop samples. Window length
+// and batch size follow the runtime cadence (cadence.c).
+//
+// Closed windows go to the sink router (sink_router.h), which fans them out
+// to Firestore, MQTT and the local CSV log, each behind its own queue. The
+// Firestore sink appends them to a CRC-protected segment log on the FAT
+// partition before anything is sent, and the uploader drains it in large
+// batches, so failed uploads and reboots no longer lose data.
+//
+// Sampling starts at boot, before the network. Until SNTP has set the wall
+// clock, windows are stamped with monotonic seconds (timebase.c) and wait in
+// the Firestore sink's queue; nothing unsynced reaches the flash log. The
+// first sync rebases them, and uploads (JWT and TLS both need the time) start.
+
+#include "uploader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+
+#include "spsc_ring.h"
+#include "sensor_record.h"
+#include "record_log.h"
+#include "win_stats.h"
+#include "report_filter.h"
+#include "firebase.h"
+#include "breaker.h"
+#include "sink_router.h"
+#include "config_cache.h"
+#include "cadence.h"
+#include "perf_metrics.h"
+#include "timebase.h"
+#include "boot.h"
+#include "acquisition.h"
+
+static const char *TAG = "Uploader";
+
+
+/* Sample queue between the acquisition task and the aggregator */
+static sample_rec_t sample_storage[SAMPLE_QUEUE_LEN];
+static spsc_ring_t sample_ring;
+static TaskHandle_t aggregator_task_handle;
+static TaskHandle_t uploader_task_handle;
+
+/* Current window of each channel, only touched by the aggregator task */
+static win_stats_t windows[SENSOR_MAX_CHANNELS];
+static int32_t window_max_jitter_us;
+static int32_t max_jitter_us;
+
+/* Flash log opened; retried by the Firestore sink (e.g. after a USB host
+ * released the volume) */
+static bool log_ready;
+
+/* Wall clock known; latched here so one window never mixes time bases */
+static bool clock_valid;
+
+/* Records read back from the log for one commit */
+static avg_sample_t upload_buffer[UPLOAD_MAX_RECORDS];
+/* Records to read for the next commit; follows what the body budget took */
+static size_t chunk_max = UPLOAD_MAX_RECORDS;
+/* Records of a rejected commit not yet resent in smaller pieces; while
+ * non-zero the chunk only shrinks, so a bad record is found by halving */
+static size_t suspect;
+
+/* Cadence as last applied by each task */
+static uint32_t window_gen;   // aggregator
+static int64_t window_us;
+static uint32_t batch_gen;    // uploader
+static uint32_t batch_base;   // configured batch size
+static uint32_t batch_size;   // effective, grows in adaptive mode
+static bool batch_adaptive;
+
+/* Recent commits and the retry gate, for the `uploads` console command;
+ * written by the uploader, copied out under the lock */
+static portMUX_TYPE status_lock = portMUX_INITIALIZER_UNLOCKED;
+static upload_result_t history[UPLOAD_HISTORY_LEN];
+static uint8_t history_head;
+static breaker_t upload_breaker;
+static uint8_t history_count;
+
+/* Metrics, registered in uploader_start() */
+static perf_metric_t *m_window_us;
+static perf_metric_t *m_flash_read_us;
+static perf_metric_t *m_commit_us;
+static perf_metric_t *m_uploaded;
+static perf_metric_t *m_upload_failures;
+static perf_metric_t *m_upload_dropped;
+static perf_metric_t *m_read_errors;
+static perf_metric_t *m_breaker_state;
+static perf_metric_t *m_drain_rate;
+static perf_metric_t *m_pending;
+static perf_metric_t *m_queue_depth;
+
+/* ----------------------------------------------------------------------------
+ * upload_batch
+ *   Streams a documents:commit body for `count` records to Firestore
+ * ------------------------------------------------------------------------- */
+static esp_err_t upload_batch(const avg_sample_t *records, size_t count,
+                              firebase_commit_result_t *res)
+{
+    // one stat() per batch; the file is only re-parsed if it changed
+    config_cache_refresh();
+
+    esp_err_t err = firebase_commit_records(records, count, res);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE("FIREBASE_HELPER", "failed to send to firestore (%s)",
+                 firestore_action_name(res->action));
+    }
+    return err;
+}
+
+/* ----------------------------------------------------------------------------
+ * log_sink_write
+ *   Firestore sink: appends a window to the flash log and wakes the
+ *   uploader. Fails, so the router holds and retries the window, while the
+ *   stamp cannot be rebased yet or the log is unavailable
+ * ------------------------------------------------------------------------- */
+static esp_err_t log_sink_write(void *ctx, const avg_sample_t *recs, size_t count)
+{
+    if (!timebase_synced())
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!log_ready)
+    {
+        log_ready = record_log_init(UPLOAD_LOG_DIR, sizeof(avg_sample_t)) == ESP_OK;
+        if (!log_ready)
+        {
+            return ESP_ERR_INVALID_STATE;
+        }
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        avg_sample_t rec = recs[i];
+        rec.timestamp = timebase_rebase(rec.timestamp);
+        esp_err_t err = record_log_append(&rec);
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+    }
+    xTaskNotifyGive(uploader_task_handle);
+    return ESP_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * adapt_batch
+ *   Adaptive mode: a failed or slow upload doubles the batch (fewer, larger
+ *   commits while the link struggles); each fast one steps it back down
+ *   towards the configured size
+ * ------------------------------------------------------------------------- */
+static void adapt_batch(bool ok, int64_t took_us)
+{
+    if (!batch_adaptive)
+    {
+        return;
+    }
+
+    uint32_t old = batch_size;
+    if (!ok || took_us > (int64_t)ADAPT_SLOW_MS * 1000)
+    {
+        batch_size = MIN(batch_size * 2, MAX(batch_base, ADAPT_MAX_BATCH));
+    }
+    else if (took_us < (int64_t)ADAPT_FAST_MS * 1000 && batch_size > batch_base)
+    {
+        batch_size--;
+    }
+    if (batch_size != old)
+    {
+        ESP_LOGI(TAG, "Adaptive batch %" PRIu32 " -> %" PRIu32 " (upload %s, %lld ms)",
+                 old, batch_size, ok ? "ok" : "failed", (long long)(took_us / 1000));
+    }
+}
+
+static void record_history(size_t records, int64_t took_us, const firebase_commit_result_t *res)
+{
+    taskENTER_CRITICAL(&status_lock);
+    history[history_head] = (upload_result_t){
+        .at = time(NULL),
+        .took_ms = (uint32_t)(took_us / 1000),
+        .records = (uint16_t)records,
+        .acked = (uint16_t)res->acked,
+        .http_status = (int16_t)res->http_status,
+        .action = (uint8_t)res->action,
+        .ok = res->action == FIRESTORE_ACK,
+    };
+    history_head = (history_head + 1) % UPLOAD_HISTORY_LEN;
+    if (history_count < UPLOAD_HISTORY_LEN)
+    {
+        history_count++;
+    }
+    taskEXIT_CRITICAL(&status_lock);
+}
+
+/* ----------------------------------------------------------------------------
+ * gate_allow / gate_report
+ *   The retry gate around commits. gate_allow() says whether a commit may
+ *   start now and whether it is the half-open probe; gate_report() feeds
+ *   back whether the endpoint answered sensibly (a rejected batch counts
+ *   as an answer, the link works). gate_cancel() takes back an allowed
+ *   commit that never reached the endpoint; only endpoint outcomes count
+ * ------------------------------------------------------------------------- */
+static bool gate_allow(bool *probe)
+{
+    taskENTER_CRITICAL(&status_lock);
+    bool ok = breaker_allow(&upload_breaker, esp_timer_get_time());
+    *probe = upload_breaker.state == BREAKER_HALF_OPEN;
+    taskEXIT_CRITICAL(&status_lock);
+    return ok;
+}
+
+static void gate_report(bool ok)
+{
+    int64_t now = esp_timer_get_time();
+    taskENTER_CRITICAL(&status_lock);
+    breaker_state_t before = upload_breaker.state;
+    breaker_state_t after = ok ? breaker_success(&upload_breaker, now)
+                               : breaker_failure(&upload_breaker, now);
+    int64_t wait_us = breaker_wait_us(&upload_breaker, now);
+    taskEXIT_CRITICAL(&status_lock);
+
+    perf_gauge_set(m_breaker_state, (int32_t)after);
+    if (after != before)
+    {
+        ESP_LOGW(TAG, "Upload breaker %s -> %s", breaker_state_name(before),
+                 breaker_state_name(after));
+    }
+    if (!ok)
+    {
+        ESP_LOGW(TAG, "Next upload attempt in %lld s", (long long)(wait_us / 1000000));
+    }
+}
+
+static void gate_cancel(void)
+{
+    taskENTER_CRITICAL(&status_lock);
+    breaker_cancel(&upload_breaker);
+    taskEXIT_CRITICAL(&status_lock);
+}
+
+/* How long the uploader may sleep before the gate lets a waiting batch out */
+static TickType_t gate_wait_ticks(void)
+{
+    if (!timebase_synced() || record_log_pending() < batch_size)
+    {
+        return portMAX_DELAY; // the next append wakes it
+    }
+    taskENTER_CRITICAL(&status_lock);
+    int64_t wait_us = breaker_wait_us(&upload_breaker, esp_timer_get_time());
+    taskEXIT_CRITICAL(&status_lock);
+    return wait_us ? pdMS_TO_TICKS(wait_us / 1000) + 1 : portMAX_DELAY;
+}
+
+/* ----------------------------------------------------------------------------
+ * read_chunk
+ *   Peeks the next commit's records: up to chunk_max, trimmed to what fits
+ *   the Firestore body budget. chunk_max tracks the trimmed size, so a
+ *   backlog is normally read once per commit; a misjudged read is redone
+ *   shorter, which also moves the peek (and commit) cursor to match. It
+ *   does not grow while a rejected commit is being split (see split_rejected)
+ * ------------------------------------------------------------------------- */
+static esp_err_t read_chunk(size_t max, size_t *count)
+{
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = record_log_peek(upload_buffer, max, count);
+    if (err == ESP_OK && *count > 1)
+    {
+        size_t fit = firebase_commit_fit(upload_buffer, *count);
+        if (fit < *count)
+        {
+            chunk_max = fit + 1; // the next records may be shorter
+            err = record_log_peek(upload_buffer, fit, count);
+        }
+        else if (*count == max && chunk_max < UPLOAD_MAX_RECORDS && suspect == 0)
+        {
+            chunk_max = MIN(chunk_max + chunk_max / 4 + 1, UPLOAD_MAX_RECORDS);
+        }
+    }
+    perf_hist_since(m_flash_read_us, start);
+    return err;
+}
+
+/* ----------------------------------------------------------------------------
+ * split_rejected
+ *   The server rejected a commit of `count` records as such (FIRESTORE_DROP).
+ *   One bad value, or a proxy refusing the request, must not cost the whole
+ *   chunk: it is resent in halves, and only a single record the server still
+ *   rejects is dropped. Returns true if that record was dropped
+ * ------------------------------------------------------------------------- */
+static bool split_rejected(size_t count)
+{
+    if (count > 1)
+    {
+        suspect = MAX(suspect, count);
+        chunk_max = count / 2;
+        ESP_LOGW(TAG, "Commit of %u records rejected, resending %u at a time",
+                 (unsigned)count, (unsigned)chunk_max);
+        return false;
+    }
+    record_log_commit();
+    perf_count(m_upload_dropped, 1);
+    suspect -= MIN(suspect, 1);
+    return true;
+}
+
+/* ----------------------------------------------------------------------------
+ * drain_chunks
+ *   Uploads from the flash log while at least batch_size records are
+ *   pending. After an outage this runs commits back to back on the kept-
+ *   alive connection, each as large as Firestore and the body budget
+ *   allow, until the backlog is gone or an upload fails. While the retry
+ *   gate is backing off this returns at once; the records wait.
+ *   Returns the records uploaded, `commits` the commits that carried them
+ * ------------------------------------------------------------------------- */
+static size_t drain_chunks(size_t *commits)
+{
+    size_t uploaded = 0;
+    *commits = 0;
+    // JWT and TLS need the wall clock; windows only reach the log once it is set
+    while (timebase_synced() && record_log_pending() >= batch_size)
+    {
+        bool probe;
+        if (!gate_allow(&probe))
+        {
+            return uploaded;
+        }
+
+        // the probe of an open breaker is the smallest useful commit
+        size_t count = 0;
+        esp_err_t err = read_chunk(probe ? 1 : chunk_max, &count);
+        if (err != ESP_OK || count == 0)
+        {
+            // local (flash) trouble, not the endpoint's; retried after the
+            // next append without touching the breaker or its budget
+            ESP_LOGE(TAG, "Flash log read failed (%s, %u of %" PRIu32 " pending records)",
+                     esp_err_to_name(err), (unsigned)count, record_log_pending());
+            perf_count(m_read_errors, 1);
+            gate_cancel();
+            return uploaded;
+        }
+
+        firebase_commit_result_t res;
+        int64_t start = esp_timer_get_time();
+        err = upload_batch(upload_buffer, count, &res);
+        if (err == ESP_ERR_INVALID_STATE)
+        {
+            // nothing was sent; the credential manager starts after SNTP
+            gate_cancel();
+            return uploaded;
+        }
+        int64_t took_us = esp_timer_get_time() - start;
+        perf_hist_since(m_commit_us, start);
+        record_history(count, took_us, &res);
+        adapt_batch(err == ESP_OK, took_us);
+        gate_report(err == ESP_OK || res.action == FIRESTORE_DROP);
+        if (res.action == FIRESTORE_DROP)
+        {
+            // the server rejected the batch itself; resending it whole would
+            // only hold back everything behind it
+            if (split_rejected(count))
+            {
+                ESP_LOGE(TAG, "Record at %lld ch%u rejected (HTTP %d), dropped",
+                         (long long)upload_buffer[0].timestamp, upload_buffer[0].channel,
+                         res.http_status);
+            }
+            continue;
+        }
+        if (err != ESP_OK)
+        {
+            perf_count(m_upload_failures, 1);
+            // records stay in the log; retried after the next window
+            return uploaded;
+        }
+        record_log_commit();
+        suspect -= MIN(suspect, count);
+        perf_count(m_uploaded, count);
+        boot_mark(BOOT_MILESTONE_FIRST_UPLOAD);
+        uploaded += count;
+        (*commits)++;
+        ESP_LOGI(TAG, "Uploaded %u records (%" PRIu32 " bytes) in %lld ms, %" PRIu32 " pending",
+                 (unsigned)count, res.body_bytes, (long long)(took_us / 1000),
+                 record_log_pending());
+    }
+    return uploaded;
+}
+
+/* ----------------------------------------------------------------------------
+ * drain_log
+ *   One drain pass; reports its throughput in records/s, which is what a
+ *   backlog after an outage drains at
+ * ------------------------------------------------------------------------- */
+static void drain_log(void)
+{
+    int64_t start = esp_timer_get_time();
+    size_t commits;
+    size_t uploaded = drain_chunks(&commits);
+    if (uploaded == 0)
+    {
+        return;
+    }
+
+    int64_t took_us = MAX(esp_timer_get_time() - start, 1);
+    uint32_t rate = (uint32_t)((int64_t)uploaded * 1000000 / took_us);
+    perf_gauge_set(m_drain_rate, (int32_t)rate);
+    if (commits > 1)
+    {
+        ESP_LOGI(TAG, "Backlog: %u records in %u commits, %lld ms, %" PRIu32 " records/s",
+                 (unsigned)uploaded, (unsigned)commits, (long long)(took_us / 1000), rate);
+    }
+}
+
+/* ----------------------------------------------------------------------------
+ * apply_window_cadence
+ *   Aggregator side: picks up a new window length. The window in progress
+ *   keeps its samples and start time; only its end moves.
+ * ------------------------------------------------------------------------- */
+static void apply_window_cadence(int64_t *window_end)
+{
+    cadence_t cad;
+    cadence_get(&cad);
+    window_gen = cadence_generation();
+
+    int64_t new_us = (int64_t)cad.window_ms * 1000;
+    if (window_end)
+    {
+        int64_t window_start = *window_end - window_us;
+        *window_end = window_start + new_us;
+    }
+    window_us = new_us;
+}
+
+/* Uploader side: picks up a new batch size and mode */
+static void apply_batch_cadence(void)
+{
+    cadence_t cad;
+    cadence_get(&cad);
+    batch_gen = cadence_generation();
+
+    batch_base = cad.batch_size;
+    batch_adaptive = cad.adaptive;
+    if (!batch_adaptive || batch_size < batch_base)
+    {
+        batch_size = batch_base;
+    }
+}
+
+/* ----------------------------------------------------------------------------
+ * check_clock
+ *   On the first SNTP sync, moves the report filters onto the wall clock;
+ *   the sinks rebase the windows they hold as they write them out
+ * ------------------------------------------------------------------------- */
+static void check_clock(void)
+{
+    if (clock_valid || !timebase_synced())
+    {
+        return;
+    }
+    clock_valid = true;
+    time_t offset = timebase_offset();
+    report_filter_shift_time(offset);
+    ESP_LOGI(TAG, "Wall clock valid, held windows move by %lld s", (long long)offset);
+}
+
+/* ----------------------------------------------------------------------------
+ * close_window
+ *   Computes the average of every channel's finished window and hands the
+ *   ones the report filter keeps to the sinks
+ * ------------------------------------------------------------------------- */
+static void close_window(int64_t end_us)
+{
+    int64_t start = esp_timer_get_time();
+    check_clock();
+    time_t now = clock_valid ? timebase_wall_at(end_us) : timebase_monotonic(end_us);
+    unsigned closed = 0;
+
+    for (uint8_t ch = 0; ch < SENSOR_MAX_CHANNELS; ch++)
+    {
+        if (windows[ch].count == 0)
+        {
+            continue;
+        }
+
+        /* Record timestamped statistics and reset */
+        win_stats_summary_t sum;
+        win_stats_summary(&windows[ch], &sum);
+        win_stats_reset(&windows[ch]);
+
+        avg_sample_t rec;
+        memset(&rec, 0, sizeof(rec)); // padding goes to flash, keep it zero
+        rec.timestamp = now;
+        rec.average = sum.mean;
+        rec.channel = ch;
+        rec.samples = sum.count > UINT16_MAX ? UINT16_MAX : (uint16_t)sum.count;
+        rec.min = sum.min;
+        rec.max = sum.max;
+        rec.stddev = sum.stddev;
+        rec.p50 = sum.p50;
+        rec.p95 = sum.p95;
+        closed++;
+        ESP_LOGI(TAG, "Window ch%u: avg %.2f min %.2f max %.2f sd %.2f p50 %.2f p95 %.2f (%u samples)",
+                 ch, rec.average, rec.min, rec.max, rec.stddev, rec.p50, rec.p95, rec.samples);
+
+        /* Only windows the channel's report filter keeps go out */
+        avg_sample_t out[2];
+        size_t n = report_filter_process(&rec, out);
+        for (size_t i = 0; i < n; i++)
+        {
+            sink_router_publish(&out[i]);
+        }
+    }
+
+    if (closed == 0)
+    {
+        ESP_LOGW(TAG, "No samples in this window");
+        return;
+    }
+    perf_hist_since(m_window_us, start);
+    perf_gauge_set(m_pending, (int32_t)record_log_pending());
+    perf_gauge_set(m_queue_depth, (int32_t)spsc_ring_count(&sample_ring));
+
+    report_filter_stats_t fs;
+    report_filter_get_stats(REPORT_FILTER_ALL_CHANNELS, &fs);
+    ESP_LOGI(TAG, "Closed %u windows at %lld  (pending=%" PRIu32 ")",
+             closed, (long long)now, record_log_pending());
+    ESP_LOGI(TAG, "Report filter: emitted=%" PRIu32 " suppressed=%" PRIu32,
+             fs.emitted, fs.suppressed);
+    ESP_LOGI(TAG, "Sample queue: depth=%" PRIu32 " max=%" PRIu32 " dropped=%" PRIu32
+                  ", jitter: window max=%" PRId32 " us, max=%" PRId32 " us",
+             spsc_ring_count(&sample_ring), spsc_ring_high_water(&sample_ring),
+             spsc_ring_dropped(&sample_ring), window_max_jitter_us, max_jitter_us);
+    window_max_jitter_us = 0;
+}
+
+static void accumulate(const sample_rec_t *rec)
+{
+    if (rec->channel >= SENSOR_MAX_CHANNELS)
+    {
+        return;
+    }
+    win_stats_t *w = &windows[rec->channel];
+    win_stats_add(w, rec->value);
+
+    int32_t jitter = rec->jitter_us < 0 ? -rec->jitter_us : rec->jitter_us;
+    if (jitter > window_max_jitter_us)
+    {
+        window_max_jitter_us = jitter;
+    }
+    if (jitter > max_jitter_us)
+    {
+        max_jitter_us = jitter;
+    }
+    ESP_LOGD(TAG, "Sampled ch%u: %.2f  (mean=%.2f count=%" PRIu32 ")",
+             rec->channel, rec->value, w->mean, w->count);
+}
+
+static void aggregator_task(void *pvParameters)
+{
+    int64_t window_end = esp_timer_get_time() + window_us;
+
+    for (;;)
+    {
+        /* Sleep until a sample arrives or the window is due */
+        int64_t now = esp_timer_get_time();
+        TickType_t wait = 0;
+        if (now < window_end)
+        {
+            wait = pdMS_TO_TICKS((window_end - now) / 1000) + 1;
+        }
+        ulTaskNotifyTake(pdTRUE, wait);
+
+        if (!clock_valid && timebase_synced())
+        {
+            /* First sync: have the sinks write out what they hold now
+             * rather than at their next retry */
+            check_clock();
+            sink_router_kick();
+        }
+
+        if (cadence_generation() != window_gen)
+        {
+            apply_window_cadence(&window_end);
+            if (esp_timer_get_time() >= window_end)
+            {
+                /* Shortened below the time already elapsed: close it now */
+                close_window(esp_timer_get_time());
+                window_end = esp_timer_get_time() + window_us;
+            }
+        }
+
+        sample_rec_t rec;
+        while (spsc_ring_pop(&sample_ring, &rec))
+        {
+            /* A sample past the boundary closes the window first; this
+             * keeps windows exact even after a long upload */
+            while (rec.t_us >= window_end)
+            {
+                close_window(window_end);
+                window_end += window_us;
+            }
+            accumulate(&rec);
+        }
+
+        if (esp_timer_get_time() >= window_end)
+        {
+            close_window(window_end);
+            window_end += window_us;
+        }
+    }
+}
+
+static void uploader_task(void *pvParameters)
+{
+    for (;;)
+    {
+        /* Woken by the Firestore sink after every append, by cadence
+         * changes, and when the retry gate opens again */
+        ulTaskNotifyTake(pdTRUE, gate_wait_ticks());
+        if (cadence_generation() != batch_gen)
+        {
+            apply_batch_cadence();
+        }
+        drain_log();
+    }
+}
+
+esp_err_t uploader_start(void)
+{
+    esp_err_t err = spsc_ring_init(&sample_ring, sample_storage,
+                                   sizeof(sample_rec_t), SAMPLE_QUEUE_LEN);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+
+    for (uint8_t ch = 0; ch < SENSOR_MAX_CHANNELS; ch++)
+    {
+        win_stats_reset(&windows[ch]);
+    }
+    apply_window_cadence(NULL);
+    apply_batch_cadence();
+    const breaker_cfg_t gate = {
+        .base_ms = UPLOAD_BACKOFF_MIN_MS,
+        .max_ms = UPLOAD_BACKOFF_MAX_MS,
+        .threshold = UPLOAD_BREAKER_THRESHOLD,
+        .budget = UPLOAD_RETRY_BUDGET,
+        .refill_ms = UPLOAD_BUDGET_REFILL_MS,
+    };
+    breaker_init(&upload_breaker, &gate, esp_random(), esp_timer_get_time());
+
+    m_window_us = perf_histogram("window.close_us");
+    m_flash_read_us = perf_histogram("flash.read_us");
+    m_commit_us = perf_histogram("upload.commit_us");
+    m_uploaded = perf_counter("upload.records");
+    m_upload_failures = perf_counter("upload.failures");
+    m_upload_dropped = perf_counter("upload.dropped");
+    m_read_errors = perf_counter("upload.read_errors");
+    m_breaker_state = perf_gauge("upload.breaker"); // 0 closed, 1 open, 2 half-open
+    m_drain_rate = perf_gauge("upload.records_per_s");
+    m_pending = perf_gauge("log.pending");
+    m_queue_depth = perf_gauge("queue.depth");
+
+    // every buffer a commit needs, reserved before the heap fragments
+    if (firebase_init() != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Upload arena not reserved, retrying at the first commit");
+    }
+
+    // records left over from before a reboot are drained after the first window
+    log_ready = record_log_init(UPLOAD_LOG_DIR, sizeof(avg_sample_t)) == ESP_OK;
+    if (!log_ready)
+    {
+        ESP_LOGW(TAG, "Flash log not available yet, buffering in RAM");
+    }
+    const sink_cfg_t log_sink = {
+        .name = "firestore",
+        .write = log_sink_write,
+        .queue_len = LOG_SINK_QUEUE_LEN,
+        .batch = 1, // one append per window, never half written
+        .retry_min_ms = LOG_SINK_RETRY_MIN_MS,
+        .retry_max_ms = LOG_SINK_RETRY_MAX_MS,
+    };
+
+    // the uploader first, the aggregator notifies it
+    if (xTaskCreatePinnedToCore(&uploader_task, "uploader", UPLOADER_STACK_SIZE, NULL,
+                                UPLOADER_PRIORITY, &uploader_task_handle,
+                                UPLOADER_CORE) != pdPASS ||
+        xTaskCreatePinnedToCore(&aggregator_task, "aggregator", AGGREGATOR_STACK_SIZE, NULL,
+                                AGGREGATOR_PRIORITY, &aggregator_task_handle,
+                                ACQ_CORE) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Uploader task creation failed");
+        return ESP_ERR_NO_MEM;
+    }
+    err = sink_router_add(&log_sink, NULL);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Firestore sink failed: %s", esp_err_to_name(err));
+        return err;
+    }
+    cadence_subscribe(aggregator_task_handle);
+    cadence_subscribe(uploader_task_handle);
+    timebase_subscribe(aggregator_task_handle);
+    perf_watch_task(aggregator_task_handle, "aggregator");
+    perf_watch_task(uploader_task_handle, "uploader");
+    return ESP_OK;
+}
+
+bool uploader_push_sample(const sample_rec_t *rec)
+{
+    if (!spsc_ring_push(&sample_ring, rec))
+    {
+        return false;
+    }
+    xTaskNotifyGive(aggregator_task_handle);
+    return true;
+}
+
+void uploader_get_status(uploader_status_t *out)
+{
+    out->queue_depth = spsc_ring_count(&sample_ring);
+    out->log_pending = record_log_pending();
+    out->batch_size = batch_size;
+
+    taskENTER_CRITICAL(&status_lock);
+    breaker_get_stats(&upload_breaker, esp_timer_get_time(), &out->breaker);
+    out->history_count = history_count;
+    for (uint8_t i = 0; i < history_count; i++)
+    {
+        uint8_t idx = (history_head + UPLOAD_HISTORY_LEN - history_count + i) % UPLOAD_HISTORY_LEN;
+        out->history[i] = history[idx];
+    }
+    taskEXIT_CRITICAL(&status_lock);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "breaker.h"
+
+/* Boot defaults; see cadence.h for cfg.json/NVS overrides and live changes */
+#define SAMPLE_INTERVAL_MS 5000  // default channel sample period
+#define WINDOW_INTERVAL_MS 60000 // average window = 60 s
+#define BATCH_SIZE 5
+
+/* Aggregation shares the acquisition core; uploads run on the network core
+ * with TLS, lwIP and MQTT (see Kconfig.projbuild) */
+#define AGGREGATOR_STACK_SIZE CONFIG_SENSORCTL_AGG_STACK_SIZE
+#define AGGREGATOR_PRIORITY CONFIG_SENSORCTL_AGG_PRIORITY
+#define UPLOADER_STACK_SIZE CONFIG_SENSORCTL_UPLOADER_STACK_SIZE
+#define UPLOADER_PRIORITY CONFIG_SENSORCTL_UPLOADER_PRIORITY
+#define UPLOADER_CORE CONFIG_SENSORCTL_NET_CORE
+#define SAMPLE_QUEUE_LEN 256     // power of two; ~40 s of 32 channels at 5 s
+
+#define UPLOAD_LOG_DIR "/data/rlog" // store-and-forward log on the FAT partition
+#define UPLOAD_MAX_RECORDS 500   // records per commit when draining a backlog (Firestore's limit)
+#define LOG_SINK_QUEUE_LEN 64    // windows held in RAM while the clock or the flash log is unavailable
+#define LOG_SINK_RETRY_MIN_MS 1000
+#define LOG_SINK_RETRY_MAX_MS 30000
+#define UPLOAD_HISTORY_LEN 16    // recent commits kept for the `uploads` console command
+
+/* Firestore retry gate (components/breaker): while commits fail the
+ * uploader backs off, and after a run of failures only probes now and
+ * then with a one-record commit; windows keep going to the flash log */
+#define UPLOAD_BACKOFF_MIN_MS 2000
+#define UPLOAD_BACKOFF_MAX_MS 300000     // also how long the breaker stays open
+#define UPLOAD_BREAKER_THRESHOLD 5       // consecutive failed commits
+#define UPLOAD_RETRY_BUDGET 10           // failed commits absorbed before opening anyway
+#define UPLOAD_BUDGET_REFILL_MS 600000   // one budget token back per 10 min
+
+/* Adaptive batching: slower uploads double the batch, faster ones shrink it */
+#define ADAPT_SLOW_MS 3000
+#define ADAPT_FAST_MS 1000
+#define ADAPT_MAX_BATCH 100      // growth cap; a backlog is chunked up to UPLOAD_MAX_RECORDS anyway
+
+/* Fixed-size record handed from the acquisition task to the uploader task */
+typedef struct
+{
+    int64_t t_us;      // esp_timer time of the read
+    int32_t jitter_us; // how late the read ran versus its schedule
+    float value;       // scaled channel value (e.g. °F, %RH)
+    uint8_t channel;   // acquisition channel id
+} sample_rec_t;
+
+/* Outcome of one Firestore commit */
+typedef struct
+{
+    time_t at;         // wall clock when it finished
+    uint32_t took_ms;  // request round trip, body streaming included
+    uint16_t records;
+    uint16_t acked;      // writes the response confirmed
+    int16_t http_status; // 0: no response
+    uint8_t action;      // firestore_action_t
+    bool ok;
+} upload_result_t;
+
+typedef struct
+{
+    uint32_t queue_depth;  // samples waiting in the acquisition ring
+    uint32_t log_pending;  // windows in the flash log not yet uploaded
+    uint32_t batch_size;   // effective batch size
+    breaker_stats_t breaker;
+    uint8_t history_count;
+    upload_result_t history[UPLOAD_HISTORY_LEN]; // oldest first
+} uploader_status_t;
+
+/**
+ * @brief  Create the sample queue, add the Firestore sink and start the
+ *         aggregator task, which drains the queue and closes one averaging
+ *         window per channel, and the uploader task, which uploads full
+ *         batches from the flash log.
+ */
+esp_err_t uploader_start(void);
+
+/**
+ * @brief  Queue one sample. Producer side, only call from the acquisition task.
+ *         Never blocks; returns false if the queue is full.
+ */
+bool uploader_push_sample(const sample_rec_t *rec);
+
+/** @brief Queue/log depths and the last UPLOAD_HISTORY_LEN commits. */
+void uploader_get_status(uploader_status_t *out);